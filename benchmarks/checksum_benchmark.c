@@ -0,0 +1,66 @@
+#include "mpnw/checksum.h"
+
+#include "mpmt/thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BYTE_COUNT_PER_SIZE (1ULL << 31)
+#define MAX_BUFFER_SIZE (1 << 20)
+
+static const size_t bufferSizes[] = {
+	64, 1024, 16384, MAX_BUFFER_SIZE,
+};
+
+int main()
+{
+	uint8_t* buffer = malloc(
+		MAX_BUFFER_SIZE * sizeof(uint8_t));
+
+	if (buffer == NULL)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < MAX_BUFFER_SIZE; i++)
+		buffer[i] = (uint8_t)(i * 31 + (i >> 8));
+
+	// Known check value of the "123456789" string
+	if (updateCrc32c(0, "123456789", 9) != 0xE3069283)
+	{
+		printf("Incorrect CRC32C check value\n");
+		free(buffer);
+		return EXIT_FAILURE;
+	}
+
+	printf("CRC32C: %s\n", isCrc32cAccelerated() == true ?
+		"hardware instructions" : "slicing-by-8 table");
+
+	size_t sizeCount = sizeof(bufferSizes) / sizeof(size_t);
+
+	for (size_t i = 0; i < sizeCount; i++)
+	{
+		size_t bufferSize = bufferSizes[i];
+		size_t iterationCount = BYTE_COUNT_PER_SIZE / bufferSize;
+		uint32_t crc = 0;
+
+		double startTime = getCurrentClock();
+
+		// Chained checksum keeps iterations dependent
+		for (size_t j = 0; j < iterationCount; j++)
+		{
+			crc = updateCrc32c(
+				crc,
+				buffer,
+				bufferSize);
+		}
+
+		double elapsedTime = getCurrentClock() - startTime;
+
+		printf("%zu byte buffers: %.2f GB/s per core (crc %08X)\n",
+			bufferSize,
+			(double)BYTE_COUNT_PER_SIZE / elapsedTime / 1000000000.0,
+			crc);
+		fflush(stdout);
+	}
+
+	free(buffer);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,240 @@
+#include "mpnw/stream_decoder.h"
+
+#include "mpmt/thread.h"
+#include <stdio.h>
+
+#define PAYLOAD_SIZE 8
+#define FRAME_COUNT 65536
+#define PASS_COUNT 200
+#define DATAGRAM_BUFFER_SIZE 64
+
+typedef struct Counter
+{
+	uint64_t frameCount;
+	uint64_t byteSum;
+} Counter;
+
+static bool onDatagram(
+	const uint8_t* buffer,
+	size_t byteCount,
+	void* handle)
+{
+	Counter* counter = handle;
+	counter->frameCount++;
+	counter->byteSum += buffer[0] + byteCount;
+	return true;
+}
+
+// Specialised handler with the directly called receive function
+DECLARE_STREAM_DATAGRAM_HANDLER(
+	handleDatagram16,
+	uint16_t,
+	onDatagram)
+DECLARE_STREAM_DATAGRAM_HANDLER(
+	handleDatagram32,
+	uint32_t,
+	onDatagram)
+
+// Generic handler, width is dispatched per call and the
+// receive function is called through the pointer
+static bool (*volatile onDatagramPointer)(
+	const uint8_t*, size_t, void*) = onDatagram;
+
+inline static uint8_t* createFrames(
+	uint8_t framing,
+	size_t* size)
+{
+	uint8_t header[MAX_STREAM_FRAME_HEADER_SIZE];
+	size_t headerSize;
+
+	encodeStreamFrameHeader(
+		framing,
+		PAYLOAD_SIZE,
+		header,
+		&headerSize);
+
+	size_t frameSize = headerSize + PAYLOAD_SIZE;
+
+	uint8_t* frames = malloc(
+		FRAME_COUNT * frameSize * sizeof(uint8_t));
+
+	if (frames == NULL)
+		return NULL;
+
+	for (size_t i = 0; i < FRAME_COUNT; i++)
+	{
+		uint8_t* frame = frames + i * frameSize;
+
+		memcpy(
+			frame,
+			header,
+			headerSize);
+		memset(
+			frame + headerSize,
+			(int)i,
+			PAYLOAD_SIZE);
+	}
+
+	*size = FRAME_COUNT * frameSize;
+	return frames;
+}
+
+inline static void printResult(
+	const char* name,
+	double elapsedTime,
+	const Counter* counter)
+{
+	printf("%s: %.1f M frames/s (%llu frames, sum %llu)\n",
+		name,
+		(double)counter->frameCount / elapsedTime / 1000000.0,
+		(unsigned long long)counter->frameCount,
+		(unsigned long long)counter->byteSum);
+	fflush(stdout);
+}
+
+static bool benchmarkHandlers(
+	uint8_t framing,
+	size_t lengthSize)
+{
+	size_t size;
+
+	uint8_t* frames = createFrames(
+		framing,
+		&size);
+
+	if (frames == NULL)
+		return false;
+
+	uint8_t datagramBuffer[DATAGRAM_BUFFER_SIZE];
+	size_t datagramByteCount = 0;
+	Counter counter = { 0, 0 };
+	bool result = true;
+
+	double startTime = getCurrentClock();
+
+	for (size_t i = 0; i < PASS_COUNT; i++)
+	{
+		result &= handleStreamDatagram(
+			frames,
+			size,
+			datagramBuffer,
+			DATAGRAM_BUFFER_SIZE,
+			&datagramByteCount,
+			lengthSize,
+			onDatagramPointer,
+			&counter);
+	}
+
+	printResult(
+		lengthSize == sizeof(uint16_t) ?
+			"u16 generic handler" : "u32 generic handler",
+		getCurrentClock() - startTime,
+		&counter);
+
+	counter.frameCount = 0;
+	counter.byteSum = 0;
+	startTime = getCurrentClock();
+
+	for (size_t i = 0; i < PASS_COUNT; i++)
+	{
+		if (lengthSize == sizeof(uint16_t))
+		{
+			result &= handleDatagram16(
+				frames,
+				size,
+				datagramBuffer,
+				DATAGRAM_BUFFER_SIZE,
+				&datagramByteCount,
+				&counter);
+		}
+		else
+		{
+			result &= handleDatagram32(
+				frames,
+				size,
+				datagramBuffer,
+				DATAGRAM_BUFFER_SIZE,
+				&datagramByteCount,
+				&counter);
+		}
+	}
+
+	printResult(
+		lengthSize == sizeof(uint16_t) ?
+			"u16 specialised handler" : "u32 specialised handler",
+		getCurrentClock() - startTime,
+		&counter);
+
+	free(frames);
+	return result;
+}
+
+static bool benchmarkDecoder(uint8_t framing)
+{
+	size_t size;
+
+	uint8_t* frames = createFrames(
+		framing,
+		&size);
+
+	if (frames == NULL)
+		return false;
+
+	StreamDecoder decoder = createStreamDecoder(
+		framing,
+		size);
+
+	if (decoder == NULL)
+	{
+		free(frames);
+		return false;
+	}
+
+	Counter counter = { 0, 0 };
+	bool result = true;
+
+	double startTime = getCurrentClock();
+
+	for (size_t i = 0; i < PASS_COUNT; i++)
+	{
+		result &= streamDecoderWrite(
+			decoder,
+			frames,
+			size);
+		result &= decodeStreamDatagrams(
+			decoder,
+			onDatagram,
+			NULL,
+			&counter);
+	}
+
+	printResult(
+		framing == VARINT_STREAM_FRAMING ?
+			"varint stream decoder" : "u16 stream decoder",
+		getCurrentClock() - startTime,
+		&counter);
+
+	destroyStreamDecoder(decoder);
+	free(frames);
+	return result;
+}
+
+int main()
+{
+	bool result = benchmarkHandlers(
+		UINT16_STREAM_FRAMING,
+		sizeof(uint16_t));
+	result &= benchmarkHandlers(
+		UINT32_STREAM_FRAMING,
+		sizeof(uint32_t));
+	result &= benchmarkDecoder(UINT16_STREAM_FRAMING);
+	result &= benchmarkDecoder(VARINT_STREAM_FRAMING);
+
+	if (result == false)
+	{
+		printf("Failed to decode frames\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,404 @@
+#include "mpnw/stream_server.h"
+
+#include "mpmt/thread.h"
+#include <stdio.h>
+
+#define SERVER_PORT "12346"
+#define SESSION_COUNT 4096
+#define SESSION_CHUNK_SIZE 256
+#define RECEIVE_BUFFER_SIZE 1024
+#define SESSION_UPDATE_COUNT 20000000
+#define LAYOUT_SESSION_COUNT 50000
+#define LAYOUT_PASS_COUNT 1000
+
+// Socket fields read by the session update loop
+typedef struct SessionSocket
+{
+	int64_t handle;
+	void* ssl;
+	uint8_t* sslBuffer;
+	size_t sslPendingCount;
+	bool isBlocking;
+} SessionSocket;
+
+// Session with the socket pointer, as before the hot arrays
+typedef struct PointerSession
+{
+	SessionSocket* socket;
+	StreamDecoder decoder;
+	void* handle;
+	bool isSslAccepted;
+} PointerSession;
+
+static bool onSessionCreate(
+	StreamServer server,
+	StreamSession session,
+	void** handle)
+{
+	return true;
+}
+static void onSessionDestroy(
+	StreamServer server,
+	StreamSession session)
+{
+}
+static bool onSessionUpdate(
+	StreamServer server,
+	StreamSession session)
+{
+	return true;
+}
+static bool onSessionReceive(
+	StreamServer server,
+	StreamSession session,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	return true;
+}
+
+inline static Socket connectClient(SocketAddress serverAddress)
+{
+	SocketAddress localAddress = createSocketAddress(
+		ANY_IP_ADDRESS_V4,
+		ANY_IP_ADDRESS_PORT);
+
+	if (localAddress == NULL)
+		return NULL;
+
+	Socket socket = createSocket(
+		STREAM_SOCKET_TYPE,
+		IP_V4_ADDRESS_FAMILY,
+		localAddress,
+		false,
+		true,
+		NULL);
+
+	destroySocketAddress(localAddress);
+
+	if (socket == NULL)
+		return NULL;
+
+	// Connection is completed by the listen backlog
+	if (connectSocket(socket, serverAddress) == false)
+	{
+		destroySocket(socket);
+		return NULL;
+	}
+
+	return socket;
+}
+
+static uint64_t updatePointerSessions(
+	PointerSession** sessions,
+	const uint8_t* states,
+	size_t sessionCount)
+{
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < sessionCount; i++)
+	{
+		if (states[i] != 0)
+			continue;
+
+		PointerSession* session = sessions[i];
+		SessionSocket* socket = session->socket;
+
+		sum += socket->handle + (socket->ssl != NULL) +
+			getStreamDecoderByteCount(session->decoder);
+	}
+
+	return sum;
+}
+static uint64_t updateInPlaceSessions(
+	const SessionSocket* sockets,
+	StreamDecoder* decoders,
+	const uint8_t* states,
+	size_t sessionCount)
+{
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < sessionCount; i++)
+	{
+		if (states[i] != 0)
+			continue;
+
+		const SessionSocket* socket = &sockets[i];
+
+		sum += socket->handle + (socket->ssl != NULL) +
+			getStreamDecoderByteCount(decoders[i]);
+	}
+
+	return sum;
+}
+
+inline static void printLayoutTime(
+	const char* name,
+	double elapsedTime,
+	uint64_t sum)
+{
+	printf("%s: %.2f ns per session update (sum %llu)\n",
+		name,
+		elapsedTime * 1000000000.0 /
+			((double)LAYOUT_PASS_COUNT * LAYOUT_SESSION_COUNT),
+		(unsigned long long)sum);
+	fflush(stdout);
+}
+
+/*
+ * Compares the session iteration memory layouts without
+ * the receive system call, which hides the cache misses.
+ * Sessions are allocated in the accept order, interleaved
+ * with their decoders, then shuffled to model session churn.
+ */
+static bool measureSessionLayouts()
+{
+	PointerSession** sessions = calloc(
+		LAYOUT_SESSION_COUNT,
+		sizeof(PointerSession*));
+	SessionSocket* sockets = calloc(
+		LAYOUT_SESSION_COUNT,
+		sizeof(SessionSocket));
+	StreamDecoder* decoders = calloc(
+		LAYOUT_SESSION_COUNT,
+		sizeof(StreamDecoder));
+	uint8_t* states = calloc(
+		LAYOUT_SESSION_COUNT,
+		sizeof(uint8_t));
+
+	bool result = sessions != NULL && sockets != NULL &&
+		decoders != NULL && states != NULL;
+
+	for (size_t i = 0; result == true && i < LAYOUT_SESSION_COUNT; i++)
+	{
+		PointerSession* session = calloc(
+			1,
+			sizeof(PointerSession));
+		SessionSocket* socket = calloc(
+			1,
+			sizeof(SessionSocket));
+		StreamDecoder decoder = createStreamDecoder(
+			UINT32_STREAM_FRAMING,
+			RECEIVE_BUFFER_SIZE);
+
+		sessions[i] = session;
+
+		if (session == NULL || socket == NULL || decoder == NULL)
+		{
+			free(socket);
+			destroyStreamDecoder(decoder);
+			result = false;
+			break;
+		}
+
+		socket->handle = (int64_t)i;
+		sockets[i].handle = (int64_t)i;
+		session->socket = socket;
+		session->decoder = decoder;
+		decoders[i] = decoder;
+	}
+
+	if (result == true)
+	{
+		printf("Session layouts: %d sessions, %d passes\n",
+			LAYOUT_SESSION_COUNT,
+			LAYOUT_PASS_COUNT);
+
+		uint64_t sum = 0;
+		double startTime = getCurrentClock();
+
+		for (size_t i = 0; i < LAYOUT_PASS_COUNT; i++)
+		{
+			sum += updateInPlaceSessions(
+				sockets,
+				decoders,
+				states,
+				LAYOUT_SESSION_COUNT);
+		}
+
+		printLayoutTime(
+			"In place sockets",
+			getCurrentClock() - startTime,
+			sum);
+
+		sum = 0;
+		startTime = getCurrentClock();
+
+		for (size_t i = 0; i < LAYOUT_PASS_COUNT; i++)
+		{
+			sum += updatePointerSessions(
+				sessions,
+				states,
+				LAYOUT_SESSION_COUNT);
+		}
+
+		printLayoutTime(
+			"Socket pointers, accept order",
+			getCurrentClock() - startTime,
+			sum);
+
+		// Removed sessions are swapped with the last ones,
+		// so the array order drifts from the allocation order
+		uint32_t shuffleState = 1;
+
+		for (size_t i = LAYOUT_SESSION_COUNT - 1; i > 0; i--)
+		{
+			shuffleState = shuffleState * 1103515245 + 12345;
+			size_t j = (shuffleState >> 8) % (i + 1);
+
+			PointerSession* session = sessions[i];
+			sessions[i] = sessions[j];
+			sessions[j] = session;
+		}
+
+		sum = 0;
+		startTime = getCurrentClock();
+
+		for (size_t i = 0; i < LAYOUT_PASS_COUNT; i++)
+		{
+			sum += updatePointerSessions(
+				sessions,
+				states,
+				LAYOUT_SESSION_COUNT);
+		}
+
+		printLayoutTime(
+			"Socket pointers, after churn",
+			getCurrentClock() - startTime,
+			sum);
+	}
+
+	if (sessions != NULL)
+	{
+		for (size_t i = 0; i < LAYOUT_SESSION_COUNT; i++)
+		{
+			PointerSession* session = sessions[i];
+
+			if (session == NULL)
+				continue;
+
+			free(session->socket);
+			destroyStreamDecoder(session->decoder);
+			free(session);
+		}
+	}
+
+	free(states);
+	free(decoders);
+	free(sockets);
+	free(sessions);
+	return result;
+}
+
+// Idle sessions, session count is limited by the descriptor limit
+static bool measureStreamServer()
+{
+	StreamServer server = createStreamServer(
+		IP_V4_ADDRESS_FAMILY,
+		SERVER_PORT,
+		SESSION_COUNT,
+		SESSION_CHUNK_SIZE,
+		0,
+		RECEIVE_BUFFER_SIZE,
+		0,
+		onSessionCreate,
+		onSessionDestroy,
+		onSessionUpdate,
+		onSessionReceive,
+		NULL,
+		NULL);
+
+	if (server == NULL)
+	{
+		printf("Failed to create stream server\n");
+		return false;
+	}
+
+	SocketAddress serverAddress = createSocketAddress(
+		LOOPBACK_IP_ADDRESS_V4,
+		SERVER_PORT);
+
+	if (serverAddress == NULL)
+	{
+		destroyStreamServer(server);
+		return false;
+	}
+
+	Socket* clients = malloc(
+		SESSION_COUNT * sizeof(Socket));
+
+	if (clients == NULL)
+	{
+		destroySocketAddress(serverAddress);
+		destroyStreamServer(server);
+		return false;
+	}
+
+	size_t clientCount = 0;
+
+	while (clientCount < SESSION_COUNT)
+	{
+		Socket client = connectClient(serverAddress);
+
+		if (client == NULL)
+			break;
+
+		clients[clientCount++] = client;
+		updateStreamServer(server);
+	}
+
+	destroySocketAddress(serverAddress);
+
+	double timeoutTime = getCurrentClock() + 5.0;
+
+	while (getStreamServerSessionCount(server) < clientCount &&
+		getCurrentClock() < timeoutTime)
+	{
+		updateStreamServer(server);
+	}
+
+	size_t sessionCount = getStreamServerSessionCount(server);
+	bool result = sessionCount != 0;
+
+	if (result == true)
+	{
+		size_t updateCount = SESSION_UPDATE_COUNT / sessionCount;
+		double startTime = getCurrentClock();
+
+		for (size_t i = 0; i < updateCount; i++)
+			updateStreamServer(server);
+
+		double elapsedTime = getCurrentClock() - startTime;
+		double sessionUpdateCount = (double)updateCount * (double)sessionCount;
+
+		printf("Stream server: %zu sessions, %zu updates, "
+			"%.1f ns per session update (with receive call)\n",
+			sessionCount,
+			updateCount,
+			elapsedTime * 1000000000.0 / sessionUpdateCount);
+		fflush(stdout);
+	}
+	else
+	{
+		printf("Failed to connect clients\n");
+	}
+
+	for (size_t i = 0; i < clientCount; i++)
+		destroySocket(clients[i]);
+
+	free(clients);
+	destroyStreamServer(server);
+	return result;
+}
+
+int main()
+{
+	if (initializeNetwork() == false)
+		return EXIT_FAILURE;
+
+	bool result = measureSessionLayouts();
+	result &= measureStreamServer();
+
+	terminateNetwork();
+	return result == true ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -77,6 +77,7 @@ inline static Server* createServer()
 		SERVER_PORT,
 		RECEIVE_BUFFER_SIZE,
 		onServerReceive,
+		NULL,
 		NULL);
 
 	if (datagramServer == NULL)
@@ -166,6 +167,7 @@ inline static Client* createClient()
 		remoteAddress,
 		RECEIVE_BUFFER_SIZE,
 		onClientReceive,
+		NULL,
 		NULL);
 
 	destroySocketAddress(remoteAddress);
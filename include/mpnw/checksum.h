@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Updates CRC32C (Castagnoli) checksum with the data.
+ * Hardware instructions are used, if supported by the CPU.
+ * Returns updated checksum value.
+ *
+ * crc - previous checksum value or 0.
+ * buffer - pointer to the valid data buffer.
+ * count - data buffer byte count.
+ */
+uint32_t updateCrc32c(
+	uint32_t crc,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Returns true if CRC32C is calculated with the hardware instructions.
+ */
+bool isCrc32cAccelerated();
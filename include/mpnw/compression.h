@@ -0,0 +1,44 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Returns maximum LZ4 block size for the specified data size.
+ * size - uncompressed data byte count.
+ */
+inline static size_t getLz4BlockBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+/*
+ * Compresses data to the LZ4 block format.
+ * Returns compressed byte count, or 0 if it does not fit the destination.
+ *
+ * source - pointer to the valid data buffer.
+ * sourceSize - data buffer byte count.
+ * destination - pointer to the valid destination buffer.
+ * destinationSize - destination buffer size.
+ */
+size_t compressLz4Block(
+	const void* source,
+	size_t sourceSize,
+	void* destination,
+	size_t destinationSize);
+
+/*
+ * Decompresses LZ4 block format data.
+ * Returns false on bad data, or if decompressed
+ * byte count is not equal to the destination size.
+ *
+ * source - pointer to the valid compressed data buffer.
+ * sourceSize - compressed data byte count.
+ * destination - pointer to the valid destination buffer.
+ * destinationSize - decompressed data byte count.
+ */
+bool decompressLz4Block(
+	const void* source,
+	size_t sourceSize,
+	void* destination,
+	size_t destinationSize);
@@ -0,0 +1,112 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram message aggregator instance handle */
+typedef struct DatagramAggregator* DatagramAggregator;
+
+/*
+ * Datagram aggregator packet send function.
+ * Packet should be sent to the remote peer aggregator,
+ * using datagramClientSend() or datagramServerSend().
+ * Returns false on send failure.
+ */
+typedef bool(*OnDatagramAggregatorSend)(
+	DatagramAggregator aggregator,
+	const uint8_t* buffer,
+	size_t count);
+
+/* Datagram aggregator unpacked message receive function */
+typedef void(*OnDatagramAggregatorReceive)(
+	DatagramAggregator aggregator,
+	const uint8_t* buffer,
+	size_t byteCount);
+
+/*
+ * Creates a new datagram message aggregator.
+ * Small messages are packed to one packet,
+ * each message is prefixed with the varint length.
+ * Returns datagram aggregator on success, otherwise NULL.
+ *
+ * packetSize - maximal aggregated packet byte count.
+ * onSend - pointer to the valid packet send function.
+ * onReceive - pointer to the valid message receive function.
+ * handle - pointer to the function argument.
+ */
+DatagramAggregator createDatagramAggregator(
+	size_t packetSize,
+	OnDatagramAggregatorSend onSend,
+	OnDatagramAggregatorReceive onReceive,
+	void* handle);
+
+/*
+ * Destroys specified datagram aggregator.
+ * aggregator - pointer to the datagram aggregator or NULL.
+ */
+void destroyDatagramAggregator(DatagramAggregator aggregator);
+
+/*
+ * Returns datagram aggregator maximal packet size.
+ * aggregator - pointer to the valid datagram aggregator.
+ */
+size_t getDatagramAggregatorPacketSize(DatagramAggregator aggregator);
+
+/*
+ * Returns datagram aggregator handle.
+ * aggregator - pointer to the valid datagram aggregator.
+ */
+void* getDatagramAggregatorHandle(DatagramAggregator aggregator);
+
+/*
+ * Returns datagram aggregator not flushed byte count.
+ * aggregator - pointer to the valid datagram aggregator.
+ */
+size_t getDatagramAggregatorByteCount(DatagramAggregator aggregator);
+
+/*
+ * Returns datagram aggregator sent message and packet count.
+ *
+ * aggregator - pointer to the valid datagram aggregator.
+ * messageCount - pointer to the valid sent message count.
+ * packetCount - pointer to the valid sent packet count.
+ */
+void getDatagramAggregatorStats(
+	DatagramAggregator aggregator,
+	uint64_t* messageCount,
+	uint64_t* packetCount);
+
+/*
+ * Appends message to the aggregated packet.
+ * Packet is flushed first if message does not fit it.
+ * Returns false if message with the length prefix is
+ * bigger than the packet size, or on flush send failure.
+ *
+ * aggregator - pointer to the valid datagram aggregator.
+ * buffer - pointer to the valid message buffer.
+ * count - message byte count.
+ */
+bool datagramAggregatorSend(
+	DatagramAggregator aggregator,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Sends aggregated packet, if it is not empty.
+ * Should be called at the end of the every tick.
+ * Returns false on send failure.
+ *
+ * aggregator - pointer to the valid datagram aggregator.
+ */
+bool flushDatagramAggregator(DatagramAggregator aggregator);
+
+/*
+ * Unpacks packet received from the remote datagram aggregator.
+ * Returns false on bad packet.
+ *
+ * aggregator - pointer to the valid datagram aggregator.
+ * buffer - pointer to the valid packet buffer.
+ * byteCount - packet byte count.
+ */
+bool datagramAggregatorReceive(
+	DatagramAggregator aggregator,
+	const uint8_t* buffer,
+	size_t byteCount);
@@ -0,0 +1,152 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram channel packet header byte count */
+#define DATAGRAM_CHANNEL_HEADER_SIZE 13
+
+/* Maximum datagram channel send and reorder window size */
+#define MAX_DATAGRAM_CHANNEL_WINDOW_SIZE 64
+
+/* Reliable datagram channel instance handle */
+typedef struct DatagramChannel* DatagramChannel;
+
+/*
+ * Datagram channel packet send function.
+ * Packet should be sent to the remote peer channel,
+ * using datagramClientSend() or datagramServerSend().
+ * Returns false on send failure.
+ */
+typedef bool(*OnDatagramChannelSend)(
+	DatagramChannel channel,
+	const uint8_t* buffer,
+	size_t count);
+
+/*
+ * Datagram channel message receive function.
+ * Reliable messages are received in the send order,
+ * unreliable messages are received as soon as they arrive.
+ */
+typedef void(*OnDatagramChannelReceive)(
+	DatagramChannel channel,
+	const uint8_t* buffer,
+	size_t byteCount,
+	bool isReliable);
+
+/*
+ * Creates a new reliable datagram channel.
+ * Channel does not own a socket, each peer uses its own channel.
+ * Returns datagram channel on success, otherwise NULL.
+ *
+ * windowSize - power of two send and reorder window packet count.
+ * packetSize - maximum packet byte count, including header.
+ * onSend - pointer to the valid packet send function.
+ * onReceive - pointer to the valid message receive function.
+ * handle - pointer to the function argument.
+ */
+DatagramChannel createDatagramChannel(
+	size_t windowSize,
+	size_t packetSize,
+	OnDatagramChannelSend onSend,
+	OnDatagramChannelReceive onReceive,
+	void* handle);
+
+/*
+ * Destroys specified datagram channel.
+ * channel - pointer to the datagram channel or NULL.
+ */
+void destroyDatagramChannel(DatagramChannel channel);
+
+/*
+ * Returns datagram channel window size.
+ * channel - pointer to the valid datagram channel.
+ */
+size_t getDatagramChannelWindowSize(DatagramChannel channel);
+
+/*
+ * Returns datagram channel maximum packet size.
+ * channel - pointer to the valid datagram channel.
+ */
+size_t getDatagramChannelPacketSize(DatagramChannel channel);
+
+/*
+ * Returns datagram channel handle.
+ * channel - pointer to the valid datagram channel.
+ */
+void* getDatagramChannelHandle(DatagramChannel channel);
+
+/*
+ * Returns datagram channel smoothed round trip time.
+ * channel - pointer to the valid datagram channel.
+ */
+double getDatagramChannelRoundTripTime(DatagramChannel channel);
+
+/*
+ * Returns datagram channel round trip time variance.
+ * channel - pointer to the valid datagram channel.
+ */
+double getDatagramChannelRoundTripVariance(DatagramChannel channel);
+
+/*
+ * Returns datagram channel retransmission timeout.
+ * channel - pointer to the valid datagram channel.
+ */
+double getDatagramChannelRetransmitTimeout(DatagramChannel channel);
+
+/*
+ * Returns datagram channel unacknowledged reliable packet count.
+ * channel - pointer to the valid datagram channel.
+ */
+size_t getDatagramChannelPendingCount(DatagramChannel channel);
+
+/*
+ * Returns datagram channel retransmitted packet count.
+ * channel - pointer to the valid datagram channel.
+ */
+uint64_t getDatagramChannelRetransmitCount(DatagramChannel channel);
+
+/*
+ * Returns datagram channel estimated bandwidth in bytes per second.
+ * Estimated from the reliable packet acknowledgement timing,
+ * zero until the first acknowledgement.
+ *
+ * channel - pointer to the valid datagram channel.
+ */
+double getDatagramChannelBandwidth(DatagramChannel channel);
+
+/*
+ * Sends message to the remote datagram channel.
+ * Reliable message is retransmitted until acknowledged.
+ * Returns false if send window is full or on send failure.
+ *
+ * channel - pointer to the valid datagram channel.
+ * buffer - pointer to the valid message buffer.
+ * count - message byte count.
+ * isReliable - deliver message reliably and in order.
+ */
+bool datagramChannelSend(
+	DatagramChannel channel,
+	const void* buffer,
+	size_t count,
+	bool isReliable);
+
+/*
+ * Handles packet received from the remote datagram channel.
+ * Returns false on bad packet.
+ *
+ * channel - pointer to the valid datagram channel.
+ * buffer - pointer to the valid packet buffer.
+ * byteCount - packet byte count.
+ */
+bool datagramChannelReceive(
+	DatagramChannel channel,
+	const uint8_t* buffer,
+	size_t byteCount);
+
+/*
+ * Retransmits timed out packets and sends pending acknowledgement.
+ * Should be called every tick, after the received packets handling.
+ * Returns false on send failure.
+ *
+ * channel - pointer to the valid datagram channel.
+ */
+bool updateDatagramChannel(DatagramChannel channel);
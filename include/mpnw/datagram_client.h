@@ -4,7 +4,10 @@
 /* Datagram client instance handle (UDP) */
 typedef struct DatagramClient* DatagramClient;
 
-/* Datagram client datagram receive function */
+/*
+ * Datagram client datagram receive function.
+ * Failed or closed DTLS session is passed as NULL buffer.
+ */
 typedef void(*OnDatagramClientReceive)(
 	DatagramClient client,
 	const uint8_t* buffer,
@@ -18,12 +21,14 @@ typedef void(*OnDatagramClientReceive)(
  * bufferSize - socket datagram receive buffer size.
  * onReceive - pointer to the valid receive function.
  * handle - pointer to the receive function argument.
+ * sslContext - pointer to the DTLS context or NULL.
  */
 DatagramClient createDatagramClient(
 	SocketAddress remoteAddress,
 	size_t bufferSize,
 	OnDatagramClientReceive onReceive,
-	void* handle);
+	void* handle,
+	SslContext sslContext);
 
 /*
  * Destroys specified datagram client.
@@ -55,8 +60,92 @@ void* getDatagramClientHandle(DatagramClient client);
  */
 Socket getDatagramClientSocket(DatagramClient client);
 
+/*
+ * Returns datagram client DTLS context, or NULL.
+ * client - pointer to the valid datagram client.
+ */
+SslContext getDatagramClientSslContext(DatagramClient client);
+
+/*
+ * Returns datagram client connection ID, or zero.
+ * client - pointer to the valid datagram client.
+ */
+uint64_t getDatagramClientConnectionID(DatagramClient client);
+
+/*
+ * Sets datagram client connection ID framing.
+ * Should match the server connection ID mode,
+ * zero ID disables the framing. Not used with DTLS.
+ * First sent datagram is the server admission request,
+ * for example, the connect token, repeated until answered.
+ *
+ * client - pointer to the valid datagram client.
+ * connectionID - unique client connection ID or zero.
+ */
+void setDatagramClientConnectionID(
+	DatagramClient client,
+	uint64_t connectionID);
+
+/*
+ * Returns datagram client clock probe delay time.
+ * client - pointer to the valid datagram client.
+ */
+double getDatagramClientProbeDelay(DatagramClient client);
+
+/*
+ * Sets datagram client clock probe delay time.
+ * NTP-style probe is sent once per delay, estimating round trip
+ * time and server clock offset. Uses the connection ID framing,
+ * zero delay disables the probes.
+ *
+ * client - pointer to the valid datagram client.
+ * delay - probe delay time or zero.
+ */
+void setDatagramClientProbeDelay(
+	DatagramClient client,
+	double delay);
+
+/*
+ * Returns datagram client smoothed round trip time.
+ * client - pointer to the valid datagram client.
+ */
+double getDatagramClientRoundTripTime(DatagramClient client);
+
+/*
+ * Returns datagram client round trip time variance.
+ * client - pointer to the valid datagram client.
+ */
+double getDatagramClientRoundTripVariance(DatagramClient client);
+
+/*
+ * Returns datagram client server minus client clock time.
+ * Server time is the getCurrentClock() plus the offset.
+ *
+ * client - pointer to the valid datagram client.
+ */
+double getDatagramClientClockOffset(DatagramClient client);
+
+/*
+ * Returns true if datagram client is ready to send.
+ * Secure client is connected after the DTLS handshake.
+ *
+ * client - pointer to the valid datagram client.
+ */
+bool isDatagramClientConnected(DatagramClient client);
+
+/*
+ * Returns true if datagram client DTLS session is failed or closed.
+ * Failed client should be destroyed, session is not recoverable.
+ *
+ * client - pointer to the valid datagram client.
+ */
+bool isDatagramClientFailed(DatagramClient client);
+
 /*
  * Receive buffered datagrams.
+ * Continues DTLS handshake and retransmits lost flights,
+ * answers connection ID path challenges, sends clock probes.
+ * DTLS handshake failure is passed to the receive function.
  * Returns true if datagram received.
  *
  * client - pointer to the valid datagram client.
@@ -65,7 +154,7 @@ bool updateDatagramClient(DatagramClient client);
 
 /*
  * Sends message to the datagram server.
- * Returns true on success.
+ * Returns false if DTLS handshake is not finished or on failure.
  *
  * client - pointer to the valid datagram client.
  * buffer - pointer to the valid data buffer.
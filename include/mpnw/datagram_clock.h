@@ -0,0 +1,108 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram clock min-filter sample count */
+#define DATAGRAM_CLOCK_SAMPLE_COUNT 8
+
+/*
+ * Datagram peer round trip and clock offset estimate state.
+ * Initialized with initializeDatagramClockState().
+ */
+typedef struct DatagramClockState
+{
+	double roundTripTimes[DATAGRAM_CLOCK_SAMPLE_COUNT];
+	double clockOffsets[DATAGRAM_CLOCK_SAMPLE_COUNT];
+	double roundTripTime;
+	double roundTripVariance;
+	double clockOffset;
+	uint32_t sampleIndex;
+	uint32_t sampleCount;
+} DatagramClockState;
+
+/*
+ * Initializes datagram clock estimate state.
+ * state - pointer to the valid datagram clock state.
+ */
+void initializeDatagramClockState(DatagramClockState* state);
+
+/*
+ * Adds NTP-style probe exchange sample to the estimate.
+ * Sample with the smallest round trip time of the recent
+ * ones is used, queueing delay spikes are rejected.
+ *
+ * state - pointer to the valid datagram clock state.
+ * roundTripTime - sample round trip time, without remote hold time.
+ * clockOffset - sample remote clock minus local clock time.
+ */
+void addDatagramClockSample(
+	DatagramClockState* state,
+	double roundTripTime,
+	double clockOffset);
+
+/*
+ * Adds remote echoed probe exchange sample to the estimate.
+ * Clock offset is the remote minus local clock time.
+ *
+ * state - pointer to the valid datagram clock state.
+ * echoTime - local probe send time, echoed by the remote.
+ * remoteSendTime - remote clock echo send time.
+ * holdTime - remote time between the probe receive and echo send.
+ * receiveTime - local echo receive time.
+ */
+void addDatagramClockExchange(
+	DatagramClockState* state,
+	double echoTime,
+	double remoteSendTime,
+	double holdTime,
+	double receiveTime);
+
+/*
+ * Encodes big-endian clock time, buffer can be unaligned.
+ *
+ * time - clock time value (getCurrentClock).
+ * buffer - pointer to the valid time buffer of 8 bytes.
+ */
+inline static void encodeDatagramClockTime(
+	double time,
+	uint8_t* buffer)
+{
+	uint64_t value;
+
+	memcpy(
+		&value,
+		&time,
+		sizeof(uint64_t));
+
+	value = hostToNet64(value);
+
+	memcpy(
+		buffer,
+		&value,
+		sizeof(uint64_t));
+}
+
+/*
+ * Decodes big-endian clock time, buffer can be unaligned.
+ * Returns decoded clock time.
+ *
+ * buffer - pointer to the valid time buffer of 8 bytes.
+ */
+inline static double decodeDatagramClockTime(const uint8_t* buffer)
+{
+	uint64_t value;
+
+	memcpy(
+		&value,
+		buffer,
+		sizeof(uint64_t));
+
+	value = netToHost64(value);
+
+	double time;
+
+	memcpy(
+		&time,
+		&value,
+		sizeof(uint64_t));
+	return time;
+}
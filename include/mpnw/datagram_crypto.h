@@ -0,0 +1,158 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram session key byte count */
+#define DATAGRAM_KEY_SIZE 32
+
+/* Sealed datagram sequence and tag byte count */
+#define DATAGRAM_SEAL_OVERHEAD (8 + 16)
+
+/* Datagram connect token byte count */
+#define DATAGRAM_CONNECT_TOKEN_SIZE (12 + 8 + 8 + DATAGRAM_KEY_SIZE + 16)
+
+/* Datagram replay window sequence count */
+#define DATAGRAM_REPLAY_WINDOW_SIZE 64
+
+/* Datagram authenticated encryption instance handle (AEAD) */
+typedef struct DatagramCrypto* DatagramCrypto;
+
+/* Datagram authenticated encryption cipher type */
+typedef enum DatagramCipher
+{
+	CHACHA20_POLY1305_DATAGRAM_CIPHER = 0,
+	AES_256_GCM_DATAGRAM_CIPHER = 1,
+	DATAGRAM_CIPHER_COUNT = 2,
+} DatagramCipher;
+
+/*
+ * Datagram peer crypto state, embedded to the peer data.
+ * Initialized with initializeDatagramCryptoState().
+ */
+typedef struct DatagramCryptoState
+{
+	uint8_t key[DATAGRAM_KEY_SIZE];
+	uint64_t sendSequence;
+	uint64_t receiveSequence;
+	uint64_t replayBits;
+} DatagramCryptoState;
+
+/*
+ * Creates a new datagram authenticated encryption instance.
+ * Server decrypts connect tokens with the private token key,
+ * which is never shared with the clients.
+ * Returns datagram crypto on success, otherwise NULL.
+ *
+ * cipher - authenticated encryption cipher type.
+ * isServer - seal server to client datagrams.
+ * tokenKey - pointer to the server token key of DATAGRAM_KEY_SIZE or NULL.
+ */
+DatagramCrypto createDatagramCrypto(
+	uint8_t cipher,
+	bool isServer,
+	const uint8_t* tokenKey);
+
+/*
+ * Destroys specified datagram crypto.
+ * crypto - pointer to the datagram crypto or NULL.
+ */
+void destroyDatagramCrypto(DatagramCrypto crypto);
+
+/*
+ * Returns datagram crypto cipher type.
+ * crypto - pointer to the valid datagram crypto.
+ */
+uint8_t getDatagramCryptoCipher(DatagramCrypto crypto);
+
+/*
+ * Generates a new random datagram session key.
+ * Returns true on success.
+ *
+ * key - pointer to the valid key buffer of DATAGRAM_KEY_SIZE.
+ */
+bool generateDatagramKey(uint8_t* key);
+
+/*
+ * Initializes datagram peer crypto state.
+ *
+ * state - pointer to the valid peer crypto state.
+ * key - pointer to the valid session key of DATAGRAM_KEY_SIZE.
+ */
+void initializeDatagramCryptoState(
+	DatagramCryptoState* state,
+	const uint8_t* key);
+
+/*
+ * Creates a new connect token, sealed with the server token key.
+ * Token and session key should be passed to the client
+ * over the secure channel, for example the TLS stream.
+ * Returns true on success.
+ *
+ * crypto - pointer to the valid server datagram crypto.
+ * clientID - client identifier value.
+ * expireTime - token expiration time (Unix seconds).
+ * key - pointer to the valid session key of DATAGRAM_KEY_SIZE.
+ * token - pointer to the valid token buffer of DATAGRAM_CONNECT_TOKEN_SIZE.
+ */
+bool createDatagramConnectToken(
+	DatagramCrypto crypto,
+	uint64_t clientID,
+	uint64_t expireTime,
+	const uint8_t* key,
+	uint8_t* token);
+
+/*
+ * Opens connect token, received from the client.
+ * Peer state should be stored only after the first
+ * datagram is opened with the token session key.
+ * Returns false on bad or expired token.
+ *
+ * crypto - pointer to the valid server datagram crypto.
+ * token - pointer to the valid token of DATAGRAM_CONNECT_TOKEN_SIZE.
+ * currentTime - current time (Unix seconds).
+ * clientID - pointer to the valid client identifier.
+ * key - pointer to the valid session key buffer of DATAGRAM_KEY_SIZE.
+ */
+bool openDatagramConnectToken(
+	DatagramCrypto crypto,
+	const uint8_t* token,
+	uint64_t currentTime,
+	uint64_t* clientID,
+	uint8_t* key);
+
+/*
+ * Seals datagram with the next send sequence nonce.
+ * Packet buffer size should be count + DATAGRAM_SEAL_OVERHEAD.
+ * Returns sealed packet byte count, or 0 on failure.
+ *
+ * crypto - pointer to the valid datagram crypto.
+ * state - pointer to the valid peer crypto state.
+ * buffer - pointer to the valid datagram buffer.
+ * count - datagram byte count.
+ * packet - pointer to the valid sealed packet buffer.
+ */
+size_t sealDatagram(
+	DatagramCrypto crypto,
+	DatagramCryptoState* state,
+	const void* buffer,
+	size_t count,
+	uint8_t* packet);
+
+/*
+ * Opens sealed datagram, rejects replayed and too old sequences.
+ * Replay window is updated only for the authentic datagram.
+ * Returns false on bad, forged or replayed packet.
+ *
+ * crypto - pointer to the valid datagram crypto.
+ * state - pointer to the valid peer crypto state.
+ * packet - pointer to the valid sealed packet.
+ * count - sealed packet byte count.
+ * buffer - pointer to the valid datagram buffer of count size.
+ * byteCount - pointer to the valid datagram byte count.
+ */
+bool openDatagram(
+	DatagramCrypto crypto,
+	DatagramCryptoState* state,
+	const uint8_t* packet,
+	size_t count,
+	uint8_t* buffer,
+	size_t* byteCount);
@@ -0,0 +1,129 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram FEC maximal packet header byte count */
+#define DATAGRAM_FEC_HEADER_SIZE 6
+
+/* Maximal datagram FEC parity group data packet count */
+#define MAX_DATAGRAM_FEC_GROUP_SIZE 32
+
+/* Datagram forward error correction instance handle */
+typedef struct DatagramFec* DatagramFec;
+
+/*
+ * Datagram FEC packet send function.
+ * Packet should be sent to the remote peer FEC,
+ * using datagramClientSend() or datagramServerSend().
+ * Returns false on send failure.
+ */
+typedef bool(*OnDatagramFecSend)(
+	DatagramFec fec,
+	const uint8_t* buffer,
+	size_t count);
+
+/*
+ * Datagram FEC message receive function.
+ * Recovered message is received after the group parity,
+ * other messages are received as soon as they arrive.
+ */
+typedef void(*OnDatagramFecReceive)(
+	DatagramFec fec,
+	const uint8_t* buffer,
+	size_t byteCount,
+	bool isRecovered);
+
+/*
+ * Creates a new datagram forward error correction.
+ * Each group of data packets is followed by one XOR parity
+ * packet, any single lost packet of the group is recovered.
+ * FEC is a standalone layer, datagram server and client do
+ * not encode or decode it, one FEC is used per remote peer.
+ * Returns datagram FEC on success, otherwise NULL.
+ *
+ * groupSize - data packet count per parity packet.
+ * packetSize - maximal packet byte count, including header.
+ * onSend - pointer to the valid packet send function.
+ * onReceive - pointer to the valid message receive function.
+ * handle - pointer to the function argument.
+ */
+DatagramFec createDatagramFec(
+	size_t groupSize,
+	size_t packetSize,
+	OnDatagramFecSend onSend,
+	OnDatagramFecReceive onReceive,
+	void* handle);
+
+/*
+ * Destroys specified datagram FEC.
+ * fec - pointer to the datagram FEC or NULL.
+ */
+void destroyDatagramFec(DatagramFec fec);
+
+/*
+ * Returns datagram FEC parity group size.
+ * fec - pointer to the valid datagram FEC.
+ */
+size_t getDatagramFecGroupSize(DatagramFec fec);
+
+/*
+ * Returns datagram FEC maximal packet size.
+ * fec - pointer to the valid datagram FEC.
+ */
+size_t getDatagramFecPacketSize(DatagramFec fec);
+
+/*
+ * Returns datagram FEC handle.
+ * fec - pointer to the valid datagram FEC.
+ */
+void* getDatagramFecHandle(DatagramFec fec);
+
+/*
+ * Returns datagram FEC statistics.
+ *
+ * fec - pointer to the valid datagram FEC.
+ * parityCount - pointer to the valid sent parity packet count.
+ * recoveredCount - pointer to the valid recovered message count.
+ */
+void getDatagramFecStats(
+	DatagramFec fec,
+	uint64_t* parityCount,
+	uint64_t* recoveredCount);
+
+/*
+ * Sends message to the remote datagram FEC.
+ * Parity packet is sent after the group is filled.
+ * Returns true on success.
+ *
+ * fec - pointer to the valid datagram FEC.
+ * buffer - pointer to the valid message buffer.
+ * count - message byte count, up to packet size minus header.
+ */
+bool datagramFecSend(
+	DatagramFec fec,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Sends parity packet of the partially filled group.
+ * Should be called at the end of each tick, to bound
+ * the recovery delay of the low rate streams.
+ * Returns true on success.
+ *
+ * fec - pointer to the valid datagram FEC.
+ */
+bool flushDatagramFec(DatagramFec fec);
+
+/*
+ * Handles packet received from the remote datagram FEC.
+ * Should be called by the application with the datagrams
+ * from OnDatagramServerReceive or OnDatagramClientReceive.
+ * Returns false on bad packet.
+ *
+ * fec - pointer to the valid datagram FEC.
+ * buffer - pointer to the valid packet buffer.
+ * byteCount - packet byte count.
+ */
+bool datagramFecReceive(
+	DatagramFec fec,
+	const uint8_t* buffer,
+	size_t byteCount);
@@ -0,0 +1,119 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram fragment header byte count */
+#define DATAGRAM_FRAGMENT_HEADER_SIZE 11
+
+/* Minimal datagram packet size, which fits any IPv6 path */
+#define MIN_DATAGRAM_PACKET_SIZE 1200
+
+/* Datagram message fragmenter instance handle */
+typedef struct DatagramFragmenter* DatagramFragmenter;
+
+/*
+ * Datagram fragmenter packet send function.
+ * Packet should be sent to the remote peer fragmenter,
+ * using datagramClientSend() or datagramServerSend().
+ * Returns false on send failure.
+ */
+typedef bool(*OnDatagramFragmenterSend)(
+	DatagramFragmenter fragmenter,
+	const uint8_t* buffer,
+	size_t count);
+
+/* Datagram fragmenter reassembled message receive function */
+typedef void(*OnDatagramFragmenterReceive)(
+	DatagramFragmenter fragmenter,
+	const uint8_t* buffer,
+	size_t byteCount);
+
+/*
+ * Creates a new datagram message fragmenter.
+ * Path MTU is probed between the minimal and maximal packet size,
+ * socket should be in the don't fragment mode (setSocketDontFragment).
+ * Returns datagram fragmenter on success, otherwise NULL.
+ *
+ * minPacketSize - minimal packet byte count, used before probing.
+ * maxPacketSize - maximal probed packet byte count.
+ * maxMessageSize - maximal reassembled message byte count.
+ * reassemblyCount - maximal concurrently reassembled message count.
+ * timeoutTime - message reassembly timeout time.
+ * onSend - pointer to the valid packet send function.
+ * onReceive - pointer to the valid message receive function.
+ * handle - pointer to the function argument.
+ */
+DatagramFragmenter createDatagramFragmenter(
+	size_t minPacketSize,
+	size_t maxPacketSize,
+	size_t maxMessageSize,
+	size_t reassemblyCount,
+	double timeoutTime,
+	OnDatagramFragmenterSend onSend,
+	OnDatagramFragmenterReceive onReceive,
+	void* handle);
+
+/*
+ * Destroys specified datagram fragmenter.
+ * fragmenter - pointer to the datagram fragmenter or NULL.
+ */
+void destroyDatagramFragmenter(DatagramFragmenter fragmenter);
+
+/*
+ * Returns datagram fragmenter current path packet size.
+ * fragmenter - pointer to the valid datagram fragmenter.
+ */
+size_t getDatagramFragmenterPacketSize(DatagramFragmenter fragmenter);
+
+/*
+ * Returns datagram fragmenter maximal message size.
+ * fragmenter - pointer to the valid datagram fragmenter.
+ */
+size_t getDatagramFragmenterMaxMessageSize(DatagramFragmenter fragmenter);
+
+/*
+ * Returns datagram fragmenter handle.
+ * fragmenter - pointer to the valid datagram fragmenter.
+ */
+void* getDatagramFragmenterHandle(DatagramFragmenter fragmenter);
+
+/*
+ * Returns datagram fragmenter dropped incomplete message count.
+ * fragmenter - pointer to the valid datagram fragmenter.
+ */
+uint64_t getDatagramFragmenterDroppedCount(DatagramFragmenter fragmenter);
+
+/*
+ * Sends message to the remote datagram fragmenter.
+ * Message bigger than the packet size is split to fragments.
+ * Returns true on success.
+ *
+ * fragmenter - pointer to the valid datagram fragmenter.
+ * buffer - pointer to the valid message buffer.
+ * count - message byte count.
+ */
+bool datagramFragmenterSend(
+	DatagramFragmenter fragmenter,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Handles packet received from the remote datagram fragmenter.
+ * Returns false on bad packet.
+ *
+ * fragmenter - pointer to the valid datagram fragmenter.
+ * buffer - pointer to the valid packet buffer.
+ * byteCount - packet byte count.
+ */
+bool datagramFragmenterReceive(
+	DatagramFragmenter fragmenter,
+	const uint8_t* buffer,
+	size_t byteCount);
+
+/*
+ * Drops timed out incomplete messages and probes path MTU.
+ * Should be called every tick, failed probe send
+ * is treated as too big for the local interface.
+ *
+ * fragmenter - pointer to the valid datagram fragmenter.
+ */
+void updateDatagramFragmenter(DatagramFragmenter fragmenter);
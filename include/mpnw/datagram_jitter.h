@@ -0,0 +1,111 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram jitter buffer instance handle */
+typedef struct DatagramJitter* DatagramJitter;
+
+/*
+ * Datagram jitter buffer frame playout function.
+ * Frames are played in the sequence order at their scheduled time,
+ * lost frame has NULL buffer and can be concealed by the receiver.
+ */
+typedef void(*OnDatagramJitterFrame)(
+	DatagramJitter jitter,
+	uint16_t sequence,
+	const uint8_t* buffer,
+	size_t byteCount);
+
+/*
+ * Creates a new adaptive datagram jitter buffer.
+ * Playout delay follows the measured transit time variation,
+ * bounded by the minimal and maximal delay.
+ * Returns datagram jitter buffer on success, otherwise NULL.
+ *
+ * frameCount - power of two buffered frame count.
+ * frameSize - maximal frame byte count.
+ * minDelay - minimal playout delay time.
+ * maxDelay - maximal playout delay time.
+ * onFrame - pointer to the valid frame playout function.
+ * handle - pointer to the function argument.
+ */
+DatagramJitter createDatagramJitter(
+	size_t frameCount,
+	size_t frameSize,
+	double minDelay,
+	double maxDelay,
+	OnDatagramJitterFrame onFrame,
+	void* handle);
+
+/*
+ * Destroys specified datagram jitter buffer.
+ * jitter - pointer to the datagram jitter buffer or NULL.
+ */
+void destroyDatagramJitter(DatagramJitter jitter);
+
+/*
+ * Returns datagram jitter buffer frame count.
+ * jitter - pointer to the valid datagram jitter buffer.
+ */
+size_t getDatagramJitterFrameCount(DatagramJitter jitter);
+
+/*
+ * Returns datagram jitter buffer maximal frame size.
+ * jitter - pointer to the valid datagram jitter buffer.
+ */
+size_t getDatagramJitterFrameSize(DatagramJitter jitter);
+
+/*
+ * Returns datagram jitter buffer handle.
+ * jitter - pointer to the valid datagram jitter buffer.
+ */
+void* getDatagramJitterHandle(DatagramJitter jitter);
+
+/*
+ * Returns datagram jitter buffer measured transit time variation.
+ * jitter - pointer to the valid datagram jitter buffer.
+ */
+double getDatagramJitterVariation(DatagramJitter jitter);
+
+/*
+ * Returns datagram jitter buffer current playout delay time.
+ * jitter - pointer to the valid datagram jitter buffer.
+ */
+double getDatagramJitterPlayoutDelay(DatagramJitter jitter);
+
+/*
+ * Returns datagram jitter buffer statistics.
+ *
+ * jitter - pointer to the valid datagram jitter buffer.
+ * lateCount - pointer to the valid after playout arrived frame count.
+ * lostCount - pointer to the valid not arrived frame count.
+ */
+void getDatagramJitterStats(
+	DatagramJitter jitter,
+	uint64_t* lateCount,
+	uint64_t* lostCount);
+
+/*
+ * Puts received frame to the datagram jitter buffer.
+ * Timestamp is the sender clock frame time (getCurrentClock).
+ * Returns false on bad frame.
+ *
+ * jitter - pointer to the valid datagram jitter buffer.
+ * sequence - frame sequence number.
+ * timestamp - frame sender timestamp.
+ * buffer - pointer to the valid frame buffer.
+ * count - frame byte count.
+ */
+bool datagramJitterPush(
+	DatagramJitter jitter,
+	uint16_t sequence,
+	double timestamp,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Plays buffered frames which playout time has come.
+ * Should be called every tick, or at the playout rate.
+ *
+ * jitter - pointer to the valid datagram jitter buffer.
+ */
+void updateDatagramJitter(DatagramJitter jitter);
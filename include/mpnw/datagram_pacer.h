@@ -0,0 +1,111 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram send pacer instance handle */
+typedef struct DatagramPacer* DatagramPacer;
+
+/*
+ * Datagram pacer packet send function.
+ * Packet should be sent to the remote peer,
+ * using datagramClientSend() or datagramServerSend().
+ * Returns false on send failure.
+ */
+typedef bool(*OnDatagramPacerSend)(
+	DatagramPacer pacer,
+	const uint8_t* buffer,
+	size_t count);
+
+/*
+ * Creates a new datagram send pacer.
+ * Token bucket spreads the tick packet burst in time,
+ * each peer uses its own pacer with its bandwidth rate.
+ * Returns datagram pacer on success, otherwise NULL.
+ *
+ * queueSize - maximal queued packet byte count.
+ * burstSize - maximal byte count sent at once after idle.
+ * onSend - pointer to the valid packet send function.
+ * handle - pointer to the function argument.
+ */
+DatagramPacer createDatagramPacer(
+	size_t queueSize,
+	size_t burstSize,
+	OnDatagramPacerSend onSend,
+	void* handle);
+
+/*
+ * Destroys specified datagram pacer.
+ * pacer - pointer to the datagram pacer or NULL.
+ */
+void destroyDatagramPacer(DatagramPacer pacer);
+
+/*
+ * Returns datagram pacer maximal queue size.
+ * pacer - pointer to the valid datagram pacer.
+ */
+size_t getDatagramPacerQueueSize(DatagramPacer pacer);
+
+/*
+ * Returns datagram pacer burst size.
+ * pacer - pointer to the valid datagram pacer.
+ */
+size_t getDatagramPacerBurstSize(DatagramPacer pacer);
+
+/*
+ * Returns datagram pacer handle.
+ * pacer - pointer to the valid datagram pacer.
+ */
+void* getDatagramPacerHandle(DatagramPacer pacer);
+
+/*
+ * Returns datagram pacer rate in bytes per second.
+ * pacer - pointer to the valid datagram pacer.
+ */
+double getDatagramPacerRate(DatagramPacer pacer);
+
+/*
+ * Sets datagram pacer rate in bytes per second.
+ * Usually the peer bandwidth estimate with some gain
+ * (getDatagramChannelBandwidth), zero disables pacing.
+ *
+ * pacer - pointer to the valid datagram pacer.
+ * rate - pacing rate or zero.
+ */
+void setDatagramPacerRate(
+	DatagramPacer pacer,
+	double rate);
+
+/*
+ * Returns datagram pacer queued packet byte count.
+ * pacer - pointer to the valid datagram pacer.
+ */
+size_t getDatagramPacerQueuedSize(DatagramPacer pacer);
+
+/*
+ * Returns time until the next queued packet send.
+ * Zero if queue is empty or packet is ready.
+ *
+ * pacer - pointer to the valid datagram pacer.
+ */
+double getDatagramPacerDelayTime(DatagramPacer pacer);
+
+/*
+ * Sends packet now or queues it until the rate allows.
+ * Returns false if queue is full or on send failure.
+ *
+ * pacer - pointer to the valid datagram pacer.
+ * buffer - pointer to the valid packet buffer.
+ * count - packet byte count.
+ */
+bool datagramPacerSend(
+	DatagramPacer pacer,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Sends queued packets allowed by the rate.
+ * Should be called often during the tick.
+ * Returns false on send failure.
+ *
+ * pacer - pointer to the valid datagram pacer.
+ */
+bool updateDatagramPacer(DatagramPacer pacer);
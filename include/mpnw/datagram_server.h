@@ -1,6 +1,9 @@
 #pragma once
 #include "mpnw/socket.h"
 
+/* Default datagram server maximal DTLS peer or connection count */
+#define DEFAULT_MAX_DATAGRAM_PEER_COUNT 1024
+
 /* Datagram server instance handle (UDP) */
 typedef struct DatagramServer* DatagramServer;
 
@@ -11,6 +14,32 @@ typedef void(*OnDatagramServerReceive)(
 	const uint8_t* buffer,
 	size_t byteCount);
 
+/*
+ * Datagram server connection admission function.
+ * Called for the first datagram of the unknown connection ID,
+ * for example, to open the client connect token from it
+ * (openDatagramConnectToken). Connection is created only
+ * if it returns true, datagram is not received afterwards.
+ */
+typedef bool(*OnDatagramConnectionAccept)(
+	DatagramServer server,
+	uint64_t connectionID,
+	SocketAddress address,
+	const uint8_t* buffer,
+	size_t byteCount);
+
+/*
+ * Datagram server connection message receive function.
+ * Address is the last validated connection address,
+ * datagram may arrive from the not yet validated one.
+ */
+typedef void(*OnDatagramConnectionReceive)(
+	DatagramServer server,
+	uint64_t connectionID,
+	SocketAddress address,
+	const uint8_t* buffer,
+	size_t byteCount);
+
 /*
  * Creates a new datagram server (UDP).
  * Returns datagram server on success, otherwise NULL.
@@ -20,13 +49,15 @@ typedef void(*OnDatagramServerReceive)(
  * bufferSize - socket datagram receive buffer size.
  * onReceive - pointer to the valid receive function.
  * handle - pointer to the receive function argument.
+ * sslContext - pointer to the DTLS context or NULL.
  */
 DatagramServer createDatagramServer(
 	uint8_t addressFamily,
 	const char* service,
 	size_t bufferSize,
 	OnDatagramServerReceive onReceive,
-	void* handle);
+	void* handle,
+	SslContext sslContext);
 
 /*
  * Destroys specified datagram server.
@@ -58,8 +89,64 @@ void* getDatagramServerHandle(DatagramServer server);
  */
 Socket getDatagramServerSocket(DatagramServer server);
 
+/*
+ * Returns datagram server DTLS context, or NULL.
+ * server - pointer to the valid datagram server.
+ */
+SslContext getDatagramServerSslContext(DatagramServer server);
+
+/*
+ * Returns datagram server DTLS peer or connection count.
+ * server - pointer to the valid datagram server.
+ */
+size_t getDatagramServerPeerCount(DatagramServer server);
+
+/*
+ * Returns datagram server maximal DTLS peer or connection count.
+ * server - pointer to the valid datagram server.
+ */
+size_t getDatagramServerMaxPeerCount(DatagramServer server);
+
+/*
+ * Sets datagram server maximal DTLS peer or connection count.
+ * New peers are ignored until existing ones are timed out.
+ *
+ * server - pointer to the valid datagram server.
+ * maxPeerCount - maximal peer count.
+ */
+void setDatagramServerMaxPeerCount(
+	DatagramServer server,
+	size_t maxPeerCount);
+
+/*
+ * Enables datagram server connection ID framing.
+ * Peer is identified by the client connection ID instead of
+ * the address, so it survives NAT rebinding. New address is
+ * used for sending only after the path challenge response.
+ * Unknown connection is admitted by the accept function.
+ * Should be called before the first update, not with DTLS.
+ * Returns true on success.
+ *
+ * server - pointer to the valid datagram server.
+ * onConnectionAccept - pointer to the valid admission function.
+ * onConnectionReceive - pointer to the valid receive function.
+ */
+bool enableDatagramServerConnectionIDs(
+	DatagramServer server,
+	OnDatagramConnectionAccept onConnectionAccept,
+	OnDatagramConnectionReceive onConnectionReceive);
+
+/*
+ * Returns true if datagram server uses connection IDs.
+ * server - pointer to the valid datagram server.
+ */
+bool isDatagramServerConnectionIDs(DatagramServer server);
+
 /*
  * Receive buffered datagrams.
+ * DTLS peer session is created only after the cookie
+ * exchange, idle peer sessions and connections are
+ * destroyed on timeout.
  * Returns true if datagram received.
  *
  * server - pointer to the valid datagram server.
@@ -68,6 +155,7 @@ bool updateDatagramServer(DatagramServer server);
 
 /*
  * Sends message to the specified address.
+ * Message is sent only to the connected DTLS peer, if secure.
  * Returns true on success.
  *
  * server - pointer to the valid datagram server.
@@ -80,3 +168,37 @@ bool datagramServerSend(
 	const void* buffer,
 	size_t count,
 	SocketAddress address);
+
+/*
+ * Returns datagram server connection clock estimate.
+ * Estimated from the client probes (setDatagramClientProbeDelay),
+ * values are zero until the second probe.
+ * Returns false if connection is not found.
+ *
+ * server - pointer to the valid datagram server.
+ * connectionID - connection ID.
+ * roundTripTime - pointer to the valid round trip time.
+ * roundTripVariance - pointer to the valid round trip time variance.
+ * clockOffset - pointer to the valid client minus server clock time.
+ */
+bool getDatagramServerConnectionClock(
+	DatagramServer server,
+	uint64_t connectionID,
+	double* roundTripTime,
+	double* roundTripVariance,
+	double* clockOffset);
+
+/*
+ * Sends message to the specified connection validated address.
+ * Returns false if connection is not found or on failure.
+ *
+ * server - pointer to the valid datagram server.
+ * connectionID - destination connection ID.
+ * buffer - pointer to the valid data buffer.
+ * count - data buffer send byte count.
+ */
+bool datagramServerSendConnection(
+	DatagramServer server,
+	uint64_t connectionID,
+	const void* buffer,
+	size_t count);
@@ -0,0 +1,127 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Datagram snapshot packet header byte count */
+#define DATAGRAM_SNAPSHOT_HEADER_SIZE 5
+
+/* Datagram state snapshot delta encoder instance handle */
+typedef struct DatagramSnapshot* DatagramSnapshot;
+
+/*
+ * Datagram snapshot packet send function.
+ * Packet should be sent to the remote peer snapshot,
+ * using datagramClientSend() or datagramServerSend().
+ * Returns false on send failure.
+ */
+typedef bool(*OnDatagramSnapshotSend)(
+	DatagramSnapshot snapshot,
+	const uint8_t* buffer,
+	size_t count);
+
+/*
+ * Datagram snapshot reconstructed state receive function.
+ * Only snapshots newer than the last received are received.
+ */
+typedef void(*OnDatagramSnapshotReceive)(
+	DatagramSnapshot snapshot,
+	uint16_t sequence,
+	const uint8_t* state);
+
+/*
+ * Creates a new datagram state snapshot delta encoder.
+ * Sender encodes state against the latest acknowledged baseline,
+ * receiver reconstructs it and acknowledges automatically.
+ * Each peer uses its own snapshot, state size is fixed.
+ * Returns datagram snapshot on success, otherwise NULL.
+ *
+ * isSender - encode and send snapshots, otherwise receive.
+ * stateSize - snapshot state byte count.
+ * historyCount - power of two stored baseline count.
+ * onSend - pointer to the valid packet send function.
+ * onReceive - pointer to the state receive function or NULL if sender.
+ * handle - pointer to the function argument.
+ */
+DatagramSnapshot createDatagramSnapshot(
+	bool isSender,
+	size_t stateSize,
+	size_t historyCount,
+	OnDatagramSnapshotSend onSend,
+	OnDatagramSnapshotReceive onReceive,
+	void* handle);
+
+/*
+ * Destroys specified datagram snapshot.
+ * snapshot - pointer to the datagram snapshot or NULL.
+ */
+void destroyDatagramSnapshot(DatagramSnapshot snapshot);
+
+/*
+ * Returns true if datagram snapshot is sender.
+ * snapshot - pointer to the valid datagram snapshot.
+ */
+bool isDatagramSnapshotSender(DatagramSnapshot snapshot);
+
+/*
+ * Returns datagram snapshot state size.
+ * snapshot - pointer to the valid datagram snapshot.
+ */
+size_t getDatagramSnapshotStateSize(DatagramSnapshot snapshot);
+
+/*
+ * Returns datagram snapshot baseline history count.
+ * snapshot - pointer to the valid datagram snapshot.
+ */
+size_t getDatagramSnapshotHistoryCount(DatagramSnapshot snapshot);
+
+/*
+ * Returns datagram snapshot handle.
+ * snapshot - pointer to the valid datagram snapshot.
+ */
+void* getDatagramSnapshotHandle(DatagramSnapshot snapshot);
+
+/*
+ * Returns datagram snapshot maximal packet size.
+ * Delta of the fully changed state, datagramFragmenterSend()
+ * can be used if it is bigger than the path packet size.
+ *
+ * snapshot - pointer to the valid datagram snapshot.
+ */
+size_t getDatagramSnapshotMaxPacketSize(DatagramSnapshot snapshot);
+
+/*
+ * Returns datagram snapshot sent or received byte statistics.
+ *
+ * snapshot - pointer to the valid datagram snapshot.
+ * stateByteCount - pointer to the valid full state byte count.
+ * packetByteCount - pointer to the valid delta packet byte count.
+ */
+void getDatagramSnapshotStats(
+	DatagramSnapshot snapshot,
+	uint64_t* stateByteCount,
+	uint64_t* packetByteCount);
+
+/*
+ * Sends state delta to the remote datagram snapshot.
+ * State is delta encoded against the latest acknowledged
+ * baseline, or against the zero state if there is none.
+ * Returns true on success.
+ *
+ * snapshot - pointer to the valid sender datagram snapshot.
+ * state - pointer to the valid state buffer of the state size.
+ */
+bool datagramSnapshotSend(
+	DatagramSnapshot snapshot,
+	const void* state);
+
+/*
+ * Handles packet received from the remote datagram snapshot.
+ * Returns false on bad packet.
+ *
+ * snapshot - pointer to the valid datagram snapshot.
+ * buffer - pointer to the valid packet buffer.
+ * byteCount - packet byte count.
+ */
+bool datagramSnapshotReceive(
+	DatagramSnapshot snapshot,
+	const uint8_t* buffer,
+	size_t byteCount);
@@ -66,6 +66,8 @@ typedef struct Socket* Socket;
 typedef struct SocketAddress* SocketAddress;
 /* Secure socket layer context handle */
 typedef struct SslContext* SslContext;
+/* Datagram secure session handle (DTLS) */
+typedef struct DtlsSession* DtlsSession;
 
 /* Socket internet protocol address family */
 typedef enum AddressFamily
@@ -100,7 +102,9 @@ typedef enum SecurityProtocol
 	UNKNOWN_SECURITY_PROTOCOL = 0,
 	TLS_SECURITY_PROTOCOL = 1,
 	TLS_1_2_SECURITY_PROTOCOL = 2,
-	SECURITY_PROTOCOL_COUNT = 3,
+	DTLS_SECURITY_PROTOCOL = 3,
+	DTLS_1_2_SECURITY_PROTOCOL = 4,
+	SECURITY_PROTOCOL_COUNT = 5,
 } SecurityProtocol;
 
 /* Returns true if network was initialized. */
@@ -110,6 +114,18 @@ void terminateNetwork();
 /* Returns true if network is initialized */
 bool isNetworkInitialized();
 
+/*
+ * Fills buffer with the cryptographically secure random bytes.
+ * OpenSSL is used if available, otherwise the OS generator.
+ * Returns true on success.
+ *
+ * buffer - pointer to the valid buffer.
+ * count - random byte count.
+ */
+bool generateRandomBytes(
+	void* buffer,
+	size_t count);
+
 /*
  * Creates a new socket.
  * Returns socket on success, otherwise NULL.
@@ -135,6 +151,18 @@ Socket createSocket(
  */
 void destroySocket(Socket socket);
 
+/*
+ * Destroys specified in place socket, without freeing its memory.
+ * socket - pointer to the valid in place socket.
+ */
+void destroySocketInPlace(Socket socket);
+
+/*
+ * Returns socket instance byte count.
+ * Used to store sockets in place, in contiguous arrays.
+ */
+size_t getSocketInstanceSize();
+
 /*
  * Returns socket connection type.
  * socket - pointer to the valid socket.
@@ -201,6 +229,34 @@ void setSocketNoDelay(
 	Socket socket,
 	bool value);
 
+/*
+ * Sets datagram socket don't fragment mode.
+ * Oversized datagram is not fragmented by the IP layer,
+ * send fails or datagram is dropped on the path instead.
+ * Used for the path MTU discovery probing.
+ * Returns false if mode is not supported.
+ *
+ * socket - pointer to the valid datagram socket.
+ * value - don't fragment mode value.
+ */
+bool setSocketDontFragment(
+	Socket socket,
+	bool value);
+
+/*
+ * Sets socket maximal kernel pacing rate in bytes per second.
+ * Packets are spread in time by the kernel queue discipline,
+ * zero rate removes the limit. Should be used together with the
+ * user space pacer (DatagramPacer) for the per-peer rates.
+ * Returns false if pacing is not supported.
+ *
+ * socket - pointer to the valid socket.
+ * rate - maximal pacing rate or zero.
+ */
+bool setSocketMaxPacingRate(
+	Socket socket,
+	uint64_t rate);
+
 /*
  * Accepts a new socket connection.
  * Returns socket on success, otherwise NULL.
@@ -210,6 +266,27 @@ void setSocketNoDelay(
  */
 Socket acceptSocket(Socket socket);
 
+/*
+ * Accepts a new socket connection to the specified memory.
+ * In place socket can be moved with memcpy until it is destroyed.
+ * Returns true on success.
+ *
+ * socket - pointer to the valid socket.
+ * acceptedSocket - pointer to the valid socket instance memory.
+ */
+bool acceptSocketInPlace(
+	Socket socket,
+	Socket acceptedSocket);
+
+/*
+ * Accepts and immediately resets a new socket connection.
+ * Does not allocate socket or SSL instance.
+ * Returns true if connection was rejected.
+ *
+ * socket - pointer to the valid socket.
+ */
+bool rejectSocket(Socket socket);
+
 /*
  * Accepts socket SSL connection.
  * Returns true on success.
@@ -249,7 +326,8 @@ bool shutdownSocket(
 
 /*
  * Receives socket message.
- * Returns true on success.
+ * Returns true on success, datagram bigger
+ * than the buffer size is dropped as truncated.
  *
  * socket - pointer to the valid socket.
  * buffer - pointer to the valid receive buffer.
@@ -264,6 +342,8 @@ bool socketReceive(
 
 /*
  * Sends socket message.
+ * Secure socket writes message records until it is sent,
+ * data of the partial write should be passed to socketSendPartial().
  * Returns true on success.
  *
  * socket - pointer to the valid socket.
@@ -275,9 +355,45 @@ bool socketSend(
 	const void* buffer,
 	size_t count);
 
+/*
+ * Sends part of the socket message, as much as fits.
+ * Returns true on success, also if socket would block.
+ * Unsent data should be passed again, SSL socket retries
+ * the blocked write from its copy and may report it sent.
+ *
+ * socket - pointer to the valid socket.
+ * buffer - pointer to the valid send buffer.
+ * count - message byte count to send.
+ * sentCount - pointer to the valid sent byte count.
+ */
+bool socketSendPartial(
+	Socket socket,
+	const void* buffer,
+	size_t count,
+	size_t* sentCount);
+
+/*
+ * Sends socket message parts with one system call, as much as fits.
+ * Returns true on success, also if socket would block.
+ * Unsent data should be passed again, see socketSendPartial().
+ *
+ * socket - pointer to the valid socket.
+ * buffers - pointer to the valid send buffer array.
+ * counts - pointer to the valid buffer byte count array.
+ * bufferCount - send buffer array size.
+ * sentCount - pointer to the valid sent byte count.
+ */
+bool socketSendBuffers(
+	Socket socket,
+	const void** buffers,
+	const size_t* counts,
+	size_t bufferCount,
+	size_t* sentCount);
+
 /*
  * Receives socket message.
- * Returns true on success.
+ * Returns true on success, datagram bigger
+ * than the buffer size is dropped as truncated.
  *
  * socket - pointer to the valid socket.
  * buffer - pointer to the valid receive buffer.
@@ -373,6 +489,14 @@ int compareSocketAddress(
 	SocketAddress a,
 	SocketAddress b);
 
+/*
+ * Returns socket address hash value.
+ * Equal addresses have the same hash value.
+ *
+ * address - pointer to the valid socket address.
+ */
+uint64_t getSocketAddressHash(SocketAddress address);
+
 /*
  * Returns socket address family.
  * address - pointer to the valid socket address.
@@ -527,6 +651,298 @@ void destroySslContext(SslContext context);
  */
 uint8_t getSslContextSecurityProtocol(SslContext context);
 
+/*
+ * Creates a new datagram secure session (DTLS).
+ * Session does not receive from the socket itself,
+ * received datagrams are passed to the session.
+ * Returns DTLS session on success, otherwise NULL.
+ *
+ * socket - pointer to the valid datagram socket.
+ * sslContext - pointer to the valid DTLS context.
+ * remoteAddress - pointer to the remote address or NULL, if socket is connected.
+ * isServer - accept session instead of connecting.
+ */
+DtlsSession createDtlsSession(
+	Socket socket,
+	SslContext sslContext,
+	SocketAddress remoteAddress,
+	bool isServer);
+
+/*
+ * Destroys specified DTLS session.
+ * Close notify alert is sent, if session is connected.
+ *
+ * session - pointer to the DTLS session or NULL.
+ */
+void destroyDtlsSession(DtlsSession session);
+
+/*
+ * Returns true if DTLS session handshake is finished.
+ * session - pointer to the valid DTLS session.
+ */
+bool isDtlsSessionConnected(DtlsSession session);
+
+/*
+ * Listens for the client hello with a valid cookie, stateless.
+ * Hello verify request with the cookie is sent to the peer otherwise.
+ * Listening session handles the peer handshake on success,
+ * new session should be used for the further listening.
+ * Returns true if peer address is verified.
+ *
+ * session - pointer to the valid not connected server DTLS session.
+ * address - pointer to the valid datagram source address.
+ * buffer - pointer to the valid received datagram.
+ * count - received datagram byte count.
+ */
+bool listenDtlsSession(
+	DtlsSession session,
+	SocketAddress address,
+	const uint8_t* buffer,
+	size_t count);
+
+/*
+ * Handles received datagram, continues handshake and decrypts message.
+ * Should be called again with the empty datagram,
+ * until there are no more buffered messages (byteCount == 0).
+ * Returns false on connection failure or close.
+ *
+ * session - pointer to the valid DTLS session.
+ * datagram - pointer to the received datagram or NULL.
+ * count - received datagram byte count.
+ * buffer - pointer to the valid message buffer.
+ * size - message buffer size.
+ * byteCount - pointer to the valid message byte count.
+ */
+bool dtlsSessionReceive(
+	DtlsSession session,
+	const uint8_t* datagram,
+	size_t count,
+	void* buffer,
+	size_t size,
+	size_t* byteCount);
+
+/*
+ * Encrypts and sends message to the DTLS session peer.
+ * Returns false if handshake is not finished or on failure.
+ *
+ * session - pointer to the valid DTLS session.
+ * buffer - pointer to the valid message buffer.
+ * count - message byte count.
+ */
+bool dtlsSessionSend(
+	DtlsSession session,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Retransmits lost handshake flight on timeout.
+ * Returns false on handshake failure.
+ *
+ * session - pointer to the valid DTLS session.
+ */
+bool updateDtlsSession(DtlsSession session);
+
+/*
+ * Decodes big-endian datagram size, buffer can be unaligned.
+ * Returns decoded datagram size.
+ *
+ * buffer - pointer to the valid datagram size buffer.
+ * lengthSize - datagram length header size.
+ */
+inline static uint64_t decodeStreamDatagramSize(
+	const uint8_t* buffer,
+	size_t lengthSize)
+{
+	switch (lengthSize)
+	{
+	default:
+		abort();
+	case sizeof(uint8_t):
+		return buffer[0];
+	case sizeof(uint16_t):
+	{
+		uint16_t value;
+		memcpy(
+			&value,
+			buffer,
+			sizeof(uint16_t));
+		return netToHost16(value);
+	}
+	case sizeof(uint32_t):
+	{
+		uint32_t value;
+		memcpy(
+			&value,
+			buffer,
+			sizeof(uint32_t));
+		return netToHost32(value);
+	}
+	case sizeof(uint64_t):
+	{
+		uint64_t value;
+		memcpy(
+			&value,
+			buffer,
+			sizeof(uint64_t));
+		return netToHost64(value);
+	}
+	}
+}
+
+/*
+ * Stream datagram handler function body.
+ * Length size is a compile time constant, receive
+ * function is called directly, so it can be inlined.
+ */
+#define STREAM_DATAGRAM_HANDLER_BODY(LENGTH_SIZE, RECEIVE_FUNCTION) \
+{ \
+	assert(receiveBuffer != NULL); \
+	assert(byteCount != 0); \
+	assert(datagramBuffer != NULL); \
+	assert(datagramBufferSize >= (LENGTH_SIZE)); \
+	assert(datagramByteCount != NULL); \
+	size_t _datagramByteCount = *datagramByteCount; \
+	size_t pointer = 0; \
+	/* Handle received data with buffered data */ \
+	if (_datagramByteCount > 0) \
+	{ \
+		/* Datagram buffer has not full size */ \
+		if (_datagramByteCount < (LENGTH_SIZE)) \
+		{ \
+			size_t datagramSizePart = \
+				(LENGTH_SIZE) - _datagramByteCount; \
+			/* Received not full datagram size */ \
+			if (datagramSizePart > byteCount) \
+			{ \
+				memcpy( \
+					datagramBuffer + _datagramByteCount, \
+					receiveBuffer, \
+					byteCount); \
+				*datagramByteCount += byteCount; \
+				return true; \
+			} \
+			memcpy( \
+				datagramBuffer + _datagramByteCount, \
+				receiveBuffer, \
+				datagramSizePart); \
+			pointer += datagramSizePart; \
+			_datagramByteCount += datagramSizePart; \
+		} \
+		uint64_t datagramSize = decodeStreamDatagramSize( \
+			datagramBuffer, \
+			(LENGTH_SIZE)); \
+		/* Received datagram is bigger than buffer */ \
+		if (datagramSize > datagramBufferSize - (LENGTH_SIZE)) \
+			return false; \
+		size_t neededPartSize = (size_t)datagramSize - \
+			(_datagramByteCount - (LENGTH_SIZE)); \
+		/* Received not full datagram */ \
+		if (neededPartSize > byteCount - pointer) \
+		{ \
+			size_t datagramPartSize = byteCount - pointer; \
+			memcpy( \
+				datagramBuffer + _datagramByteCount, \
+				receiveBuffer + pointer, \
+				datagramPartSize); \
+			*datagramByteCount = _datagramByteCount + datagramPartSize; \
+			return true; \
+		} \
+		memcpy( \
+			datagramBuffer + _datagramByteCount, \
+			receiveBuffer + pointer, \
+			neededPartSize); \
+		if (RECEIVE_FUNCTION( \
+			datagramBuffer + (LENGTH_SIZE), \
+			(size_t)datagramSize, \
+			functionHandle) == false) \
+		{ \
+			return false; \
+		} \
+		*datagramByteCount = 0; \
+		pointer += neededPartSize; \
+	} \
+	/* Continue until all received data handled */ \
+	while (pointer < byteCount) \
+	{ \
+		/* Received not full datagram size */ \
+		if ((LENGTH_SIZE) > byteCount - pointer) \
+		{ \
+			size_t datagramSizePart = byteCount - pointer; \
+			memcpy( \
+				datagramBuffer, \
+				receiveBuffer + pointer, \
+				datagramSizePart); \
+			*datagramByteCount = datagramSizePart; \
+			return true; \
+		} \
+		uint64_t datagramSize = decodeStreamDatagramSize( \
+			receiveBuffer + pointer, \
+			(LENGTH_SIZE)); \
+		/* Received datagram is bigger than buffer */ \
+		if (datagramSize > datagramBufferSize - (LENGTH_SIZE)) \
+			return false; \
+		/* Received not full datagram */ \
+		if (datagramSize > (byteCount - pointer) - (LENGTH_SIZE)) \
+		{ \
+			size_t datagramPartSize = byteCount - pointer; \
+			memcpy( \
+				datagramBuffer, \
+				receiveBuffer + pointer, \
+				datagramPartSize); \
+			*datagramByteCount = datagramPartSize; \
+			return true; \
+		} \
+		/* Handle received datagram in place */ \
+		if (RECEIVE_FUNCTION( \
+			receiveBuffer + pointer + (LENGTH_SIZE), \
+			(size_t)datagramSize, \
+			functionHandle) == false) \
+		{ \
+			return false; \
+		} \
+		pointer += (LENGTH_SIZE) + (size_t)datagramSize; \
+	} \
+	return true; \
+}
+
+/*
+ * Declares stream datagram handler with specified
+ * length header type and directly called receive function.
+ *
+ * Declared function arguments are the same as for the
+ * handleStreamDatagram, without length size and receive function.
+ *
+ * NAME - declared handler function name.
+ * LENGTH_TYPE - datagram length header type (uint8_t, uint16_t...).
+ * RECEIVE_FUNCTION - receive handler function name.
+ */
+#define DECLARE_STREAM_DATAGRAM_HANDLER(NAME, LENGTH_TYPE, RECEIVE_FUNCTION) \
+inline static bool NAME( \
+	const uint8_t* receiveBuffer, \
+	size_t byteCount, \
+	uint8_t* datagramBuffer, \
+	size_t datagramBufferSize, \
+	size_t* datagramByteCount, \
+	void* functionHandle) \
+STREAM_DATAGRAM_HANDLER_BODY(sizeof(LENGTH_TYPE), RECEIVE_FUNCTION)
+
+#define DECLARE_STREAM_DATAGRAM_FUNCTION_HANDLER(NAME, LENGTH_TYPE) \
+inline static bool NAME( \
+	const uint8_t* receiveBuffer, \
+	size_t byteCount, \
+	uint8_t* datagramBuffer, \
+	size_t datagramBufferSize, \
+	size_t* datagramByteCount, \
+	bool(*receiveFunction)(const uint8_t*, size_t, void*), \
+	void* functionHandle) \
+STREAM_DATAGRAM_HANDLER_BODY(sizeof(LENGTH_TYPE), receiveFunction)
+
+/* Stream datagram handlers with fixed length header size */
+DECLARE_STREAM_DATAGRAM_FUNCTION_HANDLER(handleStreamDatagram8, uint8_t)
+DECLARE_STREAM_DATAGRAM_FUNCTION_HANDLER(handleStreamDatagram16, uint16_t)
+DECLARE_STREAM_DATAGRAM_FUNCTION_HANDLER(handleStreamDatagram32, uint32_t)
+DECLARE_STREAM_DATAGRAM_FUNCTION_HANDLER(handleStreamDatagram64, uint64_t)
+
 /*
  * Splits and handles received stream data to the datagrams.
  * Returns true on all handle success
@@ -549,163 +965,45 @@ inline static bool handleStreamDatagram(
 	bool(*receiveFunction)(const uint8_t*, size_t, void*),
 	void* functionHandle)
 {
-	assert(receiveBuffer != NULL);
-	assert(byteCount != 0);
-	assert(datagramBuffer != NULL);
-	assert(datagramBufferSize != 0);
-	assert(datagramByteCount != NULL);
-
-	assert(
-		datagramLengthSize == sizeof(uint8_t) ||
-		datagramLengthSize == sizeof(uint16_t) ||
-		datagramLengthSize == sizeof(uint32_t) ||
-		datagramLengthSize == sizeof(uint64_t));
-	assert(datagramBufferSize >= datagramLengthSize);
-
-	size_t _datagramByteCount =
-		*datagramByteCount;
-
-	size_t pointer = 0;
-
-	// Handle received data with buffered data
-	if (_datagramByteCount > 0)
+	switch (datagramLengthSize)
 	{
-		// Datagram buffer has not full size
-		if (_datagramByteCount < datagramLengthSize)
-		{
-			size_t datagramSizePart =
-				datagramLengthSize - _datagramByteCount;
-
-			// Received not full datagram size
-			if (datagramSizePart > byteCount)
-			{
-				// Store part of the received datagram size
-				memcpy(
-					datagramBuffer + _datagramByteCount,
-					receiveBuffer,
-					byteCount);
-				*datagramByteCount += byteCount;
-				return true;
-			}
-
-			// Copy remaining datagram size part
-			memcpy(
-				datagramBuffer + _datagramByteCount,
-				receiveBuffer,
-				datagramSizePart);
-			pointer += datagramSizePart;
-			_datagramByteCount += datagramSizePart;
-		}
-
-		// Decode received datagram size
-		uint64_t datagramSize;
-
-		if (datagramLengthSize == sizeof(uint8_t))
-			datagramSize = datagramBuffer[0];
-		else if (datagramLengthSize == sizeof(uint16_t))
-			datagramSize = netToHost16(*(uint16_t*)datagramBuffer);
-		else if (datagramLengthSize == sizeof(uint32_t))
-			datagramSize = netToHost32(*(uint32_t*)datagramBuffer);
-		else if (datagramLengthSize == sizeof(uint64_t))
-			datagramSize = netToHost64(*(uint64_t*)datagramBuffer);
-		else
-			abort();
-
-		// Received datagram is bigger than buffer
-		if (datagramSize > datagramBufferSize - datagramLengthSize)
-			return false;
-
-		size_t neededPartSize = datagramSize -
-			(_datagramByteCount - datagramLengthSize);
-
-		// Received not full datagram
-		if (neededPartSize > byteCount - pointer)
-		{
-			size_t datagramPartSize = byteCount - pointer;
-
-			memcpy(
-				datagramBuffer + _datagramByteCount,
-				receiveBuffer + pointer,
-				datagramPartSize);
-			*datagramByteCount = _datagramByteCount + datagramPartSize;
-			return true;
-		}
-
-		memcpy(
-			datagramBuffer + _datagramByteCount,
-			receiveBuffer + pointer,
-			neededPartSize);
-
-		bool result = receiveFunction(
-			datagramBuffer + datagramLengthSize,
-			datagramSize,
+	default:
+		abort();
+	case sizeof(uint8_t):
+		return handleStreamDatagram8(
+			receiveBuffer,
+			byteCount,
+			datagramBuffer,
+			datagramBufferSize,
+			datagramByteCount,
+			receiveFunction,
 			functionHandle);
-
-		if (result == false)
-			return false;
-
-		*datagramByteCount = 0;
-		pointer += neededPartSize;
-	}
-
-	// Continue until all received data handled
-	while (pointer < byteCount)
-	{
-		// Received not full datagram size
-		if (datagramLengthSize > byteCount - pointer)
-		{
-			size_t datagramSizePart = byteCount - pointer;
-
-			memcpy(
-				datagramBuffer,
-				receiveBuffer + pointer,
-				datagramSizePart);
-			*datagramByteCount += datagramSizePart;
-			return true;
-		}
-
-		// Decode received datagram size
-		uint64_t datagramSize;
-
-		if (datagramLengthSize == sizeof(uint8_t))
-			datagramSize = receiveBuffer[pointer];
-		else if (datagramLengthSize == sizeof(uint16_t))
-			datagramSize = netToHost16(*(uint16_t*)(receiveBuffer + pointer));
-		else if (datagramLengthSize == sizeof(uint32_t))
-			datagramSize = netToHost32(*(uint32_t*)(receiveBuffer + pointer));
-		else if (datagramLengthSize == sizeof(uint64_t))
-			datagramSize = netToHost64(*(uint64_t*)(receiveBuffer + pointer));
-		else
-			abort();
-
-		// Received datagram is bigger than buffer
-		if (datagramSize > datagramBufferSize - datagramLengthSize)
-			return false;
-
-		// Received not full datagram
-		if (datagramSize > (byteCount - pointer) - datagramLengthSize)
-		{
-			size_t datagramPartSize = byteCount - pointer;
-
-			memcpy(
-				datagramBuffer,
-				receiveBuffer + pointer,
-				datagramPartSize);
-			*datagramByteCount += datagramPartSize;
-			return true;
-		}
-
-		// Handle received datagram data
-		bool result = receiveFunction(
-			receiveBuffer + pointer + datagramLengthSize,
-			datagramSize,
+	case sizeof(uint16_t):
+		return handleStreamDatagram16(
+			receiveBuffer,
+			byteCount,
+			datagramBuffer,
+			datagramBufferSize,
+			datagramByteCount,
+			receiveFunction,
+			functionHandle);
+	case sizeof(uint32_t):
+		return handleStreamDatagram32(
+			receiveBuffer,
+			byteCount,
+			datagramBuffer,
+			datagramBufferSize,
+			datagramByteCount,
+			receiveFunction,
+			functionHandle);
+	case sizeof(uint64_t):
+		return handleStreamDatagram64(
+			receiveBuffer,
+			byteCount,
+			datagramBuffer,
+			datagramBufferSize,
+			datagramByteCount,
+			receiveFunction,
 			functionHandle);
-
-		if (result == false)
-			return false;
-
-		pointer += datagramLengthSize + datagramSize;
 	}
-
-	return true;
 }
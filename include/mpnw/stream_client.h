@@ -1,5 +1,5 @@
 #pragma once
-#include "mpnw/socket.h"
+#include "mpnw/stream_decoder.h"
 
 /* Stream client instance handle (TCP) */
 typedef struct StreamClient* StreamClient;
@@ -57,6 +57,94 @@ void* getStreamClientHandle(StreamClient client);
  */
 Socket getStreamClientSocket(StreamClient client);
 
+/*
+ * Returns stream client send datagram framing type.
+ * client - pointer to the valid stream client.
+ */
+uint8_t getStreamClientFraming(StreamClient client);
+
+/*
+ * Sets stream client send datagram framing type.
+ * client - pointer to the valid stream client.
+ * framing - stream datagram framing type.
+ */
+void setStreamClientFraming(
+	StreamClient client,
+	uint8_t framing);
+
+/*
+ * Returns stream client send datagram delimiter byte.
+ * client - pointer to the valid stream client.
+ */
+uint8_t getStreamClientDelimiter(StreamClient client);
+
+/*
+ * Sets stream client send datagram delimiter byte.
+ * Used only by the delimiter framing.
+ *
+ * client - pointer to the valid stream client.
+ * delimiter - datagram delimiter byte.
+ */
+void setStreamClientDelimiter(
+	StreamClient client,
+	uint8_t delimiter);
+
+/*
+ * Returns true if stream client send datagrams have checksums.
+ * client - pointer to the valid stream client.
+ */
+bool isStreamClientChecksumming(StreamClient client);
+
+/*
+ * Sets stream client send datagram CRC32C checksums.
+ * Delimiter framing is not supported.
+ *
+ * client - pointer to the valid stream client.
+ * value - add datagram checksums.
+ */
+void setStreamClientChecksumming(
+	StreamClient client,
+	bool value);
+
+/*
+ * Returns stream client send datagram compression type.
+ * client - pointer to the valid stream client.
+ */
+uint8_t getStreamClientCompression(StreamClient client);
+
+/*
+ * Returns stream client minimal compressed datagram size.
+ * client - pointer to the valid stream client.
+ */
+size_t getStreamClientCompressionThreshold(StreamClient client);
+
+/*
+ * Sets stream client send datagram compression.
+ * Framed send compresses datagrams not smaller than threshold,
+ * delimiter framing is not supported.
+ *
+ * client - pointer to the valid stream client.
+ * compression - stream datagram compression type.
+ * threshold - minimal compressed datagram byte count.
+ */
+void setStreamClientCompression(
+	StreamClient client,
+	uint8_t compression,
+	size_t threshold);
+
+/*
+ * Returns stream client framed datagram compression statistics.
+ * Data size is uncompressed, and packed size is compressed byte count.
+ *
+ * client - pointer to the valid stream client.
+ * sendDataSize - pointer to the valid sent data byte count.
+ * sendPackedSize - pointer to the valid sent packed byte count.
+ */
+void getStreamClientCompressionStats(
+	StreamClient client,
+	uint64_t* sendDataSize,
+	uint64_t* sendPackedSize);
+
 /*
  * Connects stream client to the server.
  * Returns true on success.
@@ -90,3 +178,36 @@ bool streamClientSend(
 	StreamClient client,
 	const void* buffer,
 	size_t count);
+
+/*
+ * Sends datagram with the client framing to the stream server.
+ * Length prefix or delimiter is sent with the datagram in one call.
+ * Delimited datagram should not contain the delimiter byte.
+ * Returns true on success.
+ *
+ * client - pointer to the valid stream client.
+ * buffer - pointer to the valid data buffer.
+ * count - data buffer send byte count.
+ */
+bool streamClientSendFrame(
+	StreamClient client,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Sends datagrams with the client framing to the stream server.
+ * Multiple datagrams are sent with the one call.
+ * Client has no send queue, connection is shut down if
+ * datagrams are sent partially, client should be recreated.
+ * Returns true on success.
+ *
+ * client - pointer to the valid stream client.
+ * buffers - pointer to the valid data buffer array.
+ * counts - pointer to the valid data buffer byte count array.
+ * frameCount - datagram count.
+ */
+bool streamClientSendFrames(
+	StreamClient client,
+	const void** buffers,
+	const size_t* counts,
+	size_t frameCount);
@@ -0,0 +1,444 @@
+#pragma once
+#include "mpnw/socket.h"
+
+/* Maximum variable-length integer byte count */
+#define MAX_STREAM_VARINT_SIZE 10
+
+/* Stream datagram decoder instance handle */
+typedef struct StreamDecoder* StreamDecoder;
+
+/* Maximum stream frame length prefix byte count */
+#define MAX_STREAM_FRAME_HEADER_SIZE MAX_STREAM_VARINT_SIZE
+
+/* Maximum stream datagram compression header byte count */
+#define MAX_STREAM_COMPRESSION_HEADER_SIZE (1 + MAX_STREAM_VARINT_SIZE)
+
+/* Default delimiter framing byte */
+#define DEFAULT_STREAM_DELIMITER '\n'
+
+/* Stream datagram framing, length prefix or delimiter type */
+typedef enum StreamFraming
+{
+	UINT8_STREAM_FRAMING = 0,
+	UINT16_STREAM_FRAMING = 1,
+	UINT32_STREAM_FRAMING = 2,
+	UINT64_STREAM_FRAMING = 3,
+	VARINT_STREAM_FRAMING = 4,
+	DELIMITER_STREAM_FRAMING = 5,
+	STREAM_FRAMING_COUNT = 6,
+} StreamFraming;
+
+/* Stream datagram compression type */
+typedef enum StreamCompression
+{
+	NONE_STREAM_COMPRESSION = 0,
+	LZ4_STREAM_COMPRESSION = 1,
+	STREAM_COMPRESSION_COUNT = 2,
+} StreamCompression;
+
+/* Maximum stream frame count packed to the one batch */
+#define STREAM_FRAME_BATCH_SIZE 16
+
+/*
+ * Packed stream frame batch, sent with the one call.
+ * Buffers point to the batch headers and to the frame data.
+ */
+typedef struct StreamFrameBatch
+{
+	const void* buffers[STREAM_FRAME_BATCH_SIZE * 4];
+	size_t counts[STREAM_FRAME_BATCH_SIZE * 4];
+	size_t bufferCount;
+	size_t byteCount;
+	uint64_t dataSize;
+	uint64_t packedSize;
+	uint32_t trailers[STREAM_FRAME_BATCH_SIZE];
+	uint8_t headers[STREAM_FRAME_BATCH_SIZE][MAX_STREAM_FRAME_HEADER_SIZE];
+	uint8_t packHeaders[STREAM_FRAME_BATCH_SIZE][MAX_STREAM_COMPRESSION_HEADER_SIZE];
+	uint8_t delimiter;
+} StreamFrameBatch;
+
+/*
+ * Stream decoder datagram function.
+ * Stops decoding on false return result.
+ */
+typedef bool(*OnStreamDecoderDatagram)(
+	const uint8_t* buffer,
+	size_t byteCount,
+	void* handle);
+
+/*
+ * Stream decoder oversized datagram chunk function.
+ * Datagram begins with the zero chunk offset, and ends
+ * when chunk offset plus byte count is equal to the datagram size.
+ * Stops decoding on false return result.
+ */
+typedef bool(*OnStreamDecoderChunk)(
+	const uint8_t* buffer,
+	size_t byteCount,
+	uint64_t datagramSize,
+	uint64_t chunkOffset,
+	void* handle);
+
+/*
+ * Creates a new stream datagram decoder.
+ * Returns stream decoder on success, otherwise NULL.
+ *
+ * framing - stream datagram framing type.
+ * bufferSize - receive ring buffer size.
+ */
+StreamDecoder createStreamDecoder(
+	uint8_t framing,
+	size_t bufferSize);
+
+/*
+ * Destroys specified stream decoder.
+ * decoder - pointer to the stream decoder or NULL.
+ */
+void destroyStreamDecoder(StreamDecoder decoder);
+
+/*
+ * Returns stream decoder framing type.
+ * decoder - pointer to the valid stream decoder.
+ */
+uint8_t getStreamDecoderFraming(StreamDecoder decoder);
+
+/*
+ * Returns stream decoder ring buffer size.
+ * decoder - pointer to the valid stream decoder.
+ */
+size_t getStreamDecoderBufferSize(StreamDecoder decoder);
+
+/*
+ * Returns stream decoder delimiter byte.
+ * decoder - pointer to the valid stream decoder.
+ */
+uint8_t getStreamDecoderDelimiter(StreamDecoder decoder);
+
+/*
+ * Sets stream decoder delimiter byte.
+ * Used only by the delimiter framing, line feed delimiter
+ * also strips carriage return of the CRLF line ending.
+ *
+ * decoder - pointer to the valid stream decoder.
+ * delimiter - datagram delimiter byte.
+ */
+void setStreamDecoderDelimiter(
+	StreamDecoder decoder,
+	uint8_t delimiter);
+
+/*
+ * Returns true if stream decoder verifies datagram checksums.
+ * decoder - pointer to the valid stream decoder.
+ */
+bool isStreamDecoderChecksumming(StreamDecoder decoder);
+
+/*
+ * Sets stream decoder datagram checksum verification.
+ * Length prefixed datagram is followed by the CRC32C
+ * trailer, which is included to the datagram size.
+ *
+ * decoder - pointer to the valid stream decoder.
+ * value - verify datagram checksums.
+ */
+void setStreamDecoderChecksumming(
+	StreamDecoder decoder,
+	bool value);
+
+/*
+ * Returns stream decoder buffered byte count.
+ * decoder - pointer to the valid stream decoder.
+ */
+size_t getStreamDecoderByteCount(StreamDecoder decoder);
+
+/*
+ * Receives socket data directly to the decoder buffer.
+ * Returns true on success.
+ *
+ * decoder - pointer to the valid stream decoder.
+ * socket - pointer to the valid socket.
+ * count - pointer to the valid receive byte count.
+ */
+bool streamDecoderReceive(
+	StreamDecoder decoder,
+	Socket socket,
+	size_t* count);
+
+/*
+ * Copies data to the decoder buffer.
+ * Returns false if data does not fit the buffer.
+ *
+ * decoder - pointer to the valid stream decoder.
+ * buffer - pointer to the valid data buffer.
+ * count - data buffer byte count.
+ */
+bool streamDecoderWrite(
+	StreamDecoder decoder,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Handles all complete buffered datagrams.
+ * Datagram is passed without copy, if it is contiguous in the buffer.
+ * Length prefixed datagram bigger than the buffer is passed
+ * in the received chunks, if chunk function is set,
+ * delimited datagram should be shorter than the buffer size.
+ * Returns false on bad datagram, checksum or on handle failure.
+ *
+ * decoder - pointer to the valid stream decoder.
+ * onDatagram - pointer to the valid datagram function.
+ * onChunk - pointer to the chunk function or NULL.
+ * handle - pointer to the function handle or NULL.
+ */
+bool decodeStreamDatagrams(
+	StreamDecoder decoder,
+	OnStreamDecoderDatagram onDatagram,
+	OnStreamDecoderChunk onChunk,
+	void* handle);
+
+/*
+ * Packs stream datagram, compression type byte is added to the header.
+ * Datagram is compressed only if it is not smaller than the
+ * threshold and if compressed datagram is smaller.
+ * Returns compression header byte count.
+ *
+ * buffer - pointer to the valid datagram buffer.
+ * count - datagram byte count.
+ * threshold - minimal compressed datagram byte count.
+ * header - pointer to the valid buffer of MAX_STREAM_COMPRESSION_HEADER_SIZE.
+ * packBuffer - pointer to the compressed data buffer of count size or NULL.
+ * data - pointer to the valid packed data.
+ * dataSize - pointer to the valid packed data byte count.
+ */
+size_t packStreamDatagram(
+	const void* buffer,
+	size_t count,
+	size_t threshold,
+	uint8_t* header,
+	uint8_t* packBuffer,
+	const void** data,
+	size_t* dataSize);
+
+/*
+ * Unpacks stream datagram, decompresses it if required.
+ * Returns false on bad datagram.
+ *
+ * buffer - pointer to the valid packed datagram buffer.
+ * byteCount - packed datagram byte count.
+ * unpackBuffer - pointer to the valid decompressed data buffer.
+ * unpackBufferSize - decompressed data buffer size.
+ * data - pointer to the valid unpacked data.
+ * dataSize - pointer to the valid unpacked data byte count.
+ */
+bool unpackStreamDatagram(
+	const uint8_t* buffer,
+	size_t byteCount,
+	uint8_t* unpackBuffer,
+	size_t unpackBufferSize,
+	const uint8_t** data,
+	size_t* dataSize);
+
+/*
+ * Validates stream frame sizes before packing any of them.
+ * Compressed frame is never bigger than uncompressed.
+ * Returns false if frame size does not fit the length prefix.
+ *
+ * framing - stream datagram framing type.
+ * isChecksumming - frames have the CRC32C trailer.
+ * isCompressing - frames have the compression header.
+ * counts - pointer to the valid data buffer byte count array.
+ * frameCount - datagram count.
+ * totalCount - pointer to the valid maximal packed byte count.
+ */
+bool getStreamFramesSize(
+	uint8_t framing,
+	bool isChecksumming,
+	bool isCompressing,
+	const size_t* counts,
+	size_t frameCount,
+	size_t* totalCount);
+
+/*
+ * Packs validated stream frames to the batch, with the length prefix,
+ * compression header and checksum or delimiter trailer.
+ * Pack buffer is grown for the compressed data, batch is packed
+ * uncompressed on allocation failure.
+ * Returns packed frame count, up to the STREAM_FRAME_BATCH_SIZE.
+ *
+ * batch - pointer to the valid frame batch.
+ * framing - stream datagram framing type.
+ * delimiter - datagram delimiter byte.
+ * isChecksumming - add CRC32C trailer to the frames.
+ * compression - stream datagram compression type.
+ * compressionThreshold - minimal compressed datagram byte count.
+ * packBuffer - pointer to the valid pack buffer or NULL.
+ * packBufferSize - pointer to the valid pack buffer size.
+ * buffers - pointer to the valid data buffer array.
+ * counts - pointer to the valid data buffer byte count array.
+ * frameCount - datagram count.
+ */
+size_t packStreamFrames(
+	StreamFrameBatch* batch,
+	uint8_t framing,
+	uint8_t delimiter,
+	bool isChecksumming,
+	uint8_t compression,
+	size_t compressionThreshold,
+	uint8_t** packBuffer,
+	size_t* packBufferSize,
+	const void** buffers,
+	const size_t* counts,
+	size_t frameCount);
+
+/*
+ * Encodes variable-length integer (LEB128).
+ * Returns encoded byte count.
+ *
+ * value - integer value to encode.
+ * buffer - pointer to the valid buffer of MAX_STREAM_VARINT_SIZE.
+ */
+inline static size_t encodeStreamVarint(
+	uint64_t value,
+	uint8_t* buffer)
+{
+	assert(buffer != NULL);
+
+	size_t size = 0;
+
+	while (value >= 0x80)
+	{
+		buffer[size++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+
+	buffer[size++] = (uint8_t)value;
+	return size;
+}
+
+/*
+ * Decodes variable-length integer (LEB128).
+ * Returns decoded byte count, or 0 if value is incomplete or bad.
+ *
+ * buffer - pointer to the valid encoded value buffer.
+ * size - encoded value buffer size.
+ * value - pointer to the valid integer value.
+ */
+inline static size_t decodeStreamVarint(
+	const uint8_t* buffer,
+	size_t size,
+	uint64_t* value)
+{
+	assert(buffer != NULL);
+	assert(value != NULL);
+
+	if (size > MAX_STREAM_VARINT_SIZE)
+		size = MAX_STREAM_VARINT_SIZE;
+
+	uint64_t result = 0;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		uint8_t byte = buffer[i];
+		result |= (uint64_t)(byte & 0x7F) << (i * 7);
+
+		if ((byte & 0x80) == 0)
+		{
+			// Last byte can hold only one remaining bit
+			if (i == MAX_STREAM_VARINT_SIZE - 1 && byte > 1)
+				return 0;
+
+			*value = result;
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Encodes stream frame length prefix.
+ * Delimiter framing has no prefix, header size is 0.
+ * Returns false if datagram size does not fit the prefix.
+ *
+ * framing - stream datagram framing type.
+ * size - datagram byte count.
+ * buffer - pointer to the valid buffer of MAX_STREAM_FRAME_HEADER_SIZE.
+ * headerSize - pointer to the valid header byte count.
+ */
+inline static bool encodeStreamFrameHeader(
+	uint8_t framing,
+	uint64_t size,
+	uint8_t* buffer,
+	size_t* headerSize)
+{
+	assert(buffer != NULL);
+	assert(headerSize != NULL);
+
+	switch (framing)
+	{
+	default:
+		abort();
+	case UINT8_STREAM_FRAMING:
+		if (size > UINT8_MAX)
+		{
+			*headerSize = 0;
+			return false;
+		}
+
+		buffer[0] = (uint8_t)size;
+		*headerSize = sizeof(uint8_t);
+		return true;
+	case UINT16_STREAM_FRAMING:
+	{
+		if (size > UINT16_MAX)
+		{
+			*headerSize = 0;
+			return false;
+		}
+
+		uint16_t value = hostToNet16((uint16_t)size);
+
+		memcpy(
+			buffer,
+			&value,
+			sizeof(uint16_t));
+		*headerSize = sizeof(uint16_t);
+		return true;
+	}
+	case UINT32_STREAM_FRAMING:
+	{
+		if (size > UINT32_MAX)
+		{
+			*headerSize = 0;
+			return false;
+		}
+
+		uint32_t value = hostToNet32((uint32_t)size);
+
+		memcpy(
+			buffer,
+			&value,
+			sizeof(uint32_t));
+		*headerSize = sizeof(uint32_t);
+		return true;
+	}
+	case UINT64_STREAM_FRAMING:
+	{
+		uint64_t value = hostToNet64(size);
+
+		memcpy(
+			buffer,
+			&value,
+			sizeof(uint64_t));
+		*headerSize = sizeof(uint64_t);
+		return true;
+	}
+	case VARINT_STREAM_FRAMING:
+		*headerSize = encodeStreamVarint(
+			size,
+			buffer);
+		return true;
+	case DELIMITER_STREAM_FRAMING:
+		*headerSize = 0;
+		return true;
+	}
+}
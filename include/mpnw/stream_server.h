@@ -1,18 +1,29 @@
 #pragma once
-#include "mpnw/socket.h"
+#include "mpnw/stream_decoder.h"
 
 /* Stream server instance handle (TCP) */
 typedef struct StreamServer* StreamServer;
 /* Stream server session instance handle (TCP) */
 typedef struct StreamSession* StreamSession;
 
+/* Stream server admission mode, when all sessions are busy */
+typedef enum StreamAdmission
+{
+	// Stops accepting, connections wait in the listen backlog
+	PAUSE_STREAM_ADMISSION = 0,
+	// Resets connections without socket and SSL setup
+	RESET_STREAM_ADMISSION = 1,
+	STREAM_ADMISSION_COUNT = 2,
+} StreamAdmission;
+
 /*
  * Stream session create function.
  * Destroys session on false return result.
+ * Session data is zeroed before the call.
  */
 typedef bool(*OnStreamSessionCreate)(
 	StreamServer server,
-	Socket socket,
+	StreamSession session,
 	void** handle);
 
 /* Stream session destroy function */
@@ -38,14 +49,41 @@ typedef bool(*OnStreamSessionReceive)(
 	const uint8_t* buffer,
 	size_t byteCount);
 
+/*
+ * Stream session send queue watermark function.
+ * Called with true when queued byte count reaches the high
+ * watermark and with false when it drops to the low watermark.
+ */
+typedef void(*OnStreamSessionWatermark)(
+	StreamServer server,
+	StreamSession session,
+	bool isHigh);
+
+/*
+ * Stream session oversized datagram chunk function.
+ * Datagram begins with the zero chunk offset, and ends
+ * when chunk offset plus byte count is equal to the datagram size.
+ * Destroys session on false return result.
+ */
+typedef bool(*OnStreamSessionChunk)(
+	StreamServer server,
+	StreamSession session,
+	const uint8_t* buffer,
+	size_t byteCount,
+	uint64_t datagramSize,
+	uint64_t chunkOffset);
+
 /*
  * Creates a new stream server (TCP).
  * Returns stream server on success, otherwise NULL.
  *
  * addressFamily - local stream socket address family.
  * port - pointer to the valid local address port string.
- * sessionBufferSize - socket session buffer size.
+ * sessionBufferSize - maximum socket session count.
+ * sessionChunkSize - session count per storage growth step.
+ * sessionDataSize - inline session data size or 0.
  * receiveBufferSize - socket message receive buffer size.
+ * sendBufferSize - session unsent data queue size or 0.
  * receiveTimeoutTime - socket message receive timeout time (s).
  * receiveFunction - pointer to the valid receive function.
  * createFunction - pointer to the create function or NULL.
@@ -57,7 +95,10 @@ StreamServer createStreamServer(
 	uint8_t addressFamily,
 	const char* service,
 	size_t sessionBufferSize,
+	size_t sessionChunkSize,
+	size_t sessionDataSize,
 	size_t receiveBufferSize,
+	size_t sendBufferSize,
 	OnStreamSessionCreate onCreate,
 	OnStreamSessionDestroy onDestroy,
 	OnStreamSessionUpdate onUpdate,
@@ -77,12 +118,238 @@ void destroyStreamServer(StreamServer server);
  */
 size_t getStreamServerSessionBufferSize(StreamServer server);
 
+/*
+ * Returns stream server session storage chunk size.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerSessionChunkSize(StreamServer server);
+
+/*
+ * Returns stream server inline session data size.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerSessionDataSize(StreamServer server);
+
 /*
  * Returns stream server receive buffer size.
  * server - pointer to the valid stream server.
  */
 size_t getStreamServerReceiveBufferSize(StreamServer server);
 
+/*
+ * Returns stream server session send queue size.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerSendBufferSize(StreamServer server);
+
+/*
+ * Returns stream server send queue low watermark.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerLowWatermark(StreamServer server);
+
+/*
+ * Returns stream server send queue high watermark.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerHighWatermark(StreamServer server);
+
+/*
+ * Sets stream server send queue watermarks.
+ *
+ * server - pointer to the valid stream server.
+ * lowWatermark - queued byte count to resume producing.
+ * highWatermark - queued byte count to throttle producing.
+ * onWatermark - pointer to the watermark function or NULL.
+ */
+void setStreamServerWatermarks(
+	StreamServer server,
+	size_t lowWatermark,
+	size_t highWatermark,
+	OnStreamSessionWatermark onWatermark);
+
+/*
+ * Returns true if stream server coalesces session sends.
+ * server - pointer to the valid stream server.
+ */
+bool isStreamServerCoalescing(StreamServer server);
+
+/*
+ * Sets stream server session send coalescing mode.
+ * Sends are queued and flushed once at the end of the update,
+ * server should have a send queue.
+ *
+ * server - pointer to the valid stream server.
+ * value - coalescing mode value.
+ */
+void setStreamServerCoalescing(
+	StreamServer server,
+	bool value);
+
+/*
+ * Returns stream server session datagram framing type.
+ * server - pointer to the valid stream server.
+ */
+uint8_t getStreamServerFraming(StreamServer server);
+
+/*
+ * Returns stream server session datagram buffer size.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerFrameBufferSize(StreamServer server);
+
+/*
+ * Sets stream server session datagram framing.
+ * Received data is split to the datagrams, which are passed
+ * to the receive function, closed connection is passed as NULL buffer.
+ * Should be set before any session is accepted.
+ *
+ * server - pointer to the valid stream server.
+ * framing - stream datagram framing type.
+ * frameBufferSize - session datagram buffer size or 0.
+ */
+void setStreamServerFraming(
+	StreamServer server,
+	uint8_t framing,
+	size_t frameBufferSize);
+
+/*
+ * Returns stream server session datagram delimiter byte.
+ * server - pointer to the valid stream server.
+ */
+uint8_t getStreamServerDelimiter(StreamServer server);
+
+/*
+ * Sets stream server session datagram delimiter byte.
+ * Used only by the delimiter framing, datagram should be
+ * shorter than the frame buffer size.
+ * Should be set before any session is accepted.
+ *
+ * server - pointer to the valid stream server.
+ * delimiter - datagram delimiter byte.
+ */
+void setStreamServerDelimiter(
+	StreamServer server,
+	uint8_t delimiter);
+
+/*
+ * Returns true if stream server session datagrams have checksums.
+ * server - pointer to the valid stream server.
+ */
+bool isStreamServerChecksumming(StreamServer server);
+
+/*
+ * Sets stream server session datagram CRC32C checksums.
+ * Checksum is verified on receive and added on framed send,
+ * delimiter framing is not supported.
+ * Should be set before any session is accepted.
+ *
+ * server - pointer to the valid stream server.
+ * value - use datagram checksums.
+ */
+void setStreamServerChecksumming(
+	StreamServer server,
+	bool value);
+
+/*
+ * Returns stream server session datagram compression type.
+ * server - pointer to the valid stream server.
+ */
+uint8_t getStreamServerCompression(StreamServer server);
+
+/*
+ * Returns stream server minimal compressed datagram size.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerCompressionThreshold(StreamServer server);
+
+/*
+ * Sets stream server session datagram compression.
+ * Framed send compresses datagrams not smaller than threshold,
+ * received datagrams are decompressed to the frame buffer size.
+ * Oversized datagram chunks are passed only uncompressed,
+ * delimiter framing is not supported.
+ * Should be set before any session is accepted.
+ *
+ * server - pointer to the valid stream server.
+ * compression - stream datagram compression type.
+ * threshold - minimal compressed datagram byte count.
+ */
+void setStreamServerCompression(
+	StreamServer server,
+	uint8_t compression,
+	size_t threshold);
+
+/*
+ * Returns stream server oversized datagram chunk function.
+ * server - pointer to the valid stream server.
+ */
+OnStreamSessionChunk getStreamServerOnChunk(StreamServer server);
+
+/*
+ * Sets stream server oversized datagram chunk function.
+ * Length prefixed datagram bigger than the frame buffer
+ * is passed in the received chunks instead of session destruction.
+ *
+ * server - pointer to the valid stream server.
+ * onChunk - pointer to the chunk function or NULL.
+ */
+void setStreamServerOnChunk(
+	StreamServer server,
+	OnStreamSessionChunk onChunk);
+
+/*
+ * Returns stream server active session count.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerSessionCount(StreamServer server);
+
+/*
+ * Returns stream server allocated session slot count.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerSessionCapacity(StreamServer server);
+
+/*
+ * Returns stream server session count high-water mark.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerPeakSessionCount(StreamServer server);
+
+/*
+ * Returns stream server session capacity high-water mark.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerPeakSessionCapacity(StreamServer server);
+
+/*
+ * Returns stream server admission mode.
+ * server - pointer to the valid stream server.
+ */
+uint8_t getStreamServerAdmission(StreamServer server);
+
+/*
+ * Sets stream server admission mode.
+ *
+ * server - pointer to the valid stream server.
+ * admission - stream server admission mode.
+ */
+void setStreamServerAdmission(
+	StreamServer server,
+	uint8_t admission);
+
+/*
+ * Returns stream server update count with paused accepting.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerPauseCount(StreamServer server);
+
+/*
+ * Returns stream server reset connection count.
+ * server - pointer to the valid stream server.
+ */
+size_t getStreamServerRejectCount(StreamServer server);
+
 /*
  * Returns stream server create function.
  * server - pointer to the valid stream server.
@@ -121,6 +388,9 @@ Socket getStreamServerSocket(StreamServer server);
 
 /*
  * Returns stream server session socket.
+ * Socket is stored in place and moved when other session
+ * is destroyed, do not keep it between server updates.
+ *
  * session - pointer to the valid stream server session.
  */
 Socket getStreamSessionSocket(StreamSession session);
@@ -131,6 +401,37 @@ Socket getStreamSessionSocket(StreamSession session);
  */
 void* getStreamSessionHandle(StreamSession session);
 
+/*
+ * Returns stream server session queued unsent byte count.
+ * session - pointer to the valid stream server session.
+ */
+size_t getStreamSessionSendCount(StreamSession session);
+
+/*
+ * Returns stream server session framed datagram compression statistics.
+ * Data size is uncompressed, and packed size is compressed byte count.
+ *
+ * session - pointer to the valid stream server session.
+ * sendDataSize - pointer to the valid sent data byte count.
+ * sendPackedSize - pointer to the valid sent packed byte count.
+ * receiveDataSize - pointer to the valid received data byte count.
+ * receivePackedSize - pointer to the valid received packed byte count.
+ */
+void getStreamSessionCompressionStats(
+	StreamSession session,
+	uint64_t* sendDataSize,
+	uint64_t* sendPackedSize,
+	uint64_t* receiveDataSize,
+	uint64_t* receivePackedSize);
+
+/*
+ * Returns stream server session inline data.
+ * Data is aligned and stored in the session slot.
+ *
+ * session - pointer to the valid stream server session.
+ */
+void* getStreamSessionData(StreamSession session);
+
 /*
  * Receive buffered datagrams.
  * Returns true if update actions occurred.
@@ -141,6 +442,8 @@ bool updateStreamServer(StreamServer server);
 
 /*
  * Sends datagram to the specified session.
+ * Unsent part is queued, if server has send queue,
+ * and flushed on the following server updates.
  * Returns true on success.
  *
  * session - pointer to the valid stream session.
@@ -151,3 +454,43 @@ bool streamSessionSend(
 	StreamSession session,
 	const void* buffer,
 	size_t count);
+
+/*
+ * Sends queued session data without waiting for the server update.
+ * Returns true on success.
+ *
+ * session - pointer to the valid stream session.
+ */
+bool flushStreamSession(StreamSession session);
+
+/*
+ * Sends datagram with the server framing to the specified session.
+ * Length prefix or delimiter is sent with the datagram in one call.
+ * Delimited datagram should not contain the delimiter byte.
+ * Returns false if datagram does not fit the framing or send queue.
+ *
+ * session - pointer to the valid stream session.
+ * buffer - pointer to the valid data buffer.
+ * count - data buffer send byte count.
+ */
+bool streamSessionSendFrame(
+	StreamSession session,
+	const void* buffer,
+	size_t count);
+
+/*
+ * Sends datagrams with the server framing to the specified session.
+ * Multiple datagrams are sent with the one call.
+ * Returns false if any datagram does not fit the framing,
+ * or if all datagrams do not fit the send queue.
+ *
+ * session - pointer to the valid stream session.
+ * buffers - pointer to the valid data buffer array.
+ * counts - pointer to the valid data buffer byte count array.
+ * frameCount - datagram count.
+ */
+bool streamSessionSendFrames(
+	StreamSession session,
+	const void** buffers,
+	const size_t* counts,
+	size_t frameCount);
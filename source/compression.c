@@ -0,0 +1,338 @@
+#include "mpnw/compression.h"
+
+#include <string.h>
+#include <assert.h>
+
+// Compression hash table entry count power of two
+#define LZ4_HASH_LOG 12
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_LIMIT 12
+#define LZ4_MAX_DISTANCE 65535
+
+inline static uint32_t readLz4Sequence(const uint8_t* buffer)
+{
+	uint32_t value;
+
+	memcpy(
+		&value,
+		buffer,
+		sizeof(uint32_t));
+
+	return value;
+}
+
+inline static uint32_t hashLz4Sequence(uint32_t sequence)
+{
+	return (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+inline static bool writeLz4Length(
+	uint8_t* destination,
+	size_t destinationSize,
+	size_t* output,
+	size_t length)
+{
+	size_t offset = *output;
+
+	while (length >= 255)
+	{
+		if (offset == destinationSize)
+			return false;
+
+		destination[offset++] = 255;
+		length -= 255;
+	}
+
+	if (offset == destinationSize)
+		return false;
+
+	destination[offset++] = (uint8_t)length;
+	*output = offset;
+	return true;
+}
+
+static bool writeLz4Sequence(
+	const uint8_t* literals,
+	size_t literalLength,
+	size_t matchOffset,
+	size_t matchLength,
+	uint8_t* destination,
+	size_t destinationSize,
+	size_t* output)
+{
+	size_t offset = *output;
+
+	if (offset == destinationSize)
+		return false;
+
+	size_t tokenOffset = offset++;
+
+	uint8_t token = literalLength >= 15 ?
+		15 << 4 : (uint8_t)(literalLength << 4);
+
+	if (literalLength >= 15)
+	{
+		bool result = writeLz4Length(
+			destination,
+			destinationSize,
+			&offset,
+			literalLength - 15);
+
+		if (result == false)
+			return false;
+	}
+
+	if (literalLength > destinationSize - offset)
+		return false;
+
+	memcpy(
+		destination + offset,
+		literals,
+		literalLength);
+
+	offset += literalLength;
+
+	// Last sequence has only literals
+	if (matchLength != 0)
+	{
+		if (destinationSize - offset < 2)
+			return false;
+
+		destination[offset++] = (uint8_t)matchOffset;
+		destination[offset++] = (uint8_t)(matchOffset >> 8);
+
+		size_t length = matchLength - LZ4_MIN_MATCH;
+
+		if (length >= 15)
+		{
+			token |= 15;
+
+			bool result = writeLz4Length(
+				destination,
+				destinationSize,
+				&offset,
+				length - 15);
+
+			if (result == false)
+				return false;
+		}
+		else
+		{
+			token |= (uint8_t)length;
+		}
+	}
+
+	destination[tokenOffset] = token;
+	*output = offset;
+	return true;
+}
+
+size_t compressLz4Block(
+	const void* _source,
+	size_t sourceSize,
+	void* _destination,
+	size_t destinationSize)
+{
+	assert(_source != NULL);
+	assert(_destination != NULL);
+
+	const uint8_t* source = _source;
+	uint8_t* destination = _destination;
+	size_t anchor = 0;
+	size_t output = 0;
+
+	if (sourceSize > LZ4_MATCH_LIMIT)
+	{
+		uint32_t hashTable[1 << LZ4_HASH_LOG];
+
+		memset(
+			hashTable,
+			0,
+			sizeof(hashTable));
+
+		size_t matchLimit = sourceSize - LZ4_MATCH_LIMIT;
+		size_t matchEnd = sourceSize - LZ4_LAST_LITERALS;
+		size_t position = 1;
+
+		while (position < matchLimit)
+		{
+			uint32_t sequence = readLz4Sequence(
+				source + position);
+			uint32_t hash = hashLz4Sequence(sequence);
+			size_t match = hashTable[hash];
+			hashTable[hash] = (uint32_t)position;
+
+			if (position - match > LZ4_MAX_DISTANCE ||
+				readLz4Sequence(source + match) != sequence)
+			{
+				// Skip faster through the incompressible data
+				position += 1 + ((position - anchor) >> 6);
+				continue;
+			}
+
+			while (position > anchor && match > 0 &&
+				source[position - 1] == source[match - 1])
+			{
+				position--;
+				match--;
+			}
+
+			size_t matchLength = LZ4_MIN_MATCH;
+
+			while (position + matchLength < matchEnd &&
+				source[position + matchLength] == source[match + matchLength])
+			{
+				matchLength++;
+			}
+
+			bool result = writeLz4Sequence(
+				source + anchor,
+				position - anchor,
+				position - match,
+				matchLength,
+				destination,
+				destinationSize,
+				&output);
+
+			if (result == false)
+				return 0;
+
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	bool result = writeLz4Sequence(
+		source + anchor,
+		sourceSize - anchor,
+		0,
+		0,
+		destination,
+		destinationSize,
+		&output);
+
+	return result == true ? output : 0;
+}
+
+inline static bool readLz4Length(
+	const uint8_t* source,
+	size_t sourceSize,
+	size_t* input,
+	size_t* length)
+{
+	size_t offset = *input;
+	uint8_t value;
+
+	do
+	{
+		if (offset == sourceSize)
+			return false;
+
+		value = source[offset++];
+		*length += value;
+	} while (value == 255);
+
+	*input = offset;
+	return true;
+}
+
+bool decompressLz4Block(
+	const void* _source,
+	size_t sourceSize,
+	void* _destination,
+	size_t destinationSize)
+{
+	assert(_source != NULL);
+	assert(_destination != NULL);
+
+	const uint8_t* source = _source;
+	uint8_t* destination = _destination;
+	size_t input = 0;
+	size_t output = 0;
+
+	while (input < sourceSize)
+	{
+		uint8_t token = source[input++];
+		size_t literalLength = token >> 4;
+
+		if (literalLength == 15)
+		{
+			bool result = readLz4Length(
+				source,
+				sourceSize,
+				&input,
+				&literalLength);
+
+			if (result == false)
+				return false;
+		}
+
+		if (literalLength > sourceSize - input ||
+			literalLength > destinationSize - output)
+		{
+			return false;
+		}
+
+		memcpy(
+			destination + output,
+			source + input,
+			literalLength);
+
+		input += literalLength;
+		output += literalLength;
+
+		// Last sequence has only literals
+		if (input == sourceSize)
+			return output == destinationSize;
+		if (sourceSize - input < 2)
+			return false;
+
+		size_t matchOffset =
+			(size_t)source[input] |
+			(size_t)source[input + 1] << 8;
+		input += 2;
+
+		if (matchOffset == 0 || matchOffset > output)
+			return false;
+
+		size_t matchLength = token & 15;
+
+		if (matchLength == 15)
+		{
+			bool result = readLz4Length(
+				source,
+				sourceSize,
+				&input,
+				&matchLength);
+
+			if (result == false)
+				return false;
+		}
+
+		matchLength += LZ4_MIN_MATCH;
+
+		if (matchLength > destinationSize - output)
+			return false;
+
+		const uint8_t* match = destination + output - matchOffset;
+
+		// Overlapped match repeats the last bytes
+		if (matchOffset >= matchLength)
+		{
+			memcpy(
+				destination + output,
+				match,
+				matchLength);
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; i++)
+				destination[output + i] = match[i];
+		}
+
+		output += matchLength;
+	}
+
+	return false;
+}
@@ -0,0 +1,199 @@
+#include "mpnw/datagram_aggregator.h"
+#include "mpnw/stream_decoder.h"
+
+#include <assert.h>
+
+struct DatagramAggregator
+{
+	size_t packetSize;
+	OnDatagramAggregatorSend onSend;
+	OnDatagramAggregatorReceive onReceive;
+	void* handle;
+	uint8_t* packetBuffer;
+	size_t byteCount;
+	uint64_t messageCount;
+	uint64_t packetCount;
+};
+
+DatagramAggregator createDatagramAggregator(
+	size_t packetSize,
+	OnDatagramAggregatorSend onSend,
+	OnDatagramAggregatorReceive onReceive,
+	void* handle)
+{
+	assert(packetSize > MAX_STREAM_VARINT_SIZE);
+	assert(onSend != NULL);
+	assert(onReceive != NULL);
+
+	DatagramAggregator aggregator = malloc(
+		sizeof(struct DatagramAggregator));
+
+	if (aggregator == NULL)
+		return NULL;
+
+	uint8_t* packetBuffer = malloc(
+		packetSize * sizeof(uint8_t));
+
+	if (packetBuffer == NULL)
+	{
+		free(aggregator);
+		return NULL;
+	}
+
+	aggregator->packetSize = packetSize;
+	aggregator->onSend = onSend;
+	aggregator->onReceive = onReceive;
+	aggregator->handle = handle;
+	aggregator->packetBuffer = packetBuffer;
+	aggregator->byteCount = 0;
+	aggregator->messageCount = 0;
+	aggregator->packetCount = 0;
+	return aggregator;
+}
+
+void destroyDatagramAggregator(DatagramAggregator aggregator)
+{
+	if (aggregator == NULL)
+		return;
+
+	free(aggregator->packetBuffer);
+	free(aggregator);
+}
+
+size_t getDatagramAggregatorPacketSize(DatagramAggregator aggregator)
+{
+	assert(aggregator != NULL);
+	return aggregator->packetSize;
+}
+
+void* getDatagramAggregatorHandle(DatagramAggregator aggregator)
+{
+	assert(aggregator != NULL);
+	return aggregator->handle;
+}
+
+size_t getDatagramAggregatorByteCount(DatagramAggregator aggregator)
+{
+	assert(aggregator != NULL);
+	return aggregator->byteCount;
+}
+
+void getDatagramAggregatorStats(
+	DatagramAggregator aggregator,
+	uint64_t* messageCount,
+	uint64_t* packetCount)
+{
+	assert(aggregator != NULL);
+	assert(messageCount != NULL);
+	assert(packetCount != NULL);
+
+	*messageCount = aggregator->messageCount;
+	*packetCount = aggregator->packetCount;
+}
+
+bool flushDatagramAggregator(DatagramAggregator aggregator)
+{
+	assert(aggregator != NULL);
+
+	size_t byteCount = aggregator->byteCount;
+
+	if (byteCount == 0)
+		return true;
+
+	aggregator->byteCount = 0;
+	aggregator->packetCount++;
+
+	return aggregator->onSend(
+		aggregator,
+		aggregator->packetBuffer,
+		byteCount);
+}
+
+bool datagramAggregatorSend(
+	DatagramAggregator aggregator,
+	const void* buffer,
+	size_t count)
+{
+	assert(aggregator != NULL);
+	assert(buffer != NULL);
+	assert(count != 0);
+
+	uint8_t header[MAX_STREAM_VARINT_SIZE];
+
+	size_t headerSize = encodeStreamVarint(
+		count,
+		header);
+
+	size_t messageSize = headerSize + count;
+
+	// Message with the length prefix should fit one packet
+	if (messageSize > aggregator->packetSize)
+		return false;
+
+	if (aggregator->byteCount + messageSize > aggregator->packetSize)
+	{
+		bool result = flushDatagramAggregator(aggregator);
+
+		if (result == false)
+			return false;
+	}
+
+	uint8_t* packetBuffer = aggregator->packetBuffer +
+		aggregator->byteCount;
+
+	memcpy(
+		packetBuffer,
+		header,
+		headerSize);
+	memcpy(
+		packetBuffer + headerSize,
+		buffer,
+		count);
+
+	aggregator->byteCount += messageSize;
+	aggregator->messageCount++;
+	return true;
+}
+
+bool datagramAggregatorReceive(
+	DatagramAggregator aggregator,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	assert(aggregator != NULL);
+	assert(buffer != NULL);
+
+	if (byteCount == 0)
+		return false;
+
+	OnDatagramAggregatorReceive onReceive = aggregator->onReceive;
+	size_t offset = 0;
+
+	while (offset < byteCount)
+	{
+		uint64_t size;
+
+		size_t headerSize = decodeStreamVarint(
+			buffer + offset,
+			byteCount - offset,
+			&size);
+
+		offset += headerSize;
+
+		// Messages before the bad one are already received
+		if (headerSize == 0 || size == 0 ||
+			size > byteCount - offset)
+		{
+			return false;
+		}
+
+		onReceive(
+			aggregator,
+			buffer + offset,
+			(size_t)size);
+
+		offset += (size_t)size;
+	}
+
+	return true;
+}
@@ -0,0 +1,683 @@
+#include "mpnw/datagram_channel.h"
+#include "mpmt/thread.h"
+
+#include <assert.h>
+
+#define INITIAL_RETRANSMIT_TIMEOUT 0.25
+#define MIN_RETRANSMIT_TIMEOUT 0.05
+#define MAX_RETRANSMIT_TIMEOUT 2.0
+// Bandwidth max filter window, in round trip times
+#define BANDWIDTH_WINDOW_RTT_COUNT 10.0
+#define MIN_BANDWIDTH_WINDOW_TIME 1.0
+
+typedef enum DatagramChannelPacket
+{
+	RELIABLE_DATAGRAM_CHANNEL_PACKET = 0,
+	UNRELIABLE_DATAGRAM_CHANNEL_PACKET = 1,
+	ACK_DATAGRAM_CHANNEL_PACKET = 2,
+	DATAGRAM_CHANNEL_PACKET_COUNT = 3,
+} DatagramChannelPacket;
+
+typedef struct DatagramChannelSlot
+{
+	size_t size;
+	double sendTime;
+	uint64_t deliveredSize;
+	double deliveredTime;
+	uint32_t sendCount;
+	bool isUsed;
+	bool isLost;
+} DatagramChannelSlot;
+
+struct DatagramChannel
+{
+	size_t windowSize;
+	size_t packetSize;
+	OnDatagramChannelSend onSend;
+	OnDatagramChannelReceive onReceive;
+	void* handle;
+	DatagramChannelSlot* sendSlots;
+	uint8_t* sendBuffer;
+	DatagramChannelSlot* receiveSlots;
+	uint8_t* receiveBuffer;
+	uint8_t* packetBuffer;
+	double roundTripTime;
+	double roundTripVariance;
+	double retransmitTimeout;
+	uint64_t retransmitCount;
+	uint64_t deliveredSize;
+	double deliveredTime;
+	double maxBandwidth;
+	double lastMaxBandwidth;
+	double bandwidthTime;
+	uint16_t sendBase;
+	uint16_t sendNext;
+	uint16_t receiveBase;
+	bool hasRoundTripTime;
+	bool isAckPending;
+};
+
+inline static int16_t getSequenceDistance(
+	uint16_t a,
+	uint16_t b)
+{
+	return (int16_t)(uint16_t)(a - b);
+}
+
+DatagramChannel createDatagramChannel(
+	size_t windowSize,
+	size_t packetSize,
+	OnDatagramChannelSend onSend,
+	OnDatagramChannelReceive onReceive,
+	void* handle)
+{
+	assert(windowSize > 1);
+	assert(windowSize <= MAX_DATAGRAM_CHANNEL_WINDOW_SIZE);
+	assert((windowSize & (windowSize - 1)) == 0);
+	assert(packetSize > DATAGRAM_CHANNEL_HEADER_SIZE);
+	assert(onSend != NULL);
+	assert(onReceive != NULL);
+
+	DatagramChannel channel = calloc(1,
+		sizeof(struct DatagramChannel));
+
+	if (channel == NULL)
+		return NULL;
+
+	channel->windowSize = windowSize;
+	channel->packetSize = packetSize;
+	channel->onSend = onSend;
+	channel->onReceive = onReceive;
+	channel->handle = handle;
+	channel->retransmitTimeout = INITIAL_RETRANSMIT_TIMEOUT;
+	channel->deliveredTime = getCurrentClock();
+	channel->bandwidthTime = channel->deliveredTime;
+
+	DatagramChannelSlot* sendSlots = calloc(windowSize,
+		sizeof(DatagramChannelSlot));
+
+	if (sendSlots == NULL)
+	{
+		destroyDatagramChannel(channel);
+		return NULL;
+	}
+
+	channel->sendSlots = sendSlots;
+
+	uint8_t* sendBuffer = malloc(
+		windowSize * packetSize * sizeof(uint8_t));
+
+	if (sendBuffer == NULL)
+	{
+		destroyDatagramChannel(channel);
+		return NULL;
+	}
+
+	channel->sendBuffer = sendBuffer;
+
+	DatagramChannelSlot* receiveSlots = calloc(windowSize,
+		sizeof(DatagramChannelSlot));
+
+	if (receiveSlots == NULL)
+	{
+		destroyDatagramChannel(channel);
+		return NULL;
+	}
+
+	channel->receiveSlots = receiveSlots;
+
+	uint8_t* receiveBuffer = malloc(
+		windowSize * packetSize * sizeof(uint8_t));
+
+	if (receiveBuffer == NULL)
+	{
+		destroyDatagramChannel(channel);
+		return NULL;
+	}
+
+	channel->receiveBuffer = receiveBuffer;
+
+	uint8_t* packetBuffer = malloc(
+		packetSize * sizeof(uint8_t));
+
+	if (packetBuffer == NULL)
+	{
+		destroyDatagramChannel(channel);
+		return NULL;
+	}
+
+	channel->packetBuffer = packetBuffer;
+	return channel;
+}
+
+void destroyDatagramChannel(DatagramChannel channel)
+{
+	if (channel == NULL)
+		return;
+
+	free(channel->packetBuffer);
+	free(channel->receiveBuffer);
+	free(channel->receiveSlots);
+	free(channel->sendBuffer);
+	free(channel->sendSlots);
+	free(channel);
+}
+
+size_t getDatagramChannelWindowSize(DatagramChannel channel)
+{
+	assert(channel != NULL);
+	return channel->windowSize;
+}
+
+size_t getDatagramChannelPacketSize(DatagramChannel channel)
+{
+	assert(channel != NULL);
+	return channel->packetSize;
+}
+
+void* getDatagramChannelHandle(DatagramChannel channel)
+{
+	assert(channel != NULL);
+	return channel->handle;
+}
+
+double getDatagramChannelRoundTripTime(DatagramChannel channel)
+{
+	assert(channel != NULL);
+	return channel->roundTripTime;
+}
+
+double getDatagramChannelRoundTripVariance(DatagramChannel channel)
+{
+	assert(channel != NULL);
+	return channel->roundTripVariance;
+}
+
+double getDatagramChannelRetransmitTimeout(DatagramChannel channel)
+{
+	assert(channel != NULL);
+	return channel->retransmitTimeout;
+}
+
+size_t getDatagramChannelPendingCount(DatagramChannel channel)
+{
+	assert(channel != NULL);
+	return (uint16_t)(channel->sendNext - channel->sendBase);
+}
+
+uint64_t getDatagramChannelRetransmitCount(DatagramChannel channel)
+{
+	assert(channel != NULL);
+	return channel->retransmitCount;
+}
+
+double getDatagramChannelBandwidth(DatagramChannel channel)
+{
+	assert(channel != NULL);
+
+	return channel->maxBandwidth > channel->lastMaxBandwidth ?
+		channel->maxBandwidth : channel->lastMaxBandwidth;
+}
+
+static void writeDatagramChannelHeader(
+	DatagramChannel channel,
+	uint8_t* buffer,
+	uint8_t type,
+	uint16_t sequence)
+{
+	DatagramChannelSlot* receiveSlots = channel->receiveSlots;
+	size_t windowMask = channel->windowSize - 1;
+	uint16_t receiveBase = channel->receiveBase;
+	uint64_t ackBits = 0;
+
+	// Selective acks of the packets after the next expected one
+	for (uint16_t i = 0; i < windowMask; i++)
+	{
+		uint16_t index = (uint16_t)(receiveBase + 1 + i) & windowMask;
+
+		if (receiveSlots[index].isUsed == true)
+			ackBits |= (uint64_t)1 << i;
+	}
+
+	uint16_t sequenceValue = hostToNet16(sequence);
+	uint16_t ackValue = hostToNet16(receiveBase);
+	ackBits = hostToNet64(ackBits);
+
+	buffer[0] = type;
+
+	memcpy(
+		buffer + 1,
+		&sequenceValue,
+		sizeof(uint16_t));
+	memcpy(
+		buffer + 3,
+		&ackValue,
+		sizeof(uint16_t));
+	memcpy(
+		buffer + 5,
+		&ackBits,
+		sizeof(uint64_t));
+
+	channel->isAckPending = false;
+}
+
+static void updateDatagramChannelTimeout(
+	DatagramChannel channel,
+	double sample)
+{
+	// RFC 6298 smoothed round trip time estimation
+	if (channel->hasRoundTripTime == false)
+	{
+		channel->roundTripTime = sample;
+		channel->roundTripVariance = sample * 0.5;
+		channel->hasRoundTripTime = true;
+	}
+	else
+	{
+		double difference = channel->roundTripTime - sample;
+
+		if (difference < 0.0)
+			difference = -difference;
+
+		channel->roundTripVariance =
+			channel->roundTripVariance * 0.75 + difference * 0.25;
+		channel->roundTripTime =
+			channel->roundTripTime * 0.875 + sample * 0.125;
+	}
+
+	double timeout = channel->roundTripTime +
+		channel->roundTripVariance * 4.0;
+
+	if (timeout < MIN_RETRANSMIT_TIMEOUT)
+		timeout = MIN_RETRANSMIT_TIMEOUT;
+	else if (timeout > MAX_RETRANSMIT_TIMEOUT)
+		timeout = MAX_RETRANSMIT_TIMEOUT;
+
+	channel->retransmitTimeout = timeout;
+}
+
+static void updateDatagramChannelBandwidth(
+	DatagramChannel channel,
+	const DatagramChannelSlot* slot,
+	double currentTime)
+{
+	channel->deliveredSize += slot->size;
+	channel->deliveredTime = currentTime;
+
+	// Delivery rate since the packet was sent, as in BBR
+	double interval = currentTime - slot->deliveredTime;
+
+	if (interval <= 0.0)
+		return;
+
+	double sample = (double)(channel->deliveredSize -
+		slot->deliveredSize) / interval;
+
+	double windowTime = channel->roundTripTime *
+		BANDWIDTH_WINDOW_RTT_COUNT;
+
+	if (windowTime < MIN_BANDWIDTH_WINDOW_TIME)
+		windowTime = MIN_BANDWIDTH_WINDOW_TIME;
+
+	// Windowed max filter, application limited samples are low
+	if (currentTime - channel->bandwidthTime > windowTime)
+	{
+		channel->lastMaxBandwidth = channel->maxBandwidth;
+		channel->maxBandwidth = 0.0;
+		channel->bandwidthTime = currentTime;
+	}
+
+	if (sample > channel->maxBandwidth)
+		channel->maxBandwidth = sample;
+}
+
+bool datagramChannelSend(
+	DatagramChannel channel,
+	const void* buffer,
+	size_t count,
+	bool isReliable)
+{
+	assert(channel != NULL);
+	assert(buffer != NULL);
+	assert(count != 0);
+	assert(count <= channel->packetSize - DATAGRAM_CHANNEL_HEADER_SIZE);
+
+	if (isReliable == false)
+	{
+		uint8_t* packetBuffer = channel->packetBuffer;
+
+		writeDatagramChannelHeader(
+			channel,
+			packetBuffer,
+			UNRELIABLE_DATAGRAM_CHANNEL_PACKET,
+			0);
+		memcpy(
+			packetBuffer + DATAGRAM_CHANNEL_HEADER_SIZE,
+			buffer,
+			count);
+
+		return channel->onSend(
+			channel,
+			packetBuffer,
+			count + DATAGRAM_CHANNEL_HEADER_SIZE);
+	}
+
+	uint16_t sequence = channel->sendNext;
+
+	if ((uint16_t)(sequence - channel->sendBase) >= channel->windowSize)
+		return false;
+
+	size_t index = sequence & (channel->windowSize - 1);
+	DatagramChannelSlot* slot = &channel->sendSlots[index];
+	uint8_t* packet = channel->sendBuffer + index * channel->packetSize;
+	size_t size = count + DATAGRAM_CHANNEL_HEADER_SIZE;
+
+	writeDatagramChannelHeader(
+		channel,
+		packet,
+		RELIABLE_DATAGRAM_CHANNEL_PACKET,
+		sequence);
+	memcpy(
+		packet + DATAGRAM_CHANNEL_HEADER_SIZE,
+		buffer,
+		count);
+
+	slot->size = size;
+	slot->sendTime = getCurrentClock();
+	slot->deliveredSize = channel->deliveredSize;
+	slot->deliveredTime = channel->deliveredTime;
+	slot->sendCount = 1;
+	slot->isUsed = true;
+	slot->isLost = false;
+	channel->sendNext = sequence + 1;
+
+	// Lost packet is retransmitted on timeout
+	return channel->onSend(
+		channel,
+		packet,
+		size);
+}
+
+static bool handleDatagramChannelAcks(
+	DatagramChannel channel,
+	uint16_t ack,
+	uint64_t ackBits)
+{
+	uint16_t sendBase = channel->sendBase;
+	uint16_t sendNext = channel->sendNext;
+
+	if (getSequenceDistance(ack, sendNext) > 0)
+		return false;
+
+	DatagramChannelSlot* sendSlots = channel->sendSlots;
+	size_t windowMask = channel->windowSize - 1;
+	double currentTime = getCurrentClock();
+	uint16_t lastAck = sendBase;
+	bool hasAcks = false;
+
+	for (uint16_t sequence = sendBase; sequence != sendNext; sequence++)
+	{
+		int16_t distance = getSequenceDistance(sequence, ack);
+
+		if (distance >= 0 && (distance == 0 || distance > 64 ||
+			(ackBits & ((uint64_t)1 << (distance - 1))) == 0))
+		{
+			continue;
+		}
+
+		lastAck = sequence;
+		hasAcks = true;
+
+		DatagramChannelSlot* slot = &sendSlots[sequence & windowMask];
+
+		if (slot->isUsed == false)
+			continue;
+
+		// Karn's algorithm, ambiguous samples are skipped
+		if (slot->sendCount == 1)
+		{
+			updateDatagramChannelTimeout(
+				channel,
+				currentTime - slot->sendTime);
+		}
+
+		updateDatagramChannelBandwidth(
+			channel,
+			slot,
+			currentTime);
+
+		slot->isUsed = false;
+	}
+
+	// Packets skipped by the selective acks are retransmitted early
+	if (hasAcks == true)
+	{
+		for (uint16_t sequence = sendBase; sequence != lastAck; sequence++)
+		{
+			DatagramChannelSlot* slot = &sendSlots[sequence & windowMask];
+
+			if (slot->isUsed == true)
+				slot->isLost = true;
+		}
+	}
+
+	while (sendBase != sendNext &&
+		sendSlots[sendBase & windowMask].isUsed == false)
+	{
+		sendBase++;
+	}
+
+	channel->sendBase = sendBase;
+	return true;
+}
+
+bool datagramChannelReceive(
+	DatagramChannel channel,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	assert(channel != NULL);
+	assert(buffer != NULL);
+
+	if (byteCount < DATAGRAM_CHANNEL_HEADER_SIZE ||
+		byteCount > channel->packetSize)
+	{
+		return false;
+	}
+
+	uint8_t type = buffer[0];
+
+	if (type >= DATAGRAM_CHANNEL_PACKET_COUNT)
+		return false;
+
+	uint16_t sequence, ack;
+	uint64_t ackBits;
+
+	memcpy(
+		&sequence,
+		buffer + 1,
+		sizeof(uint16_t));
+	memcpy(
+		&ack,
+		buffer + 3,
+		sizeof(uint16_t));
+	memcpy(
+		&ackBits,
+		buffer + 5,
+		sizeof(uint64_t));
+
+	bool result = handleDatagramChannelAcks(
+		channel,
+		netToHost16(ack),
+		netToHost64(ackBits));
+
+	if (result == false)
+		return false;
+
+	const uint8_t* data = buffer + DATAGRAM_CHANNEL_HEADER_SIZE;
+	size_t dataSize = byteCount - DATAGRAM_CHANNEL_HEADER_SIZE;
+
+	if (type == ACK_DATAGRAM_CHANNEL_PACKET)
+	{
+		return dataSize == 0;
+	}
+	else if (type == UNRELIABLE_DATAGRAM_CHANNEL_PACKET)
+	{
+		if (dataSize == 0)
+			return false;
+
+		channel->onReceive(
+			channel,
+			data,
+			dataSize,
+			false);
+		return true;
+	}
+
+	if (dataSize == 0)
+		return false;
+
+	sequence = netToHost16(sequence);
+	channel->isAckPending = true;
+
+	size_t windowSize = channel->windowSize;
+	uint16_t receiveBase = channel->receiveBase;
+	int16_t distance = getSequenceDistance(sequence, receiveBase);
+
+	// Duplicate is acknowledged again, ahead of window is dropped
+	if (distance < 0 || distance >= (int16_t)windowSize)
+		return true;
+
+	DatagramChannelSlot* receiveSlots = channel->receiveSlots;
+	size_t windowMask = windowSize - 1;
+	size_t packetSize = channel->packetSize;
+
+	if (distance != 0)
+	{
+		size_t index = sequence & windowMask;
+		DatagramChannelSlot* slot = &receiveSlots[index];
+
+		if (slot->isUsed == false)
+		{
+			memcpy(
+				channel->receiveBuffer + index * packetSize,
+				data,
+				dataSize);
+			slot->size = dataSize;
+			slot->isUsed = true;
+		}
+
+		return true;
+	}
+
+	channel->receiveBase = ++receiveBase;
+
+	channel->onReceive(
+		channel,
+		data,
+		dataSize,
+		true);
+
+	// Deliver buffered packets that are now in order
+	while (true)
+	{
+		size_t index = channel->receiveBase & windowMask;
+		DatagramChannelSlot* slot = &receiveSlots[index];
+
+		if (slot->isUsed == false)
+			break;
+
+		slot->isUsed = false;
+		channel->receiveBase++;
+
+		channel->onReceive(
+			channel,
+			channel->receiveBuffer + index * packetSize,
+			slot->size,
+			true);
+	}
+
+	return true;
+}
+
+bool updateDatagramChannel(DatagramChannel channel)
+{
+	assert(channel != NULL);
+
+	DatagramChannelSlot* sendSlots = channel->sendSlots;
+	uint8_t* sendBuffer = channel->sendBuffer;
+	size_t windowMask = channel->windowSize - 1;
+	size_t packetSize = channel->packetSize;
+	double retransmitTimeout = channel->retransmitTimeout;
+	double currentTime = getCurrentClock();
+	uint16_t sendNext = channel->sendNext;
+
+	for (uint16_t sequence = channel->sendBase; sequence != sendNext; sequence++)
+	{
+		size_t index = sequence & windowMask;
+		DatagramChannelSlot* slot = &sendSlots[index];
+
+		if (slot->isUsed == false)
+			continue;
+
+		double timeout;
+
+		if (slot->isLost == true)
+		{
+			// Single retransmission per round trip of the skipped packet
+			timeout = channel->hasRoundTripTime == true ?
+				channel->roundTripTime : retransmitTimeout;
+		}
+		else
+		{
+			// Exponential backoff of the repeated retransmissions
+			timeout = retransmitTimeout * (double)((uint32_t)1 <<
+				(slot->sendCount < 8 ? slot->sendCount - 1 : 7));
+
+			if (timeout > MAX_RETRANSMIT_TIMEOUT)
+				timeout = MAX_RETRANSMIT_TIMEOUT;
+		}
+
+		if (currentTime - slot->sendTime < timeout)
+			continue;
+
+		uint8_t* packet = sendBuffer + index * packetSize;
+
+		writeDatagramChannelHeader(
+			channel,
+			packet,
+			RELIABLE_DATAGRAM_CHANNEL_PACKET,
+			sequence);
+
+		slot->sendTime = currentTime;
+		slot->deliveredSize = channel->deliveredSize;
+		slot->deliveredTime = channel->deliveredTime;
+		slot->sendCount++;
+		slot->isLost = false;
+		channel->retransmitCount++;
+
+		bool result = channel->onSend(
+			channel,
+			packet,
+			slot->size);
+
+		if (result == false)
+			return false;
+	}
+
+	if (channel->isAckPending == false)
+		return true;
+
+	uint8_t* packetBuffer = channel->packetBuffer;
+
+	writeDatagramChannelHeader(
+		channel,
+		packetBuffer,
+		ACK_DATAGRAM_CHANNEL_PACKET,
+		0);
+
+	return channel->onSend(
+		channel,
+		packetBuffer,
+		DATAGRAM_CHANNEL_HEADER_SIZE);
+}
@@ -1,6 +1,20 @@
 #include "mpnw/datagram_client.h"
+#include "mpnw/datagram_clock.h"
+#include "mpmt/thread.h"
+
 #include <assert.h>
 
+// Client connection packet header size (type and ID)
+#define CONNECTION_HEADER_SIZE 9
+
+typedef enum DatagramConnectionPacket
+{
+	DATA_DATAGRAM_CONNECTION_PACKET = 0,
+	PATH_DATAGRAM_CONNECTION_PACKET = 1,
+	TIME_DATAGRAM_CONNECTION_PACKET = 2,
+	DATAGRAM_CONNECTION_PACKET_COUNT = 3,
+} DatagramConnectionPacket;
+
 struct DatagramClient
 {
 	size_t bufferSize;
@@ -8,13 +22,24 @@ struct DatagramClient
 	void* handle;
 	uint8_t* buffer;
 	Socket socket;
+	SslContext sslContext;
+	DtlsSession session;
+	uint8_t* messageBuffer;
+	uint64_t connectionID;
+	DatagramClockState clock;
+	double probeDelay;
+	double probeTime;
+	double echoTime;
+	double echoReceiveTime;
+	bool isFailed;
 };
 
 DatagramClient createDatagramClient(
 	SocketAddress remoteAddress,
 	size_t bufferSize,
 	OnDatagramClientReceive onReceive,
-	void* handle)
+	void* handle,
+	SslContext sslContext)
 {
 	assert(remoteAddress != NULL);
 	assert(bufferSize != 0);
@@ -101,6 +126,62 @@ DatagramClient createDatagramClient(
 	client->handle = handle;
 	client->buffer = buffer;
 	client->socket = socket;
+	client->sslContext = sslContext;
+	client->session = NULL;
+	client->messageBuffer = NULL;
+	client->connectionID = 0;
+	client->probeDelay = 0.0;
+	client->probeTime = 0.0;
+	client->echoTime = 0.0;
+	client->echoReceiveTime = 0.0;
+	client->isFailed = false;
+	initializeDatagramClockState(&client->clock);
+
+	if (sslContext == NULL)
+		return client;
+
+	uint8_t* messageBuffer = malloc(
+		bufferSize * sizeof(uint8_t));
+
+	if (messageBuffer == NULL)
+	{
+		destroyDatagramClient(client);
+		return NULL;
+	}
+
+	client->messageBuffer = messageBuffer;
+
+	DtlsSession session = createDtlsSession(
+		socket,
+		sslContext,
+		NULL,
+		false);
+
+	if (session == NULL)
+	{
+		destroyDatagramClient(client);
+		return NULL;
+	}
+
+	client->session = session;
+
+	size_t messageSize;
+
+	// Sends the first client hello
+	result = dtlsSessionReceive(
+		session,
+		NULL,
+		0,
+		messageBuffer,
+		bufferSize,
+		&messageSize);
+
+	if (result == false)
+	{
+		destroyDatagramClient(client);
+		return NULL;
+	}
+
 	return client;
 }
 
@@ -111,6 +192,12 @@ void destroyDatagramClient(DatagramClient client)
 	if (client == NULL)
 		return;
 
+	if (client->sslContext != NULL)
+	{
+		destroyDtlsSession(client->session);
+		free(client->messageBuffer);
+	}
+
 	shutdownSocket(
 		client->socket,
 		RECEIVE_SEND_SOCKET_SHUTDOWN);
@@ -147,10 +234,277 @@ Socket getDatagramClientSocket(DatagramClient client)
 	return client->socket;
 }
 
+SslContext getDatagramClientSslContext(DatagramClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->sslContext;
+}
+
+uint64_t getDatagramClientConnectionID(DatagramClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->connectionID;
+}
+
+void setDatagramClientConnectionID(
+	DatagramClient client,
+	uint64_t connectionID)
+{
+	assert(client != NULL);
+	assert(client->sslContext == NULL);
+	assert(isNetworkInitialized() == true);
+	client->connectionID = connectionID;
+}
+
+double getDatagramClientProbeDelay(DatagramClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->probeDelay;
+}
+
+void setDatagramClientProbeDelay(
+	DatagramClient client,
+	double delay)
+{
+	assert(client != NULL);
+	assert(delay >= 0.0);
+	assert(isNetworkInitialized() == true);
+	client->probeDelay = delay;
+}
+
+double getDatagramClientRoundTripTime(DatagramClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->clock.roundTripTime;
+}
+
+double getDatagramClientRoundTripVariance(DatagramClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->clock.roundTripVariance;
+}
+
+double getDatagramClientClockOffset(DatagramClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->clock.clockOffset;
+}
+
+bool isDatagramClientConnected(DatagramClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+
+	if (client->sslContext == NULL)
+		return true;
+
+	return isDtlsSessionConnected(client->session);
+}
+
+bool isDatagramClientFailed(DatagramClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->isFailed;
+}
+
+// Failed or closed session is not recoverable,
+// it is reported once with the empty datagram
+static void failDatagramClient(DatagramClient client)
+{
+	client->isFailed = true;
+
+	client->onReceive(
+		client,
+		NULL,
+		0);
+}
+
+static void receiveDtlsDatagram(
+	DatagramClient client,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	DtlsSession session = client->session;
+	uint8_t* messageBuffer = client->messageBuffer;
+	size_t bufferSize = client->bufferSize;
+
+	while (true)
+	{
+		size_t messageSize;
+
+		bool result = dtlsSessionReceive(
+			session,
+			buffer,
+			byteCount,
+			messageBuffer,
+			bufferSize,
+			&messageSize);
+
+		if (result == false)
+		{
+			failDatagramClient(client);
+			return;
+		}
+
+		if (messageSize == 0)
+			return;
+
+		client->onReceive(
+			client,
+			messageBuffer,
+			messageSize);
+
+		buffer = NULL;
+		byteCount = 0;
+	}
+}
+
+static bool sendConnectionDatagram(
+	DatagramClient client,
+	uint8_t type,
+	const void* buffer,
+	size_t count)
+{
+	uint8_t header[CONNECTION_HEADER_SIZE];
+	header[0] = type;
+
+	uint64_t connectionID = hostToNet64(client->connectionID);
+
+	memcpy(
+		header + 1,
+		&connectionID,
+		sizeof(uint64_t));
+
+	const void* buffers[2] = { header, buffer, };
+	size_t counts[2] = { CONNECTION_HEADER_SIZE, count, };
+	size_t sentCount;
+
+	bool result = socketSendBuffers(
+		client->socket,
+		buffers,
+		counts,
+		2,
+		&sentCount);
+
+	return result == true &&
+		sentCount == CONNECTION_HEADER_SIZE + count;
+}
+
+static void sendTimeDatagram(DatagramClient client)
+{
+	double currentTime = getCurrentClock();
+
+	if (currentTime - client->probeTime < client->probeDelay)
+		return;
+
+	client->probeTime = currentTime;
+
+	double echoTime = client->echoTime;
+
+	// Server measures its own round trip from the echoed time
+	double holdTime = echoTime != 0.0 ?
+		currentTime - client->echoReceiveTime : 0.0;
+
+	uint8_t payload[sizeof(double) * 3];
+
+	encodeDatagramClockTime(
+		currentTime,
+		payload);
+	encodeDatagramClockTime(
+		echoTime,
+		payload + sizeof(double));
+	encodeDatagramClockTime(
+		holdTime,
+		payload + sizeof(double) * 2);
+
+	sendConnectionDatagram(
+		client,
+		TIME_DATAGRAM_CONNECTION_PACKET,
+		payload,
+		sizeof(payload));
+}
+
+static void receiveTimeDatagram(
+	DatagramClient client,
+	const uint8_t* buffer)
+{
+	double receiveTime = getCurrentClock();
+	double sendTime = decodeDatagramClockTime(buffer);
+	double serverReceiveTime = decodeDatagramClockTime(buffer + sizeof(double));
+	double serverSendTime = decodeDatagramClockTime(buffer + sizeof(double) * 2);
+
+	// Only the latest probe is answered, old responses are stale
+	if (sendTime != client->probeTime)
+		return;
+
+	addDatagramClockExchange(
+		&client->clock,
+		sendTime,
+		serverSendTime,
+		serverSendTime - serverReceiveTime,
+		receiveTime);
+
+	client->echoTime = serverSendTime;
+	client->echoReceiveTime = receiveTime;
+}
+
+static void receiveConnectionDatagram(
+	DatagramClient client,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	if (byteCount == 0)
+		return;
+
+	if (buffer[0] == PATH_DATAGRAM_CONNECTION_PACKET)
+	{
+		// Challenge is echoed back from the current address
+		if (byteCount == sizeof(uint8_t) + sizeof(uint64_t))
+		{
+			sendConnectionDatagram(
+				client,
+				PATH_DATAGRAM_CONNECTION_PACKET,
+				buffer + 1,
+				sizeof(uint64_t));
+		}
+
+		return;
+	}
+	else if (buffer[0] == TIME_DATAGRAM_CONNECTION_PACKET)
+	{
+		if (byteCount == sizeof(uint8_t) + sizeof(double) * 3)
+		{
+			receiveTimeDatagram(
+				client,
+				buffer + 1);
+		}
+
+		return;
+	}
+
+	if (buffer[0] != DATA_DATAGRAM_CONNECTION_PACKET)
+		return;
+
+	client->onReceive(
+		client,
+		buffer + 1,
+		byteCount - 1);
+}
+
 bool updateDatagramClient(DatagramClient client)
 {
 	assert(client != NULL);
 
+	if (client->isFailed == true)
+		return false;
+
 	uint8_t* buffer = client->buffer;
 	size_t byteCount;
 
@@ -161,7 +515,34 @@ bool updateDatagramClient(DatagramClient client)
 		&byteCount);
 
 	if (result == false)
+	{
+		if (client->sslContext != NULL)
+		{
+			if (updateDtlsSession(client->session) == false)
+				failDatagramClient(client);
+		}
+		else if (client->probeDelay != 0.0 && client->connectionID != 0)
+			sendTimeDatagram(client);
 		return false;
+	}
+
+	if (client->sslContext != NULL)
+	{
+		receiveDtlsDatagram(
+			client,
+			buffer,
+			byteCount);
+		return true;
+	}
+
+	if (client->connectionID != 0)
+	{
+		receiveConnectionDatagram(
+			client,
+			buffer,
+			byteCount);
+		return true;
+	}
 
 	client->onReceive(
 		client,
@@ -180,6 +561,23 @@ bool datagramClientSend(
 	assert(count != 0);
 	assert(isNetworkInitialized() == true);
 
+	if (client->sslContext != NULL)
+	{
+		return dtlsSessionSend(
+			client->session,
+			buffer,
+			count);
+	}
+
+	if (client->connectionID != 0)
+	{
+		return sendConnectionDatagram(
+			client,
+			DATA_DATAGRAM_CONNECTION_PACKET,
+			buffer,
+			count);
+	}
+
 	return socketSend(
 		client->socket,
 		buffer,
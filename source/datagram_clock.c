@@ -0,0 +1,84 @@
+#include "mpnw/datagram_clock.h"
+#include <assert.h>
+
+void initializeDatagramClockState(DatagramClockState* state)
+{
+	assert(state != NULL);
+
+	memset(
+		state,
+		0,
+		sizeof(DatagramClockState));
+}
+
+void addDatagramClockSample(
+	DatagramClockState* state,
+	double roundTripTime,
+	double clockOffset)
+{
+	assert(state != NULL);
+
+	// Clock difference may exceed the hold time on a fast path
+	if (roundTripTime < 0.0)
+		roundTripTime = 0.0;
+
+	uint32_t sampleIndex = state->sampleIndex;
+	state->roundTripTimes[sampleIndex] = roundTripTime;
+	state->clockOffsets[sampleIndex] = clockOffset;
+	state->sampleIndex = (sampleIndex + 1) % DATAGRAM_CLOCK_SAMPLE_COUNT;
+
+	uint32_t sampleCount = state->sampleCount;
+
+	if (sampleCount < DATAGRAM_CLOCK_SAMPLE_COUNT)
+		state->sampleCount = ++sampleCount;
+
+	// NTP clock filter, least delayed sample is the most accurate
+	uint32_t minIndex = 0;
+
+	for (uint32_t i = 1; i < sampleCount; i++)
+	{
+		if (state->roundTripTimes[i] < state->roundTripTimes[minIndex])
+			minIndex = i;
+	}
+
+	double filteredTime = state->roundTripTimes[minIndex];
+	double filteredOffset = state->clockOffsets[minIndex];
+
+	if (sampleCount == 1)
+	{
+		state->roundTripTime = filteredTime;
+		state->roundTripVariance = filteredTime * 0.5;
+		state->clockOffset = filteredOffset;
+		return;
+	}
+
+	double difference = state->roundTripTime - filteredTime;
+
+	if (difference < 0.0)
+		difference = -difference;
+
+	state->roundTripVariance =
+		state->roundTripVariance * 0.75 + difference * 0.25;
+	state->roundTripTime =
+		state->roundTripTime * 0.875 + filteredTime * 0.125;
+	state->clockOffset =
+		state->clockOffset * 0.875 + filteredOffset * 0.125;
+}
+
+void addDatagramClockExchange(
+	DatagramClockState* state,
+	double echoTime,
+	double remoteSendTime,
+	double holdTime,
+	double receiveTime)
+{
+	assert(state != NULL);
+
+	double remoteReceiveTime = remoteSendTime - holdTime;
+
+	// Offset is exact when both path delays are equal
+	addDatagramClockSample(
+		state,
+		(receiveTime - echoTime) - holdTime,
+		((remoteReceiveTime - echoTime) + (remoteSendTime - receiveTime)) * 0.5);
+}
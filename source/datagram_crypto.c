@@ -0,0 +1,523 @@
+#include "mpnw/datagram_crypto.h"
+#include <assert.h>
+
+#if MPNW_HAS_OPENSSL
+#include "openssl/evp.h"
+#include "openssl/rand.h"
+#include "openssl/crypto.h"
+#endif
+
+#define NONCE_SIZE 12
+#define TAG_SIZE 16
+#define TOKEN_DATA_SIZE (8 + 8 + DATAGRAM_KEY_SIZE)
+
+struct DatagramCrypto
+{
+#if MPNW_HAS_OPENSSL
+	EVP_CIPHER_CTX* context;
+#endif
+	uint8_t tokenKey[DATAGRAM_KEY_SIZE];
+	uint8_t cipher;
+	bool isServer;
+	bool hasTokenKey;
+};
+
+DatagramCrypto createDatagramCrypto(
+	uint8_t cipher,
+	bool isServer,
+	const uint8_t* tokenKey)
+{
+#if MPNW_HAS_OPENSSL
+	assert(cipher < DATAGRAM_CIPHER_COUNT);
+	assert(tokenKey == NULL || isServer == true);
+
+	DatagramCrypto crypto = calloc(1,
+		sizeof(struct DatagramCrypto));
+
+	if (crypto == NULL)
+		return NULL;
+
+	const EVP_CIPHER* cipherHandle;
+
+	switch (cipher)
+	{
+	default:
+		free(crypto);
+		return NULL;
+	case CHACHA20_POLY1305_DATAGRAM_CIPHER:
+		cipherHandle = EVP_chacha20_poly1305();
+		break;
+	case AES_256_GCM_DATAGRAM_CIPHER:
+		cipherHandle = EVP_aes_256_gcm();
+		break;
+	}
+
+	EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+
+	if (context == NULL)
+	{
+		free(crypto);
+		return NULL;
+	}
+
+	// Cipher is set once, only key and nonce are set per packet
+	int result = EVP_CipherInit_ex(
+		context,
+		cipherHandle,
+		NULL,
+		NULL,
+		NULL,
+		1);
+
+	if (result != 1)
+	{
+		EVP_CIPHER_CTX_free(context);
+		free(crypto);
+		return NULL;
+	}
+
+	if (tokenKey != NULL)
+	{
+		memcpy(
+			crypto->tokenKey,
+			tokenKey,
+			DATAGRAM_KEY_SIZE);
+	}
+
+	crypto->context = context;
+	crypto->cipher = cipher;
+	crypto->isServer = isServer;
+	crypto->hasTokenKey = tokenKey != NULL;
+	return crypto;
+#else
+	abort();
+#endif
+}
+
+void destroyDatagramCrypto(DatagramCrypto crypto)
+{
+#if MPNW_HAS_OPENSSL
+	if (crypto == NULL)
+		return;
+
+	OPENSSL_cleanse(
+		crypto->tokenKey,
+		DATAGRAM_KEY_SIZE);
+	EVP_CIPHER_CTX_free(crypto->context);
+	free(crypto);
+#else
+	abort();
+#endif
+}
+
+uint8_t getDatagramCryptoCipher(DatagramCrypto crypto)
+{
+	assert(crypto != NULL);
+	return crypto->cipher;
+}
+
+bool generateDatagramKey(uint8_t* key)
+{
+#if MPNW_HAS_OPENSSL
+	assert(key != NULL);
+
+	return RAND_bytes(
+		key,
+		DATAGRAM_KEY_SIZE) == 1;
+#else
+	abort();
+#endif
+}
+
+void initializeDatagramCryptoState(
+	DatagramCryptoState* state,
+	const uint8_t* key)
+{
+	assert(state != NULL);
+	assert(key != NULL);
+
+	memcpy(
+		state->key,
+		key,
+		DATAGRAM_KEY_SIZE);
+
+	state->sendSequence = 0;
+	state->receiveSequence = 0;
+	state->replayBits = 0;
+}
+
+#if MPNW_HAS_OPENSSL
+static bool sealAead(
+	DatagramCrypto crypto,
+	const uint8_t* key,
+	const uint8_t* nonce,
+	const uint8_t* data,
+	size_t size,
+	uint8_t* output,
+	uint8_t* tag)
+{
+	EVP_CIPHER_CTX* context = crypto->context;
+	int length = 0;
+
+	int result = EVP_CipherInit_ex(
+		context,
+		NULL,
+		NULL,
+		key,
+		nonce,
+		1);
+
+	if (result != 1)
+		return false;
+
+	if (size != 0)
+	{
+		result = EVP_CipherUpdate(
+			context,
+			output,
+			&length,
+			data,
+			(int)size);
+
+		if (result != 1)
+			return false;
+	}
+
+	result = EVP_CipherFinal_ex(
+		context,
+		output + length,
+		&length);
+
+	if (result != 1)
+		return false;
+
+	return EVP_CIPHER_CTX_ctrl(
+		context,
+		EVP_CTRL_AEAD_GET_TAG,
+		TAG_SIZE,
+		tag) == 1;
+}
+
+static bool openAead(
+	DatagramCrypto crypto,
+	const uint8_t* key,
+	const uint8_t* nonce,
+	const uint8_t* data,
+	size_t size,
+	const uint8_t* tag,
+	uint8_t* output)
+{
+	EVP_CIPHER_CTX* context = crypto->context;
+	int length = 0;
+
+	int result = EVP_CipherInit_ex(
+		context,
+		NULL,
+		NULL,
+		key,
+		nonce,
+		0);
+
+	if (result != 1)
+		return false;
+
+	if (size != 0)
+	{
+		result = EVP_CipherUpdate(
+			context,
+			output,
+			&length,
+			data,
+			(int)size);
+
+		if (result != 1)
+			return false;
+	}
+
+	result = EVP_CIPHER_CTX_ctrl(
+		context,
+		EVP_CTRL_AEAD_SET_TAG,
+		TAG_SIZE,
+		(void*)tag);
+
+	if (result != 1)
+		return false;
+
+	// Fails if authentication tag does not match
+	return EVP_CipherFinal_ex(
+		context,
+		output + length,
+		&length) == 1;
+}
+
+static void writeDatagramNonce(
+	uint8_t* nonce,
+	bool isServer,
+	uint64_t sequence)
+{
+	// Direction prefix separates client and server nonces of one key
+	uint32_t direction = hostToNet32(isServer == true ? 1 : 0);
+	sequence = hostToNet64(sequence);
+
+	memcpy(
+		nonce,
+		&direction,
+		sizeof(uint32_t));
+	memcpy(
+		nonce + sizeof(uint32_t),
+		&sequence,
+		sizeof(uint64_t));
+}
+#endif
+
+bool createDatagramConnectToken(
+	DatagramCrypto crypto,
+	uint64_t clientID,
+	uint64_t expireTime,
+	const uint8_t* key,
+	uint8_t* token)
+{
+#if MPNW_HAS_OPENSSL
+	assert(crypto != NULL);
+	assert(crypto->hasTokenKey == true);
+	assert(key != NULL);
+	assert(token != NULL);
+
+	int result = RAND_bytes(
+		token,
+		NONCE_SIZE);
+
+	if (result != 1)
+		return false;
+
+	uint8_t data[TOKEN_DATA_SIZE];
+	clientID = hostToNet64(clientID);
+	expireTime = hostToNet64(expireTime);
+
+	memcpy(
+		data,
+		&clientID,
+		sizeof(uint64_t));
+	memcpy(
+		data + 8,
+		&expireTime,
+		sizeof(uint64_t));
+	memcpy(
+		data + 16,
+		key,
+		DATAGRAM_KEY_SIZE);
+
+	bool sealResult = sealAead(
+		crypto,
+		crypto->tokenKey,
+		token,
+		data,
+		TOKEN_DATA_SIZE,
+		token + NONCE_SIZE,
+		token + NONCE_SIZE + TOKEN_DATA_SIZE);
+
+	OPENSSL_cleanse(
+		data,
+		TOKEN_DATA_SIZE);
+	return sealResult;
+#else
+	abort();
+#endif
+}
+
+bool openDatagramConnectToken(
+	DatagramCrypto crypto,
+	const uint8_t* token,
+	uint64_t currentTime,
+	uint64_t* clientID,
+	uint8_t* key)
+{
+#if MPNW_HAS_OPENSSL
+	assert(crypto != NULL);
+	assert(crypto->hasTokenKey == true);
+	assert(token != NULL);
+	assert(clientID != NULL);
+	assert(key != NULL);
+
+	uint8_t data[TOKEN_DATA_SIZE];
+
+	bool result = openAead(
+		crypto,
+		crypto->tokenKey,
+		token,
+		token + NONCE_SIZE,
+		TOKEN_DATA_SIZE,
+		token + NONCE_SIZE + TOKEN_DATA_SIZE,
+		data);
+
+	if (result == false)
+		return false;
+
+	uint64_t expireTime;
+
+	memcpy(
+		&expireTime,
+		data + 8,
+		sizeof(uint64_t));
+
+	if (netToHost64(expireTime) < currentTime)
+	{
+		OPENSSL_cleanse(
+			data,
+			TOKEN_DATA_SIZE);
+		return false;
+	}
+
+	memcpy(
+		clientID,
+		data,
+		sizeof(uint64_t));
+	memcpy(
+		key,
+		data + 16,
+		DATAGRAM_KEY_SIZE);
+	OPENSSL_cleanse(
+		data,
+		TOKEN_DATA_SIZE);
+
+	*clientID = netToHost64(*clientID);
+	return true;
+#else
+	abort();
+#endif
+}
+
+size_t sealDatagram(
+	DatagramCrypto crypto,
+	DatagramCryptoState* state,
+	const void* buffer,
+	size_t count,
+	uint8_t* packet)
+{
+#if MPNW_HAS_OPENSSL
+	assert(crypto != NULL);
+	assert(state != NULL);
+	assert(buffer != NULL);
+	assert(count != 0);
+	assert(packet != NULL);
+
+	uint64_t sequence = state->sendSequence;
+
+	// Nonce can not be reused with the same key
+	if (sequence == UINT64_MAX)
+		return 0;
+
+	uint8_t nonce[NONCE_SIZE];
+
+	writeDatagramNonce(
+		nonce,
+		crypto->isServer,
+		sequence);
+	memcpy(
+		packet,
+		nonce + sizeof(uint32_t),
+		sizeof(uint64_t));
+
+	bool result = sealAead(
+		crypto,
+		state->key,
+		nonce,
+		buffer,
+		count,
+		packet + sizeof(uint64_t),
+		packet + sizeof(uint64_t) + count);
+
+	if (result == false)
+		return 0;
+
+	state->sendSequence = sequence + 1;
+	return count + DATAGRAM_SEAL_OVERHEAD;
+#else
+	abort();
+#endif
+}
+
+bool openDatagram(
+	DatagramCrypto crypto,
+	DatagramCryptoState* state,
+	const uint8_t* packet,
+	size_t count,
+	uint8_t* buffer,
+	size_t* byteCount)
+{
+#if MPNW_HAS_OPENSSL
+	assert(crypto != NULL);
+	assert(state != NULL);
+	assert(packet != NULL);
+	assert(buffer != NULL);
+	assert(byteCount != NULL);
+
+	if (count <= DATAGRAM_SEAL_OVERHEAD)
+		return false;
+
+	uint64_t sequence;
+
+	memcpy(
+		&sequence,
+		packet,
+		sizeof(uint64_t));
+
+	sequence = netToHost64(sequence);
+
+	uint64_t receiveSequence = state->receiveSequence;
+	uint64_t distance = 0;
+
+	// Cheap replay check before the decryption
+	if (receiveSequence != 0 && sequence < receiveSequence)
+	{
+		distance = receiveSequence - 1 - sequence;
+
+		if (distance >= DATAGRAM_REPLAY_WINDOW_SIZE ||
+			(state->replayBits & ((uint64_t)1 << distance)) != 0)
+		{
+			return false;
+		}
+	}
+
+	if (sequence == UINT64_MAX)
+		return false;
+
+	uint8_t nonce[NONCE_SIZE];
+	size_t size = count - DATAGRAM_SEAL_OVERHEAD;
+
+	writeDatagramNonce(
+		nonce,
+		!crypto->isServer,
+		sequence);
+
+	bool result = openAead(
+		crypto,
+		state->key,
+		nonce,
+		packet + sizeof(uint64_t),
+		size,
+		packet + sizeof(uint64_t) + size,
+		buffer);
+
+	if (result == false)
+		return false;
+
+	if (receiveSequence == 0 || sequence >= receiveSequence)
+	{
+		uint64_t shift = sequence + 1 - receiveSequence;
+
+		state->replayBits = shift >= DATAGRAM_REPLAY_WINDOW_SIZE ||
+			receiveSequence == 0 ? 1 : (state->replayBits << shift) | 1;
+		state->receiveSequence = sequence + 1;
+	}
+	else
+	{
+		state->replayBits |= (uint64_t)1 << distance;
+	}
+
+	*byteCount = size;
+	return true;
+#else
+	abort();
+#endif
+}
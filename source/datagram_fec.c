@@ -0,0 +1,482 @@
+#include "mpnw/datagram_fec.h"
+#include <assert.h>
+
+// Data packet header size (type, group ID and index)
+#define DATA_HEADER_SIZE 4
+// Concurrently recovered parity group count, power of two
+#define GROUP_WINDOW_SIZE 16
+
+typedef enum DatagramFecPacket
+{
+	DATA_DATAGRAM_FEC_PACKET = 0,
+	PARITY_DATAGRAM_FEC_PACKET = 1,
+	DATAGRAM_FEC_PACKET_COUNT = 2,
+} DatagramFecPacket;
+
+typedef struct DatagramFecGroup
+{
+	uint8_t* buffer;
+	size_t byteCount;
+	uint32_t receivedBits;
+	uint16_t id;
+	uint16_t lengthXor;
+	uint8_t count;
+	uint8_t receivedCount;
+	bool hasParity;
+	bool isUsed;
+} DatagramFecGroup;
+
+struct DatagramFec
+{
+	size_t groupSize;
+	size_t packetSize;
+	OnDatagramFecSend onSend;
+	OnDatagramFecReceive onReceive;
+	void* handle;
+	uint8_t* sendBuffer;
+	uint8_t* parityBuffer;
+	size_t parityLength;
+	uint16_t parityLengthXor;
+	uint16_t groupID;
+	uint8_t groupIndex;
+	DatagramFecGroup groups[GROUP_WINDOW_SIZE];
+	uint64_t parityCount;
+	uint64_t recoveredCount;
+};
+
+DatagramFec createDatagramFec(
+	size_t groupSize,
+	size_t packetSize,
+	OnDatagramFecSend onSend,
+	OnDatagramFecReceive onReceive,
+	void* handle)
+{
+	assert(groupSize != 0);
+	assert(groupSize <= MAX_DATAGRAM_FEC_GROUP_SIZE);
+	assert(packetSize > DATAGRAM_FEC_HEADER_SIZE);
+	assert(packetSize <= UINT16_MAX);
+	assert(onSend != NULL);
+	assert(onReceive != NULL);
+
+	DatagramFec fec = calloc(1,
+		sizeof(struct DatagramFec));
+
+	if (fec == NULL)
+		return NULL;
+
+	fec->groupSize = groupSize;
+	fec->packetSize = packetSize;
+	fec->onSend = onSend;
+	fec->onReceive = onReceive;
+	fec->handle = handle;
+
+	uint8_t* sendBuffer = malloc(
+		packetSize * sizeof(uint8_t));
+
+	if (sendBuffer == NULL)
+	{
+		destroyDatagramFec(fec);
+		return NULL;
+	}
+
+	fec->sendBuffer = sendBuffer;
+
+	uint8_t* parityBuffer = malloc(
+		packetSize * sizeof(uint8_t));
+
+	if (parityBuffer == NULL)
+	{
+		destroyDatagramFec(fec);
+		return NULL;
+	}
+
+	fec->parityBuffer = parityBuffer;
+
+	DatagramFecGroup* groups = fec->groups;
+
+	for (size_t i = 0; i < GROUP_WINDOW_SIZE; i++)
+	{
+		uint8_t* buffer = malloc(
+			packetSize * sizeof(uint8_t));
+
+		if (buffer == NULL)
+		{
+			destroyDatagramFec(fec);
+			return NULL;
+		}
+
+		groups[i].buffer = buffer;
+	}
+
+	return fec;
+}
+
+void destroyDatagramFec(DatagramFec fec)
+{
+	if (fec == NULL)
+		return;
+
+	DatagramFecGroup* groups = fec->groups;
+
+	for (size_t i = 0; i < GROUP_WINDOW_SIZE; i++)
+		free(groups[i].buffer);
+
+	free(fec->parityBuffer);
+	free(fec->sendBuffer);
+	free(fec);
+}
+
+size_t getDatagramFecGroupSize(DatagramFec fec)
+{
+	assert(fec != NULL);
+	return fec->groupSize;
+}
+
+size_t getDatagramFecPacketSize(DatagramFec fec)
+{
+	assert(fec != NULL);
+	return fec->packetSize;
+}
+
+void* getDatagramFecHandle(DatagramFec fec)
+{
+	assert(fec != NULL);
+	return fec->handle;
+}
+
+void getDatagramFecStats(
+	DatagramFec fec,
+	uint64_t* parityCount,
+	uint64_t* recoveredCount)
+{
+	assert(fec != NULL);
+	assert(parityCount != NULL);
+	assert(recoveredCount != NULL);
+
+	*parityCount = fec->parityCount;
+	*recoveredCount = fec->recoveredCount;
+}
+
+inline static void xorDatagramFecBuffer(
+	uint8_t* destination,
+	const uint8_t* source,
+	size_t count)
+{
+	size_t wordCount = count & ~(sizeof(uint64_t) - 1);
+	size_t i = 0;
+
+	// Unaligned word access, vectorized by the compiler
+	for (; i < wordCount; i += sizeof(uint64_t))
+	{
+		uint64_t a, b;
+		memcpy(&a, destination + i, sizeof(uint64_t));
+		memcpy(&b, source + i, sizeof(uint64_t));
+		a ^= b;
+		memcpy(destination + i, &a, sizeof(uint64_t));
+	}
+
+	for (; i < count; i++)
+		destination[i] ^= source[i];
+}
+
+inline static void addDatagramFecPayload(
+	uint8_t* buffer,
+	size_t* byteCount,
+	const uint8_t* payload,
+	size_t count)
+{
+	// Accumulator tail is zeroed only when it grows
+	if (count > *byteCount)
+	{
+		memset(
+			buffer + *byteCount,
+			0,
+			count - *byteCount);
+		*byteCount = count;
+	}
+
+	xorDatagramFecBuffer(
+		buffer,
+		payload,
+		count);
+}
+
+bool flushDatagramFec(DatagramFec fec)
+{
+	assert(fec != NULL);
+
+	uint8_t groupIndex = fec->groupIndex;
+
+	if (groupIndex == 0)
+		return true;
+
+	uint8_t* parityBuffer = fec->parityBuffer;
+	uint16_t groupID = hostToNet16(fec->groupID);
+	uint16_t lengthXor = hostToNet16(fec->parityLengthXor);
+
+	parityBuffer[0] = PARITY_DATAGRAM_FEC_PACKET;
+
+	memcpy(
+		parityBuffer + 1,
+		&groupID,
+		sizeof(uint16_t));
+
+	parityBuffer[3] = groupIndex;
+
+	memcpy(
+		parityBuffer + 4,
+		&lengthXor,
+		sizeof(uint16_t));
+
+	size_t parityLength = fec->parityLength;
+
+	fec->parityLength = 0;
+	fec->parityLengthXor = 0;
+	fec->groupID++;
+	fec->groupIndex = 0;
+	fec->parityCount++;
+
+	return fec->onSend(
+		fec,
+		parityBuffer,
+		DATAGRAM_FEC_HEADER_SIZE + parityLength);
+}
+
+bool datagramFecSend(
+	DatagramFec fec,
+	const void* buffer,
+	size_t count)
+{
+	assert(fec != NULL);
+	assert(buffer != NULL);
+	assert(count != 0);
+	assert(count <= fec->packetSize - DATAGRAM_FEC_HEADER_SIZE);
+
+	uint8_t* sendBuffer = fec->sendBuffer;
+	uint16_t groupID = hostToNet16(fec->groupID);
+	uint8_t groupIndex = fec->groupIndex;
+
+	sendBuffer[0] = DATA_DATAGRAM_FEC_PACKET;
+
+	memcpy(
+		sendBuffer + 1,
+		&groupID,
+		sizeof(uint16_t));
+
+	sendBuffer[3] = groupIndex;
+
+	memcpy(
+		sendBuffer + DATA_HEADER_SIZE,
+		buffer,
+		count);
+
+	addDatagramFecPayload(
+		fec->parityBuffer + DATAGRAM_FEC_HEADER_SIZE,
+		&fec->parityLength,
+		buffer,
+		count);
+
+	fec->parityLengthXor ^= (uint16_t)count;
+	fec->groupIndex = groupIndex + 1;
+
+	bool result = fec->onSend(
+		fec,
+		sendBuffer,
+		DATA_HEADER_SIZE + count);
+
+	if (result == false)
+		return false;
+
+	if (fec->groupIndex == fec->groupSize)
+		return flushDatagramFec(fec);
+
+	return true;
+}
+
+static DatagramFecGroup* getDatagramFecGroup(
+	DatagramFec fec,
+	uint16_t groupID)
+{
+	DatagramFecGroup* group =
+		&fec->groups[groupID & (GROUP_WINDOW_SIZE - 1)];
+
+	if (group->isUsed == true)
+	{
+		if (group->id == groupID)
+			return group;
+
+		// Older group slot is already reused
+		if ((int16_t)(groupID - group->id) < 0)
+			return NULL;
+	}
+
+	group->byteCount = 0;
+	group->receivedBits = 0;
+	group->id = groupID;
+	group->lengthXor = 0;
+	group->count = 0;
+	group->receivedCount = 0;
+	group->hasParity = false;
+	group->isUsed = true;
+	return group;
+}
+
+static bool recoverDatagramFecGroup(
+	DatagramFec fec,
+	DatagramFecGroup* group)
+{
+	uint8_t count = group->count;
+
+	// Single lost packet is the parity XOR of the others
+	if (group->hasParity == false ||
+		group->receivedCount + 1 != count)
+	{
+		return true;
+	}
+
+	size_t length = group->lengthXor;
+
+	group->receivedBits = (uint32_t)(((uint64_t)1 << count) - 1);
+	group->receivedCount = count;
+
+	if (length == 0 || length > group->byteCount)
+		return false;
+
+	fec->recoveredCount++;
+
+	fec->onReceive(
+		fec,
+		group->buffer,
+		length,
+		true);
+	return true;
+}
+
+bool datagramFecReceive(
+	DatagramFec fec,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	assert(fec != NULL);
+	assert(buffer != NULL);
+
+	if (byteCount < DATA_HEADER_SIZE ||
+		byteCount > fec->packetSize)
+	{
+		return false;
+	}
+
+	uint8_t type = buffer[0];
+	uint16_t groupID;
+
+	memcpy(
+		&groupID,
+		buffer + 1,
+		sizeof(uint16_t));
+
+	groupID = netToHost16(groupID);
+
+	if (type == DATA_DATAGRAM_FEC_PACKET)
+	{
+		uint8_t index = buffer[3];
+		const uint8_t* payload = buffer + DATA_HEADER_SIZE;
+		size_t payloadSize = byteCount - DATA_HEADER_SIZE;
+
+		if (index >= MAX_DATAGRAM_FEC_GROUP_SIZE || payloadSize == 0 ||
+			payloadSize > fec->packetSize - DATAGRAM_FEC_HEADER_SIZE)
+		{
+			return false;
+		}
+
+		DatagramFecGroup* group = getDatagramFecGroup(
+			fec,
+			groupID);
+
+		// Late packet of the forgotten group is still delivered
+		if (group == NULL)
+		{
+			fec->onReceive(
+				fec,
+				payload,
+				payloadSize,
+				false);
+			return true;
+		}
+
+		uint32_t indexBit = (uint32_t)1 << index;
+
+		if ((group->receivedBits & indexBit) != 0)
+			return true;
+
+		if (group->hasParity == true && index >= group->count)
+			return false;
+
+		group->receivedBits |= indexBit;
+		group->receivedCount++;
+		group->lengthXor ^= (uint16_t)payloadSize;
+
+		addDatagramFecPayload(
+			group->buffer,
+			&group->byteCount,
+			payload,
+			payloadSize);
+
+		fec->onReceive(
+			fec,
+			payload,
+			payloadSize,
+			false);
+
+		// Group slot is not changed by the receive function
+		return recoverDatagramFecGroup(
+			fec,
+			group);
+	}
+	else if (type == PARITY_DATAGRAM_FEC_PACKET)
+	{
+		if (byteCount < DATAGRAM_FEC_HEADER_SIZE)
+			return false;
+
+		uint8_t count = buffer[3];
+
+		if (count == 0 || count > MAX_DATAGRAM_FEC_GROUP_SIZE)
+			return false;
+
+		DatagramFecGroup* group = getDatagramFecGroup(
+			fec,
+			groupID);
+
+		if (group == NULL || group->hasParity == true)
+			return true;
+
+		if (count < 32 && (group->receivedBits >> count) != 0)
+			return false;
+
+		uint16_t lengthXor;
+
+		memcpy(
+			&lengthXor,
+			buffer + 4,
+			sizeof(uint16_t));
+
+		group->lengthXor ^= netToHost16(lengthXor);
+		group->count = count;
+		group->hasParity = true;
+
+		// Complete group parity is not needed
+		if (group->receivedCount == count)
+			return true;
+
+		addDatagramFecPayload(
+			group->buffer,
+			&group->byteCount,
+			buffer + DATAGRAM_FEC_HEADER_SIZE,
+			byteCount - DATAGRAM_FEC_HEADER_SIZE);
+
+		return recoverDatagramFecGroup(
+			fec,
+			group);
+	}
+
+	return false;
+}
@@ -0,0 +1,607 @@
+#include "mpnw/datagram_fragmenter.h"
+#include "mpmt/thread.h"
+
+#include <assert.h>
+
+#define PROBE_TIMEOUT_TIME 1.0
+#define PROBE_ATTEMPT_COUNT 3
+#define REPROBE_DELAY_TIME 60.0
+
+typedef enum DatagramFragmenterPacket
+{
+	WHOLE_DATAGRAM_FRAGMENTER_PACKET = 0,
+	FRAGMENT_DATAGRAM_FRAGMENTER_PACKET = 1,
+	PROBE_DATAGRAM_FRAGMENTER_PACKET = 2,
+	PROBE_ACK_DATAGRAM_FRAGMENTER_PACKET = 3,
+	DATAGRAM_FRAGMENTER_PACKET_COUNT = 4,
+} DatagramFragmenterPacket;
+
+typedef struct DatagramReassembly
+{
+	uint8_t* buffer;
+	uint8_t* fragmentBits;
+	double startTime;
+	uint32_t messageSize;
+	uint16_t fragmentSize;
+	uint16_t messageID;
+	uint16_t fragmentCount;
+	uint16_t receivedCount;
+	bool isUsed;
+} DatagramReassembly;
+
+struct DatagramFragmenter
+{
+	size_t minPacketSize;
+	size_t maxPacketSize;
+	size_t maxMessageSize;
+	size_t reassemblyCount;
+	double timeoutTime;
+	OnDatagramFragmenterSend onSend;
+	OnDatagramFragmenterReceive onReceive;
+	void* handle;
+	DatagramReassembly* reassemblies;
+	uint8_t* reassemblyBuffer;
+	uint8_t* packetBuffer;
+	size_t fragmentBitsSize;
+	size_t packetSize;
+	size_t probeSize;
+	size_t probeLimit;
+	double probeTime;
+	uint64_t droppedCount;
+	uint32_t probeAttempt;
+	uint16_t messageID;
+};
+
+DatagramFragmenter createDatagramFragmenter(
+	size_t minPacketSize,
+	size_t maxPacketSize,
+	size_t maxMessageSize,
+	size_t reassemblyCount,
+	double timeoutTime,
+	OnDatagramFragmenterSend onSend,
+	OnDatagramFragmenterReceive onReceive,
+	void* handle)
+{
+	assert(minPacketSize > DATAGRAM_FRAGMENT_HEADER_SIZE);
+	assert(maxPacketSize >= minPacketSize);
+	assert(maxPacketSize <= UINT16_MAX);
+	assert(maxMessageSize != 0);
+	assert(maxMessageSize <= UINT32_MAX);
+	assert(reassemblyCount != 0);
+	assert(timeoutTime > 0.0);
+	assert(onSend != NULL);
+	assert(onReceive != NULL);
+
+	size_t fragmentSize = minPacketSize - DATAGRAM_FRAGMENT_HEADER_SIZE;
+	size_t fragmentCount = (maxMessageSize + fragmentSize - 1) / fragmentSize;
+	assert(fragmentCount <= UINT16_MAX);
+
+	DatagramFragmenter fragmenter = calloc(1,
+		sizeof(struct DatagramFragmenter));
+
+	if (fragmenter == NULL)
+		return NULL;
+
+	size_t fragmentBitsSize = (fragmentCount + 7) / 8;
+
+	fragmenter->minPacketSize = minPacketSize;
+	fragmenter->maxPacketSize = maxPacketSize;
+	fragmenter->maxMessageSize = maxMessageSize;
+	fragmenter->reassemblyCount = reassemblyCount;
+	fragmenter->timeoutTime = timeoutTime;
+	fragmenter->onSend = onSend;
+	fragmenter->onReceive = onReceive;
+	fragmenter->handle = handle;
+	fragmenter->fragmentBitsSize = fragmentBitsSize;
+	fragmenter->packetSize = minPacketSize;
+	fragmenter->probeLimit = maxPacketSize;
+
+	DatagramReassembly* reassemblies = calloc(reassemblyCount,
+		sizeof(DatagramReassembly));
+
+	if (reassemblies == NULL)
+	{
+		destroyDatagramFragmenter(fragmenter);
+		return NULL;
+	}
+
+	fragmenter->reassemblies = reassemblies;
+
+	// Reassembly memory is bounded and allocated once
+	size_t reassemblySize = maxMessageSize + fragmentBitsSize;
+
+	uint8_t* reassemblyBuffer = malloc(
+		reassemblyCount * reassemblySize * sizeof(uint8_t));
+
+	if (reassemblyBuffer == NULL)
+	{
+		destroyDatagramFragmenter(fragmenter);
+		return NULL;
+	}
+
+	fragmenter->reassemblyBuffer = reassemblyBuffer;
+
+	for (size_t i = 0; i < reassemblyCount; i++)
+	{
+		uint8_t* buffer = reassemblyBuffer + i * reassemblySize;
+		reassemblies[i].buffer = buffer;
+		reassemblies[i].fragmentBits = buffer + maxMessageSize;
+	}
+
+	uint8_t* packetBuffer = calloc(maxPacketSize,
+		sizeof(uint8_t));
+
+	if (packetBuffer == NULL)
+	{
+		destroyDatagramFragmenter(fragmenter);
+		return NULL;
+	}
+
+	fragmenter->packetBuffer = packetBuffer;
+	return fragmenter;
+}
+
+void destroyDatagramFragmenter(DatagramFragmenter fragmenter)
+{
+	if (fragmenter == NULL)
+		return;
+
+	free(fragmenter->packetBuffer);
+	free(fragmenter->reassemblyBuffer);
+	free(fragmenter->reassemblies);
+	free(fragmenter);
+}
+
+size_t getDatagramFragmenterPacketSize(DatagramFragmenter fragmenter)
+{
+	assert(fragmenter != NULL);
+	return fragmenter->packetSize;
+}
+
+size_t getDatagramFragmenterMaxMessageSize(DatagramFragmenter fragmenter)
+{
+	assert(fragmenter != NULL);
+	return fragmenter->maxMessageSize;
+}
+
+void* getDatagramFragmenterHandle(DatagramFragmenter fragmenter)
+{
+	assert(fragmenter != NULL);
+	return fragmenter->handle;
+}
+
+uint64_t getDatagramFragmenterDroppedCount(DatagramFragmenter fragmenter)
+{
+	assert(fragmenter != NULL);
+	return fragmenter->droppedCount;
+}
+
+bool datagramFragmenterSend(
+	DatagramFragmenter fragmenter,
+	const void* buffer,
+	size_t count)
+{
+	assert(fragmenter != NULL);
+	assert(buffer != NULL);
+	assert(count != 0);
+	assert(count <= fragmenter->maxMessageSize);
+
+	uint8_t* packetBuffer = fragmenter->packetBuffer;
+	size_t packetSize = fragmenter->packetSize;
+
+	if (count < packetSize)
+	{
+		packetBuffer[0] = WHOLE_DATAGRAM_FRAGMENTER_PACKET;
+
+		memcpy(
+			packetBuffer + 1,
+			buffer,
+			count);
+
+		return fragmenter->onSend(
+			fragmenter,
+			packetBuffer,
+			count + 1);
+	}
+
+	size_t fragmentSize = packetSize - DATAGRAM_FRAGMENT_HEADER_SIZE;
+	size_t fragmentCount = (count + fragmentSize - 1) / fragmentSize;
+
+	uint16_t messageID = hostToNet16(fragmenter->messageID++);
+	uint16_t countValue = hostToNet16((uint16_t)fragmentCount);
+	uint32_t sizeValue = hostToNet32((uint32_t)count);
+
+	packetBuffer[0] = FRAGMENT_DATAGRAM_FRAGMENTER_PACKET;
+
+	memcpy(
+		packetBuffer + 1,
+		&messageID,
+		sizeof(uint16_t));
+	memcpy(
+		packetBuffer + 5,
+		&countValue,
+		sizeof(uint16_t));
+	memcpy(
+		packetBuffer + 7,
+		&sizeValue,
+		sizeof(uint32_t));
+
+	const uint8_t* data = (const uint8_t*)buffer;
+
+	for (size_t i = 0; i < fragmentCount; i++)
+	{
+		size_t offset = i * fragmentSize;
+		size_t size = count - offset < fragmentSize ?
+			count - offset : fragmentSize;
+		uint16_t indexValue = hostToNet16((uint16_t)i);
+
+		memcpy(
+			packetBuffer + 3,
+			&indexValue,
+			sizeof(uint16_t));
+		memcpy(
+			packetBuffer + DATAGRAM_FRAGMENT_HEADER_SIZE,
+			data + offset,
+			size);
+
+		bool result = fragmenter->onSend(
+			fragmenter,
+			packetBuffer,
+			size + DATAGRAM_FRAGMENT_HEADER_SIZE);
+
+		if (result == false)
+			return false;
+	}
+
+	return true;
+}
+
+static DatagramReassembly* getDatagramReassembly(
+	DatagramFragmenter fragmenter,
+	uint16_t messageID,
+	uint16_t fragmentCount,
+	uint16_t fragmentSize,
+	uint32_t messageSize)
+{
+	DatagramReassembly* reassemblies = fragmenter->reassemblies;
+	size_t reassemblyCount = fragmenter->reassemblyCount;
+	DatagramReassembly* freeReassembly = NULL;
+	DatagramReassembly* oldestReassembly = &reassemblies[0];
+
+	for (size_t i = 0; i < reassemblyCount; i++)
+	{
+		DatagramReassembly* reassembly = &reassemblies[i];
+
+		if (reassembly->isUsed == false)
+		{
+			if (freeReassembly == NULL)
+				freeReassembly = reassembly;
+			continue;
+		}
+
+		if (reassembly->messageID == messageID)
+		{
+			if (reassembly->fragmentCount != fragmentCount ||
+				reassembly->fragmentSize != fragmentSize ||
+				reassembly->messageSize != messageSize)
+			{
+				return NULL;
+			}
+
+			return reassembly;
+		}
+
+		if (reassembly->startTime < oldestReassembly->startTime ||
+			oldestReassembly->isUsed == false)
+		{
+			oldestReassembly = reassembly;
+		}
+	}
+
+	// Oldest incomplete message is dropped if there is no free space
+	if (freeReassembly == NULL)
+	{
+		freeReassembly = oldestReassembly;
+		fragmenter->droppedCount++;
+	}
+
+	memset(
+		freeReassembly->fragmentBits,
+		0,
+		(fragmentCount + 7) / 8);
+
+	freeReassembly->startTime = getCurrentClock();
+	freeReassembly->messageSize = messageSize;
+	freeReassembly->fragmentSize = fragmentSize;
+	freeReassembly->messageID = messageID;
+	freeReassembly->fragmentCount = fragmentCount;
+	freeReassembly->receivedCount = 0;
+	freeReassembly->isUsed = true;
+	return freeReassembly;
+}
+
+static bool handleDatagramFragment(
+	DatagramFragmenter fragmenter,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	if (byteCount <= DATAGRAM_FRAGMENT_HEADER_SIZE)
+		return false;
+
+	uint16_t messageID, fragmentIndex, fragmentCount;
+	uint32_t messageSize;
+
+	memcpy(
+		&messageID,
+		buffer + 1,
+		sizeof(uint16_t));
+	memcpy(
+		&fragmentIndex,
+		buffer + 3,
+		sizeof(uint16_t));
+	memcpy(
+		&fragmentCount,
+		buffer + 5,
+		sizeof(uint16_t));
+	memcpy(
+		&messageSize,
+		buffer + 7,
+		sizeof(uint32_t));
+
+	messageID = netToHost16(messageID);
+	fragmentIndex = netToHost16(fragmentIndex);
+	fragmentCount = netToHost16(fragmentCount);
+	messageSize = netToHost32(messageSize);
+
+	const uint8_t* data = buffer + DATAGRAM_FRAGMENT_HEADER_SIZE;
+	size_t dataSize = byteCount - DATAGRAM_FRAGMENT_HEADER_SIZE;
+
+	if (fragmentCount < 2 || fragmentIndex >= fragmentCount ||
+		messageSize > fragmenter->maxMessageSize ||
+		((size_t)fragmentCount + 7) / 8 > fragmenter->fragmentBitsSize)
+	{
+		return false;
+	}
+
+	// Every fragment defines the same fragment size, all non-last
+	// fragments have it and the last one holds the remainder
+	size_t fragmentSize, lastSize;
+
+	if (fragmentIndex == fragmentCount - 1)
+	{
+		if (dataSize >= messageSize ||
+			(messageSize - dataSize) % (fragmentCount - 1) != 0)
+		{
+			return false;
+		}
+
+		fragmentSize = (messageSize - dataSize) / (fragmentCount - 1);
+		lastSize = dataSize;
+	}
+	else
+	{
+		fragmentSize = dataSize;
+
+		if ((size_t)(fragmentCount - 1) * fragmentSize >= messageSize)
+			return false;
+
+		lastSize = messageSize - (size_t)(fragmentCount - 1) * fragmentSize;
+	}
+
+	if (lastSize > fragmentSize || fragmentSize > UINT16_MAX)
+		return false;
+
+	size_t offset = (size_t)fragmentIndex * fragmentSize;
+
+	DatagramReassembly* reassembly = getDatagramReassembly(
+		fragmenter,
+		messageID,
+		fragmentCount,
+		(uint16_t)fragmentSize,
+		messageSize);
+
+	if (reassembly == NULL)
+		return false;
+
+	uint8_t* fragmentBits = reassembly->fragmentBits;
+	uint8_t fragmentBit = (uint8_t)(1 << (fragmentIndex & 7));
+
+	if ((fragmentBits[fragmentIndex >> 3] & fragmentBit) != 0)
+		return true;
+
+	fragmentBits[fragmentIndex >> 3] |= fragmentBit;
+
+	memcpy(
+		reassembly->buffer + offset,
+		data,
+		dataSize);
+
+	if (++reassembly->receivedCount != fragmentCount)
+		return true;
+
+	reassembly->isUsed = false;
+
+	fragmenter->onReceive(
+		fragmenter,
+		reassembly->buffer,
+		messageSize);
+	return true;
+}
+
+static bool sendDatagramProbe(
+	DatagramFragmenter fragmenter,
+	uint8_t type,
+	size_t size,
+	size_t count)
+{
+	uint8_t* packetBuffer = fragmenter->packetBuffer;
+	uint16_t sizeValue = hostToNet16((uint16_t)size);
+
+	packetBuffer[0] = type;
+
+	memcpy(
+		packetBuffer + 1,
+		&sizeValue,
+		sizeof(uint16_t));
+
+	// Probe padding should not leak previous packet data
+	if (count > 3)
+	{
+		memset(
+			packetBuffer + 3,
+			0,
+			count - 3);
+	}
+
+	return fragmenter->onSend(
+		fragmenter,
+		packetBuffer,
+		count);
+}
+
+bool datagramFragmenterReceive(
+	DatagramFragmenter fragmenter,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	assert(fragmenter != NULL);
+	assert(buffer != NULL);
+
+	if (byteCount < 2)
+		return false;
+
+	uint8_t type = buffer[0];
+
+	if (type == WHOLE_DATAGRAM_FRAGMENTER_PACKET)
+	{
+		fragmenter->onReceive(
+			fragmenter,
+			buffer + 1,
+			byteCount - 1);
+		return true;
+	}
+	else if (type == FRAGMENT_DATAGRAM_FRAGMENTER_PACKET)
+	{
+		return handleDatagramFragment(
+			fragmenter,
+			buffer,
+			byteCount);
+	}
+	else if (type >= DATAGRAM_FRAGMENTER_PACKET_COUNT ||
+		byteCount < 3)
+	{
+		return false;
+	}
+
+	uint16_t size;
+
+	memcpy(
+		&size,
+		buffer + 1,
+		sizeof(uint16_t));
+
+	size = netToHost16(size);
+
+	if (type == PROBE_DATAGRAM_FRAGMENTER_PACKET)
+	{
+		if (size != byteCount)
+			return false;
+
+		// Acknowledgement failure is recovered by the probe repeat
+		sendDatagramProbe(
+			fragmenter,
+			PROBE_ACK_DATAGRAM_FRAGMENTER_PACKET,
+			size,
+			3);
+		return true;
+	}
+
+	if (byteCount != 3)
+		return false;
+
+	if (size == fragmenter->probeSize)
+	{
+		fragmenter->packetSize = size;
+		fragmenter->probeSize = 0;
+		fragmenter->probeAttempt = 0;
+	}
+
+	return true;
+}
+
+void updateDatagramFragmenter(DatagramFragmenter fragmenter)
+{
+	assert(fragmenter != NULL);
+
+	DatagramReassembly* reassemblies = fragmenter->reassemblies;
+	size_t reassemblyCount = fragmenter->reassemblyCount;
+	double timeoutTime = fragmenter->timeoutTime;
+	double currentTime = getCurrentClock();
+
+	for (size_t i = 0; i < reassemblyCount; i++)
+	{
+		DatagramReassembly* reassembly = &reassemblies[i];
+
+		if (reassembly->isUsed == true &&
+			currentTime - reassembly->startTime > timeoutTime)
+		{
+			reassembly->isUsed = false;
+			fragmenter->droppedCount++;
+		}
+	}
+
+	size_t probeSize = fragmenter->probeSize;
+
+	if (probeSize != 0)
+	{
+		if (currentTime - fragmenter->probeTime < PROBE_TIMEOUT_TIME)
+			return;
+
+		// Repeatedly lost probe is bigger than path MTU
+		if (++fragmenter->probeAttempt >= PROBE_ATTEMPT_COUNT)
+		{
+			fragmenter->probeLimit = probeSize - 1;
+			fragmenter->probeSize = 0;
+			fragmenter->probeAttempt = 0;
+			fragmenter->probeTime = currentTime;
+			return;
+		}
+	}
+	else
+	{
+		size_t packetSize = fragmenter->packetSize;
+		size_t probeLimit = fragmenter->probeLimit;
+
+		if (packetSize >= probeLimit)
+		{
+			// Path may have changed, search is restarted later
+			if (currentTime - fragmenter->probeTime < REPROBE_DELAY_TIME)
+				return;
+
+			if (packetSize >= fragmenter->maxPacketSize)
+				return;
+
+			fragmenter->probeLimit = probeLimit = fragmenter->maxPacketSize;
+		}
+
+		// Binary search between confirmed and limit sizes
+		probeSize = (packetSize + probeLimit + 1) / 2;
+		fragmenter->probeSize = probeSize;
+	}
+
+	fragmenter->probeTime = currentTime;
+
+	bool result = sendDatagramProbe(
+		fragmenter,
+		PROBE_DATAGRAM_FRAGMENTER_PACKET,
+		probeSize,
+		probeSize);
+
+	// Local MTU failure, datagram is too big for the interface
+	if (result == false)
+	{
+		fragmenter->probeLimit = probeSize - 1;
+		fragmenter->probeSize = 0;
+		fragmenter->probeAttempt = 0;
+	}
+}
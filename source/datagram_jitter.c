@@ -0,0 +1,312 @@
+#include "mpnw/datagram_jitter.h"
+#include "mpmt/thread.h"
+
+#include <assert.h>
+
+// Transit time and variation smoothing gains
+#define TRANSIT_GAIN (1.0 / 64.0)
+#define VARIATION_GAIN (1.0 / 16.0)
+// Playout delay in transit variations, as in the Ramjee algorithm
+#define VARIATION_FACTOR 4.0
+
+typedef struct DatagramJitterSlot
+{
+	size_t size;
+	double timestamp;
+	uint16_t sequence;
+	bool isUsed;
+} DatagramJitterSlot;
+
+struct DatagramJitter
+{
+	size_t frameCount;
+	size_t frameSize;
+	double minDelay;
+	double maxDelay;
+	OnDatagramJitterFrame onFrame;
+	void* handle;
+	DatagramJitterSlot* slots;
+	uint8_t* frameBuffer;
+	double transitTime;
+	double variation;
+	uint64_t lateCount;
+	uint64_t lostCount;
+	size_t bufferedCount;
+	uint16_t playSequence;
+	bool isStarted;
+};
+
+inline static int16_t getSequenceDistance(
+	uint16_t a,
+	uint16_t b)
+{
+	return (int16_t)(uint16_t)(a - b);
+}
+
+DatagramJitter createDatagramJitter(
+	size_t frameCount,
+	size_t frameSize,
+	double minDelay,
+	double maxDelay,
+	OnDatagramJitterFrame onFrame,
+	void* handle)
+{
+	assert(frameCount > 1);
+	assert(frameCount <= INT16_MAX);
+	assert((frameCount & (frameCount - 1)) == 0);
+	assert(frameSize != 0);
+	assert(minDelay >= 0.0);
+	assert(maxDelay >= minDelay);
+	assert(onFrame != NULL);
+
+	DatagramJitter jitter = calloc(1,
+		sizeof(struct DatagramJitter));
+
+	if (jitter == NULL)
+		return NULL;
+
+	DatagramJitterSlot* slots = calloc(frameCount,
+		sizeof(DatagramJitterSlot));
+
+	if (slots == NULL)
+	{
+		free(jitter);
+		return NULL;
+	}
+
+	uint8_t* frameBuffer = malloc(
+		frameCount * frameSize * sizeof(uint8_t));
+
+	if (frameBuffer == NULL)
+	{
+		free(slots);
+		free(jitter);
+		return NULL;
+	}
+
+	jitter->frameCount = frameCount;
+	jitter->frameSize = frameSize;
+	jitter->minDelay = minDelay;
+	jitter->maxDelay = maxDelay;
+	jitter->onFrame = onFrame;
+	jitter->handle = handle;
+	jitter->slots = slots;
+	jitter->frameBuffer = frameBuffer;
+	return jitter;
+}
+
+void destroyDatagramJitter(DatagramJitter jitter)
+{
+	if (jitter == NULL)
+		return;
+
+	free(jitter->frameBuffer);
+	free(jitter->slots);
+	free(jitter);
+}
+
+size_t getDatagramJitterFrameCount(DatagramJitter jitter)
+{
+	assert(jitter != NULL);
+	return jitter->frameCount;
+}
+
+size_t getDatagramJitterFrameSize(DatagramJitter jitter)
+{
+	assert(jitter != NULL);
+	return jitter->frameSize;
+}
+
+void* getDatagramJitterHandle(DatagramJitter jitter)
+{
+	assert(jitter != NULL);
+	return jitter->handle;
+}
+
+double getDatagramJitterVariation(DatagramJitter jitter)
+{
+	assert(jitter != NULL);
+	return jitter->variation;
+}
+
+double getDatagramJitterPlayoutDelay(DatagramJitter jitter)
+{
+	assert(jitter != NULL);
+
+	double delay = jitter->variation * VARIATION_FACTOR;
+
+	if (delay < jitter->minDelay)
+		return jitter->minDelay;
+	if (delay > jitter->maxDelay)
+		return jitter->maxDelay;
+	return delay;
+}
+
+void getDatagramJitterStats(
+	DatagramJitter jitter,
+	uint64_t* lateCount,
+	uint64_t* lostCount)
+{
+	assert(jitter != NULL);
+	assert(lateCount != NULL);
+	assert(lostCount != NULL);
+
+	*lateCount = jitter->lateCount;
+	*lostCount = jitter->lostCount;
+}
+
+static void playDatagramJitterFrame(DatagramJitter jitter)
+{
+	uint16_t sequence = jitter->playSequence;
+	size_t index = sequence & (jitter->frameCount - 1);
+	DatagramJitterSlot* slot = &jitter->slots[index];
+
+	jitter->playSequence = sequence + 1;
+
+	if (slot->isUsed == false || slot->sequence != sequence)
+	{
+		jitter->lostCount++;
+
+		jitter->onFrame(
+			jitter,
+			sequence,
+			NULL,
+			0);
+		return;
+	}
+
+	slot->isUsed = false;
+	jitter->bufferedCount--;
+
+	jitter->onFrame(
+		jitter,
+		sequence,
+		jitter->frameBuffer + index * jitter->frameSize,
+		slot->size);
+}
+
+bool datagramJitterPush(
+	DatagramJitter jitter,
+	uint16_t sequence,
+	double timestamp,
+	const void* buffer,
+	size_t count)
+{
+	assert(jitter != NULL);
+	assert(buffer != NULL);
+
+	if (count == 0 || count > jitter->frameSize)
+		return false;
+
+	// Transit includes clock offset, only its variation matters
+	double transitTime = getCurrentClock() - timestamp;
+
+	if (jitter->isStarted == false)
+	{
+		jitter->transitTime = transitTime;
+		jitter->variation = 0.0;
+		jitter->playSequence = sequence;
+		jitter->isStarted = true;
+	}
+	else
+	{
+		double difference = transitTime - jitter->transitTime;
+
+		if (difference < 0.0)
+			difference = -difference;
+
+		jitter->variation += (difference - jitter->variation) * VARIATION_GAIN;
+		jitter->transitTime += (transitTime - jitter->transitTime) * TRANSIT_GAIN;
+	}
+
+	int16_t distance = getSequenceDistance(
+		sequence,
+		jitter->playSequence);
+
+	if (distance < 0)
+	{
+		jitter->lateCount++;
+		return true;
+	}
+
+	size_t frameCount = jitter->frameCount;
+
+	// Stream jumped ahead, buffered frames are played early
+	if ((size_t)distance >= frameCount)
+	{
+		while (jitter->bufferedCount != 0)
+			playDatagramJitterFrame(jitter);
+
+		jitter->lostCount += (uint16_t)(sequence - jitter->playSequence);
+		jitter->playSequence = sequence;
+	}
+
+	size_t index = sequence & (frameCount - 1);
+	DatagramJitterSlot* slot = &jitter->slots[index];
+
+	if (slot->isUsed == true)
+		return true;
+
+	memcpy(
+		jitter->frameBuffer + index * jitter->frameSize,
+		buffer,
+		count);
+
+	slot->size = count;
+	slot->timestamp = timestamp;
+	slot->sequence = sequence;
+	slot->isUsed = true;
+	jitter->bufferedCount++;
+	return true;
+}
+
+void updateDatagramJitter(DatagramJitter jitter)
+{
+	assert(jitter != NULL);
+
+	if (jitter->bufferedCount == 0)
+		return;
+
+	DatagramJitterSlot* slots = jitter->slots;
+	size_t frameMask = jitter->frameCount - 1;
+	double currentTime = getCurrentClock();
+
+	// Frame is due at its sender time plus transit and playout delay
+	double deadlineTime = currentTime - jitter->transitTime -
+		getDatagramJitterPlayoutDelay(jitter);
+
+	while (jitter->bufferedCount != 0)
+	{
+		uint16_t sequence = jitter->playSequence;
+		DatagramJitterSlot* slot = &slots[sequence & frameMask];
+
+		if (slot->isUsed == true && slot->sequence == sequence)
+		{
+			if (slot->timestamp > deadlineTime)
+				return;
+
+			playDatagramJitterFrame(jitter);
+			continue;
+		}
+
+		// Missing frame is lost when any later frame is due
+		bool isLost = false;
+
+		for (uint16_t i = 1; i <= frameMask; i++)
+		{
+			slot = &slots[(uint16_t)(sequence + i) & frameMask];
+
+			if (slot->isUsed == true &&
+				slot->sequence == (uint16_t)(sequence + i))
+			{
+				isLost = slot->timestamp <= deadlineTime;
+				break;
+			}
+		}
+
+		if (isLost == false)
+			return;
+
+		playDatagramJitterFrame(jitter);
+	}
+}
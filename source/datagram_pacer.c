@@ -0,0 +1,299 @@
+#include "mpnw/datagram_pacer.h"
+#include "mpmt/thread.h"
+
+#include <assert.h>
+
+// Queued packet length prefix size
+#define LENGTH_SIZE 2
+
+struct DatagramPacer
+{
+	size_t queueSize;
+	size_t burstSize;
+	OnDatagramPacerSend onSend;
+	void* handle;
+	uint8_t* queueBuffer;
+	uint8_t* packetBuffer;
+	size_t queueOffset;
+	size_t queuedSize;
+	double rate;
+	double tokenCount;
+	double tokenTime;
+};
+
+DatagramPacer createDatagramPacer(
+	size_t queueSize,
+	size_t burstSize,
+	OnDatagramPacerSend onSend,
+	void* handle)
+{
+	assert(queueSize > LENGTH_SIZE);
+	assert(burstSize != 0);
+	assert(onSend != NULL);
+
+	DatagramPacer pacer = malloc(
+		sizeof(struct DatagramPacer));
+
+	if (pacer == NULL)
+		return NULL;
+
+	uint8_t* queueBuffer = malloc(
+		queueSize * sizeof(uint8_t));
+
+	if (queueBuffer == NULL)
+	{
+		free(pacer);
+		return NULL;
+	}
+
+	uint8_t* packetBuffer = malloc(
+		queueSize * sizeof(uint8_t));
+
+	if (packetBuffer == NULL)
+	{
+		free(queueBuffer);
+		free(pacer);
+		return NULL;
+	}
+
+	pacer->queueSize = queueSize;
+	pacer->burstSize = burstSize;
+	pacer->onSend = onSend;
+	pacer->handle = handle;
+	pacer->queueBuffer = queueBuffer;
+	pacer->packetBuffer = packetBuffer;
+	pacer->queueOffset = 0;
+	pacer->queuedSize = 0;
+	pacer->rate = 0.0;
+	pacer->tokenCount = (double)burstSize;
+	pacer->tokenTime = getCurrentClock();
+	return pacer;
+}
+
+void destroyDatagramPacer(DatagramPacer pacer)
+{
+	if (pacer == NULL)
+		return;
+
+	free(pacer->packetBuffer);
+	free(pacer->queueBuffer);
+	free(pacer);
+}
+
+size_t getDatagramPacerQueueSize(DatagramPacer pacer)
+{
+	assert(pacer != NULL);
+	return pacer->queueSize;
+}
+
+size_t getDatagramPacerBurstSize(DatagramPacer pacer)
+{
+	assert(pacer != NULL);
+	return pacer->burstSize;
+}
+
+void* getDatagramPacerHandle(DatagramPacer pacer)
+{
+	assert(pacer != NULL);
+	return pacer->handle;
+}
+
+double getDatagramPacerRate(DatagramPacer pacer)
+{
+	assert(pacer != NULL);
+	return pacer->rate;
+}
+
+void setDatagramPacerRate(
+	DatagramPacer pacer,
+	double rate)
+{
+	assert(pacer != NULL);
+	assert(rate >= 0.0);
+	pacer->rate = rate;
+}
+
+size_t getDatagramPacerQueuedSize(DatagramPacer pacer)
+{
+	assert(pacer != NULL);
+	return pacer->queuedSize;
+}
+
+static void refillDatagramPacer(DatagramPacer pacer)
+{
+	double currentTime = getCurrentClock();
+
+	double tokenCount = pacer->tokenCount + pacer->rate *
+		(currentTime - pacer->tokenTime);
+
+	if (tokenCount > (double)pacer->burstSize)
+		tokenCount = (double)pacer->burstSize;
+
+	pacer->tokenCount = tokenCount;
+	pacer->tokenTime = currentTime;
+}
+
+double getDatagramPacerDelayTime(DatagramPacer pacer)
+{
+	assert(pacer != NULL);
+
+	if (pacer->queuedSize == 0 || pacer->rate == 0.0)
+		return 0.0;
+
+	refillDatagramPacer(pacer);
+
+	if (pacer->tokenCount >= 0.0)
+		return 0.0;
+
+	return -pacer->tokenCount / pacer->rate;
+}
+
+inline static bool sendDatagramPacerPacket(
+	DatagramPacer pacer,
+	const uint8_t* buffer,
+	size_t count)
+{
+	// Token debt lets any packet size through the small bucket
+	if (pacer->rate != 0.0)
+		pacer->tokenCount -= (double)count;
+
+	return pacer->onSend(
+		pacer,
+		buffer,
+		count);
+}
+
+static void writeDatagramPacerQueue(
+	DatagramPacer pacer,
+	size_t offset,
+	const uint8_t* buffer,
+	size_t count)
+{
+	size_t queueSize = pacer->queueSize;
+	uint8_t* queueBuffer = pacer->queueBuffer;
+
+	offset %= queueSize;
+
+	size_t firstCount = queueSize - offset < count ?
+		queueSize - offset : count;
+
+	memcpy(
+		queueBuffer + offset,
+		buffer,
+		firstCount);
+	memcpy(
+		queueBuffer,
+		buffer + firstCount,
+		count - firstCount);
+}
+
+static void readDatagramPacerQueue(
+	DatagramPacer pacer,
+	size_t count,
+	uint8_t* buffer)
+{
+	size_t queueSize = pacer->queueSize;
+	const uint8_t* queueBuffer = pacer->queueBuffer;
+	size_t offset = pacer->queueOffset;
+
+	size_t firstCount = queueSize - offset < count ?
+		queueSize - offset : count;
+
+	memcpy(
+		buffer,
+		queueBuffer + offset,
+		firstCount);
+	memcpy(
+		buffer + firstCount,
+		queueBuffer,
+		count - firstCount);
+
+	pacer->queueOffset = (offset + count) % queueSize;
+	pacer->queuedSize -= count;
+}
+
+bool datagramPacerSend(
+	DatagramPacer pacer,
+	const void* buffer,
+	size_t count)
+{
+	assert(pacer != NULL);
+	assert(buffer != NULL);
+	assert(count != 0);
+	assert(count <= UINT16_MAX);
+
+	if (pacer->queuedSize == 0)
+	{
+		refillDatagramPacer(pacer);
+
+		if (pacer->rate == 0.0 || pacer->tokenCount >= 0.0)
+		{
+			return sendDatagramPacerPacket(
+				pacer,
+				buffer,
+				count);
+		}
+	}
+
+	size_t queuedSize = pacer->queuedSize;
+
+	if (queuedSize + LENGTH_SIZE + count > pacer->queueSize)
+		return false;
+
+	uint16_t length = hostToNet16((uint16_t)count);
+	size_t offset = pacer->queueOffset + queuedSize;
+
+	writeDatagramPacerQueue(
+		pacer,
+		offset,
+		(const uint8_t*)&length,
+		LENGTH_SIZE);
+	writeDatagramPacerQueue(
+		pacer,
+		offset + LENGTH_SIZE,
+		buffer,
+		count);
+
+	pacer->queuedSize = queuedSize + LENGTH_SIZE + count;
+	return true;
+}
+
+bool updateDatagramPacer(DatagramPacer pacer)
+{
+	assert(pacer != NULL);
+
+	if (pacer->queuedSize == 0)
+		return true;
+
+	refillDatagramPacer(pacer);
+
+	uint8_t* packetBuffer = pacer->packetBuffer;
+
+	while (pacer->queuedSize != 0 &&
+		(pacer->rate == 0.0 || pacer->tokenCount >= 0.0))
+	{
+		uint16_t length;
+
+		readDatagramPacerQueue(
+			pacer,
+			LENGTH_SIZE,
+			(uint8_t*)&length);
+
+		size_t count = netToHost16(length);
+
+		readDatagramPacerQueue(
+			pacer,
+			count,
+			packetBuffer);
+
+		bool result = sendDatagramPacerPacket(
+			pacer,
+			packetBuffer,
+			count);
+
+		if (result == false)
+			return false;
+	}
+
+	return true;
+}
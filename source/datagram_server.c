@@ -1,8 +1,42 @@
 #include "mpnw/datagram_server.h"
+#include "mpnw/datagram_clock.h"
+#include "mpmt/thread.h"
 
 #include <assert.h>
 #include <stdio.h>
 
+// DTLS peer or connection idle timeout time
+#define PEER_TIMEOUT_TIME 30.0
+// DTLS peer retransmission timer check delay
+#define PEER_UPDATE_DELAY_TIME 0.05
+// Connection address validation challenge repeat delay
+#define CHALLENGE_DELAY_TIME 0.25
+// Maximal datagram payload size
+#define MAX_DATAGRAM_SIZE 65507
+// Client connection packet header size (type and ID)
+#define CONNECTION_HEADER_SIZE 9
+
+typedef enum DatagramConnectionPacket
+{
+	DATA_DATAGRAM_CONNECTION_PACKET = 0,
+	PATH_DATAGRAM_CONNECTION_PACKET = 1,
+	TIME_DATAGRAM_CONNECTION_PACKET = 2,
+	DATAGRAM_CONNECTION_PACKET_COUNT = 3,
+} DatagramConnectionPacket;
+
+typedef struct DatagramPeer
+{
+	SocketAddress address;
+	DtlsSession session;
+	SocketAddress pendingAddress;
+	DatagramClockState clock;
+	uint64_t connectionID;
+	uint64_t challenge;
+	double lastReceiveTime;
+	double challengeTime;
+	bool isMigrating;
+} DatagramPeer;
+
 struct DatagramServer
 {
 	size_t bufferSize;
@@ -11,21 +45,252 @@ struct DatagramServer
 	uint8_t* buffer;
 	SocketAddress address;
 	Socket socket;
+	SslContext sslContext;
+	uint8_t* messageBuffer;
+	DtlsSession listenSession;
+	DatagramPeer* peers;
+	size_t peerCount;
+	size_t maxPeerCount;
+	size_t peerCapacity;
+	size_t* peerTable;
+	size_t peerTableMask;
+	double peerUpdateTime;
+	OnDatagramConnectionAccept onConnectionAccept;
+	OnDatagramConnectionReceive onConnectionReceive;
+	uint8_t* sendBuffer;
 };
 
+inline static uint64_t getConnectionIDHash(uint64_t connectionID)
+{
+	connectionID ^= connectionID >> 33;
+	connectionID *= 0xFF51AFD7ED558CCDULL;
+	connectionID ^= connectionID >> 33;
+	return connectionID;
+}
+
+inline static uint64_t getDatagramPeerHash(
+	DatagramServer server,
+	const DatagramPeer* peer)
+{
+	if (server->onConnectionReceive != NULL)
+		return getConnectionIDHash(peer->connectionID);
+	return getSocketAddressHash(peer->address);
+}
+
+static void rebuildDatagramPeerTable(DatagramServer server)
+{
+	DatagramPeer* peers = server->peers;
+	size_t* peerTable = server->peerTable;
+	size_t peerTableMask = server->peerTableMask;
+	size_t peerCount = server->peerCount;
+
+	memset(
+		peerTable,
+		0,
+		(peerTableMask + 1) * sizeof(size_t));
+
+	// Open addressing, table stores peer index plus one
+	for (size_t i = 0; i < peerCount; i++)
+	{
+		size_t index = (size_t)getDatagramPeerHash(
+			server,
+			&peers[i]) & peerTableMask;
+
+		while (peerTable[index] != 0)
+			index = (index + 1) & peerTableMask;
+
+		peerTable[index] = i + 1;
+	}
+}
+
+static DatagramPeer* findDatagramPeer(
+	DatagramServer server,
+	SocketAddress address)
+{
+	DatagramPeer* peers = server->peers;
+	size_t* peerTable = server->peerTable;
+	size_t peerTableMask = server->peerTableMask;
+
+	size_t index = (size_t)getSocketAddressHash(
+		address) & peerTableMask;
+
+	while (peerTable[index] != 0)
+	{
+		DatagramPeer* peer = &peers[peerTable[index] - 1];
+
+		if (compareSocketAddress(peer->address, address) == 0)
+			return peer;
+
+		index = (index + 1) & peerTableMask;
+	}
+
+	return NULL;
+}
+
+static DatagramPeer* findDatagramConnection(
+	DatagramServer server,
+	uint64_t connectionID)
+{
+	DatagramPeer* peers = server->peers;
+	size_t* peerTable = server->peerTable;
+	size_t peerTableMask = server->peerTableMask;
+
+	size_t index = (size_t)getConnectionIDHash(
+		connectionID) & peerTableMask;
+
+	while (peerTable[index] != 0)
+	{
+		DatagramPeer* peer = &peers[peerTable[index] - 1];
+
+		if (peer->connectionID == connectionID)
+			return peer;
+
+		index = (index + 1) & peerTableMask;
+	}
+
+	return NULL;
+}
+
+static DatagramPeer* addDatagramPeer(
+	DatagramServer server,
+	SocketAddress address,
+	DtlsSession session,
+	uint64_t connectionID)
+{
+	size_t peerCount = server->peerCount;
+
+	if (peerCount >= server->maxPeerCount)
+		return NULL;
+
+	// Storage grows only on the new peer, never per packet
+	if (peerCount == server->peerCapacity)
+	{
+		size_t peerCapacity = server->peerCapacity * 2;
+
+		DatagramPeer* peers = realloc(
+			server->peers,
+			peerCapacity * sizeof(DatagramPeer));
+
+		if (peers == NULL)
+			return NULL;
+
+		server->peers = peers;
+
+		size_t* peerTable = realloc(
+			server->peerTable,
+			peerCapacity * 2 * sizeof(size_t));
+
+		if (peerTable == NULL)
+			return NULL;
+
+		server->peerTable = peerTable;
+		server->peerTableMask = peerCapacity * 2 - 1;
+		server->peerCapacity = peerCapacity;
+		rebuildDatagramPeerTable(server);
+	}
+
+	SocketAddress peerAddress = createSocketAddressCopy(
+		address);
+
+	if (peerAddress == NULL)
+		return NULL;
+
+	SocketAddress pendingAddress = NULL;
+
+	// Migration address is allocated once with the connection
+	if (server->onConnectionReceive != NULL)
+	{
+		pendingAddress = createSocketAddressCopy(
+			address);
+
+		if (pendingAddress == NULL)
+		{
+			destroySocketAddress(peerAddress);
+			return NULL;
+		}
+	}
+
+	DatagramPeer* peer = &server->peers[peerCount];
+	peer->address = peerAddress;
+	peer->session = session;
+	peer->pendingAddress = pendingAddress;
+	peer->connectionID = connectionID;
+	peer->challenge = 0;
+	peer->lastReceiveTime = getCurrentClock();
+	peer->challengeTime = 0.0;
+	peer->isMigrating = false;
+	initializeDatagramClockState(&peer->clock);
+
+	size_t* peerTable = server->peerTable;
+	size_t peerTableMask = server->peerTableMask;
+
+	size_t index = (size_t)getDatagramPeerHash(
+		server,
+		peer) & peerTableMask;
+
+	while (peerTable[index] != 0)
+		index = (index + 1) & peerTableMask;
+
+	peerTable[index] = peerCount + 1;
+	server->peerCount = peerCount + 1;
+	return peer;
+}
+
+static void removeDatagramPeer(
+	DatagramServer server,
+	DatagramPeer* peer)
+{
+	destroyDtlsSession(peer->session);
+	destroySocketAddress(peer->pendingAddress);
+	destroySocketAddress(peer->address);
+
+	DatagramPeer* lastPeer =
+		&server->peers[server->peerCount - 1];
+
+	if (peer != lastPeer)
+		*peer = *lastPeer;
+
+	server->peerCount--;
+}
+
+static bool createDatagramPeerStorage(DatagramServer server)
+{
+	DatagramPeer* peers = malloc(
+		sizeof(DatagramPeer));
+
+	if (peers == NULL)
+		return false;
+
+	size_t* peerTable = calloc(2,
+		sizeof(size_t));
+
+	if (peerTable == NULL)
+	{
+		free(peers);
+		return false;
+	}
+
+	server->peers = peers;
+	server->peerCapacity = 1;
+	server->peerTable = peerTable;
+	server->peerTableMask = 1;
+	return true;
+}
+
 DatagramServer createDatagramServer(
 	uint8_t addressFamily,
 	const char* service,
 	size_t bufferSize,
 	OnDatagramServerReceive onReceive,
-	void* handle)
+	void* handle,
+	SslContext sslContext)
 {
 	assert(addressFamily < ADDRESS_FAMILY_COUNT);
 	assert(bufferSize != 0);
 	assert(onReceive != NULL);
 	assert(isNetworkInitialized() == true);
 
-	DatagramServer server = malloc(
+	DatagramServer server = calloc(1,
 		sizeof(struct DatagramServer));
 
 	if (server == NULL)
@@ -90,6 +355,42 @@ DatagramServer createDatagramServer(
 	server->buffer = receiveBuffer;
 	server->address = address;
 	server->socket = socket;
+	server->sslContext = sslContext;
+	server->maxPeerCount = DEFAULT_MAX_DATAGRAM_PEER_COUNT;
+
+	if (sslContext == NULL)
+		return server;
+
+	uint8_t* messageBuffer = malloc(
+		bufferSize * sizeof(uint8_t));
+
+	if (messageBuffer == NULL)
+	{
+		destroyDatagramServer(server);
+		return NULL;
+	}
+
+	server->messageBuffer = messageBuffer;
+
+	if (createDatagramPeerStorage(server) == false)
+	{
+		destroyDatagramServer(server);
+		return NULL;
+	}
+
+	DtlsSession listenSession = createDtlsSession(
+		socket,
+		sslContext,
+		NULL,
+		true);
+
+	if (listenSession == NULL)
+	{
+		destroyDatagramServer(server);
+		return NULL;
+	}
+
+	server->listenSession = listenSession;
 	return server;
 }
 
@@ -100,6 +401,24 @@ void destroyDatagramServer(DatagramServer server)
 	if (server == NULL)
 		return;
 
+	DatagramPeer* peers = server->peers;
+	size_t peerCount = server->peerCount;
+
+	for (size_t i = 0; i < peerCount; i++)
+	{
+		destroyDtlsSession(peers[i].session);
+		destroySocketAddress(peers[i].pendingAddress);
+		destroySocketAddress(peers[i].address);
+	}
+
+	if (server->sslContext != NULL)
+		destroyDtlsSession(server->listenSession);
+
+	free(server->sendBuffer);
+	free(server->peerTable);
+	free(peers);
+	free(server->messageBuffer);
+
 	shutdownSocket(
 		server->socket,
 		RECEIVE_SEND_SOCKET_SHUTDOWN);
@@ -137,10 +456,437 @@ Socket getDatagramServerSocket(DatagramServer server)
 	return server->socket;
 }
 
+SslContext getDatagramServerSslContext(DatagramServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->sslContext;
+}
+
+size_t getDatagramServerPeerCount(DatagramServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->peerCount;
+}
+
+size_t getDatagramServerMaxPeerCount(DatagramServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->maxPeerCount;
+}
+
+void setDatagramServerMaxPeerCount(
+	DatagramServer server,
+	size_t maxPeerCount)
+{
+	assert(server != NULL);
+	assert(maxPeerCount != 0);
+	assert(isNetworkInitialized() == true);
+	server->maxPeerCount = maxPeerCount;
+}
+
+bool enableDatagramServerConnectionIDs(
+	DatagramServer server,
+	OnDatagramConnectionAccept onConnectionAccept,
+	OnDatagramConnectionReceive onConnectionReceive)
+{
+	assert(server != NULL);
+	assert(onConnectionAccept != NULL);
+	assert(onConnectionReceive != NULL);
+	assert(server->sslContext == NULL);
+	assert(server->onConnectionReceive == NULL);
+	assert(isNetworkInitialized() == true);
+
+	uint8_t* sendBuffer = malloc(
+		MAX_DATAGRAM_SIZE * sizeof(uint8_t));
+
+	if (sendBuffer == NULL)
+		return false;
+
+	if (createDatagramPeerStorage(server) == false)
+	{
+		free(sendBuffer);
+		return false;
+	}
+
+	server->onConnectionAccept = onConnectionAccept;
+	server->onConnectionReceive = onConnectionReceive;
+	server->sendBuffer = sendBuffer;
+	return true;
+}
+
+bool isDatagramServerConnectionIDs(DatagramServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->onConnectionReceive != NULL;
+}
+
+static void sendPathChallenge(
+	DatagramServer server,
+	DatagramPeer* peer,
+	double currentTime)
+{
+	uint8_t packet[sizeof(uint8_t) + sizeof(uint64_t)];
+	packet[0] = PATH_DATAGRAM_CONNECTION_PACKET;
+
+	uint64_t challenge = hostToNet64(peer->challenge);
+
+	memcpy(
+		packet + 1,
+		&challenge,
+		sizeof(uint64_t));
+
+	socketSendTo(
+		server->socket,
+		packet,
+		sizeof(packet),
+		peer->pendingAddress);
+
+	peer->challengeTime = currentTime;
+}
+
+static void updateDatagramPeers(DatagramServer server)
+{
+	double currentTime = getCurrentClock();
+
+	if (currentTime - server->peerUpdateTime < PEER_UPDATE_DELAY_TIME)
+		return;
+
+	server->peerUpdateTime = currentTime;
+
+	DatagramPeer* peers = server->peers;
+	size_t peerCount = server->peerCount;
+	bool isRemoved = false;
+
+	for (size_t i = 0; i < peerCount; i++)
+	{
+		DatagramPeer* peer = &peers[i];
+
+		bool isAlive = currentTime -
+			peer->lastReceiveTime < PEER_TIMEOUT_TIME;
+
+		if (isAlive == true && peer->session != NULL)
+			isAlive = updateDtlsSession(peer->session);
+
+		if (isAlive == true)
+		{
+			if (peer->isMigrating == true && currentTime -
+				peer->challengeTime >= CHALLENGE_DELAY_TIME)
+			{
+				sendPathChallenge(
+					server,
+					peer,
+					currentTime);
+			}
+
+			continue;
+		}
+
+		// Swapped last peer is checked again
+		removeDatagramPeer(
+			server,
+			peer);
+
+		peerCount--;
+		isRemoved = true;
+		i--;
+	}
+
+	if (isRemoved == true)
+		rebuildDatagramPeerTable(server);
+}
+
+static void receiveDtlsDatagram(
+	DatagramServer server,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	SocketAddress address = server->address;
+	uint8_t* messageBuffer = server->messageBuffer;
+	size_t bufferSize = server->bufferSize;
+
+	DatagramPeer* peer = findDatagramPeer(
+		server,
+		address);
+
+	if (peer == NULL)
+	{
+		// Full server does not spend the cookie exchange
+		if (server->peerCount >= server->maxPeerCount)
+			return;
+
+		bool result = listenDtlsSession(
+			server->listenSession,
+			address,
+			buffer,
+			byteCount);
+
+		if (result == false)
+			return;
+
+		DtlsSession listenSession = createDtlsSession(
+			server->socket,
+			server->sslContext,
+			NULL,
+			true);
+
+		if (listenSession == NULL)
+			return;
+
+		// Verified listen session becomes the peer session
+		peer = addDatagramPeer(
+			server,
+			address,
+			server->listenSession,
+			0);
+
+		if (peer == NULL)
+		{
+			destroyDtlsSession(listenSession);
+			return;
+		}
+
+		server->listenSession = listenSession;
+		buffer = NULL;
+		byteCount = 0;
+	}
+
+	peer->lastReceiveTime = getCurrentClock();
+
+	while (true)
+	{
+		size_t messageSize;
+
+		bool result = dtlsSessionReceive(
+			peer->session,
+			buffer,
+			byteCount,
+			messageBuffer,
+			bufferSize,
+			&messageSize);
+
+		if (result == false)
+		{
+			removeDatagramPeer(
+				server,
+				peer);
+			rebuildDatagramPeerTable(server);
+			return;
+		}
+
+		if (messageSize == 0)
+			return;
+
+		server->onReceive(
+			server,
+			address,
+			messageBuffer,
+			messageSize);
+
+		// Peer storage is not changed by the receive function
+		buffer = NULL;
+		byteCount = 0;
+	}
+}
+
+static void receiveTimeDatagram(
+	DatagramServer server,
+	DatagramPeer* peer,
+	const uint8_t* buffer,
+	double currentTime)
+{
+	double sendTime = decodeDatagramClockTime(buffer);
+	double echoTime = decodeDatagramClockTime(buffer + sizeof(double));
+	double holdTime = decodeDatagramClockTime(buffer + sizeof(double) * 2);
+
+	// Previous response round trip, measured by the server clock
+	if (echoTime != 0.0)
+	{
+		addDatagramClockExchange(
+			&peer->clock,
+			echoTime,
+			sendTime,
+			holdTime,
+			currentTime);
+	}
+
+	uint8_t packet[sizeof(uint8_t) + sizeof(double) * 3];
+	packet[0] = TIME_DATAGRAM_CONNECTION_PACKET;
+
+	encodeDatagramClockTime(
+		sendTime,
+		packet + 1);
+	encodeDatagramClockTime(
+		currentTime,
+		packet + 1 + sizeof(double));
+	encodeDatagramClockTime(
+		getCurrentClock(),
+		packet + 1 + sizeof(double) * 2);
+
+	socketSendTo(
+		server->socket,
+		packet,
+		sizeof(packet),
+		peer->address);
+
+	peer->lastReceiveTime = currentTime;
+}
+
+static void receiveConnectionDatagram(
+	DatagramServer server,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	if (byteCount < CONNECTION_HEADER_SIZE)
+		return;
+
+	uint8_t type = buffer[0];
+	uint64_t connectionID;
+
+	memcpy(
+		&connectionID,
+		buffer + 1,
+		sizeof(uint64_t));
+
+	connectionID = netToHost64(connectionID);
+
+	// Zero connection ID is reserved for the disabled framing
+	if (connectionID == 0 || type >= DATAGRAM_CONNECTION_PACKET_COUNT)
+		return;
+
+	SocketAddress address = server->address;
+	double currentTime = getCurrentClock();
+
+	DatagramPeer* peer = findDatagramConnection(
+		server,
+		connectionID);
+
+	if (type == TIME_DATAGRAM_CONNECTION_PACKET)
+	{
+		// Probe is answered only on the validated path
+		if (peer == NULL ||
+			byteCount != CONNECTION_HEADER_SIZE + sizeof(double) * 3 ||
+			compareSocketAddress(peer->address, address) != 0)
+		{
+			return;
+		}
+
+		receiveTimeDatagram(
+			server,
+			peer,
+			buffer + CONNECTION_HEADER_SIZE,
+			currentTime);
+		return;
+	}
+	else if (type == PATH_DATAGRAM_CONNECTION_PACKET)
+	{
+		if (peer == NULL || peer->isMigrating == false ||
+			byteCount != CONNECTION_HEADER_SIZE + sizeof(uint64_t))
+		{
+			return;
+		}
+
+		uint64_t challenge;
+
+		memcpy(
+			&challenge,
+			buffer + CONNECTION_HEADER_SIZE,
+			sizeof(uint64_t));
+
+		// Response is accepted only from the challenged address
+		if (netToHost64(challenge) != peer->challenge ||
+			compareSocketAddress(peer->pendingAddress, address) != 0)
+		{
+			return;
+		}
+
+		copySocketAddress(
+			peer->pendingAddress,
+			peer->address);
+
+		peer->isMigrating = false;
+		peer->lastReceiveTime = currentTime;
+		return;
+	}
+
+	if (peer == NULL)
+	{
+		if (server->peerCount >= server->maxPeerCount)
+			return;
+
+		// Unknown connection is created only if admitted,
+		// admission datagram is not passed to the receive
+		bool result = server->onConnectionAccept(
+			server,
+			connectionID,
+			address,
+			buffer + CONNECTION_HEADER_SIZE,
+			byteCount - CONNECTION_HEADER_SIZE);
+
+		if (result == true)
+		{
+			addDatagramPeer(
+				server,
+				address,
+				NULL,
+				connectionID);
+		}
+
+		return;
+	}
+	else if (compareSocketAddress(peer->address, address) != 0)
+	{
+		// New path is validated before it replaces the current one
+		if (peer->isMigrating == false ||
+			compareSocketAddress(peer->pendingAddress, address) != 0)
+		{
+			// Each challenge is drawn from the secure generator, so
+			// one challenge does not reveal the others, migration is
+			// retried by the next datagram on generator failure
+			uint64_t challenge;
+
+			if (generateRandomBytes(
+				&challenge,
+				sizeof(uint64_t)) == false)
+			{
+				return;
+			}
+
+			copySocketAddress(
+				address,
+				peer->pendingAddress);
+
+			peer->challenge = challenge;
+			peer->isMigrating = true;
+
+			sendPathChallenge(
+				server,
+				peer,
+				currentTime);
+		}
+	}
+
+	peer->lastReceiveTime = currentTime;
+
+	server->onConnectionReceive(
+		server,
+		connectionID,
+		peer->address,
+		buffer + CONNECTION_HEADER_SIZE,
+		byteCount - CONNECTION_HEADER_SIZE);
+}
+
 bool updateDatagramServer(DatagramServer server)
 {
 	assert(server != NULL);
 
+	// Peers are timed out even if datagrams keep arriving
+	if (server->peers != NULL)
+		updateDatagramPeers(server);
+
 	uint8_t* buffer = server->buffer;
 	size_t byteCount;
 
@@ -154,6 +900,24 @@ bool updateDatagramServer(DatagramServer server)
 	if (result == false)
 		return false;
 
+	if (server->sslContext != NULL)
+	{
+		receiveDtlsDatagram(
+			server,
+			buffer,
+			byteCount);
+		return true;
+	}
+
+	if (server->onConnectionReceive != NULL)
+	{
+		receiveConnectionDatagram(
+			server,
+			buffer,
+			byteCount);
+		return true;
+	}
+
 	server->onReceive(
 		server,
 		server->address,
@@ -174,9 +938,100 @@ bool datagramServerSend(
 	assert(address != NULL);
 	assert(isNetworkInitialized() == true);
 
+	if (server->sslContext != NULL)
+	{
+		DatagramPeer* peer = findDatagramPeer(
+			server,
+			address);
+
+		if (peer == NULL)
+			return false;
+
+		return dtlsSessionSend(
+			peer->session,
+			buffer,
+			count);
+	}
+
+	if (server->onConnectionReceive != NULL)
+	{
+		if (count >= MAX_DATAGRAM_SIZE)
+			return false;
+
+		uint8_t* sendBuffer = server->sendBuffer;
+		sendBuffer[0] = DATA_DATAGRAM_CONNECTION_PACKET;
+
+		memcpy(
+			sendBuffer + 1,
+			buffer,
+			count);
+
+		return socketSendTo(
+			server->socket,
+			sendBuffer,
+			count + 1,
+			address);
+	}
+
 	return socketSendTo(
 		server->socket,
 		buffer,
 		count,
 		address);
 }
+
+bool getDatagramServerConnectionClock(
+	DatagramServer server,
+	uint64_t connectionID,
+	double* roundTripTime,
+	double* roundTripVariance,
+	double* clockOffset)
+{
+	assert(server != NULL);
+	assert(roundTripTime != NULL);
+	assert(roundTripVariance != NULL);
+	assert(clockOffset != NULL);
+	assert(server->onConnectionReceive != NULL);
+	assert(isNetworkInitialized() == true);
+
+	DatagramPeer* peer = findDatagramConnection(
+		server,
+		connectionID);
+
+	if (peer == NULL)
+		return false;
+
+	const DatagramClockState* clock = &peer->clock;
+	*roundTripTime = clock->roundTripTime;
+	*roundTripVariance = clock->roundTripVariance;
+	*clockOffset = clock->clockOffset;
+	return true;
+}
+
+bool datagramServerSendConnection(
+	DatagramServer server,
+	uint64_t connectionID,
+	const void* buffer,
+	size_t count)
+{
+	assert(server != NULL);
+	assert(connectionID != 0);
+	assert(buffer != NULL);
+	assert(count != 0);
+	assert(server->onConnectionReceive != NULL);
+	assert(isNetworkInitialized() == true);
+
+	DatagramPeer* peer = findDatagramConnection(
+		server,
+		connectionID);
+
+	if (peer == NULL)
+		return false;
+
+	// Sent only to the validated address during migration
+	return datagramServerSend(
+		server,
+		buffer,
+		count,
+		peer->address);
+}
@@ -0,0 +1,688 @@
+#include "mpnw/datagram_snapshot.h"
+#include <assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MPNW_SSE2_SNAPSHOT_DIFF
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define MPNW_NEON_SNAPSHOT_DIFF
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Block compared at once before the per word delta
+#define DIFF_BLOCK_SIZE 64
+// Acknowledgement packet size (type and sequence)
+#define ACK_PACKET_SIZE 3
+
+typedef enum DatagramSnapshotPacket
+{
+	STATE_DATAGRAM_SNAPSHOT_PACKET = 0,
+	ACK_DATAGRAM_SNAPSHOT_PACKET = 1,
+	DATAGRAM_SNAPSHOT_PACKET_COUNT = 2,
+} DatagramSnapshotPacket;
+
+typedef struct DatagramSnapshotSlot
+{
+	uint16_t sequence;
+	bool isUsed;
+} DatagramSnapshotSlot;
+
+struct DatagramSnapshot
+{
+	size_t stateSize;
+	size_t historyCount;
+	OnDatagramSnapshotSend onSend;
+	OnDatagramSnapshotReceive onReceive;
+	void* handle;
+	DatagramSnapshotSlot* slots;
+	uint8_t* states;
+	uint8_t* zeroState;
+	uint8_t* packetBuffer;
+	uint64_t stateByteCount;
+	uint64_t packetByteCount;
+	uint16_t sequence;
+	uint16_t ackSequence;
+	bool hasSequence;
+	bool isSender;
+};
+
+inline static int16_t getSequenceDistance(
+	uint16_t a,
+	uint16_t b)
+{
+	return (int16_t)(uint16_t)(a - b);
+}
+
+inline static size_t getDatagramSnapshotWordCount(size_t stateSize)
+{
+	return (stateSize + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+DatagramSnapshot createDatagramSnapshot(
+	bool isSender,
+	size_t stateSize,
+	size_t historyCount,
+	OnDatagramSnapshotSend onSend,
+	OnDatagramSnapshotReceive onReceive,
+	void* handle)
+{
+	assert(stateSize != 0);
+	assert(historyCount > 1);
+	assert(historyCount <= INT16_MAX);
+	assert((historyCount & (historyCount - 1)) == 0);
+	assert(onSend != NULL);
+	assert(isSender == true || onReceive != NULL);
+
+	DatagramSnapshot snapshot = calloc(1,
+		sizeof(struct DatagramSnapshot));
+
+	if (snapshot == NULL)
+		return NULL;
+
+	snapshot->stateSize = stateSize;
+	snapshot->historyCount = historyCount;
+	snapshot->onSend = onSend;
+	snapshot->onReceive = onReceive;
+	snapshot->handle = handle;
+	snapshot->isSender = isSender;
+
+	DatagramSnapshotSlot* slots = calloc(historyCount,
+		sizeof(DatagramSnapshotSlot));
+
+	if (slots == NULL)
+	{
+		destroyDatagramSnapshot(snapshot);
+		return NULL;
+	}
+
+	snapshot->slots = slots;
+
+	uint8_t* states = malloc(
+		historyCount * stateSize * sizeof(uint8_t));
+
+	if (states == NULL)
+	{
+		destroyDatagramSnapshot(snapshot);
+		return NULL;
+	}
+
+	snapshot->states = states;
+
+	uint8_t* zeroState = calloc(stateSize,
+		sizeof(uint8_t));
+
+	if (zeroState == NULL)
+	{
+		destroyDatagramSnapshot(snapshot);
+		return NULL;
+	}
+
+	snapshot->zeroState = zeroState;
+
+	if (isSender == false)
+		return snapshot;
+
+	uint8_t* packetBuffer = malloc(
+		getDatagramSnapshotMaxPacketSize(snapshot) * sizeof(uint8_t));
+
+	if (packetBuffer == NULL)
+	{
+		destroyDatagramSnapshot(snapshot);
+		return NULL;
+	}
+
+	snapshot->packetBuffer = packetBuffer;
+	return snapshot;
+}
+
+void destroyDatagramSnapshot(DatagramSnapshot snapshot)
+{
+	if (snapshot == NULL)
+		return;
+
+	free(snapshot->packetBuffer);
+	free(snapshot->zeroState);
+	free(snapshot->states);
+	free(snapshot->slots);
+	free(snapshot);
+}
+
+bool isDatagramSnapshotSender(DatagramSnapshot snapshot)
+{
+	assert(snapshot != NULL);
+	return snapshot->isSender;
+}
+
+size_t getDatagramSnapshotStateSize(DatagramSnapshot snapshot)
+{
+	assert(snapshot != NULL);
+	return snapshot->stateSize;
+}
+
+size_t getDatagramSnapshotHistoryCount(DatagramSnapshot snapshot)
+{
+	assert(snapshot != NULL);
+	return snapshot->historyCount;
+}
+
+void* getDatagramSnapshotHandle(DatagramSnapshot snapshot)
+{
+	assert(snapshot != NULL);
+	return snapshot->handle;
+}
+
+size_t getDatagramSnapshotMaxPacketSize(DatagramSnapshot snapshot)
+{
+	assert(snapshot != NULL);
+
+	size_t stateSize = snapshot->stateSize;
+	size_t wordCount = getDatagramSnapshotWordCount(stateSize);
+
+	// Word mask, byte mask per word and all bytes changed
+	return DATAGRAM_SNAPSHOT_HEADER_SIZE +
+		(wordCount + 7) / 8 + wordCount + stateSize;
+}
+
+void getDatagramSnapshotStats(
+	DatagramSnapshot snapshot,
+	uint64_t* stateByteCount,
+	uint64_t* packetByteCount)
+{
+	assert(snapshot != NULL);
+	assert(stateByteCount != NULL);
+	assert(packetByteCount != NULL);
+
+	*stateByteCount = snapshot->stateByteCount;
+	*packetByteCount = snapshot->packetByteCount;
+}
+
+inline static size_t getLowestBitIndex(uint32_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return index;
+#else
+	return (size_t)__builtin_ctz(value);
+#endif
+}
+
+// Only the changed bytes of the word are written
+inline static uint8_t* writeDatagramSnapshotWord(
+	uint8_t* wordMask,
+	size_t word,
+	uint32_t byteMask,
+	const uint8_t* bytes,
+	uint8_t* data)
+{
+	wordMask[word / 8] |= (uint8_t)(1 << (word % 8));
+	*data++ = (uint8_t)byteMask;
+
+	while (byteMask != 0)
+	{
+		*data++ = bytes[getLowestBitIndex(byteMask)];
+		byteMask &= byteMask - 1;
+	}
+
+	return data;
+}
+
+#if defined(MPNW_SSE2_SNAPSHOT_DIFF)
+#define MPNW_VECTOR_SNAPSHOT_DIFF
+
+// Stores block XOR, returns one bit per changed byte
+inline static uint64_t diffDatagramSnapshotBlock(
+	const uint8_t* state,
+	const uint8_t* baseline,
+	uint8_t* bytes)
+{
+	__m128i zero = _mm_setzero_si128();
+	uint64_t mask = 0;
+
+	for (size_t i = 0; i < DIFF_BLOCK_SIZE; i += 16)
+	{
+		__m128i value = _mm_xor_si128(
+			_mm_loadu_si128((const __m128i*)(state + i)),
+			_mm_loadu_si128((const __m128i*)(baseline + i)));
+
+		_mm_storeu_si128(
+			(__m128i*)(bytes + i),
+			value);
+
+		uint32_t equal = (uint32_t)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(value, zero));
+		mask |= (uint64_t)(~equal & 0xFFFF) << i;
+	}
+
+	return mask;
+}
+#elif defined(MPNW_NEON_SNAPSHOT_DIFF)
+#define MPNW_VECTOR_SNAPSHOT_DIFF
+
+// Stores block XOR, returns one bit per changed byte
+inline static uint64_t diffDatagramSnapshotBlock(
+	const uint8_t* state,
+	const uint8_t* baseline,
+	uint8_t* bytes)
+{
+	uint64_t mask = 0;
+
+	for (size_t i = 0; i < DIFF_BLOCK_SIZE; i += 16)
+	{
+		uint8x16_t value = veorq_u8(
+			vld1q_u8(state + i),
+			vld1q_u8(baseline + i));
+
+		vst1q_u8(bytes + i, value);
+
+		// Narrows comparison result to the 4 bits per byte mask
+		uint64_t changed = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(
+			vreinterpretq_u16_u8(vtstq_u8(value, value)), 4)), 0);
+
+		// Gathers the lowest bit of each nibble
+		changed &= 0x1111111111111111ULL;
+		changed = (changed | changed >> 3) & 0x0303030303030303ULL;
+		changed = (changed | changed >> 6) & 0x000F000F000F000FULL;
+		changed = (changed | changed >> 12) & 0x000000FF000000FFULL;
+		changed = (changed | changed >> 24) & 0xFFFFULL;
+		mask |= changed << i;
+	}
+
+	return mask;
+}
+#endif
+
+static size_t encodeDatagramSnapshotDelta(
+	const uint8_t* state,
+	const uint8_t* baseline,
+	size_t stateSize,
+	uint8_t* buffer)
+{
+	size_t wordCount = getDatagramSnapshotWordCount(stateSize);
+	size_t maskSize = (wordCount + 7) / 8;
+	uint8_t* data = buffer + maskSize;
+
+	memset(
+		buffer,
+		0,
+		maskSize);
+
+	size_t offset = 0;
+
+#if defined(MPNW_VECTOR_SNAPSHOT_DIFF)
+	uint8_t bytes[DIFF_BLOCK_SIZE];
+
+	// Changed byte mask of the block holds byte masks of its words
+	while (stateSize - offset >= DIFF_BLOCK_SIZE)
+	{
+		uint64_t mask = diffDatagramSnapshotBlock(
+			state + offset,
+			baseline + offset,
+			bytes);
+
+		for (size_t i = 0; mask != 0; i++, mask >>= 8)
+		{
+			uint32_t byteMask = (uint32_t)(mask & 0xFF);
+
+			if (byteMask == 0)
+				continue;
+
+			data = writeDatagramSnapshotWord(
+				buffer,
+				offset / sizeof(uint64_t) + i,
+				byteMask,
+				bytes + i * sizeof(uint64_t),
+				data);
+		}
+
+		offset += DIFF_BLOCK_SIZE;
+	}
+#endif
+
+	// Remaining bytes, or whole state without the vector unit
+	while (offset < stateSize)
+	{
+		size_t blockSize = stateSize - offset < DIFF_BLOCK_SIZE ?
+			stateSize - offset : DIFF_BLOCK_SIZE;
+
+		if (memcmp(state + offset, baseline + offset, blockSize) == 0)
+		{
+			offset += blockSize;
+			continue;
+		}
+
+		size_t blockEnd = offset + blockSize;
+
+		for (; offset < blockEnd; offset += sizeof(uint64_t))
+		{
+			size_t count = stateSize - offset < sizeof(uint64_t) ?
+				stateSize - offset : sizeof(uint64_t);
+
+			uint8_t wordBytes[sizeof(uint64_t)];
+			uint32_t byteMask = 0;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				wordBytes[i] = state[offset + i] ^ baseline[offset + i];
+
+				if (wordBytes[i] != 0)
+					byteMask |= (uint32_t)1 << i;
+			}
+
+			if (byteMask == 0)
+				continue;
+
+			data = writeDatagramSnapshotWord(
+				buffer,
+				offset / sizeof(uint64_t),
+				byteMask,
+				wordBytes,
+				data);
+		}
+	}
+
+	return data - buffer;
+}
+
+static bool decodeDatagramSnapshotDelta(
+	const uint8_t* buffer,
+	size_t byteCount,
+	uint8_t* state,
+	size_t stateSize)
+{
+	size_t wordCount = getDatagramSnapshotWordCount(stateSize);
+	size_t maskSize = (wordCount + 7) / 8;
+
+	if (byteCount < maskSize)
+		return false;
+
+	// Word mask bits after the last word should be zero
+	if (wordCount % 8 != 0 &&
+		(buffer[maskSize - 1] >> (wordCount % 8)) != 0)
+	{
+		return false;
+	}
+
+	const uint8_t* data = buffer + maskSize;
+	const uint8_t* dataEnd = buffer + byteCount;
+
+	for (size_t i = 0; i < maskSize; i++)
+	{
+		uint8_t wordMask = buffer[i];
+
+		if (wordMask == 0)
+			continue;
+
+		for (size_t j = 0; j < 8; j++)
+		{
+			if ((wordMask & (1 << j)) == 0)
+				continue;
+
+			if (data == dataEnd)
+				return false;
+
+			uint8_t byteMask = *data++;
+			size_t offset = (i * 8 + j) * sizeof(uint64_t);
+
+			size_t count = stateSize - offset < sizeof(uint64_t) ?
+				stateSize - offset : sizeof(uint64_t);
+
+			if (byteMask == 0 || (byteMask >> count) != 0)
+				return false;
+
+			for (size_t k = 0; k < count; k++)
+			{
+				if ((byteMask & (1 << k)) == 0)
+					continue;
+
+				if (data == dataEnd)
+					return false;
+
+				state[offset + k] ^= *data++;
+			}
+		}
+	}
+
+	return data == dataEnd;
+}
+
+bool datagramSnapshotSend(
+	DatagramSnapshot snapshot,
+	const void* state)
+{
+	assert(snapshot != NULL);
+	assert(state != NULL);
+	assert(snapshot->isSender == true);
+
+	size_t stateSize = snapshot->stateSize;
+	size_t historyMask = snapshot->historyCount - 1;
+	uint16_t sequence = snapshot->sequence;
+	uint16_t ackSequence = snapshot->ackSequence;
+
+	const uint8_t* baseline = snapshot->zeroState;
+	uint16_t baseSequence = sequence;
+
+	// Older baseline may be already replaced on the receiver
+	if (snapshot->hasSequence == true &&
+		(uint16_t)(sequence - ackSequence) <= historyMask)
+	{
+		size_t index = ackSequence & historyMask;
+		baseline = snapshot->states + index * stateSize;
+		baseSequence = ackSequence;
+	}
+
+	uint8_t* packetBuffer = snapshot->packetBuffer;
+	packetBuffer[0] = STATE_DATAGRAM_SNAPSHOT_PACKET;
+
+	uint16_t value = hostToNet16(sequence);
+
+	memcpy(
+		packetBuffer + 1,
+		&value,
+		sizeof(uint16_t));
+
+	value = hostToNet16(baseSequence);
+
+	memcpy(
+		packetBuffer + 3,
+		&value,
+		sizeof(uint16_t));
+
+	size_t packetSize = DATAGRAM_SNAPSHOT_HEADER_SIZE +
+		encodeDatagramSnapshotDelta(
+			state,
+			baseline,
+			stateSize,
+			packetBuffer + DATAGRAM_SNAPSHOT_HEADER_SIZE);
+
+	size_t index = sequence & historyMask;
+
+	memcpy(
+		snapshot->states + index * stateSize,
+		state,
+		stateSize);
+
+	snapshot->slots[index].sequence = sequence;
+	snapshot->slots[index].isUsed = true;
+	snapshot->sequence = sequence + 1;
+	snapshot->stateByteCount += stateSize;
+	snapshot->packetByteCount += packetSize;
+
+	return snapshot->onSend(
+		snapshot,
+		packetBuffer,
+		packetSize);
+}
+
+static bool receiveDatagramSnapshotAck(
+	DatagramSnapshot snapshot,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	if (snapshot->isSender == false || byteCount != ACK_PACKET_SIZE)
+		return false;
+
+	uint16_t sequence;
+
+	memcpy(
+		&sequence,
+		buffer + 1,
+		sizeof(uint16_t));
+
+	sequence = netToHost16(sequence);
+
+	if (getSequenceDistance(sequence, snapshot->sequence) >= 0)
+		return false;
+
+	if (snapshot->hasSequence == true && getSequenceDistance(
+		sequence, snapshot->ackSequence) <= 0)
+	{
+		return true;
+	}
+
+	DatagramSnapshotSlot* slot =
+		&snapshot->slots[sequence & (snapshot->historyCount - 1)];
+
+	// Acknowledged state should still be in the history
+	if (slot->isUsed == false || slot->sequence != sequence)
+		return true;
+
+	snapshot->ackSequence = sequence;
+	snapshot->hasSequence = true;
+	return true;
+}
+
+static bool receiveDatagramSnapshotState(
+	DatagramSnapshot snapshot,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	if (snapshot->isSender == true ||
+		byteCount < DATAGRAM_SNAPSHOT_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	uint16_t sequence, baseSequence;
+
+	memcpy(
+		&sequence,
+		buffer + 1,
+		sizeof(uint16_t));
+	memcpy(
+		&baseSequence,
+		buffer + 3,
+		sizeof(uint16_t));
+
+	sequence = netToHost16(sequence);
+	baseSequence = netToHost16(baseSequence);
+
+	size_t historyMask = snapshot->historyCount - 1;
+
+	if ((uint16_t)(sequence - baseSequence) > historyMask)
+		return false;
+
+	// Older or duplicate snapshot is not needed
+	if (snapshot->hasSequence == true && getSequenceDistance(
+		sequence, snapshot->sequence) <= 0)
+	{
+		return true;
+	}
+
+	size_t stateSize = snapshot->stateSize;
+	DatagramSnapshotSlot* slots = snapshot->slots;
+	const uint8_t* baseline = snapshot->zeroState;
+
+	if (baseSequence != sequence)
+	{
+		DatagramSnapshotSlot* slot = &slots[baseSequence & historyMask];
+
+		// Baseline was not received, sender will use a newer one
+		if (slot->isUsed == false || slot->sequence != baseSequence)
+			return true;
+
+		baseline = snapshot->states +
+			(baseSequence & historyMask) * stateSize;
+	}
+
+	size_t index = sequence & historyMask;
+	uint8_t* state = snapshot->states + index * stateSize;
+
+	memcpy(
+		state,
+		baseline,
+		stateSize);
+
+	slots[index].isUsed = false;
+
+	bool result = decodeDatagramSnapshotDelta(
+		buffer + DATAGRAM_SNAPSHOT_HEADER_SIZE,
+		byteCount - DATAGRAM_SNAPSHOT_HEADER_SIZE,
+		state,
+		stateSize);
+
+	if (result == false)
+		return false;
+
+	slots[index].sequence = sequence;
+	slots[index].isUsed = true;
+	snapshot->sequence = sequence;
+	snapshot->hasSequence = true;
+	snapshot->stateByteCount += stateSize;
+	snapshot->packetByteCount += byteCount;
+
+	uint8_t packet[ACK_PACKET_SIZE];
+	packet[0] = ACK_DATAGRAM_SNAPSHOT_PACKET;
+
+	uint16_t value = hostToNet16(sequence);
+
+	memcpy(
+		packet + 1,
+		&value,
+		sizeof(uint16_t));
+
+	// Lost acknowledgement is replaced by the next one
+	snapshot->onSend(
+		snapshot,
+		packet,
+		ACK_PACKET_SIZE);
+
+	snapshot->onReceive(
+		snapshot,
+		sequence,
+		state);
+	return true;
+}
+
+bool datagramSnapshotReceive(
+	DatagramSnapshot snapshot,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	assert(snapshot != NULL);
+	assert(buffer != NULL);
+
+	if (byteCount == 0)
+		return false;
+
+	if (buffer[0] == STATE_DATAGRAM_SNAPSHOT_PACKET)
+	{
+		return receiveDatagramSnapshotState(
+			snapshot,
+			buffer,
+			byteCount);
+	}
+	else if (buffer[0] == ACK_DATAGRAM_SNAPSHOT_PACKET)
+	{
+		return receiveDatagramSnapshotAck(
+			snapshot,
+			buffer,
+			byteCount);
+	}
+
+	return false;
+}
@@ -6,10 +6,15 @@
 #include <errno.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 
+#if __linux__
+#include <sys/random.h>
+#endif
+
 #define SOCKET int
 #define INVALID_SOCKET (-1)
 #define SOCKET_LENGTH socklen_t
@@ -17,10 +22,12 @@
 #elif _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <bcrypt.h>
 
 #pragma comment (lib, "Ws2_32.lib")
 #pragma comment (lib, "Mswsock.lib")
 #pragma comment (lib, "AdvApi32.lib")
+#pragma comment (lib, "Bcrypt.lib")
 
 #define SOCKET_LENGTH int
 
@@ -29,9 +36,19 @@ static WSADATA wsaData;
 #error Unknown operating system
 #endif
 
+// Maximum buffer count sent with one system call
+#define SEND_VECTOR_SIZE 64
+
 #if MPNW_HAS_OPENSSL
 #include "openssl/ssl.h"
 #include "openssl/err.h"
+#include "openssl/hmac.h"
+#include "openssl/rand.h"
+
+// Secure datagram size, which fits any IPv6 path
+#define DTLS_PACKET_SIZE 1200
+// Maximum SSL record plaintext size, written at once
+#define SSL_SEND_BUFFER_SIZE 16384
 #else
 #define SSL_CTX void
 #endif
@@ -45,6 +62,8 @@ struct Socket
 #if MPNW_HAS_OPENSSL
 	SslContext sslContext;
 	SSL* ssl;
+	uint8_t* sslBuffer;
+	size_t sslPendingCount;
 #endif
 };
 
@@ -58,8 +77,149 @@ struct SslContext
 	SSL_CTX* handle;
 };
 
+#if MPNW_HAS_OPENSSL
+struct DtlsSession
+{
+	Socket socket;
+	SSL* ssl;
+	BIO_ADDR* listenAddress;
+	const uint8_t* receiveBuffer;
+	size_t receiveCount;
+	struct SocketAddress address;
+	bool hasAddress;
+};
+
+static BIO_METHOD* dtlsBioMethod = NULL;
+static uint8_t dtlsCookieSecret[32];
+#endif
+
 static bool networkInitialized = false;
 
+#if MPNW_HAS_OPENSSL
+static int createDtlsBio(BIO* bio)
+{
+	BIO_set_init(bio, 1);
+	return 1;
+}
+
+static int readDtlsBio(
+	BIO* bio,
+	char* buffer,
+	int size)
+{
+	DtlsSession session = BIO_get_data(bio);
+	size_t count = session->receiveCount;
+
+	BIO_clear_retry_flags(bio);
+
+	if (count == 0)
+	{
+		BIO_set_retry_read(bio);
+		return -1;
+	}
+
+	if (count > (size_t)size)
+		count = (size_t)size;
+
+	// Datagram is passed to the session only once
+	memcpy(
+		buffer,
+		session->receiveBuffer,
+		count);
+
+	session->receiveCount = 0;
+	return (int)count;
+}
+
+static int writeDtlsBio(
+	BIO* bio,
+	const char* buffer,
+	int size)
+{
+	DtlsSession session = BIO_get_data(bio);
+
+	BIO_clear_retry_flags(bio);
+
+	// Lost datagram is retransmitted by the DTLS itself
+	if (session->hasAddress == true)
+	{
+		socketSendTo(
+			session->socket,
+			buffer,
+			(size_t)size,
+			&session->address);
+	}
+	else
+	{
+		socketSend(
+			session->socket,
+			buffer,
+			(size_t)size);
+	}
+
+	return size;
+}
+
+static long controlDtlsBio(
+	BIO* bio,
+	int command,
+	long number,
+	void* pointer)
+{
+	(void)bio;
+	(void)number;
+	(void)pointer;
+
+	return command == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+static int generateDtlsCookie(
+	SSL* ssl,
+	unsigned char* cookie,
+	unsigned int* cookieLength)
+{
+	DtlsSession session = SSL_get_app_data(ssl);
+	const struct sockaddr_storage* address = &session->address.handle;
+
+	size_t length = address->ss_family == AF_INET6 ?
+		sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+
+	// Stateless cookie is bound to the peer address
+	unsigned char* result = HMAC(
+		EVP_sha256(),
+		dtlsCookieSecret,
+		sizeof(dtlsCookieSecret),
+		(const unsigned char*)address,
+		length,
+		cookie,
+		cookieLength);
+
+	return result != NULL ? 1 : 0;
+}
+
+static int verifyDtlsCookie(
+	SSL* ssl,
+	const unsigned char* cookie,
+	unsigned int cookieLength)
+{
+	unsigned char expectedCookie[EVP_MAX_MD_SIZE];
+	unsigned int expectedLength;
+
+	int result = generateDtlsCookie(
+		ssl,
+		expectedCookie,
+		&expectedLength);
+
+	if (result == 0 || expectedLength != cookieLength)
+		return 0;
+
+	return CRYPTO_memcmp(
+		expectedCookie,
+		cookie,
+		cookieLength) == 0 ? 1 : 0;
+}
+#endif
+
 bool initializeNetwork()
 {
 	if (networkInitialized == true)
@@ -79,6 +239,26 @@ bool initializeNetwork()
 #if MPNW_HAS_OPENSSL
 	SSL_load_error_strings();
 	OpenSSL_add_ssl_algorithms();
+
+	int secretResult = RAND_bytes(
+		dtlsCookieSecret,
+		sizeof(dtlsCookieSecret));
+
+	if (secretResult != 1)
+		return false;
+
+	BIO_METHOD* bioMethod = BIO_meth_new(
+		BIO_get_new_index() | BIO_TYPE_SOURCE_SINK,
+		"mpnw dtls");
+
+	if (bioMethod == NULL)
+		return false;
+
+	BIO_meth_set_create(bioMethod, createDtlsBio);
+	BIO_meth_set_read(bioMethod, readDtlsBio);
+	BIO_meth_set_write(bioMethod, writeDtlsBio);
+	BIO_meth_set_ctrl(bioMethod, controlDtlsBio);
+	dtlsBioMethod = bioMethod;
 #endif
 
 	networkInitialized = true;
@@ -99,6 +279,8 @@ void terminateNetwork()
 #endif
 
 #if MPNW_HAS_OPENSSL
+	BIO_meth_free(dtlsBioMethod);
+	dtlsBioMethod = NULL;
 	EVP_cleanup();
 #endif
 
@@ -109,6 +291,53 @@ bool isNetworkInitialized()
 	return networkInitialized;
 }
 
+bool generateRandomBytes(
+	void* buffer,
+	size_t count)
+{
+	assert(buffer != NULL);
+	assert(count <= INT32_MAX);
+
+#if MPNW_HAS_OPENSSL
+	return RAND_bytes(
+		buffer,
+		(int)count) == 1;
+#elif __linux__
+	uint8_t* bytes = buffer;
+
+	while (count != 0)
+	{
+		ssize_t result = getrandom(
+			bytes,
+			count,
+			0);
+
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		bytes += result;
+		count -= (size_t)result;
+	}
+
+	return true;
+#elif __APPLE__
+	arc4random_buf(
+		buffer,
+		count);
+	return true;
+#elif _WIN32
+	return BCryptGenRandom(
+		NULL,
+		buffer,
+		(ULONG)count,
+		BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#endif
+}
+
 Socket createSocket(
 	uint8_t _type,
 	uint8_t _family,
@@ -271,8 +500,16 @@ Socket createSocket(
 			return NULL;
 		}
 
+		// Allows partial writes and retries from the moved buffer
+		SSL_set_mode(
+			ssl,
+			SSL_MODE_ENABLE_PARTIAL_WRITE |
+			SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
 		_socket->sslContext = sslContext;
 		_socket->ssl = ssl;
+		_socket->sslBuffer = NULL;
+		_socket->sslPendingCount = 0;
 	}
 	else
 	{
@@ -283,16 +520,17 @@ Socket createSocket(
 	return _socket;
 }
 
-void destroySocket(Socket socket)
+void destroySocketInPlace(Socket socket)
 {
+	assert(socket != NULL);
 	assert(networkInitialized == true);
 
-	if (socket == NULL)
-		return;
-
 #if MPNW_HAS_OPENSSL
 	if (socket->sslContext != NULL)
+	{
 		SSL_free(socket->ssl);
+		free(socket->sslBuffer);
+	}
 #endif
 
 	int result = closesocket(
@@ -300,10 +538,23 @@ void destroySocket(Socket socket)
 
 	if (result != 0)
 		abort();
+}
+void destroySocket(Socket socket)
+{
+	assert(networkInitialized == true);
+
+	if (socket == NULL)
+		return;
 
+	destroySocketInPlace(socket);
 	free(socket);
 }
 
+size_t getSocketInstanceSize()
+{
+	return sizeof(struct Socket);
+}
+
 uint8_t getSocketType(Socket socket)
 {
 	assert(socket != NULL);
@@ -498,18 +749,127 @@ void setSocketNoDelay(
 		abort();
 }
 
-Socket acceptSocket(Socket socket)
+bool setSocketDontFragment(
+	Socket socket,
+	bool value)
 {
 	assert(socket != NULL);
-	assert(isSocketListening(socket) == true);
-	assert(getSocketType(socket) == STREAM_SOCKET_TYPE);
+	assert(getSocketType(socket) == DATAGRAM_SOCKET_TYPE);
 	assert(networkInitialized == true);
 
-	Socket acceptedSocket = malloc(
-		sizeof(struct Socket));
+	struct sockaddr_storage socketAddress;
 
-	if (acceptedSocket == NULL)
-		return NULL;
+	SOCKET_LENGTH length =
+		sizeof(struct sockaddr_storage);
+
+	int result = getsockname(
+		socket->handle,
+		(struct sockaddr*)&socketAddress,
+		&length);
+
+	if (result != 0)
+		return false;
+
+	int level, name;
+
+#if __linux__
+	// Probe mode sets DF bit, but ignores cached path MTU
+	int option;
+
+	if (socketAddress.ss_family == AF_INET6)
+	{
+		level = IPPROTO_IPV6;
+		name = IPV6_MTU_DISCOVER;
+		option = value == true ?
+			IPV6_PMTUDISC_PROBE : IPV6_PMTUDISC_DONT;
+	}
+	else
+	{
+		level = IPPROTO_IP;
+		name = IP_MTU_DISCOVER;
+		option = value == true ?
+			IP_PMTUDISC_PROBE : IP_PMTUDISC_DONT;
+	}
+#elif __APPLE__
+	int option = value == true ? 1 : 0;
+
+	if (socketAddress.ss_family == AF_INET6)
+	{
+		level = IPPROTO_IPV6;
+		name = IPV6_DONTFRAG;
+	}
+	else
+	{
+#ifdef IP_DONTFRAG
+		level = IPPROTO_IP;
+		name = IP_DONTFRAG;
+#else
+		return false;
+#endif
+	}
+#elif _WIN32
+	DWORD option = value == true ? TRUE : FALSE;
+
+	if (socketAddress.ss_family == AF_INET6)
+	{
+		level = IPPROTO_IPV6;
+		name = IPV6_DONTFRAG;
+	}
+	else
+	{
+		level = IPPROTO_IP;
+		name = IP_DONTFRAGMENT;
+	}
+#endif
+
+	result = setsockopt(
+		socket->handle,
+		level,
+		name,
+		(char*)&option,
+		sizeof(option));
+
+	return result == 0;
+}
+
+bool setSocketMaxPacingRate(
+	Socket socket,
+	uint64_t rate)
+{
+	assert(socket != NULL);
+	assert(networkInitialized == true);
+
+#if __linux__ && defined(SO_MAX_PACING_RATE)
+	// Kernel paces the socket packets with the fq queue discipline
+	unsigned int option;
+
+	if (rate == 0 || rate >= UINT32_MAX)
+		option = UINT32_MAX;
+	else
+		option = (unsigned int)rate;
+
+	int result = setsockopt(
+		socket->handle,
+		SOL_SOCKET,
+		SO_MAX_PACING_RATE,
+		(char*)&option,
+		sizeof(option));
+
+	return result == 0;
+#else
+	return false;
+#endif
+}
+
+bool acceptSocketInPlace(
+	Socket socket,
+	Socket acceptedSocket)
+{
+	assert(socket != NULL);
+	assert(acceptedSocket != NULL);
+	assert(isSocketListening(socket) == true);
+	assert(getSocketType(socket) == STREAM_SOCKET_TYPE);
+	assert(networkInitialized == true);
 
 	SOCKET handle = accept(
 		socket->handle,
@@ -517,10 +877,7 @@ Socket acceptSocket(Socket socket)
 		0);
 
 	if (handle == INVALID_SOCKET)
-	{
-		free(acceptedSocket);
-		return NULL;
-	}
+		return false;
 
 	if (socket->blocking == false)
 	{
@@ -533,8 +890,7 @@ Socket acceptSocket(Socket socket)
 		if (flags == -1)
 		{
 			closesocket(handle);
-			free(acceptedSocket);
-			return NULL;
+			return false;
 		}
 
 		int result = fcntl(
@@ -553,8 +909,7 @@ Socket acceptSocket(Socket socket)
 		if (result != 0)
 		{
 			closesocket(handle);
-			free(acceptedSocket);
-			return NULL;
+			return false;
 		}
 	}
 
@@ -571,8 +926,7 @@ Socket acceptSocket(Socket socket)
 		if (ssl == NULL)
 		{
 			closesocket(handle);
-			free(acceptedSocket);
-			return NULL;
+			return false;
 		}
 
 		int result = SSL_set_fd(
@@ -583,13 +937,19 @@ Socket acceptSocket(Socket socket)
 		{
 			SSL_free(ssl);
 			closesocket(handle);
-			free(acceptedSocket);
-			return NULL;
+			return false;
 		}
 
+		SSL_set_mode(
+			ssl,
+			SSL_MODE_ENABLE_PARTIAL_WRITE |
+			SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
 		acceptedSocket->sslContext =
 			socket->sslContext;
 		acceptedSocket->ssl = ssl;
+		acceptedSocket->sslBuffer = NULL;
+		acceptedSocket->sslPendingCount = 0;
 	}
 	else
 	{
@@ -597,9 +957,67 @@ Socket acceptSocket(Socket socket)
 	}
 #endif
 
+	return true;
+}
+Socket acceptSocket(Socket socket)
+{
+	assert(socket != NULL);
+	assert(networkInitialized == true);
+
+	Socket acceptedSocket = malloc(
+		sizeof(struct Socket));
+
+	if (acceptedSocket == NULL)
+		return NULL;
+
+	bool result = acceptSocketInPlace(
+		socket,
+		acceptedSocket);
+
+	if (result == false)
+	{
+		free(acceptedSocket);
+		return NULL;
+	}
+
 	return acceptedSocket;
 }
 
+bool rejectSocket(Socket socket)
+{
+	assert(socket != NULL);
+	assert(isSocketListening(socket) == true);
+	assert(getSocketType(socket) == STREAM_SOCKET_TYPE);
+	assert(networkInitialized == true);
+
+	SOCKET handle = accept(
+		socket->handle,
+		NULL,
+		0);
+
+	if (handle == INVALID_SOCKET)
+		return false;
+
+	// Zero linger time closes connection with reset
+	struct linger linger;
+	linger.l_onoff = 1;
+	linger.l_linger = 0;
+
+	setsockopt(
+		handle,
+		SOL_SOCKET,
+		SO_LINGER,
+		(const char*)&linger,
+		sizeof(struct linger));
+
+	int result = closesocket(handle);
+
+	if (result != 0)
+		abort();
+
+	return true;
+}
+
 bool acceptSslSocket(Socket socket)
 {
 	assert(socket != NULL);
@@ -704,56 +1122,393 @@ bool socketReceive(
 #if MPNW_HAS_OPENSSL
 	if (socket->sslContext != NULL)
 	{
-		int result = SSL_read(
-			socket->ssl,
-			buffer,
-			(int)size);
+		int result = SSL_read(
+			socket->ssl,
+			buffer,
+			(int)size);
+
+		if (result < 0)
+			return false;
+
+		*count = (size_t)result;
+		return true;
+	}
+#endif
+
+#if __linux__ || __APPLE__
+	struct iovec vector;
+	vector.iov_base = buffer;
+	vector.iov_len = size;
+
+	struct msghdr message;
+
+	memset(
+		&message,
+		0,
+		sizeof(struct msghdr));
+
+	message.msg_iov = &vector;
+	message.msg_iovlen = 1;
+
+	int64_t result = recvmsg(
+		socket->handle,
+		&message,
+		0);
+
+	// Truncated datagram is dropped
+	if (result < 0 || (message.msg_flags & MSG_TRUNC) != 0)
+		return false;
+#elif _WIN32
+	// Truncated datagram fails with WSAEMSGSIZE
+	int64_t result = recv(
+		socket->handle,
+		(char*)buffer,
+		(int)size,
+		0);
+
+	if (result < 0)
+		return false;
+#endif
+
+	*count = (size_t)result;
+	return true;
+}
+
+bool socketSend(
+	Socket socket,
+	const void* buffer,
+	size_t count)
+{
+	assert(socket != NULL);
+	assert(buffer != NULL);
+	assert(networkInitialized == true);
+
+#if MPNW_HAS_OPENSSL
+	if (socket->sslContext != NULL)
+	{
+		// Pending partial write should be retried first
+		if (socket->sslPendingCount != 0)
+			return false;
+
+		const uint8_t* data = buffer;
+
+		// Partial write mode returns after each record
+		while (count != 0)
+		{
+			int result = SSL_write(
+				socket->ssl,
+				data,
+				count > INT32_MAX ? INT32_MAX : (int)count);
+
+			if (result <= 0)
+				return false;
+
+			data += result;
+			count -= (size_t)result;
+		}
+
+		return true;
+	}
+#endif
+
+	return send(
+		socket->handle,
+		(const char*)buffer,
+		(int)count,
+		0) == count;
+}
+
+#if MPNW_HAS_OPENSSL
+static uint8_t* getSslSocketBuffer(Socket socket)
+{
+	uint8_t* sslBuffer = socket->sslBuffer;
+
+	// Allocated only for the sockets which are sending
+	if (sslBuffer == NULL)
+	{
+		sslBuffer = malloc(
+			SSL_SEND_BUFFER_SIZE * sizeof(uint8_t));
+		socket->sslBuffer = sslBuffer;
+	}
+
+	return sslBuffer;
+}
+static bool sslSocketSendPartial(
+	Socket socket,
+	const void* buffer,
+	size_t count,
+	size_t* sentCount)
+{
+	size_t pendingCount = socket->sslPendingCount;
+
+	// Write retry after would block should have the same length,
+	// caller data is moved meanwhile, so it is resent from the copy
+	if (pendingCount != 0)
+	{
+		buffer = socket->sslBuffer;
+		count = pendingCount;
+	}
+	else if (count > SSL_SEND_BUFFER_SIZE)
+	{
+		count = SSL_SEND_BUFFER_SIZE;
+	}
+
+	int result = SSL_write(
+		socket->ssl,
+		buffer,
+		(int)count);
+
+	if (result > 0)
+	{
+		socket->sslPendingCount = 0;
+		*sentCount = (size_t)result;
+		return true;
+	}
+
+	int error = SSL_get_error(
+		socket->ssl,
+		result);
+
+	if (error != SSL_ERROR_WANT_WRITE &&
+		error != SSL_ERROR_WANT_READ)
+	{
+		return false;
+	}
+
+	if (pendingCount == 0)
+	{
+		uint8_t* sslBuffer = getSslSocketBuffer(socket);
+
+		if (sslBuffer == NULL)
+			return false;
+
+		// Gathered buffers are already in place
+		if (buffer != sslBuffer)
+		{
+			memcpy(
+				sslBuffer,
+				buffer,
+				count);
+		}
+
+		socket->sslPendingCount = count;
+	}
+
+	*sentCount = 0;
+	return true;
+}
+#endif
+
+bool socketSendPartial(
+	Socket socket,
+	const void* buffer,
+	size_t count,
+	size_t* sentCount)
+{
+	assert(socket != NULL);
+	assert(buffer != NULL);
+	assert(sentCount != NULL);
+	assert(networkInitialized == true);
+
+#if MPNW_HAS_OPENSSL
+	if (socket->sslContext != NULL)
+	{
+		return sslSocketSendPartial(
+			socket,
+			buffer,
+			count,
+			sentCount);
+	}
+#endif
+
+	int64_t result = send(
+		socket->handle,
+		(const char*)buffer,
+		(int)count,
+		0);
+
+	if (result >= 0)
+	{
+		*sentCount = (size_t)result;
+		return true;
+	}
+
+#if __linux__ || __APPLE__
+	if (errno == EAGAIN || errno == EWOULDBLOCK)
+#elif _WIN32
+	if (WSAGetLastError() == WSAEWOULDBLOCK)
+#endif
+	{
+		*sentCount = 0;
+		return true;
+	}
+
+	return false;
+}
+
+bool socketSendBuffers(
+	Socket socket,
+	const void** buffers,
+	const size_t* counts,
+	size_t bufferCount,
+	size_t* sentCount)
+{
+	assert(socket != NULL);
+	assert(buffers != NULL);
+	assert(counts != NULL);
+	assert(bufferCount != 0);
+	assert(sentCount != NULL);
+	assert(networkInitialized == true);
+
+#if MPNW_HAS_OPENSSL
+	// SSL has no vectored write, buffers are gathered to one record,
+	// instead of the separate record and system call for each of them
+	if (socket->sslContext != NULL)
+	{
+		// Pending write is retried alone, it can span buffers
+		if (socket->sslPendingCount != 0)
+		{
+			return sslSocketSendPartial(
+				socket,
+				buffers[0],
+				counts[0],
+				sentCount);
+		}
 
-		if (result < 0)
+		uint8_t* sslBuffer = getSslSocketBuffer(socket);
+
+		if (sslBuffer == NULL)
 			return false;
 
-		*count = (size_t)result;
+		size_t totalCount = 0;
+		size_t bufferIndex = 0;
+		size_t bufferOffset = 0;
+
+		while (bufferIndex < bufferCount)
+		{
+			size_t gatherCount = 0;
+
+			while (bufferIndex < bufferCount &&
+				gatherCount < SSL_SEND_BUFFER_SIZE)
+			{
+				size_t partSize = counts[bufferIndex] - bufferOffset;
+				size_t freeSize = SSL_SEND_BUFFER_SIZE - gatherCount;
+
+				if (partSize > freeSize)
+					partSize = freeSize;
+
+				memcpy(
+					sslBuffer + gatherCount,
+					(const uint8_t*)buffers[bufferIndex] + bufferOffset,
+					partSize);
+
+				gatherCount += partSize;
+				bufferOffset += partSize;
+
+				if (bufferOffset == counts[bufferIndex])
+				{
+					bufferIndex++;
+					bufferOffset = 0;
+				}
+			}
+
+			if (gatherCount == 0)
+				break;
+
+			size_t count;
+
+			bool result = sslSocketSendPartial(
+				socket,
+				sslBuffer,
+				gatherCount,
+				&count);
+
+			if (result == false)
+				return false;
+
+			totalCount += count;
+
+			if (count < gatherCount)
+				break;
+		}
+
+		*sentCount = totalCount;
 		return true;
 	}
 #endif
 
-	int64_t result = recv(
+	if (bufferCount > SEND_VECTOR_SIZE)
+		bufferCount = SEND_VECTOR_SIZE;
+
+#if __linux__ || __APPLE__
+	struct iovec vectors[SEND_VECTOR_SIZE];
+
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		vectors[i].iov_base = (void*)buffers[i];
+		vectors[i].iov_len = counts[i];
+	}
+
+	struct msghdr message;
+
+	memset(
+		&message,
+		0,
+		sizeof(struct msghdr));
+
+	message.msg_iov = vectors;
+	message.msg_iovlen = bufferCount;
+
+	int64_t result = sendmsg(
 		socket->handle,
-		(char*)buffer,
-		(int)size,
+		&message,
 		0);
 
-	if (result < 0)
-		return false;
+	if (result >= 0)
+	{
+		*sentCount = (size_t)result;
+		return true;
+	}
 
-	*count = (size_t)result;
-	return true;
-}
+	if (errno == EAGAIN || errno == EWOULDBLOCK)
+	{
+		*sentCount = 0;
+		return true;
+	}
+#elif _WIN32
+	WSABUF vectors[SEND_VECTOR_SIZE];
 
-bool socketSend(
-	Socket socket,
-	const void* buffer,
-	size_t count)
-{
-	assert(socket != NULL);
-	assert(buffer != NULL);
-	assert(networkInitialized == true);
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		vectors[i].buf = (CHAR*)buffers[i];
+		vectors[i].len = (ULONG)counts[i];
+	}
 
-#if MPNW_HAS_OPENSSL
-	if (socket->sslContext != NULL)
+	DWORD count;
+
+	int result = WSASend(
+		socket->handle,
+		vectors,
+		(DWORD)bufferCount,
+		&count,
+		0,
+		NULL,
+		NULL);
+
+	if (result == 0)
 	{
-		return SSL_write(
-			socket->ssl,
-			buffer,
-			(int)count) == count;
+		*sentCount = (size_t)count;
+		return true;
+	}
+
+	if (WSAGetLastError() == WSAEWOULDBLOCK)
+	{
+		*sentCount = 0;
+		return true;
 	}
 #endif
 
-	return send(
-		socket->handle,
-		(const char*)buffer,
-		(int)count,
-		0) == count;
+	return false;
 }
 
 bool socketReceiveFrom(
@@ -780,9 +1535,36 @@ bool socketReceiveFrom(
 		0,
 		sizeof(struct sockaddr_storage));
 
+#if __linux__ || __APPLE__
+	struct iovec vector;
+	vector.iov_base = buffer;
+	vector.iov_len = size;
+
+	struct msghdr message;
+
+	memset(
+		&message,
+		0,
+		sizeof(struct msghdr));
+
+	message.msg_name = &socketAddress;
+	message.msg_namelen = sizeof(struct sockaddr_storage);
+	message.msg_iov = &vector;
+	message.msg_iovlen = 1;
+
+	int64_t count = recvmsg(
+		socket->handle,
+		&message,
+		0);
+
+	// Truncated datagram is dropped
+	if (count < 0 || (message.msg_flags & MSG_TRUNC) != 0)
+		return false;
+#elif _WIN32
 	SOCKET_LENGTH length =
 		sizeof(struct sockaddr_storage);
 
+	// Truncated datagram fails with WSAEMSGSIZE
 	int64_t count = recvfrom(
 		socket->handle,
 		(char*)buffer,
@@ -793,6 +1575,7 @@ bool socketReceiveFrom(
 
 	if (count < 0)
 		return false;
+#endif
 
 	address->handle = socketAddress;
 	*_count = (size_t)count;
@@ -1059,6 +1842,32 @@ int compareSocketAddress(
 	}
 }
 
+uint64_t getSocketAddressHash(SocketAddress address)
+{
+	assert(address != NULL);
+
+	size_t length;
+
+	if (address->handle.ss_family == AF_INET)
+		length = sizeof(struct sockaddr_in);
+	else if (address->handle.ss_family == AF_INET6)
+		length = sizeof(struct sockaddr_in6);
+	else
+		length = sizeof(struct sockaddr_storage);
+
+	const uint8_t* bytes = (const uint8_t*)&address->handle;
+	uint64_t hash = 14695981039346656037ULL;
+
+	// FNV-1a over the same bytes as compareSocketAddress()
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
 uint8_t getSocketAddressFamily(SocketAddress address)
 {
 	assert(address != NULL);
@@ -1341,6 +2150,12 @@ SslContext createSslContext(
 	case TLS_1_2_SECURITY_PROTOCOL:
 		handle = SSL_CTX_new(TLSv1_2_method());
 		break;
+	case DTLS_SECURITY_PROTOCOL:
+		handle = SSL_CTX_new(DTLS_method());
+		break;
+	case DTLS_1_2_SECURITY_PROTOCOL:
+		handle = SSL_CTX_new(DTLSv1_2_method());
+		break;
 	}
 
 	if (handle == NULL)
@@ -1349,6 +2164,17 @@ SslContext createSslContext(
 		return NULL;
 	}
 
+	if (securityProtocol == DTLS_SECURITY_PROTOCOL ||
+		securityProtocol == DTLS_1_2_SECURITY_PROTOCOL)
+	{
+		SSL_CTX_set_cookie_generate_cb(
+			handle,
+			generateDtlsCookie);
+		SSL_CTX_set_cookie_verify_cb(
+			handle,
+			verifyDtlsCookie);
+	}
+
 	int result;
 
 	if (certificateVerifyPath != NULL)
@@ -1409,6 +2235,12 @@ SslContext createSslContextFromFile(
 	case TLS_1_2_SECURITY_PROTOCOL:
 		handle = SSL_CTX_new(TLSv1_2_method());
 		break;
+	case DTLS_SECURITY_PROTOCOL:
+		handle = SSL_CTX_new(DTLS_method());
+		break;
+	case DTLS_1_2_SECURITY_PROTOCOL:
+		handle = SSL_CTX_new(DTLSv1_2_method());
+		break;
 	}
 
 	if (handle == NULL)
@@ -1417,6 +2249,17 @@ SslContext createSslContextFromFile(
 		return NULL;
 	}
 
+	if (securityProtocol == DTLS_SECURITY_PROTOCOL ||
+		securityProtocol == DTLS_1_2_SECURITY_PROTOCOL)
+	{
+		SSL_CTX_set_cookie_generate_cb(
+			handle,
+			generateDtlsCookie);
+		SSL_CTX_set_cookie_verify_cb(
+			handle,
+			verifyDtlsCookie);
+	}
+
 	int result;
 
 	if (certificateChain == true)
@@ -1497,9 +2340,269 @@ uint8_t getSslContextSecurityProtocol(SslContext context)
 		return TLS_SECURITY_PROTOCOL;
 	else if (method == TLSv1_2_method())
 		return TLS_1_2_SECURITY_PROTOCOL;
+	else if (method == DTLS_method())
+		return DTLS_SECURITY_PROTOCOL;
+	else if (method == DTLSv1_2_method())
+		return DTLS_1_2_SECURITY_PROTOCOL;
 	else
 		return UNKNOWN_SECURITY_PROTOCOL;
 #else
 	abort();
 #endif
 }
+
+DtlsSession createDtlsSession(
+	Socket socket,
+	SslContext sslContext,
+	SocketAddress remoteAddress,
+	bool isServer)
+{
+#if MPNW_HAS_OPENSSL
+	assert(socket != NULL);
+	assert(sslContext != NULL);
+	assert(getSocketType(socket) == DATAGRAM_SOCKET_TYPE);
+	assert(networkInitialized == true);
+
+	DtlsSession session = calloc(1,
+		sizeof(struct DtlsSession));
+
+	if (session == NULL)
+		return NULL;
+
+	SSL* ssl = SSL_new(
+		sslContext->handle);
+
+	if (ssl == NULL)
+	{
+		free(session);
+		return NULL;
+	}
+
+	BIO* bio = BIO_new(dtlsBioMethod);
+
+	if (bio == NULL)
+	{
+		SSL_free(ssl);
+		free(session);
+		return NULL;
+	}
+
+	BIO_set_data(
+		bio,
+		session);
+	SSL_set_bio(
+		ssl,
+		bio,
+		bio);
+	SSL_set_app_data(
+		ssl,
+		session);
+
+	// Packet size is fixed, BIO can not query path MTU
+	SSL_set_options(
+		ssl,
+		SSL_OP_NO_QUERY_MTU);
+	SSL_set_mtu(
+		ssl,
+		DTLS_PACKET_SIZE);
+
+	if (isServer == true)
+		SSL_set_accept_state(ssl);
+	else
+		SSL_set_connect_state(ssl);
+
+	if (remoteAddress != NULL)
+	{
+		session->address = *remoteAddress;
+		session->hasAddress = true;
+	}
+
+	session->socket = socket;
+	session->ssl = ssl;
+	return session;
+#else
+	abort();
+#endif
+}
+
+void destroyDtlsSession(DtlsSession session)
+{
+#if MPNW_HAS_OPENSSL
+	assert(networkInitialized == true);
+
+	if (session == NULL)
+		return;
+
+	if (SSL_is_init_finished(session->ssl) == 1)
+		SSL_shutdown(session->ssl);
+
+	SSL_free(session->ssl);
+	BIO_ADDR_free(session->listenAddress);
+	free(session);
+#else
+	abort();
+#endif
+}
+
+bool isDtlsSessionConnected(DtlsSession session)
+{
+#if MPNW_HAS_OPENSSL
+	assert(session != NULL);
+	assert(networkInitialized == true);
+	return SSL_is_init_finished(session->ssl) == 1;
+#else
+	abort();
+#endif
+}
+
+bool listenDtlsSession(
+	DtlsSession session,
+	SocketAddress address,
+	const uint8_t* buffer,
+	size_t count)
+{
+#if MPNW_HAS_OPENSSL
+	assert(session != NULL);
+	assert(address != NULL);
+	assert(buffer != NULL);
+	assert(SSL_is_server(session->ssl) == 1);
+	assert(networkInitialized == true);
+
+	BIO_ADDR* listenAddress = session->listenAddress;
+
+	if (listenAddress == NULL)
+	{
+		listenAddress = BIO_ADDR_new();
+
+		if (listenAddress == NULL)
+			return false;
+
+		session->listenAddress = listenAddress;
+	}
+
+	session->address = *address;
+	session->hasAddress = true;
+	session->receiveBuffer = buffer;
+	session->receiveCount = count;
+
+	int result = DTLSv1_listen(
+		session->ssl,
+		listenAddress);
+
+	session->receiveCount = 0;
+
+	if (result <= 0)
+	{
+		ERR_clear_error();
+		return false;
+	}
+
+	return true;
+#else
+	abort();
+#endif
+}
+
+bool dtlsSessionReceive(
+	DtlsSession session,
+	const uint8_t* datagram,
+	size_t count,
+	void* buffer,
+	size_t size,
+	size_t* byteCount)
+{
+#if MPNW_HAS_OPENSSL
+	assert(session != NULL);
+	assert(datagram != NULL || count == 0);
+	assert(buffer != NULL);
+	assert(byteCount != NULL);
+	assert(networkInitialized == true);
+
+	SSL* ssl = session->ssl;
+	session->receiveBuffer = datagram;
+	session->receiveCount = count;
+	*byteCount = 0;
+
+	int result;
+
+	if (SSL_is_init_finished(ssl) == 0)
+	{
+		result = SSL_do_handshake(ssl);
+
+		if (result <= 0)
+		{
+			session->receiveCount = 0;
+
+			int error = SSL_get_error(
+				ssl,
+				result);
+			ERR_clear_error();
+
+			return error == SSL_ERROR_WANT_READ ||
+				error == SSL_ERROR_WANT_WRITE;
+		}
+	}
+
+	result = SSL_read(
+		ssl,
+		buffer,
+		(int)size);
+
+	session->receiveCount = 0;
+
+	if (result > 0)
+	{
+		*byteCount = (size_t)result;
+		return true;
+	}
+
+	int error = SSL_get_error(
+		ssl,
+		result);
+	ERR_clear_error();
+
+	return error == SSL_ERROR_WANT_READ;
+#else
+	abort();
+#endif
+}
+
+bool dtlsSessionSend(
+	DtlsSession session,
+	const void* buffer,
+	size_t count)
+{
+#if MPNW_HAS_OPENSSL
+	assert(session != NULL);
+	assert(buffer != NULL);
+	assert(count != 0);
+	assert(networkInitialized == true);
+
+	SSL* ssl = session->ssl;
+
+	if (SSL_is_init_finished(ssl) == 0)
+		return false;
+
+	return SSL_write(
+		ssl,
+		buffer,
+		(int)count) == count;
+#else
+	abort();
+#endif
+}
+
+bool updateDtlsSession(DtlsSession session)
+{
+#if MPNW_HAS_OPENSSL
+	assert(session != NULL);
+	assert(networkInitialized == true);
+
+	if (SSL_is_init_finished(session->ssl) == 1)
+		return true;
+
+	return DTLSv1_handle_timeout(session->ssl) >= 0;
+#else
+	abort();
+#endif
+}
@@ -10,6 +10,15 @@ struct StreamClient
 	void* handle;
 	uint8_t* buffer;
 	Socket socket;
+	uint8_t framing;
+	uint8_t delimiter;
+	bool isChecksumming;
+	uint8_t compression;
+	size_t compressionThreshold;
+	uint8_t* packBuffer;
+	size_t packBufferSize;
+	uint64_t sendDataSize;
+	uint64_t sendPackedSize;
 };
 
 StreamClient createStreamClient(
@@ -89,6 +98,15 @@ StreamClient createStreamClient(
 	client->handle = handle;
 	client->buffer = buffer;
 	client->socket = socket;
+	client->framing = UINT8_STREAM_FRAMING;
+	client->delimiter = DEFAULT_STREAM_DELIMITER;
+	client->isChecksumming = false;
+	client->compression = NONE_STREAM_COMPRESSION;
+	client->compressionThreshold = 0;
+	client->packBuffer = NULL;
+	client->packBufferSize = 0;
+	client->sendDataSize = 0;
+	client->sendPackedSize = 0;
 	return client;
 }
 
@@ -103,6 +121,7 @@ void destroyStreamClient(StreamClient client)
 		client->socket,
 		RECEIVE_SEND_SOCKET_SHUTDOWN);
 	destroySocket(client->socket);
+	free(client->packBuffer);
 	free(client->buffer);
 	free(client);
 }
@@ -135,6 +154,109 @@ Socket getStreamClientSocket(StreamClient client)
 	return client->socket;
 }
 
+uint8_t getStreamClientFraming(StreamClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->framing;
+}
+
+void setStreamClientFraming(
+	StreamClient client,
+	uint8_t framing)
+{
+	assert(client != NULL);
+	assert(framing < STREAM_FRAMING_COUNT);
+	assert(isNetworkInitialized() == true);
+
+	assert(client->isChecksumming == false ||
+		framing != DELIMITER_STREAM_FRAMING);
+	assert(client->compression == NONE_STREAM_COMPRESSION ||
+		framing != DELIMITER_STREAM_FRAMING);
+
+	client->framing = framing;
+}
+
+uint8_t getStreamClientDelimiter(StreamClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->delimiter;
+}
+
+void setStreamClientDelimiter(
+	StreamClient client,
+	uint8_t delimiter)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	client->delimiter = delimiter;
+}
+
+bool isStreamClientChecksumming(StreamClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->isChecksumming;
+}
+
+void setStreamClientChecksumming(
+	StreamClient client,
+	bool value)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+
+	assert(value == false ||
+		client->framing != DELIMITER_STREAM_FRAMING);
+
+	client->isChecksumming = value;
+}
+
+uint8_t getStreamClientCompression(StreamClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->compression;
+}
+
+size_t getStreamClientCompressionThreshold(StreamClient client)
+{
+	assert(client != NULL);
+	assert(isNetworkInitialized() == true);
+	return client->compressionThreshold;
+}
+
+void setStreamClientCompression(
+	StreamClient client,
+	uint8_t compression,
+	size_t threshold)
+{
+	assert(client != NULL);
+	assert(compression < STREAM_COMPRESSION_COUNT);
+	assert(isNetworkInitialized() == true);
+
+	assert(compression == NONE_STREAM_COMPRESSION ||
+		client->framing != DELIMITER_STREAM_FRAMING);
+
+	client->compression = compression;
+	client->compressionThreshold = threshold;
+}
+
+void getStreamClientCompressionStats(
+	StreamClient client,
+	uint64_t* sendDataSize,
+	uint64_t* sendPackedSize)
+{
+	assert(client != NULL);
+	assert(sendDataSize != NULL);
+	assert(sendPackedSize != NULL);
+	assert(isNetworkInitialized() == true);
+
+	*sendDataSize = client->sendDataSize;
+	*sendPackedSize = client->sendPackedSize;
+}
+
 bool connectStreamClient(
 	StreamClient client,
 	SocketAddress address,
@@ -218,3 +340,83 @@ bool streamClientSend(
 		buffer,
 		count);
 }
+
+bool streamClientSendFrames(
+	StreamClient client,
+	const void** buffers,
+	const size_t* counts,
+	size_t frameCount)
+{
+	assert(client != NULL);
+	assert(buffers != NULL);
+	assert(counts != NULL);
+	assert(frameCount != 0);
+	assert(isNetworkInitialized() == true);
+
+	size_t totalCount;
+
+	bool result = getStreamFramesSize(
+		client->framing,
+		client->isChecksumming,
+		client->compression != NONE_STREAM_COMPRESSION,
+		counts,
+		frameCount,
+		&totalCount);
+
+	if (result == false)
+		return false;
+
+	StreamFrameBatch batch;
+
+	for (size_t i = 0; i < frameCount;)
+	{
+		i += packStreamFrames(
+			&batch,
+			client->framing,
+			client->delimiter,
+			client->isChecksumming,
+			client->compression,
+			client->compressionThreshold,
+			&client->packBuffer,
+			&client->packBufferSize,
+			buffers + i,
+			counts + i,
+			frameCount - i);
+
+		client->sendDataSize += batch.dataSize;
+		client->sendPackedSize += batch.packedSize;
+
+		size_t sentCount;
+
+		result = socketSendBuffers(
+			client->socket,
+			batch.buffers,
+			batch.counts,
+			batch.bufferCount,
+			&sentCount);
+
+		// Client has no send queue, rest of the partially
+		// sent frame would corrupt the stream, so it is closed
+		if (result == false || sentCount != batch.byteCount)
+		{
+			shutdownSocket(
+				client->socket,
+				RECEIVE_SEND_SOCKET_SHUTDOWN);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool streamClientSendFrame(
+	StreamClient client,
+	const void* buffer,
+	size_t count)
+{
+	return streamClientSendFrames(
+		client,
+		&buffer,
+		&count,
+		1);
+}
@@ -0,0 +1,1098 @@
+#include "mpnw/stream_decoder.h"
+#include "mpnw/checksum.h"
+#include "mpnw/compression.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MPNW_SSE2_DELIMITER_SCAN
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define MPNW_NEON_DELIMITER_SCAN
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+struct StreamDecoder
+{
+	size_t bufferSize;
+	uint8_t* buffer;
+	uint8_t* frameBuffer;
+	size_t readOffset;
+	size_t byteCount;
+	size_t scanCount;
+	uint64_t chunkSize;
+	uint64_t chunkOffset;
+	uint32_t chunkChecksum;
+	uint8_t framing;
+	uint8_t delimiter;
+	bool isChecksumming;
+	bool isChunkVerified;
+};
+
+inline static size_t getStreamFramingPrefixSize(uint8_t framing)
+{
+	switch (framing)
+	{
+	default:
+		abort();
+	case UINT8_STREAM_FRAMING:
+		return sizeof(uint8_t);
+	case UINT16_STREAM_FRAMING:
+		return sizeof(uint16_t);
+	case UINT32_STREAM_FRAMING:
+		return sizeof(uint32_t);
+	case UINT64_STREAM_FRAMING:
+		return sizeof(uint64_t);
+	case VARINT_STREAM_FRAMING:
+		return sizeof(uint8_t);
+	case DELIMITER_STREAM_FRAMING:
+		return 0;
+	}
+}
+inline static uint64_t decodeStreamFixedPrefix(
+	uint8_t framing,
+	const uint8_t* prefix)
+{
+	return decodeStreamDatagramSize(
+		prefix,
+		getStreamFramingPrefixSize(framing));
+}
+
+StreamDecoder createStreamDecoder(
+	uint8_t framing,
+	size_t bufferSize)
+{
+	assert(framing < STREAM_FRAMING_COUNT);
+	assert(bufferSize > getStreamFramingPrefixSize(framing));
+
+	StreamDecoder decoder = malloc(
+		sizeof(struct StreamDecoder));
+
+	if (decoder == NULL)
+		return NULL;
+
+	uint8_t* buffer = malloc(
+		bufferSize * sizeof(uint8_t));
+
+	if (buffer == NULL)
+	{
+		free(decoder);
+		return NULL;
+	}
+
+	decoder->bufferSize = bufferSize;
+	decoder->buffer = buffer;
+	decoder->frameBuffer = NULL;
+	decoder->readOffset = 0;
+	decoder->byteCount = 0;
+	decoder->scanCount = 0;
+	decoder->chunkSize = 0;
+	decoder->chunkOffset = 0;
+	decoder->chunkChecksum = 0;
+	decoder->framing = framing;
+	decoder->delimiter = DEFAULT_STREAM_DELIMITER;
+	decoder->isChecksumming = false;
+	decoder->isChunkVerified = false;
+	return decoder;
+}
+
+void destroyStreamDecoder(StreamDecoder decoder)
+{
+	if (decoder == NULL)
+		return;
+
+	free(decoder->frameBuffer);
+	free(decoder->buffer);
+	free(decoder);
+}
+
+uint8_t getStreamDecoderFraming(StreamDecoder decoder)
+{
+	assert(decoder != NULL);
+	return decoder->framing;
+}
+
+size_t getStreamDecoderBufferSize(StreamDecoder decoder)
+{
+	assert(decoder != NULL);
+	return decoder->bufferSize;
+}
+
+uint8_t getStreamDecoderDelimiter(StreamDecoder decoder)
+{
+	assert(decoder != NULL);
+	return decoder->delimiter;
+}
+
+void setStreamDecoderDelimiter(
+	StreamDecoder decoder,
+	uint8_t delimiter)
+{
+	assert(decoder != NULL);
+	decoder->delimiter = delimiter;
+	decoder->scanCount = 0;
+}
+
+bool isStreamDecoderChecksumming(StreamDecoder decoder)
+{
+	assert(decoder != NULL);
+	return decoder->isChecksumming;
+}
+
+void setStreamDecoderChecksumming(
+	StreamDecoder decoder,
+	bool value)
+{
+	assert(decoder != NULL);
+
+	assert(value == false || (
+		decoder->framing != DELIMITER_STREAM_FRAMING &&
+		decoder->bufferSize > sizeof(uint32_t) +
+		getStreamFramingPrefixSize(decoder->framing)));
+
+	decoder->isChecksumming = value;
+}
+
+size_t getStreamDecoderByteCount(StreamDecoder decoder)
+{
+	assert(decoder != NULL);
+	return decoder->byteCount;
+}
+
+inline static uint8_t* getStreamDecoderWriteBuffer(
+	StreamDecoder decoder,
+	size_t* size)
+{
+	size_t bufferSize = decoder->bufferSize;
+	size_t readOffset = decoder->readOffset;
+	size_t writeOffset = readOffset + decoder->byteCount;
+
+	// Free space is either after the data or before the read offset
+	if (writeOffset >= bufferSize)
+	{
+		writeOffset -= bufferSize;
+		*size = readOffset - writeOffset;
+	}
+	else
+	{
+		*size = bufferSize - writeOffset;
+	}
+
+	return decoder->buffer + writeOffset;
+}
+
+bool streamDecoderReceive(
+	StreamDecoder decoder,
+	Socket socket,
+	size_t* count)
+{
+	assert(decoder != NULL);
+	assert(socket != NULL);
+	assert(count != NULL);
+
+	size_t size;
+
+	uint8_t* buffer = getStreamDecoderWriteBuffer(
+		decoder,
+		&size);
+
+	// Full buffer without a complete datagram
+	if (size == 0)
+		return false;
+
+	bool result = socketReceive(
+		socket,
+		buffer,
+		size,
+		count);
+
+	if (result == false)
+		return false;
+
+	decoder->byteCount += *count;
+	return true;
+}
+
+bool streamDecoderWrite(
+	StreamDecoder decoder,
+	const void* _buffer,
+	size_t count)
+{
+	assert(decoder != NULL);
+	assert(_buffer != NULL);
+
+	if (count > decoder->bufferSize - decoder->byteCount)
+		return false;
+
+	const uint8_t* buffer = _buffer;
+
+	while (count != 0)
+	{
+		size_t size;
+
+		uint8_t* writeBuffer = getStreamDecoderWriteBuffer(
+			decoder,
+			&size);
+
+		if (size > count)
+			size = count;
+
+		memcpy(
+			writeBuffer,
+			buffer,
+			size);
+
+		decoder->byteCount += size;
+		buffer += size;
+		count -= size;
+	}
+
+	return true;
+}
+
+inline static void readStreamDecoder(
+	StreamDecoder decoder,
+	size_t offset,
+	uint8_t* destination,
+	size_t count)
+{
+	size_t bufferSize = decoder->bufferSize;
+	size_t partSize = bufferSize - offset;
+
+	if (partSize > count)
+		partSize = count;
+
+	memcpy(
+		destination,
+		decoder->buffer + offset,
+		partSize);
+	memcpy(
+		destination + partSize,
+		decoder->buffer,
+		count - partSize);
+}
+
+// Prefix size is set to 0, if prefix is not fully received yet
+static bool readStreamVarintPrefix(
+	StreamDecoder decoder,
+	size_t readOffset,
+	size_t byteCount,
+	uint64_t* datagramSize,
+	size_t* prefixSize)
+{
+	size_t contiguousSize = decoder->bufferSize - readOffset;
+
+	if (contiguousSize > byteCount)
+		contiguousSize = byteCount;
+
+	// Whole prefix is usually available in place
+	size_t size = decodeStreamVarint(
+		decoder->buffer + readOffset,
+		contiguousSize,
+		datagramSize);
+
+	size_t availableSize = byteCount < MAX_STREAM_VARINT_SIZE ?
+		byteCount : MAX_STREAM_VARINT_SIZE;
+
+	if (size == 0 && contiguousSize < availableSize)
+	{
+		uint8_t prefix[MAX_STREAM_VARINT_SIZE];
+
+		readStreamDecoder(
+			decoder,
+			readOffset,
+			prefix,
+			availableSize);
+
+		size = decodeStreamVarint(
+			prefix,
+			availableSize,
+			datagramSize);
+	}
+
+	if (size == 0 && availableSize == MAX_STREAM_VARINT_SIZE)
+		return false;
+
+	*prefixSize = size;
+	return true;
+}
+
+// Checksum trailer follows the datagram data
+static bool verifyStreamDecoderChecksum(
+	StreamDecoder decoder,
+	size_t offset,
+	size_t size,
+	uint32_t checksum)
+{
+	size_t bufferSize = decoder->bufferSize;
+	size_t partSize = bufferSize - offset;
+
+	if (partSize > size)
+		partSize = size;
+
+	checksum = updateCrc32c(
+		checksum,
+		decoder->buffer + offset,
+		partSize);
+	checksum = updateCrc32c(
+		checksum,
+		decoder->buffer,
+		size - partSize);
+
+	offset += size;
+
+	if (offset >= bufferSize)
+		offset -= bufferSize;
+
+	uint32_t trailer;
+
+	readStreamDecoder(
+		decoder,
+		offset,
+		(uint8_t*)&trailer,
+		sizeof(uint32_t));
+
+	return netToHost32(trailer) == checksum;
+}
+
+// Wrapped datagrams are copied to the separate buffer
+static bool getStreamDecoderDatagram(
+	StreamDecoder decoder,
+	size_t offset,
+	size_t size,
+	const uint8_t** datagram)
+{
+	size_t bufferSize = decoder->bufferSize;
+
+	if (offset + size <= bufferSize)
+	{
+		*datagram = decoder->buffer + offset;
+		return true;
+	}
+
+	uint8_t* frameBuffer = decoder->frameBuffer;
+
+	if (frameBuffer == NULL)
+	{
+		frameBuffer = malloc(
+			bufferSize * sizeof(uint8_t));
+
+		if (frameBuffer == NULL)
+			return false;
+
+		decoder->frameBuffer = frameBuffer;
+	}
+
+	readStreamDecoder(
+		decoder,
+		offset,
+		frameBuffer,
+		size);
+
+	*datagram = frameBuffer;
+	return true;
+}
+
+inline static size_t getLowestBitIndex(uint32_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return index;
+#else
+	return (size_t)__builtin_ctz(value);
+#endif
+}
+
+// Returns delimiter index, or size if it is not found
+static size_t findStreamDelimiter(
+	const uint8_t* buffer,
+	size_t size,
+	uint8_t delimiter)
+{
+	size_t offset = 0;
+
+#if defined(__AVX2__)
+	__m256i delimiters256 = _mm256_set1_epi8((char)delimiter);
+
+	while (size - offset >= 32)
+	{
+		__m256i data = _mm256_loadu_si256(
+			(const __m256i*)(buffer + offset));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(data, delimiters256));
+
+		if (mask != 0)
+			return offset + getLowestBitIndex(mask);
+
+		offset += 32;
+	}
+#endif
+
+#if defined(MPNW_SSE2_DELIMITER_SCAN)
+	__m128i delimiters = _mm_set1_epi8((char)delimiter);
+
+	while (size - offset >= 16)
+	{
+		__m128i data = _mm_loadu_si128(
+			(const __m128i*)(buffer + offset));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(data, delimiters));
+
+		if (mask != 0)
+			return offset + getLowestBitIndex(mask);
+
+		offset += 16;
+	}
+#elif defined(MPNW_NEON_DELIMITER_SCAN)
+	uint8x16_t delimiters = vdupq_n_u8(delimiter);
+
+	while (size - offset >= 16)
+	{
+		uint8x16_t data = vld1q_u8(buffer + offset);
+		uint8x16_t equal = vceqq_u8(data, delimiters);
+
+		// Narrows comparison result to the 4 bits per byte mask
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(
+			vreinterpretq_u16_u8(equal), 4)), 0);
+
+		if (mask != 0)
+			return offset + ((size_t)__builtin_ctzll(mask) >> 2);
+
+		offset += 16;
+	}
+#endif
+
+	for (; offset < size; offset++)
+	{
+		if (buffer[offset] == delimiter)
+			return offset;
+	}
+
+	return size;
+}
+
+static bool decodeStreamDelimitedDatagrams(
+	StreamDecoder decoder,
+	OnStreamDecoderDatagram onDatagram,
+	void* handle)
+{
+	uint8_t delimiter = decoder->delimiter;
+	uint8_t* buffer = decoder->buffer;
+	size_t bufferSize = decoder->bufferSize;
+	size_t readOffset = decoder->readOffset;
+	size_t byteCount = decoder->byteCount;
+	size_t scanCount = decoder->scanCount;
+	bool result = true;
+
+	// Already scanned datagram part is not scanned again
+	while (scanCount < byteCount)
+	{
+		size_t scanOffset = readOffset + scanCount;
+
+		if (scanOffset >= bufferSize)
+			scanOffset -= bufferSize;
+
+		size_t scanSize = byteCount - scanCount;
+
+		if (scanSize > bufferSize - scanOffset)
+			scanSize = bufferSize - scanOffset;
+
+		size_t index = findStreamDelimiter(
+			buffer + scanOffset,
+			scanSize,
+			delimiter);
+
+		scanCount += index;
+
+		if (index == scanSize)
+			continue;
+
+		size_t datagramSize = scanCount;
+		const uint8_t* datagram;
+
+		result = getStreamDecoderDatagram(
+			decoder,
+			readOffset,
+			datagramSize,
+			&datagram);
+
+		if (result == false)
+			break;
+
+		// Strip carriage return of the CRLF line ending
+		if (delimiter == '\n' && datagramSize != 0 &&
+			datagram[datagramSize - 1] == '\r')
+		{
+			datagramSize--;
+		}
+
+		size_t frameSize = scanCount + 1;
+		readOffset += frameSize;
+		byteCount -= frameSize;
+		scanCount = 0;
+
+		if (readOffset >= bufferSize)
+			readOffset -= bufferSize;
+
+		result = onDatagram(
+			datagram,
+			datagramSize,
+			handle);
+
+		if (result == false)
+			break;
+	}
+
+	// Datagram is longer than the maximum size
+	if (byteCount == bufferSize)
+		result = false;
+
+	if (byteCount == 0)
+		readOffset = 0;
+
+	decoder->readOffset = readOffset;
+	decoder->byteCount = byteCount;
+	decoder->scanCount = scanCount;
+	return result;
+}
+
+bool decodeStreamDatagrams(
+	StreamDecoder decoder,
+	OnStreamDecoderDatagram onDatagram,
+	OnStreamDecoderChunk onChunk,
+	void* handle)
+{
+	assert(decoder != NULL);
+	assert(onDatagram != NULL);
+
+	uint8_t framing = decoder->framing;
+
+	if (framing == DELIMITER_STREAM_FRAMING)
+	{
+		return decodeStreamDelimitedDatagrams(
+			decoder,
+			onDatagram,
+			handle);
+	}
+
+	uint8_t* buffer = decoder->buffer;
+	size_t bufferSize = decoder->bufferSize;
+	size_t readOffset = decoder->readOffset;
+	size_t byteCount = decoder->byteCount;
+	uint64_t chunkSize = decoder->chunkSize;
+	uint64_t chunkOffset = decoder->chunkOffset;
+	uint32_t chunkChecksum = decoder->chunkChecksum;
+	bool isChunkVerified = decoder->isChunkVerified;
+	size_t minPrefixSize = getStreamFramingPrefixSize(framing);
+
+	size_t checksumSize = decoder->isChecksumming == true ?
+		sizeof(uint32_t) : 0;
+
+	bool result = true;
+
+	while (true)
+	{
+		// Oversized datagram parts are passed directly from the buffer
+		if (chunkOffset < chunkSize)
+		{
+			if (byteCount == 0)
+				break;
+
+			uint64_t remainingSize = chunkSize - chunkOffset;
+			size_t partSize = bufferSize - readOffset;
+
+			if (partSize > byteCount)
+				partSize = byteCount;
+			if (partSize > remainingSize)
+				partSize = (size_t)remainingSize;
+
+			// Last part is passed only after the checksum verification
+			if (checksumSize != 0 && isChunkVerified == false)
+			{
+				if (byteCount < remainingSize + checksumSize)
+				{
+					if (partSize == remainingSize)
+						partSize--;
+					if (partSize == 0)
+						break;
+				}
+				else
+				{
+					result = verifyStreamDecoderChecksum(
+						decoder,
+						readOffset,
+						(size_t)remainingSize,
+						chunkChecksum);
+
+					if (result == false)
+						break;
+
+					isChunkVerified = true;
+				}
+
+				if (isChunkVerified == false)
+				{
+					chunkChecksum = updateCrc32c(
+						chunkChecksum,
+						buffer + readOffset,
+						partSize);
+				}
+			}
+
+			const uint8_t* chunk = buffer + readOffset;
+			uint64_t offset = chunkOffset;
+
+			chunkOffset += partSize;
+			readOffset += partSize;
+			byteCount -= partSize;
+
+			// Verified checksum trailer is skipped
+			if (chunkOffset == chunkSize && checksumSize != 0)
+			{
+				readOffset += checksumSize;
+				byteCount -= checksumSize;
+				isChunkVerified = false;
+			}
+
+			if (readOffset >= bufferSize)
+				readOffset -= bufferSize;
+
+			result = onChunk(
+				chunk,
+				partSize,
+				chunkSize,
+				offset,
+				handle);
+
+			if (result == false)
+				break;
+
+			continue;
+		}
+
+		if (byteCount < minPrefixSize)
+			break;
+
+		uint64_t datagramSize;
+		size_t prefixSize = minPrefixSize;
+
+		if (framing == VARINT_STREAM_FRAMING)
+		{
+			result = readStreamVarintPrefix(
+				decoder,
+				readOffset,
+				byteCount,
+				&datagramSize,
+				&prefixSize);
+
+			if (result == false || prefixSize == 0)
+				break;
+		}
+		else if (readOffset + prefixSize <= bufferSize)
+		{
+			datagramSize = decodeStreamFixedPrefix(
+				framing,
+				buffer + readOffset);
+		}
+		else
+		{
+			// Datagram size prefix is split by the buffer end
+			uint8_t prefix[sizeof(uint64_t)];
+
+			readStreamDecoder(
+				decoder,
+				readOffset,
+				prefix,
+				prefixSize);
+			datagramSize = decodeStreamFixedPrefix(
+				framing,
+				prefix);
+		}
+
+		// Datagram size includes checksum trailer
+		if (datagramSize < checksumSize)
+		{
+			result = false;
+			break;
+		}
+
+		// Datagram will never fit the buffer
+		if (datagramSize > bufferSize - prefixSize)
+		{
+			if (onChunk == NULL)
+			{
+				result = false;
+				break;
+			}
+
+			readOffset += prefixSize;
+			byteCount -= prefixSize;
+
+			if (readOffset >= bufferSize)
+				readOffset -= bufferSize;
+
+			chunkSize = datagramSize - checksumSize;
+			chunkOffset = 0;
+			chunkChecksum = 0;
+			continue;
+		}
+
+		if (datagramSize > byteCount - prefixSize)
+			break;
+
+		size_t frameSize = prefixSize + (size_t)datagramSize;
+		size_t datagramOffset = readOffset + prefixSize;
+
+		if (datagramOffset >= bufferSize)
+			datagramOffset -= bufferSize;
+
+		datagramSize -= checksumSize;
+
+		if (checksumSize != 0)
+		{
+			result = verifyStreamDecoderChecksum(
+				decoder,
+				datagramOffset,
+				(size_t)datagramSize,
+				0);
+
+			if (result == false)
+				break;
+		}
+
+		const uint8_t* datagram;
+
+		result = getStreamDecoderDatagram(
+			decoder,
+			datagramOffset,
+			(size_t)datagramSize,
+			&datagram);
+
+		if (result == false)
+			break;
+
+		readOffset += frameSize;
+		byteCount -= frameSize;
+
+		if (readOffset >= bufferSize)
+			readOffset -= bufferSize;
+
+		result = onDatagram(
+			datagram,
+			(size_t)datagramSize,
+			handle);
+
+		if (result == false)
+			break;
+	}
+
+	// Empty buffer gets the whole contiguous space back
+	if (byteCount == 0)
+		readOffset = 0;
+
+	decoder->readOffset = readOffset;
+	decoder->byteCount = byteCount;
+	decoder->chunkSize = chunkSize;
+	decoder->chunkOffset = chunkOffset;
+	decoder->chunkChecksum = chunkChecksum;
+	decoder->isChunkVerified = isChunkVerified;
+	return result;
+}
+
+size_t packStreamDatagram(
+	const void* buffer,
+	size_t count,
+	size_t threshold,
+	uint8_t* header,
+	uint8_t* packBuffer,
+	const void** data,
+	size_t* dataSize)
+{
+	assert(buffer != NULL);
+	assert(header != NULL);
+	assert(data != NULL);
+	assert(dataSize != NULL);
+
+	if (packBuffer != NULL && count >= threshold)
+	{
+		size_t packSize = compressLz4Block(
+			buffer,
+			count,
+			packBuffer,
+			count);
+
+		size_t headerSize = 1 + encodeStreamVarint(
+			count,
+			header + 1);
+
+		// Compression should save at least the size header
+		if (packSize != 0 && packSize + headerSize <= count)
+		{
+			header[0] = LZ4_STREAM_COMPRESSION;
+			*data = packBuffer;
+			*dataSize = packSize;
+			return headerSize;
+		}
+	}
+
+	header[0] = NONE_STREAM_COMPRESSION;
+	*data = buffer;
+	*dataSize = count;
+	return 1;
+}
+
+bool unpackStreamDatagram(
+	const uint8_t* buffer,
+	size_t byteCount,
+	uint8_t* unpackBuffer,
+	size_t unpackBufferSize,
+	const uint8_t** data,
+	size_t* dataSize)
+{
+	assert(buffer != NULL);
+	assert(unpackBuffer != NULL);
+	assert(data != NULL);
+	assert(dataSize != NULL);
+
+	if (byteCount == 0)
+		return false;
+
+	uint8_t compression = buffer[0];
+
+	if (compression == NONE_STREAM_COMPRESSION)
+	{
+		*data = buffer + 1;
+		*dataSize = byteCount - 1;
+		return true;
+	}
+	if (compression != LZ4_STREAM_COMPRESSION)
+		return false;
+
+	uint64_t size;
+
+	size_t sizeSize = decodeStreamVarint(
+		buffer + 1,
+		byteCount - 1,
+		&size);
+
+	if (sizeSize == 0 || size > unpackBufferSize)
+		return false;
+
+	size_t headerSize = 1 + sizeSize;
+
+	bool result = decompressLz4Block(
+		buffer + headerSize,
+		byteCount - headerSize,
+		unpackBuffer,
+		(size_t)size);
+
+	if (result == false)
+		return false;
+
+	*data = unpackBuffer;
+	*dataSize = (size_t)size;
+	return true;
+}
+
+bool getStreamFramesSize(
+	uint8_t framing,
+	bool isChecksumming,
+	bool isCompressing,
+	const size_t* counts,
+	size_t frameCount,
+	size_t* totalCount)
+{
+	assert(framing < STREAM_FRAMING_COUNT);
+	assert(counts != NULL);
+	assert(totalCount != NULL);
+
+	size_t checksumSize = isChecksumming == true ?
+		sizeof(uint32_t) : 0;
+	size_t trailerSize = framing == DELIMITER_STREAM_FRAMING ?
+		sizeof(uint8_t) : checksumSize;
+	size_t packHeaderSize = isCompressing == true ? 1 : 0;
+
+	uint8_t header[MAX_STREAM_FRAME_HEADER_SIZE];
+	size_t size = 0;
+
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		size_t count = counts[i] + packHeaderSize;
+		size_t headerSize;
+
+		bool result = encodeStreamFrameHeader(
+			framing,
+			count + checksumSize,
+			header,
+			&headerSize);
+
+		if (result == false)
+			return false;
+
+		size += headerSize + count + trailerSize;
+	}
+
+	*totalCount = size;
+	return true;
+}
+
+// Compressed batch datagrams are stored in the pack buffer
+static uint8_t* reserveStreamPackBuffer(
+	uint8_t** packBuffer,
+	size_t* packBufferSize,
+	size_t size)
+{
+	if (size <= *packBufferSize)
+		return *packBuffer;
+
+	uint8_t* buffer = realloc(
+		*packBuffer,
+		size * sizeof(uint8_t));
+
+	if (buffer == NULL)
+		return NULL;
+
+	*packBuffer = buffer;
+	*packBufferSize = size;
+	return buffer;
+}
+
+size_t packStreamFrames(
+	StreamFrameBatch* batch,
+	uint8_t framing,
+	uint8_t delimiter,
+	bool isChecksumming,
+	uint8_t compression,
+	size_t compressionThreshold,
+	uint8_t** packBuffer,
+	size_t* packBufferSize,
+	const void** buffers,
+	const size_t* counts,
+	size_t frameCount)
+{
+	assert(batch != NULL);
+	assert(framing < STREAM_FRAMING_COUNT);
+	assert(compression < STREAM_COMPRESSION_COUNT);
+	assert(packBuffer != NULL);
+	assert(packBufferSize != NULL);
+	assert(buffers != NULL);
+	assert(counts != NULL);
+	assert(frameCount != 0);
+
+	bool isCompressing = compression != NONE_STREAM_COMPRESSION;
+
+	size_t checksumSize = isChecksumming == true ?
+		sizeof(uint32_t) : 0;
+	size_t trailerSize = framing == DELIMITER_STREAM_FRAMING ?
+		sizeof(uint8_t) : checksumSize;
+
+	if (frameCount > STREAM_FRAME_BATCH_SIZE)
+		frameCount = STREAM_FRAME_BATCH_SIZE;
+
+	uint8_t* packData = NULL;
+
+	if (isCompressing == true)
+	{
+		size_t packSize = 0;
+
+		for (size_t i = 0; i < frameCount; i++)
+			packSize += counts[i];
+
+		// Batch is packed uncompressed on allocation failure
+		packData = reserveStreamPackBuffer(
+			packBuffer,
+			packBufferSize,
+			packSize);
+	}
+
+	const void** sendBuffers = batch->buffers;
+	size_t* sendCounts = batch->counts;
+	size_t bufferCount = 0;
+	size_t byteCount = 0;
+
+	batch->dataSize = 0;
+	batch->packedSize = 0;
+	batch->delimiter = delimiter;
+
+	// Header and trailer are sent with the payload in one call
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		assert(buffers[i] != NULL);
+
+		const void* data = buffers[i];
+		size_t count = counts[i];
+		size_t packSize = 0;
+
+		if (isCompressing == true)
+		{
+			packSize = packStreamDatagram(
+				data,
+				count,
+				compressionThreshold,
+				batch->packHeaders[i],
+				packData,
+				&data,
+				&count);
+
+			if (data == packData)
+				packData += count;
+
+			batch->dataSize += counts[i];
+			batch->packedSize += packSize + count;
+		}
+
+		size_t headerSize;
+
+		encodeStreamFrameHeader(
+			framing,
+			packSize + count + checksumSize,
+			batch->headers[i],
+			&headerSize);
+
+		if (headerSize != 0)
+		{
+			sendBuffers[bufferCount] = batch->headers[i];
+			sendCounts[bufferCount++] = headerSize;
+		}
+		if (packSize != 0)
+		{
+			sendBuffers[bufferCount] = batch->packHeaders[i];
+			sendCounts[bufferCount++] = packSize;
+		}
+		if (count != 0)
+		{
+			sendBuffers[bufferCount] = data;
+			sendCounts[bufferCount++] = count;
+		}
+
+		if (isChecksumming == true)
+		{
+			uint32_t checksum = updateCrc32c(
+				0,
+				batch->packHeaders[i],
+				packSize);
+			checksum = updateCrc32c(
+				checksum,
+				data,
+				count);
+
+			batch->trailers[i] = hostToNet32(checksum);
+			sendBuffers[bufferCount] = &batch->trailers[i];
+			sendCounts[bufferCount++] = trailerSize;
+		}
+		else if (trailerSize != 0)
+		{
+			sendBuffers[bufferCount] = &batch->delimiter;
+			sendCounts[bufferCount++] = trailerSize;
+		}
+
+		byteCount += headerSize + packSize + count + trailerSize;
+	}
+
+	batch->bufferCount = bufferCount;
+	batch->byteCount = byteCount;
+	return frameCount;
+}
@@ -1,33 +1,193 @@
 #include "mpnw/stream_server.h"
 #include <stdio.h>
 
+// Session slot and inline session data alignment
+#define STREAM_SESSION_ALIGNMENT 16
+
+// Session state flags, stored separately from the cold session data
+typedef enum StreamSessionState
+{
+	SSL_ACCEPTED_STREAM_SESSION_STATE = 1 << 0,
+	SEND_PENDING_STREAM_SESSION_STATE = 1 << 1,
+	FAILED_STREAM_SESSION_STATE = 1 << 2,
+} StreamSessionState;
+
 struct StreamSession
 {
-	Socket receiveSocket;
+	StreamServer server;
 	void* handle;
-	bool isSslAccepted;
+	size_t chunkIndex;
+	size_t index;
+	uint8_t* sendBuffer;
+	size_t sendOffset;
+	size_t sendCount;
+	bool isSendHigh;
+	uint64_t sendDataSize;
+	uint64_t sendPackedSize;
+	uint64_t receiveDataSize;
+	uint64_t receivePackedSize;
 };
 
 struct StreamServer
 {
 	size_t sessionBufferSize;
+	size_t sessionChunkSize;
+	size_t sessionDataSize;
 	size_t receiveBufferSize;
+	size_t sendBufferSize;
+	size_t lowWatermark;
+	size_t highWatermark;
+	OnStreamSessionWatermark onWatermark;
+	bool isCoalescing;
+	uint8_t framing;
+	uint8_t delimiter;
+	bool isChecksumming;
+	uint8_t compression;
+	size_t compressionThreshold;
+	size_t frameBufferSize;
+	uint8_t* packBuffer;
+	size_t packBufferSize;
+	uint8_t* unpackBuffer;
 	OnStreamSessionCreate onCreate;
 	OnStreamSessionDestroy onDestroy;
 	OnStreamSessionReceive onReceive;
+	OnStreamSessionChunk onChunk;
 	OnStreamSessionUpdate onUpdate;
 	void* handle;
 	uint8_t* receiveBuffer;
-	StreamSession sessionBuffer;
+	// Hot session data, iterated every update,
+	// sockets are stored in place without the indirection
+	uint8_t* socketBuffer;
+	StreamDecoder* decoderBuffer;
+	uint8_t* stateBuffer;
+	StreamSession* sessionBuffer;
+	size_t socketSize;
+	// Cold session data, allocated in chunks of slots
+	uint8_t** chunkBuffer;
+	size_t* chunkSessionCounts;
+	size_t chunkBufferSize;
+	size_t sessionSlotSize;
+	size_t sessionCapacity;
 	size_t sessionCount;
+	size_t peakSessionCapacity;
+	size_t peakSessionCount;
+	size_t pauseCount;
+	size_t rejectCount;
+	uint8_t admission;
 	Socket acceptSocket;
 };
 
+inline static size_t alignStreamSessionSize(size_t size)
+{
+	return (size + (STREAM_SESSION_ALIGNMENT - 1)) &
+		~((size_t)STREAM_SESSION_ALIGNMENT - 1);
+}
+inline static size_t getStreamSessionSlotSize(size_t dataSize)
+{
+	return alignStreamSessionSize(sizeof(struct StreamSession)) +
+		alignStreamSessionSize(dataSize);
+}
+
+inline static Socket getStreamServerSessionSocket(
+	StreamServer server,
+	size_t index)
+{
+	return (Socket)(server->socketBuffer +
+		index * server->socketSize);
+}
+
+inline static size_t getStreamSessionChunkSlotCount(
+	StreamServer server,
+	size_t chunkIndex)
+{
+	size_t chunkSize = server->sessionChunkSize;
+	size_t offset = chunkIndex * chunkSize;
+	size_t slotCount = server->sessionBufferSize - offset;
+	return slotCount < chunkSize ? slotCount : chunkSize;
+}
+
+static bool allocateStreamSessionChunk(StreamServer server)
+{
+	uint8_t** chunkBuffer = server->chunkBuffer;
+	size_t chunkBufferSize = server->chunkBufferSize;
+	size_t chunkIndex = 0;
+
+	// Reuse the first released chunk place
+	while (chunkIndex < chunkBufferSize &&
+		chunkBuffer[chunkIndex] != NULL)
+	{
+		chunkIndex++;
+	}
+
+	if (chunkIndex == chunkBufferSize)
+		return false;
+
+	size_t slotSize = server->sessionSlotSize;
+
+	size_t slotCount = getStreamSessionChunkSlotCount(
+		server,
+		chunkIndex);
+
+	uint8_t* chunk = malloc(
+		slotCount * slotSize);
+
+	if (chunk == NULL)
+		return false;
+
+	StreamSession* sessionBuffer = server->sessionBuffer;
+	size_t sessionCapacity = server->sessionCapacity;
+
+	// New slots are appended to the free part of the session buffer
+	for (size_t i = 0; i < slotCount; i++)
+	{
+		StreamSession session = (StreamSession)(
+			chunk + i * slotSize);
+		session->chunkIndex = chunkIndex;
+		sessionBuffer[sessionCapacity + i] = session;
+	}
+
+	sessionCapacity += slotCount;
+
+	if (sessionCapacity > server->peakSessionCapacity)
+		server->peakSessionCapacity = sessionCapacity;
+
+	chunkBuffer[chunkIndex] = chunk;
+	server->chunkSessionCounts[chunkIndex] = 0;
+	server->sessionCapacity = sessionCapacity;
+	return true;
+}
+static void releaseStreamSessionChunk(
+	StreamServer server,
+	size_t chunkIndex)
+{
+	StreamSession* sessionBuffer = server->sessionBuffer;
+	size_t sessionCapacity = server->sessionCapacity;
+	size_t freeIndex = server->sessionCount;
+
+	assert(server->chunkSessionCounts[chunkIndex] == 0);
+
+	// Slots past the session count are free, remove chunk ones
+	for (size_t i = freeIndex; i < sessionCapacity; i++)
+	{
+		StreamSession session = sessionBuffer[i];
+
+		if (session->chunkIndex != chunkIndex)
+			sessionBuffer[freeIndex++] = session;
+	}
+
+	free(server->chunkBuffer[chunkIndex]);
+	server->chunkBuffer[chunkIndex] = NULL;
+	server->sessionCapacity = freeIndex;
+}
+
 StreamServer createStreamServer(
 	uint8_t addressFamily,
 	const char* service,
 	size_t sessionBufferSize,
+	size_t sessionChunkSize,
+	size_t sessionDataSize,
 	size_t receiveBufferSize,
+	size_t sendBufferSize,
 	OnStreamSessionCreate onCreate,
 	OnStreamSessionDestroy onDestroy,
 	OnStreamSessionUpdate onUpdate,
@@ -37,6 +197,8 @@ StreamServer createStreamServer(
 {
 	assert(addressFamily < ADDRESS_FAMILY_COUNT);
 	assert(sessionBufferSize != 0);
+	assert(sessionChunkSize != 0);
+	assert(sessionChunkSize <= sessionBufferSize);
 	assert(receiveBufferSize != 0);
 	assert(onCreate != NULL);
 	assert(onDestroy != NULL);
@@ -59,11 +221,78 @@ StreamServer createStreamServer(
 		return NULL;
 	}
 
-	StreamSession sessionBuffer = malloc(
-		sessionBufferSize * sizeof(struct StreamSession));
+	size_t socketSize = getSocketInstanceSize();
+
+	// Hot arrays share one allocation: sockets, slot pointers,
+	// decoders and states, instance size keeps pointer alignment
+	uint8_t* hotBuffer = malloc(sessionBufferSize * (socketSize +
+		sizeof(StreamSession) + sizeof(StreamDecoder) + sizeof(uint8_t)));
+
+	if (hotBuffer == NULL)
+	{
+		free(receiveBuffer);
+		free(server);
+		return NULL;
+	}
+
+	size_t chunkBufferSize = (sessionBufferSize +
+		(sessionChunkSize - 1)) / sessionChunkSize;
+
+	uint8_t** chunkBuffer = calloc(
+		chunkBufferSize,
+		sizeof(uint8_t*));
+
+	if (chunkBuffer == NULL)
+	{
+		free(hotBuffer);
+		free(receiveBuffer);
+		free(server);
+		return NULL;
+	}
+
+	size_t* chunkSessionCounts = calloc(
+		chunkBufferSize,
+		sizeof(size_t));
+
+	if (chunkSessionCounts == NULL)
+	{
+		free(chunkBuffer);
+		free(hotBuffer);
+		free(receiveBuffer);
+		free(server);
+		return NULL;
+	}
+
+	StreamSession* sessionBuffer = (StreamSession*)(
+		hotBuffer + sessionBufferSize * socketSize);
+	StreamDecoder* decoderBuffer = (StreamDecoder*)(
+		sessionBuffer + sessionBufferSize);
+	uint8_t* stateBuffer = (uint8_t*)(
+		decoderBuffer + sessionBufferSize);
+
+	server->sessionBufferSize = sessionBufferSize;
+	server->sessionChunkSize = sessionChunkSize;
+	server->sessionBuffer = sessionBuffer;
+	server->chunkBuffer = chunkBuffer;
+	server->chunkSessionCounts = chunkSessionCounts;
+	server->chunkBufferSize = chunkBufferSize;
+	// Session data is stored inline, right after the session
+	server->sessionSlotSize = getStreamSessionSlotSize(
+		sessionDataSize);
+	server->sessionCapacity = 0;
+	server->sessionCount = 0;
+	server->peakSessionCapacity = 0;
+	server->peakSessionCount = 0;
+	server->pauseCount = 0;
+	server->rejectCount = 0;
+	server->admission = PAUSE_STREAM_ADMISSION;
 
-	if (sessionBuffer == NULL)
+	// First chunk is kept for the whole server lifetime
+	if (allocateStreamSessionChunk(server) == false)
 	{
+		free(chunkSessionCounts);
+		free(chunkBuffer);
+		free(hotBuffer);
 		free(receiveBuffer);
 		free(server);
 		return NULL;
@@ -85,7 +314,10 @@ StreamServer createStreamServer(
 	}
 	else
 	{
-		free(sessionBuffer);
+		free(chunkBuffer[0]);
+		free(chunkSessionCounts);
+		free(chunkBuffer);
+		free(hotBuffer);
 		free(receiveBuffer);
 		free(server);
 		return NULL;
@@ -93,7 +325,10 @@ StreamServer createStreamServer(
 
 	if (localAddress == NULL)
 	{
-		free(sessionBuffer);
+		free(chunkBuffer[0]);
+		free(chunkSessionCounts);
+		free(chunkBuffer);
+		free(hotBuffer);
 		free(receiveBuffer);
 		free(server);
 		return NULL;
@@ -111,21 +346,41 @@ StreamServer createStreamServer(
 
 	if (acceptSocket == NULL)
 	{
-		free(sessionBuffer);
+		free(chunkBuffer[0]);
+		free(chunkSessionCounts);
+		free(chunkBuffer);
+		free(hotBuffer);
 		free(receiveBuffer);
 		free(server);
 		return NULL;
 	}
 
-	server->sessionBufferSize = sessionBufferSize;
+	server->sessionDataSize = sessionDataSize;
 	server->receiveBufferSize = receiveBufferSize;
+	server->sendBufferSize = sendBufferSize;
+	server->lowWatermark = 0;
+	server->highWatermark = sendBufferSize;
+	server->onWatermark = NULL;
+	server->isCoalescing = false;
+	server->framing = UINT8_STREAM_FRAMING;
+	server->delimiter = DEFAULT_STREAM_DELIMITER;
+	server->isChecksumming = false;
+	server->compression = NONE_STREAM_COMPRESSION;
+	server->compressionThreshold = 0;
+	server->frameBufferSize = 0;
+	server->packBuffer = NULL;
+	server->packBufferSize = 0;
+	server->unpackBuffer = NULL;
 	server->onCreate = onCreate;
 	server->onDestroy = onDestroy;
 	server->onUpdate = onUpdate;
 	server->onReceive = onReceive;
+	server->onChunk = NULL;
 	server->handle = handle;
-	server->sessionBuffer = sessionBuffer;
-	server->sessionCount = 0;
+	server->socketBuffer = hotBuffer;
+	server->decoderBuffer = decoderBuffer;
+	server->stateBuffer = stateBuffer;
+	server->socketSize = socketSize;
 	server->receiveBuffer = receiveBuffer;
 	server->acceptSocket = acceptSocket;
 	return server;
@@ -138,30 +393,44 @@ void destroyStreamServer(StreamServer server)
 	if (server == NULL)
 		return;
 
-	StreamSession sessionBuffer = server->sessionBuffer;
+	StreamDecoder* decoderBuffer = server->decoderBuffer;
+	StreamSession* sessionBuffer = server->sessionBuffer;
 	size_t sessionCount = server->sessionCount;
 	OnStreamSessionDestroy onDestroy = server->onDestroy;
 
 	for (size_t i = 0; i < sessionCount; i++)
 	{
-		StreamSession session = &sessionBuffer[i];
-		Socket receiveSocket = session->receiveSocket;
+		Socket receiveSocket = getStreamServerSessionSocket(
+			server,
+			i);
 
 		onDestroy(
 			server,
-			session);
+			sessionBuffer[i]);
 		shutdownSocket(
 			receiveSocket,
 			RECEIVE_SEND_SOCKET_SHUTDOWN);
-		destroySocket(receiveSocket);
+		destroySocketInPlace(receiveSocket);
+		destroyStreamDecoder(decoderBuffer[i]);
+		free(sessionBuffer[i]->sendBuffer);
 	}
 
 	shutdownSocket(
 		server->acceptSocket,
 		RECEIVE_SEND_SOCKET_SHUTDOWN);
 	destroySocket(server->acceptSocket);
+	uint8_t** chunkBuffer = server->chunkBuffer;
+	size_t chunkBufferSize = server->chunkBufferSize;
+
+	for (size_t i = 0; i < chunkBufferSize; i++)
+		free(chunkBuffer[i]);
+
+	free(server->unpackBuffer);
+	free(server->packBuffer);
 	free(server->receiveBuffer);
-	free(sessionBuffer);
+	free(server->chunkSessionCounts);
+	free(chunkBuffer);
+	free(server->socketBuffer);
 	free(server);
 }
 
@@ -172,6 +441,20 @@ size_t getStreamServerSessionBufferSize(StreamServer server)
 	return server->sessionBufferSize;
 }
 
+size_t getStreamServerSessionChunkSize(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->sessionChunkSize;
+}
+
+size_t getStreamServerSessionDataSize(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->sessionDataSize;
+}
+
 size_t getStreamServerReceiveBufferSize(StreamServer server)
 {
 	assert(server != NULL);
@@ -179,205 +462,1135 @@ size_t getStreamServerReceiveBufferSize(StreamServer server)
 	return server->receiveBufferSize;
 }
 
-OnStreamSessionCreate getStreamServerOnCreate(StreamServer server)
+size_t getStreamServerSendBufferSize(StreamServer server)
 {
 	assert(server != NULL);
 	assert(isNetworkInitialized() == true);
-	return server->onCreate;
+	return server->sendBufferSize;
 }
 
-OnStreamSessionDestroy getStreamServerOnDestroy(StreamServer server)
+size_t getStreamServerLowWatermark(StreamServer server)
 {
 	assert(server != NULL);
 	assert(isNetworkInitialized() == true);
-	return server->onDestroy;
+	return server->lowWatermark;
 }
 
-OnStreamSessionUpdate getStreamServerOnUpdate(StreamServer server)
+size_t getStreamServerHighWatermark(StreamServer server)
 {
 	assert(server != NULL);
 	assert(isNetworkInitialized() == true);
-	return server->onUpdate;
+	return server->highWatermark;
 }
 
-OnStreamSessionReceive getStreamServerOnReceive(StreamServer server)
+void setStreamServerWatermarks(
+	StreamServer server,
+	size_t lowWatermark,
+	size_t highWatermark,
+	OnStreamSessionWatermark onWatermark)
 {
 	assert(server != NULL);
+	assert(lowWatermark < highWatermark);
+	assert(highWatermark <= server->sendBufferSize);
 	assert(isNetworkInitialized() == true);
-	return server->onReceive;
+
+	server->lowWatermark = lowWatermark;
+	server->highWatermark = highWatermark;
+	server->onWatermark = onWatermark;
 }
 
-void* getStreamServerHandle(StreamServer server)
+bool isStreamServerCoalescing(StreamServer server)
 {
 	assert(server != NULL);
 	assert(isNetworkInitialized() == true);
-	return server->handle;
+	return server->isCoalescing;
 }
 
-Socket getStreamServerSocket(StreamServer server)
+void setStreamServerCoalescing(
+	StreamServer server,
+	bool value)
 {
 	assert(server != NULL);
+	assert(value == false || server->sendBufferSize != 0);
 	assert(isNetworkInitialized() == true);
-	return server->acceptSocket;
+	server->isCoalescing = value;
 }
 
-Socket getStreamSessionSocket(StreamSession session)
+uint8_t getStreamServerFraming(StreamServer server)
 {
-	assert(session != NULL);
+	assert(server != NULL);
 	assert(isNetworkInitialized() == true);
-	return session->receiveSocket;
+	return server->framing;
 }
 
-void* getStreamSessionHandle(StreamSession session)
+size_t getStreamServerFrameBufferSize(StreamServer server)
 {
-	assert(session != NULL);
+	assert(server != NULL);
 	assert(isNetworkInitialized() == true);
-	return session->handle;
+	return server->frameBufferSize;
 }
 
-bool updateStreamServer(StreamServer server)
+void setStreamServerFraming(
+	StreamServer server,
+	uint8_t framing,
+	size_t frameBufferSize)
 {
 	assert(server != NULL);
+	assert(framing < STREAM_FRAMING_COUNT);
+	assert(server->sessionCount == 0);
+	assert(isNetworkInitialized() == true);
 
-	bool isUpdated = false;
+	assert(server->isChecksumming == false ||
+		framing != DELIMITER_STREAM_FRAMING);
+	assert(server->compression == NONE_STREAM_COMPRESSION ||
+		framing != DELIMITER_STREAM_FRAMING);
 
-	StreamSession sessionBuffer = server->sessionBuffer;
-	size_t sessionBufferSize = server->sessionBufferSize;
-	size_t sessionCount = server->sessionCount;
-	uint8_t* receiveBuffer = server->receiveBuffer;
-	size_t receiveBufferSize = server->receiveBufferSize;
-	OnStreamSessionCreate onCreate = server->onCreate;
-	OnStreamSessionDestroy onDestroy = server->onDestroy;
-	OnStreamSessionUpdate onUpdate = server->onUpdate;
-	OnStreamSessionReceive onReceive = server->onReceive;
-	Socket serverSocket = server->acceptSocket;
-	bool isServerSocketSsl = getSocketSslContext(serverSocket) != NULL;
+	server->framing = framing;
+	server->frameBufferSize = frameBufferSize;
+}
 
-	for (size_t i = 0; i < sessionCount; i++)
-	{
-		StreamSession session = &sessionBuffer[i];
-		Socket receiveSocket = session->receiveSocket;
+uint8_t getStreamServerDelimiter(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->delimiter;
+}
 
-		if (session->isSslAccepted == false)
-		{
-			bool result = acceptSslSocket(receiveSocket);
+void setStreamServerDelimiter(
+	StreamServer server,
+	uint8_t delimiter)
+{
+	assert(server != NULL);
+	assert(server->sessionCount == 0);
+	assert(isNetworkInitialized() == true);
+	server->delimiter = delimiter;
+}
 
-			if(result == true)
-			{
-				session->isSslAccepted = true;
-				isUpdated = true;
-			}
-			else
-			{
-				continue;
-			}
-		}
+bool isStreamServerChecksumming(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->isChecksumming;
+}
 
-		bool result = onUpdate(
-			server,
-			session);
+void setStreamServerChecksumming(
+	StreamServer server,
+	bool value)
+{
+	assert(server != NULL);
+	assert(server->sessionCount == 0);
+	assert(isNetworkInitialized() == true);
 
-		if (result == false)
-			goto DESTROY_SESSION;
+	assert(value == false ||
+		server->framing != DELIMITER_STREAM_FRAMING);
 
-		size_t byteCount;
+	server->isChecksumming = value;
+}
 
-		result = socketReceive(
-			receiveSocket,
-			receiveBuffer,
-			receiveBufferSize,
-			&byteCount);
+uint8_t getStreamServerCompression(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->compression;
+}
 
-		if (result == false)
-			continue;
+size_t getStreamServerCompressionThreshold(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->compressionThreshold;
+}
 
-		result = onReceive(
-			server,
-			session,
-			receiveBuffer,
-			byteCount);
+void setStreamServerCompression(
+	StreamServer server,
+	uint8_t compression,
+	size_t threshold)
+{
+	assert(server != NULL);
+	assert(compression < STREAM_COMPRESSION_COUNT);
+	assert(server->sessionCount == 0);
+	assert(isNetworkInitialized() == true);
 
-		if (result == true)
-		{
-			isUpdated = true;
-			continue;
-		}
+	assert(compression == NONE_STREAM_COMPRESSION ||
+		server->framing != DELIMITER_STREAM_FRAMING);
 
-	DESTROY_SESSION:
-		onDestroy(
-			server,
-			session);
-		shutdownSocket(
-			receiveSocket,
-			RECEIVE_SEND_SOCKET_SHUTDOWN);
-		destroySocket(receiveSocket);
+	server->compression = compression;
+	server->compressionThreshold = threshold;
+}
 
-		for (size_t j = i + 1; j < sessionCount; j++)
-			sessionBuffer[j - 1] = sessionBuffer[j];
+OnStreamSessionChunk getStreamServerOnChunk(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->onChunk;
+}
 
-		if (i > 0)
-			i--;
+void setStreamServerOnChunk(
+	StreamServer server,
+	OnStreamSessionChunk onChunk)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	server->onChunk = onChunk;
+}
 
-		sessionCount--;
-		isUpdated = true;
-	}
+size_t getStreamServerSessionCount(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->sessionCount;
+}
 
-	Socket acceptedSocket = acceptSocket(serverSocket);
+size_t getStreamServerSessionCapacity(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->sessionCapacity;
+}
 
-	if (acceptedSocket != NULL)
-	{
-		if (sessionCount < sessionBufferSize)
-		{
-			void* session;
+size_t getStreamServerPeakSessionCount(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->peakSessionCount;
+}
 
-			bool result = onCreate(
-				server,
-				acceptedSocket,
-				&session);
+size_t getStreamServerPeakSessionCapacity(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->peakSessionCapacity;
+}
 
-			if (result == true)
-			{
-				struct StreamSession streamSession;
-				streamSession.receiveSocket = acceptedSocket;
-				streamSession.handle = session;
-				streamSession.isSslAccepted = !isServerSocketSsl;
-				sessionBuffer[sessionCount++] = streamSession;
-			}
-			else
-			{
-				shutdownSocket(
-					acceptedSocket,
-					RECEIVE_SEND_SOCKET_SHUTDOWN);
-				destroySocket(acceptedSocket);
-			}
-		}
-		else
-		{
-			shutdownSocket(
-				acceptedSocket,
-				RECEIVE_SEND_SOCKET_SHUTDOWN);
-			destroySocket(acceptedSocket);
-		}
+uint8_t getStreamServerAdmission(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->admission;
+}
 
-		isUpdated = true;
-	}
+void setStreamServerAdmission(
+	StreamServer server,
+	uint8_t admission)
+{
+	assert(server != NULL);
+	assert(admission < STREAM_ADMISSION_COUNT);
+	assert(isNetworkInitialized() == true);
+	server->admission = admission;
+}
 
-	server->sessionCount = sessionCount;
-	return isUpdated;
+size_t getStreamServerPauseCount(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->pauseCount;
 }
 
-bool streamSessionSend(
-	StreamSession session,
-	const void* buffer,
-	size_t count)
+size_t getStreamServerRejectCount(StreamServer server)
 {
-	assert(session != NULL);
-	assert(buffer != NULL);
-	assert(count != 0);
+	assert(server != NULL);
 	assert(isNetworkInitialized() == true);
+	return server->rejectCount;
+}
 
-	return socketSend(
-		session->receiveSocket,
-		buffer,
-		count);
+OnStreamSessionCreate getStreamServerOnCreate(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->onCreate;
+}
+
+OnStreamSessionDestroy getStreamServerOnDestroy(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->onDestroy;
+}
+
+OnStreamSessionUpdate getStreamServerOnUpdate(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->onUpdate;
+}
+
+OnStreamSessionReceive getStreamServerOnReceive(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->onReceive;
+}
+
+void* getStreamServerHandle(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->handle;
+}
+
+Socket getStreamServerSocket(StreamServer server)
+{
+	assert(server != NULL);
+	assert(isNetworkInitialized() == true);
+	return server->acceptSocket;
+}
+
+Socket getStreamSessionSocket(StreamSession session)
+{
+	assert(session != NULL);
+	assert(isNetworkInitialized() == true);
+
+	return getStreamServerSessionSocket(
+		session->server,
+		session->index);
+}
+
+void* getStreamSessionHandle(StreamSession session)
+{
+	assert(session != NULL);
+	assert(isNetworkInitialized() == true);
+	return session->handle;
+}
+
+size_t getStreamSessionSendCount(StreamSession session)
+{
+	assert(session != NULL);
+	assert(isNetworkInitialized() == true);
+	return session->sendCount;
+}
+
+void getStreamSessionCompressionStats(
+	StreamSession session,
+	uint64_t* sendDataSize,
+	uint64_t* sendPackedSize,
+	uint64_t* receiveDataSize,
+	uint64_t* receivePackedSize)
+{
+	assert(session != NULL);
+	assert(sendDataSize != NULL);
+	assert(sendPackedSize != NULL);
+	assert(receiveDataSize != NULL);
+	assert(receivePackedSize != NULL);
+	assert(isNetworkInitialized() == true);
+
+	*sendDataSize = session->sendDataSize;
+	*sendPackedSize = session->sendPackedSize;
+	*receiveDataSize = session->receiveDataSize;
+	*receivePackedSize = session->receivePackedSize;
+}
+
+void* getStreamSessionData(StreamSession session)
+{
+	assert(session != NULL);
+	assert(isNetworkInitialized() == true);
+
+	return (uint8_t*)session + alignStreamSessionSize(
+		sizeof(struct StreamSession));
+}
+
+bool flushStreamSession(StreamSession session)
+{
+	assert(session != NULL);
+	assert(isNetworkInitialized() == true);
+
+	StreamServer server = session->server;
+	uint8_t* sendBuffer = session->sendBuffer;
+	size_t sendBufferSize = server->sendBufferSize;
+	size_t sendOffset = session->sendOffset;
+	size_t sendCount = session->sendCount;
+
+	if (sendCount == 0)
+		return true;
+
+	// Queued data is at most two ring buffer parts
+	size_t partSize = sendBufferSize - sendOffset;
+
+	if (partSize > sendCount)
+		partSize = sendCount;
+
+	const void* buffers[2] = {
+		sendBuffer + sendOffset,
+		sendBuffer,
+	};
+	size_t counts[2] = {
+		partSize,
+		sendCount - partSize,
+	};
+
+	size_t sentCount;
+
+	bool result = socketSendBuffers(
+		getStreamServerSessionSocket(server, session->index),
+		buffers,
+		counts,
+		counts[1] != 0 ? 2 : 1,
+		&sentCount);
+
+	if (result == false)
+		return false;
+
+	sendOffset += sentCount;
+	sendCount -= sentCount;
+
+	if (sendOffset >= sendBufferSize)
+		sendOffset -= sendBufferSize;
+
+	if (sendCount == 0)
+	{
+		server->stateBuffer[session->index] &=
+			~SEND_PENDING_STREAM_SESSION_STATE;
+		sendOffset = 0;
+	}
+
+	session->sendOffset = sendOffset;
+	session->sendCount = sendCount;
+
+	if (session->isSendHigh == true &&
+		server->onWatermark != NULL &&
+		sendCount <= server->lowWatermark)
+	{
+		session->isSendHigh = false;
+
+		server->onWatermark(
+			server,
+			session,
+			false);
+	}
+
+	return true;
+}
+// Unsent data can not be kept without the queue,
+// session is destroyed on the next server update
+static void failStreamSession(StreamSession session)
+{
+	session->server->stateBuffer[session->index] |=
+		FAILED_STREAM_SESSION_STATE;
+}
+static bool queueStreamSession(
+	StreamSession session,
+	const uint8_t* buffer,
+	size_t count)
+{
+	StreamServer server = session->server;
+	uint8_t* sendBuffer = session->sendBuffer;
+	size_t sendBufferSize = server->sendBufferSize;
+
+	// Queue memory is allocated only for congested sessions
+	if (sendBuffer == NULL)
+	{
+		sendBuffer = malloc(
+			sendBufferSize * sizeof(uint8_t));
+
+		// Message part can be already sent
+		if (sendBuffer == NULL)
+		{
+			failStreamSession(session);
+			return false;
+		}
+
+		session->sendBuffer = sendBuffer;
+	}
+
+	size_t sendCount = session->sendCount;
+	size_t tail = session->sendOffset + sendCount;
+
+	if (tail >= sendBufferSize)
+		tail -= sendBufferSize;
+
+	size_t partSize = sendBufferSize - tail;
+
+	if (partSize > count)
+		partSize = count;
+
+	memcpy(
+		sendBuffer + tail,
+		buffer,
+		partSize);
+	memcpy(
+		sendBuffer,
+		buffer + partSize,
+		count - partSize);
+
+	sendCount += count;
+	session->sendCount = sendCount;
+
+	server->stateBuffer[session->index] |=
+		SEND_PENDING_STREAM_SESSION_STATE;
+
+	if (session->isSendHigh == false &&
+		server->onWatermark != NULL &&
+		sendCount >= server->highWatermark)
+	{
+		session->isSendHigh = true;
+
+		server->onWatermark(
+			server,
+			session,
+			true);
+	}
+
+	return true;
+}
+
+static void destroyStreamSession(
+	StreamServer server,
+	size_t index)
+{
+	StreamDecoder* decoderBuffer = server->decoderBuffer;
+	uint8_t* stateBuffer = server->stateBuffer;
+	StreamSession* sessionBuffer = server->sessionBuffer;
+	StreamSession session = sessionBuffer[index];
+
+	Socket receiveSocket = getStreamServerSessionSocket(
+		server,
+		index);
+
+	server->onDestroy(
+		server,
+		session);
+	shutdownSocket(
+		receiveSocket,
+		RECEIVE_SEND_SOCKET_SHUTDOWN);
+	destroySocketInPlace(receiveSocket);
+	destroyStreamDecoder(decoderBuffer[index]);
+	free(session->sendBuffer);
+
+	// Move last session in place, its slot becomes free
+	size_t sessionCount = server->sessionCount - 1;
+
+	if (index != sessionCount)
+	{
+		memcpy(
+			receiveSocket,
+			getStreamServerSessionSocket(server, sessionCount),
+			server->socketSize);
+	}
+
+	decoderBuffer[index] = decoderBuffer[sessionCount];
+	stateBuffer[index] = stateBuffer[sessionCount];
+	sessionBuffer[index] = sessionBuffer[sessionCount];
+	sessionBuffer[index]->index = index;
+	sessionBuffer[sessionCount] = session;
+	server->sessionCount = sessionCount;
+
+	size_t chunkIndex = session->chunkIndex;
+
+	// Release empty chunk, keeping the first one
+	// and one spare chunk of free slots
+	if (--server->chunkSessionCounts[chunkIndex] == 0 &&
+		chunkIndex != 0)
+	{
+		size_t freeSlotCount =
+			server->sessionCapacity - sessionCount;
+		size_t chunkSlotCount = getStreamSessionChunkSlotCount(
+			server,
+			chunkIndex);
+
+		if (freeSlotCount >= chunkSlotCount + server->sessionChunkSize)
+		{
+			releaseStreamSessionChunk(
+				server,
+				chunkIndex);
+		}
+	}
+}
+static bool acceptStreamSession(StreamServer server)
+{
+	Socket serverSocket = server->acceptSocket;
+	size_t sessionCount = server->sessionCount;
+
+	// Do not accept connections which can not be stored
+	if (sessionCount == server->sessionBufferSize)
+	{
+		if (server->admission == RESET_STREAM_ADMISSION)
+		{
+			if (rejectSocket(serverSocket) == true)
+			{
+				server->rejectCount++;
+				return true;
+			}
+		}
+		else
+		{
+			server->pauseCount++;
+		}
+
+		return false;
+	}
+
+	// Socket is accepted directly to the free hot array slot
+	Socket acceptedSocket = getStreamServerSessionSocket(
+		server,
+		sessionCount);
+
+	if (acceptSocketInPlace(serverSocket, acceptedSocket) == false)
+		return false;
+
+	// Grow session storage without moving live sessions
+	if (sessionCount == server->sessionCapacity)
+		allocateStreamSessionChunk(server);
+
+	if (sessionCount == server->sessionCapacity)
+	{
+		shutdownSocket(
+			acceptedSocket,
+			RECEIVE_SEND_SOCKET_SHUTDOWN);
+		destroySocketInPlace(acceptedSocket);
+		return true;
+	}
+
+	StreamSession session =
+		server->sessionBuffer[sessionCount];
+	session->server = server;
+	session->handle = NULL;
+	session->index = sessionCount;
+	session->sendBuffer = NULL;
+	session->sendOffset = 0;
+	session->sendCount = 0;
+	session->isSendHigh = false;
+	session->sendDataSize = 0;
+	session->sendPackedSize = 0;
+	session->receiveDataSize = 0;
+	session->receivePackedSize = 0;
+
+	StreamDecoder decoder = NULL;
+	size_t frameBufferSize = server->frameBufferSize;
+
+	if (frameBufferSize != 0)
+	{
+		decoder = createStreamDecoder(
+			server->framing,
+			frameBufferSize);
+
+		if (decoder == NULL)
+		{
+			shutdownSocket(
+				acceptedSocket,
+				RECEIVE_SEND_SOCKET_SHUTDOWN);
+			destroySocketInPlace(acceptedSocket);
+			return true;
+		}
+
+		setStreamDecoderDelimiter(
+			decoder,
+			server->delimiter);
+		setStreamDecoderChecksumming(
+			decoder,
+			server->isChecksumming);
+	}
+
+	size_t sessionDataSize = server->sessionDataSize;
+
+	if (sessionDataSize != 0)
+	{
+		memset(
+			getStreamSessionData(session),
+			0,
+			sessionDataSize);
+	}
+
+	bool isSsl = getSocketSslContext(serverSocket) != NULL;
+
+	// Session can send data from the create function,
+	// which sets its state bits, initialize slots before
+	server->decoderBuffer[sessionCount] = decoder;
+	server->stateBuffer[sessionCount] = isSsl ?
+		0 : SSL_ACCEPTED_STREAM_SESSION_STATE;
+
+	bool result = server->onCreate(
+		server,
+		session,
+		&session->handle);
+
+	if (result == false)
+	{
+		destroyStreamDecoder(decoder);
+		free(session->sendBuffer);
+		shutdownSocket(
+			acceptedSocket,
+			RECEIVE_SEND_SOCKET_SHUTDOWN);
+		destroySocketInPlace(acceptedSocket);
+		return true;
+	}
+
+	server->chunkSessionCounts[session->chunkIndex]++;
+	sessionCount++;
+
+	if (sessionCount > server->peakSessionCount)
+		server->peakSessionCount = sessionCount;
+
+	server->sessionCount = sessionCount;
+	return true;
+}
+
+static bool onStreamSessionDatagram(
+	const uint8_t* buffer,
+	size_t byteCount,
+	void* handle)
+{
+	StreamSession session = handle;
+	StreamServer server = session->server;
+
+	if (server->compression != NONE_STREAM_COMPRESSION)
+	{
+		uint8_t* unpackBuffer = server->unpackBuffer;
+
+		// Decompressed datagram should fit the frame buffer
+		if (unpackBuffer == NULL)
+		{
+			unpackBuffer = malloc(
+				server->frameBufferSize * sizeof(uint8_t));
+
+			if (unpackBuffer == NULL)
+				return false;
+
+			server->unpackBuffer = unpackBuffer;
+		}
+
+		session->receivePackedSize += byteCount;
+
+		bool result = unpackStreamDatagram(
+			buffer,
+			byteCount,
+			unpackBuffer,
+			server->frameBufferSize,
+			&buffer,
+			&byteCount);
+
+		if (result == false)
+			return false;
+
+		session->receiveDataSize += byteCount;
+	}
+
+	return server->onReceive(
+		server,
+		session,
+		buffer,
+		byteCount);
+}
+
+static bool onStreamSessionChunk(
+	const uint8_t* buffer,
+	size_t byteCount,
+	uint64_t datagramSize,
+	uint64_t chunkOffset,
+	void* handle)
+{
+	StreamSession session = handle;
+	StreamServer server = session->server;
+
+	// Oversized datagram is never compressed, skip compression type
+	if (server->compression != NONE_STREAM_COMPRESSION)
+	{
+		session->receivePackedSize += byteCount;
+
+		if (chunkOffset == 0)
+		{
+			if (buffer[0] != NONE_STREAM_COMPRESSION)
+				return false;
+
+			buffer++;
+			byteCount--;
+		}
+		else
+		{
+			chunkOffset--;
+		}
+
+		datagramSize--;
+		session->receiveDataSize += byteCount;
+
+		if (byteCount == 0)
+			return true;
+	}
+
+	return server->onChunk(
+		server,
+		session,
+		buffer,
+		byteCount,
+		datagramSize,
+		chunkOffset);
+}
+
+static bool receiveStreamSession(
+	StreamServer server,
+	StreamSession session,
+	Socket receiveSocket,
+	StreamDecoder decoder,
+	bool* isReceived)
+{
+	size_t byteCount;
+
+	if (decoder == NULL)
+	{
+		uint8_t* receiveBuffer = server->receiveBuffer;
+
+		bool result = socketReceive(
+			receiveSocket,
+			receiveBuffer,
+			server->receiveBufferSize,
+			&byteCount);
+
+		if (result == false)
+			return true;
+
+		*isReceived = true;
+
+		return server->onReceive(
+			server,
+			session,
+			receiveBuffer,
+			byteCount);
+	}
+
+	// Data is received directly to the session datagram buffer
+	bool result = streamDecoderReceive(
+		decoder,
+		receiveSocket,
+		&byteCount);
+
+	if (result == false)
+		return true;
+
+	*isReceived = true;
+
+	if (byteCount == 0)
+	{
+		return server->onReceive(
+			server,
+			session,
+			NULL,
+			0);
+	}
+
+	return decodeStreamDatagrams(
+		decoder,
+		onStreamSessionDatagram,
+		server->onChunk != NULL ?
+			onStreamSessionChunk : NULL,
+		session);
+}
+
+bool updateStreamServer(StreamServer server)
+{
+	assert(server != NULL);
+
+	bool isUpdated = false;
+
+	uint8_t* socketBuffer = server->socketBuffer;
+	StreamDecoder* decoderBuffer = server->decoderBuffer;
+	uint8_t* stateBuffer = server->stateBuffer;
+	StreamSession* sessionBuffer = server->sessionBuffer;
+	OnStreamSessionUpdate onUpdate = server->onUpdate;
+	size_t socketSize = server->socketSize;
+
+	size_t i = 0;
+
+	// Only hot arrays are accessed, cold session is passed through
+	while (i < server->sessionCount)
+	{
+		Socket receiveSocket = (Socket)(
+			socketBuffer + i * socketSize);
+		StreamSession session = sessionBuffer[i];
+
+		if ((stateBuffer[i] & FAILED_STREAM_SESSION_STATE) != 0)
+			goto DESTROY_SESSION;
+
+		if ((stateBuffer[i] & SSL_ACCEPTED_STREAM_SESSION_STATE) == 0)
+		{
+			bool result = acceptSslSocket(receiveSocket);
+
+			if(result == true)
+			{
+				stateBuffer[i] |= SSL_ACCEPTED_STREAM_SESSION_STATE;
+				isUpdated = true;
+			}
+			else
+			{
+				i++;
+				continue;
+			}
+		}
+
+		if ((stateBuffer[i] & SEND_PENDING_STREAM_SESSION_STATE) != 0)
+		{
+			if (flushStreamSession(session) == false)
+				goto DESTROY_SESSION;
+		}
+
+		bool result = onUpdate(
+			server,
+			session);
+
+		if (result == false)
+			goto DESTROY_SESSION;
+
+		bool isReceived = false;
+
+		result = receiveStreamSession(
+			server,
+			session,
+			receiveSocket,
+			decoderBuffer[i],
+			&isReceived);
+
+		if (result == true)
+		{
+			if (isReceived == true)
+				isUpdated = true;
+
+			i++;
+			continue;
+		}
+
+	DESTROY_SESSION:
+		destroyStreamSession(
+			server,
+			i);
+		isUpdated = true;
+	}
+
+	if (acceptStreamSession(server) == true)
+		isUpdated = true;
+
+	// Send all data coalesced during this update at once
+	if (server->isCoalescing == true)
+	{
+		i = 0;
+
+		while (i < server->sessionCount)
+		{
+			if ((stateBuffer[i] & SEND_PENDING_STREAM_SESSION_STATE) == 0 ||
+				flushStreamSession(sessionBuffer[i]) == true)
+			{
+				i++;
+				continue;
+			}
+
+			destroyStreamSession(
+				server,
+				i);
+			isUpdated = true;
+		}
+	}
+
+	return isUpdated;
+}
+
+bool streamSessionSend(
+	StreamSession session,
+	const void* _buffer,
+	size_t count)
+{
+	assert(session != NULL);
+	assert(_buffer != NULL);
+	assert(count != 0);
+	assert(isNetworkInitialized() == true);
+
+	const uint8_t* buffer = _buffer;
+	StreamServer server = session->server;
+	size_t sendBufferSize = server->sendBufferSize;
+
+	Socket receiveSocket = getStreamServerSessionSocket(
+		server,
+		session->index);
+
+	if (sendBufferSize == 0)
+	{
+		size_t sentCount;
+
+		bool result = socketSendPartial(
+			receiveSocket,
+			buffer,
+			count,
+			&sentCount);
+
+		if (result == true && sentCount == count)
+			return true;
+
+		failStreamSession(session);
+		return false;
+	}
+
+	size_t sendCount = session->sendCount;
+
+	// Never split message, unsent part should fit the queue
+	if (count > sendBufferSize - sendCount)
+		return false;
+
+	// Keep message order, send directly only to the empty queue
+	if (sendCount == 0 && server->isCoalescing == false)
+	{
+		size_t sentCount;
+
+		bool result = socketSendPartial(
+			receiveSocket,
+			buffer,
+			count,
+			&sentCount);
+
+		if (result == false)
+			return false;
+		if (sentCount == count)
+			return true;
+
+		buffer += sentCount;
+		count -= sentCount;
+	}
+
+	return queueStreamSession(
+		session,
+		buffer,
+		count);
+}
+
+static bool sendStreamSessionBuffers(
+	StreamSession session,
+	const void** buffers,
+	const size_t* counts,
+	size_t bufferCount,
+	size_t totalCount)
+{
+	StreamServer server = session->server;
+	size_t sentCount = 0;
+
+	Socket receiveSocket = getStreamServerSessionSocket(
+		server,
+		session->index);
+
+	if (server->sendBufferSize == 0)
+	{
+		bool result = socketSendBuffers(
+			receiveSocket,
+			buffers,
+			counts,
+			bufferCount,
+			&sentCount);
+
+		if (result == true && sentCount == totalCount)
+			return true;
+
+		failStreamSession(session);
+		return false;
+	}
+
+	if (session->sendCount == 0 && server->isCoalescing == false)
+	{
+		bool result = socketSendBuffers(
+			receiveSocket,
+			buffers,
+			counts,
+			bufferCount,
+			&sentCount);
+
+		if (result == false)
+			return false;
+		if (sentCount == totalCount)
+			return true;
+	}
+
+	// Queue unsent part of the buffers
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		size_t count = counts[i];
+
+		if (sentCount >= count)
+		{
+			sentCount -= count;
+			continue;
+		}
+
+		bool result = queueStreamSession(
+			session,
+			(const uint8_t*)buffers[i] + sentCount,
+			count - sentCount);
+
+		if (result == false)
+			return false;
+
+		sentCount = 0;
+	}
+
+	return true;
+}
+
+bool streamSessionSendFrames(
+	StreamSession session,
+	const void** buffers,
+	const size_t* counts,
+	size_t frameCount)
+{
+	assert(session != NULL);
+	assert(buffers != NULL);
+	assert(counts != NULL);
+	assert(frameCount != 0);
+	assert(isNetworkInitialized() == true);
+
+	StreamServer server = session->server;
+	size_t sendBufferSize = server->sendBufferSize;
+	size_t totalCount;
+
+	bool result = getStreamFramesSize(
+		server->framing,
+		server->isChecksumming,
+		server->compression != NONE_STREAM_COMPRESSION,
+		counts,
+		frameCount,
+		&totalCount);
+
+	if (result == false)
+		return false;
+
+	if (sendBufferSize != 0 &&
+		totalCount > sendBufferSize - session->sendCount)
+	{
+		return false;
+	}
+
+	StreamFrameBatch batch;
+
+	for (size_t i = 0; i < frameCount;)
+	{
+		i += packStreamFrames(
+			&batch,
+			server->framing,
+			server->delimiter,
+			server->isChecksumming,
+			server->compression,
+			server->compressionThreshold,
+			&server->packBuffer,
+			&server->packBufferSize,
+			buffers + i,
+			counts + i,
+			frameCount - i);
+
+		session->sendDataSize += batch.dataSize;
+		session->sendPackedSize += batch.packedSize;
+
+		result = sendStreamSessionBuffers(
+			session,
+			batch.buffers,
+			batch.counts,
+			batch.bufferCount,
+			batch.byteCount);
+
+		if (result == false)
+			return false;
+	}
+
+	return true;
+}
+
+bool streamSessionSendFrame(
+	StreamSession session,
+	const void* buffer,
+	size_t count)
+{
+	return streamSessionSendFrames(
+		session,
+		&buffer,
+		&count,
+		1);
 }
@@ -0,0 +1,174 @@
+#include "mpnw/datagram_aggregator.h"
+
+#include <stdio.h>
+
+#define PACKET_SIZE 1200
+#define MESSAGE_COUNT 1000
+#define MAX_PAYLOAD_SIZE 40
+
+static DatagramAggregator receiver = NULL;
+static size_t receivedCount = 0;
+static size_t errorCount = 0;
+
+static bool onSend(
+	DatagramAggregator aggregator,
+	const uint8_t* buffer,
+	size_t count)
+{
+	if (count > PACKET_SIZE)
+		errorCount++;
+
+	return datagramAggregatorReceive(
+		receiver,
+		buffer,
+		count);
+}
+static bool onReceiverSend(
+	DatagramAggregator aggregator,
+	const uint8_t* buffer,
+	size_t count)
+{
+	return true;
+}
+static void onReceive(
+	DatagramAggregator aggregator,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	size_t index = receivedCount++;
+
+	if (byteCount != 1 + index % MAX_PAYLOAD_SIZE)
+	{
+		errorCount++;
+		return;
+	}
+
+	for (size_t i = 0; i < byteCount; i++)
+	{
+		if (buffer[i] != (uint8_t)(index + i))
+		{
+			errorCount++;
+			return;
+		}
+	}
+}
+
+static bool testMessages(DatagramAggregator sender)
+{
+	uint8_t message[MAX_PAYLOAD_SIZE];
+
+	for (size_t i = 0; i < MESSAGE_COUNT; i++)
+	{
+		size_t messageSize = 1 + i % MAX_PAYLOAD_SIZE;
+
+		for (size_t j = 0; j < messageSize; j++)
+			message[j] = (uint8_t)(i + j);
+
+		if (datagramAggregatorSend(
+			sender,
+			message,
+			messageSize) == false)
+		{
+			return false;
+		}
+	}
+
+	if (flushDatagramAggregator(sender) == false)
+		return false;
+
+	uint64_t messageCount, packetCount;
+
+	getDatagramAggregatorStats(
+		sender,
+		&messageCount,
+		&packetCount);
+
+	if (receivedCount != MESSAGE_COUNT || errorCount != 0 ||
+		messageCount != MESSAGE_COUNT || packetCount >= MESSAGE_COUNT)
+	{
+		printf("Messages are not aggregated\n");
+		return false;
+	}
+
+	return true;
+}
+
+// Message with the length prefix should fit one packet
+static bool testMessageSizes(DatagramAggregator sender)
+{
+	uint8_t message[PACKET_SIZE + 1];
+
+	memset(
+		message,
+		0,
+		sizeof(message));
+
+	bool result = !datagramAggregatorSend(
+		sender,
+		message,
+		PACKET_SIZE + 1);
+	result &= !datagramAggregatorSend(
+		sender,
+		message,
+		PACKET_SIZE);
+	result &= !datagramAggregatorSend(
+		sender,
+		message,
+		PACKET_SIZE - 1);
+
+	if (result == false ||
+		getDatagramAggregatorByteCount(sender) != 0 ||
+		errorCount != 0)
+	{
+		printf("Oversized message is accepted\n");
+		return false;
+	}
+
+	// Two byte varint prefix and the biggest fitting message
+	result = datagramAggregatorSend(
+		sender,
+		message,
+		PACKET_SIZE - 2);
+
+	if (result == false ||
+		getDatagramAggregatorByteCount(sender) != PACKET_SIZE)
+	{
+		printf("Biggest message is not accepted\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	receiver = createDatagramAggregator(
+		PACKET_SIZE,
+		onReceiverSend,
+		onReceive,
+		NULL);
+	DatagramAggregator sender = createDatagramAggregator(
+		PACKET_SIZE,
+		onSend,
+		onReceive,
+		NULL);
+
+	bool result = false;
+
+	if (receiver != NULL && sender != NULL)
+	{
+		result = testMessages(sender);
+		result &= testMessageSizes(sender);
+	}
+
+	destroyDatagramAggregator(sender);
+	destroyDatagramAggregator(receiver);
+
+	if (result == false)
+	{
+		printf("Datagram aggregator test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,330 @@
+#include "mpnw/datagram_channel.h"
+#include "mpnw/datagram_server.h"
+#include "mpnw/datagram_client.h"
+
+#include "mpmt/thread.h"
+#include <stdio.h>
+
+#define BUFFER_SIZE 1500
+#define WINDOW_SIZE 32
+#define PACKET_SIZE 1200
+#define MESSAGE_COUNT 2000
+#define MESSAGES_PER_UPDATE 8
+#define MAX_PAYLOAD_SIZE 100
+#define LOSS_PERCENT 20
+#define TIMEOUT_TIME 30.0
+
+static DatagramServer server = NULL;
+static DatagramClient client = NULL;
+static DatagramChannel serverChannel = NULL;
+static DatagramChannel clientChannel = NULL;
+static SocketAddress peerAddress = NULL;
+
+static uint32_t lossState = 1;
+static uint32_t droppedCount = 0;
+static uint32_t receivedCount = 0;
+static uint32_t unreliableCount = 0;
+static uint32_t errorCount = 0;
+
+// Deterministic packet loss, independent of the rand() state
+inline static bool isPacketLost()
+{
+	lossState = lossState * 1103515245 + 12345;
+
+	if ((lossState >> 16) % 100 < LOSS_PERCENT)
+	{
+		droppedCount++;
+		return true;
+	}
+
+	return false;
+}
+
+inline static size_t getMessageSize(uint32_t index)
+{
+	return sizeof(uint32_t) + index % MAX_PAYLOAD_SIZE;
+}
+
+static bool onServerChannelSend(
+	DatagramChannel channel,
+	const uint8_t* buffer,
+	size_t count)
+{
+	if (isPacketLost() == true || peerAddress == NULL)
+		return true;
+
+	return datagramServerSend(
+		server,
+		buffer,
+		count,
+		peerAddress);
+}
+static bool onClientChannelSend(
+	DatagramChannel channel,
+	const uint8_t* buffer,
+	size_t count)
+{
+	if (isPacketLost() == true)
+		return true;
+
+	return datagramClientSend(
+		client,
+		buffer,
+		count);
+}
+
+static void onServerChannelReceive(
+	DatagramChannel channel,
+	const uint8_t* buffer,
+	size_t byteCount,
+	bool isReliable)
+{
+	if (isReliable == false)
+	{
+		unreliableCount++;
+		return;
+	}
+
+	uint32_t index;
+
+	if (byteCount < sizeof(uint32_t))
+	{
+		errorCount++;
+		return;
+	}
+
+	memcpy(
+		&index,
+		buffer,
+		sizeof(uint32_t));
+
+	// Reliable messages should arrive once, in the send order
+	if (index != receivedCount ||
+		byteCount != getMessageSize(index))
+	{
+		errorCount++;
+	}
+
+	for (size_t i = sizeof(uint32_t); i < byteCount; i++)
+	{
+		if (buffer[i] != (uint8_t)(index + i))
+		{
+			errorCount++;
+			break;
+		}
+	}
+
+	receivedCount++;
+}
+static void onClientChannelReceive(
+	DatagramChannel channel,
+	const uint8_t* buffer,
+	size_t byteCount,
+	bool isReliable)
+{
+}
+
+static void onServerReceive(
+	DatagramServer server,
+	SocketAddress address,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	if (peerAddress == NULL)
+		peerAddress = createSocketAddressCopy(address);
+
+	if (datagramChannelReceive(
+		serverChannel,
+		buffer,
+		byteCount) == false)
+	{
+		errorCount++;
+	}
+}
+static void onClientReceive(
+	DatagramClient client,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	if (datagramChannelReceive(
+		clientChannel,
+		buffer,
+		byteCount) == false)
+	{
+		errorCount++;
+	}
+}
+
+inline static SocketAddress createServerAddress()
+{
+	SocketAddress address = createEmptySocketAddress();
+
+	if (address == NULL)
+		return NULL;
+
+	uint16_t port;
+
+	bool result = getSocketLocalAddress(
+		getDatagramServerSocket(server),
+		address);
+	result &= getSocketAddressPort(
+		address,
+		&port);
+
+	destroySocketAddress(address);
+
+	if (result == false)
+		return NULL;
+
+	char service[MAX_NUMERIC_SERVICE_LENGTH];
+
+	snprintf(
+		service,
+		MAX_NUMERIC_SERVICE_LENGTH,
+		"%hu",
+		port);
+
+	return createSocketAddress(
+		LOOPBACK_IP_ADDRESS_V4,
+		service);
+}
+
+static bool runChannels()
+{
+	uint8_t message[sizeof(uint32_t) + MAX_PAYLOAD_SIZE];
+	uint32_t sentCount = 0;
+
+	double timeoutTime = getCurrentClock() + TIMEOUT_TIME;
+
+	while (receivedCount < MESSAGE_COUNT &&
+		getCurrentClock() < timeoutTime)
+	{
+		for (size_t i = 0; i < MESSAGES_PER_UPDATE &&
+			sentCount < MESSAGE_COUNT; i++)
+		{
+			size_t messageSize = getMessageSize(sentCount);
+
+			memcpy(
+				message,
+				&sentCount,
+				sizeof(uint32_t));
+
+			for (size_t j = sizeof(uint32_t); j < messageSize; j++)
+				message[j] = (uint8_t)(sentCount + j);
+
+			// Full send window, retried on the next update
+			if (datagramChannelSend(
+				clientChannel,
+				message,
+				messageSize,
+				true) == false)
+			{
+				break;
+			}
+
+			sentCount++;
+		}
+
+		datagramChannelSend(
+			clientChannel,
+			message,
+			sizeof(uint32_t),
+			false);
+
+		while (updateDatagramServer(server) == true);
+		while (updateDatagramClient(client) == true);
+
+		updateDatagramChannel(serverChannel);
+		updateDatagramChannel(clientChannel);
+
+		sleepThread(0.001);
+	}
+
+	printf("Delivered %u/%d reliable messages, %u unreliable, "
+		"%u packets dropped, %llu retransmitted, "
+		"RTT %.2f ms, RTO %.2f ms\n",
+		receivedCount,
+		MESSAGE_COUNT,
+		unreliableCount,
+		droppedCount,
+		(unsigned long long)getDatagramChannelRetransmitCount(clientChannel),
+		getDatagramChannelRoundTripTime(clientChannel) * 1000.0,
+		getDatagramChannelRetransmitTimeout(clientChannel) * 1000.0);
+	fflush(stdout);
+
+	return receivedCount == MESSAGE_COUNT &&
+		unreliableCount != 0 &&
+		droppedCount != 0 &&
+		errorCount == 0;
+}
+
+int main()
+{
+	if (initializeNetwork() == false)
+		return EXIT_FAILURE;
+
+	server = createDatagramServer(
+		IP_V4_ADDRESS_FAMILY,
+		ANY_IP_ADDRESS_PORT,
+		BUFFER_SIZE,
+		onServerReceive,
+		NULL,
+		NULL);
+
+	SocketAddress serverAddress = NULL;
+
+	if (server != NULL)
+		serverAddress = createServerAddress();
+
+	if (serverAddress != NULL)
+	{
+		client = createDatagramClient(
+			serverAddress,
+			BUFFER_SIZE,
+			onClientReceive,
+			NULL,
+			NULL);
+	}
+
+	serverChannel = createDatagramChannel(
+		WINDOW_SIZE,
+		PACKET_SIZE,
+		onServerChannelSend,
+		onServerChannelReceive,
+		NULL);
+	clientChannel = createDatagramChannel(
+		WINDOW_SIZE,
+		PACKET_SIZE,
+		onClientChannelSend,
+		onClientChannelReceive,
+		NULL);
+
+	bool result = false;
+
+	if (client != NULL &&
+		serverChannel != NULL &&
+		clientChannel != NULL)
+	{
+		result = runChannels();
+	}
+	else
+	{
+		printf("Failed to create datagram channels\n");
+	}
+
+	destroyDatagramChannel(clientChannel);
+	destroyDatagramChannel(serverChannel);
+	destroyDatagramClient(client);
+	destroySocketAddress(serverAddress);
+	destroyDatagramServer(server);
+	destroySocketAddress(peerAddress);
+	terminateNetwork();
+
+	if (result == false)
+	{
+		printf("Datagram channel test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include "mpnw/datagram_clock.h"
+
+#include <stdio.h>
+
+// Client clock is ahead of the server clock
+#define CLIENT_OFFSET 3.0
+#define PATH_DELAY 0.01
+#define QUEUE_DELAY 0.5
+#define HOLD_TIME 0.002
+#define EPSILON 0.000001
+
+inline static bool isNear(double a, double b)
+{
+	double difference = a - b;
+	return difference < EPSILON && difference > -EPSILON;
+}
+
+// Server side of the exchange, times as in receiveTimeDatagram
+static void addServerExchange(
+	DatagramClockState* state,
+	double serverSendTime,
+	double sendDelay,
+	double echoDelay)
+{
+	double clientReceiveTime = serverSendTime + sendDelay + CLIENT_OFFSET;
+	double clientSendTime = clientReceiveTime + HOLD_TIME;
+	double serverReceiveTime = clientSendTime - CLIENT_OFFSET + echoDelay;
+
+	addDatagramClockExchange(
+		state,
+		serverSendTime,
+		clientSendTime,
+		HOLD_TIME,
+		serverReceiveTime);
+}
+
+// Offset is the client minus server clock time on the server
+static bool testOffsetSign()
+{
+	DatagramClockState server;
+	initializeDatagramClockState(&server);
+
+	addServerExchange(
+		&server,
+		100.0,
+		PATH_DELAY,
+		PATH_DELAY);
+
+	if (isNear(server.clockOffset, CLIENT_OFFSET) == false ||
+		isNear(server.roundTripTime, PATH_DELAY * 2.0) == false)
+	{
+		printf("Server clock offset sign is incorrect\n");
+		return false;
+	}
+
+	// Client sees the same exchange from the other side
+	DatagramClockState client;
+	initializeDatagramClockState(&client);
+
+	double clientSendTime = 200.0;
+	double serverReceiveTime = clientSendTime - CLIENT_OFFSET + PATH_DELAY;
+	double serverSendTime = serverReceiveTime + HOLD_TIME;
+
+	addDatagramClockExchange(
+		&client,
+		clientSendTime,
+		serverSendTime,
+		HOLD_TIME,
+		serverSendTime + CLIENT_OFFSET + PATH_DELAY);
+
+	if (isNear(client.clockOffset, -CLIENT_OFFSET) == false ||
+		isNear(client.roundTripTime, PATH_DELAY * 2.0) == false)
+	{
+		printf("Client clock offset sign is incorrect\n");
+		return false;
+	}
+
+	return true;
+}
+
+// Queued echo makes the offset wrong, least delayed sample is kept
+static bool testMinFilter()
+{
+	DatagramClockState state;
+	initializeDatagramClockState(&state);
+
+	double time = 100.0;
+
+	for (size_t i = 0; i < 4; i++, time += 1.0)
+		addServerExchange(&state, time, PATH_DELAY, PATH_DELAY);
+
+	addServerExchange(
+		&state,
+		time,
+		PATH_DELAY,
+		QUEUE_DELAY);
+
+	if (isNear(state.clockOffset, CLIENT_OFFSET) == false ||
+		isNear(state.roundTripTime, PATH_DELAY * 2.0) == false)
+	{
+		printf("Delayed clock sample is not rejected\n");
+		return false;
+	}
+
+	// Filter follows the path once the good samples are out of the window
+	for (size_t i = 0; i < DATAGRAM_CLOCK_SAMPLE_COUNT; i++, time += 1.0)
+		addServerExchange(&state, time, PATH_DELAY, QUEUE_DELAY);
+
+	if (state.roundTripTime <= PATH_DELAY * 2.0 ||
+		state.clockOffset >= CLIENT_OFFSET)
+	{
+		printf("Clock filter window is not moved\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	bool result = testOffsetSign();
+	result &= testMinFilter();
+
+	if (result == false)
+	{
+		printf("Datagram clock test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
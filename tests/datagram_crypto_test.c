@@ -0,0 +1,305 @@
+#include "mpnw/datagram_crypto.h"
+
+#include <stdio.h>
+
+#define MESSAGE_SIZE 100
+#define PACKET_COUNT 100
+#define CLIENT_ID 42
+#define EXPIRE_TIME 1000
+
+static const char* const cipherNames[DATAGRAM_CIPHER_COUNT] = {
+	"ChaCha20-Poly1305",
+	"AES-256-GCM",
+};
+
+static uint8_t packets[PACKET_COUNT][MESSAGE_SIZE + DATAGRAM_SEAL_OVERHEAD];
+static size_t packetSizes[PACKET_COUNT];
+
+inline static bool openPacket(
+	DatagramCrypto crypto,
+	DatagramCryptoState* state,
+	size_t index)
+{
+	uint8_t buffer[MESSAGE_SIZE + DATAGRAM_SEAL_OVERHEAD];
+	size_t byteCount;
+
+	bool result = openDatagram(
+		crypto,
+		state,
+		packets[index],
+		packetSizes[index],
+		buffer,
+		&byteCount);
+
+	if (result == false)
+		return false;
+
+	// Opened datagram should be equal to the sealed one
+	if (byteCount != 1 + index % MESSAGE_SIZE)
+		return false;
+
+	for (size_t i = 0; i < byteCount; i++)
+	{
+		if (buffer[i] != (uint8_t)(index + i))
+			return false;
+	}
+
+	return true;
+}
+
+static bool sealPackets(
+	DatagramCrypto crypto,
+	DatagramCryptoState* state)
+{
+	uint8_t message[MESSAGE_SIZE];
+
+	for (size_t i = 0; i < PACKET_COUNT; i++)
+	{
+		size_t messageSize = 1 + i % MESSAGE_SIZE;
+
+		for (size_t j = 0; j < messageSize; j++)
+			message[j] = (uint8_t)(i + j);
+
+		packetSizes[i] = sealDatagram(
+			crypto,
+			state,
+			message,
+			messageSize,
+			packets[i]);
+
+		if (packetSizes[i] != messageSize + DATAGRAM_SEAL_OVERHEAD)
+			return false;
+	}
+
+	return true;
+}
+
+static bool testConnectToken(
+	DatagramCrypto server,
+	const uint8_t* key)
+{
+	uint8_t token[DATAGRAM_CONNECT_TOKEN_SIZE];
+
+	bool result = createDatagramConnectToken(
+		server,
+		CLIENT_ID,
+		EXPIRE_TIME,
+		key,
+		token);
+
+	if (result == false)
+		return false;
+
+	uint64_t clientID = 0;
+	uint8_t tokenKey[DATAGRAM_KEY_SIZE];
+
+	result = openDatagramConnectToken(
+		server,
+		token,
+		EXPIRE_TIME - 1,
+		&clientID,
+		tokenKey);
+
+	if (result == false || clientID != CLIENT_ID ||
+		memcmp(tokenKey, key, DATAGRAM_KEY_SIZE) != 0)
+	{
+		printf("Connect token is not opened\n");
+		return false;
+	}
+
+	result = openDatagramConnectToken(
+		server,
+		token,
+		EXPIRE_TIME + 1,
+		&clientID,
+		tokenKey);
+
+	if (result == true)
+	{
+		printf("Expired connect token is opened\n");
+		return false;
+	}
+
+	token[DATAGRAM_CONNECT_TOKEN_SIZE / 2] ^= 1;
+
+	result = openDatagramConnectToken(
+		server,
+		token,
+		EXPIRE_TIME - 1,
+		&clientID,
+		tokenKey);
+
+	if (result == true)
+	{
+		printf("Forged connect token is opened\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool testReplayWindow(
+	DatagramCrypto server,
+	DatagramCrypto client,
+	const uint8_t* key)
+{
+	DatagramCryptoState clientState, serverState;
+
+	initializeDatagramCryptoState(
+		&clientState,
+		key);
+	initializeDatagramCryptoState(
+		&serverState,
+		key);
+
+	if (sealPackets(client, &clientState) == false)
+		return false;
+
+	// In order packets and the duplicate
+	bool result = openPacket(server, &serverState, 0);
+	result &= openPacket(server, &serverState, 1);
+	result &= !openPacket(server, &serverState, 1);
+
+	if (result == false)
+	{
+		printf("Duplicate packet is accepted\n");
+		return false;
+	}
+
+	// Reordered packet inside the window is accepted once
+	result = openPacket(server, &serverState, 10);
+	result &= openPacket(server, &serverState, 5);
+	result &= !openPacket(server, &serverState, 5);
+	result &= !openPacket(server, &serverState, 10);
+
+	if (result == false)
+	{
+		printf("Reordered packet is not accepted once\n");
+		return false;
+	}
+
+	// Packet older than the window is rejected
+	size_t lastIndex = PACKET_COUNT - 1;
+	size_t oldIndex = lastIndex - DATAGRAM_REPLAY_WINDOW_SIZE;
+
+	result = openPacket(server, &serverState, lastIndex);
+	result &= !openPacket(server, &serverState, oldIndex);
+	result &= openPacket(server, &serverState, oldIndex + 1);
+
+	if (result == false)
+	{
+		printf("Replay window edge is incorrect\n");
+		return false;
+	}
+
+	// Forged packet does not move the window
+	DatagramCryptoState state;
+
+	initializeDatagramCryptoState(
+		&state,
+		key);
+
+	packets[20][packetSizes[20] - 1] ^= 1;
+	result = !openPacket(server, &state, 20);
+	packets[20][packetSizes[20] - 1] ^= 1;
+	result &= openPacket(server, &state, 20);
+
+	if (result == false)
+	{
+		printf("Forged packet is accepted\n");
+		return false;
+	}
+
+	return true;
+}
+
+// Server sealed packet should not be accepted back by the server
+static bool testReflection(
+	DatagramCrypto server,
+	DatagramCrypto client,
+	const uint8_t* key)
+{
+	DatagramCryptoState sendState, receiveState;
+
+	initializeDatagramCryptoState(
+		&sendState,
+		key);
+
+	if (sealPackets(server, &sendState) == false)
+		return false;
+
+	initializeDatagramCryptoState(
+		&receiveState,
+		key);
+
+	bool result = !openPacket(server, &receiveState, 0);
+
+	initializeDatagramCryptoState(
+		&receiveState,
+		key);
+
+	result &= openPacket(client, &receiveState, 0);
+
+	if (result == false)
+	{
+		printf("Reflected packet is accepted\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool testCipher(uint8_t cipher)
+{
+	uint8_t tokenKey[DATAGRAM_KEY_SIZE];
+	uint8_t key[DATAGRAM_KEY_SIZE];
+
+	if (generateDatagramKey(tokenKey) == false ||
+		generateDatagramKey(key) == false)
+	{
+		return false;
+	}
+
+	DatagramCrypto server = createDatagramCrypto(
+		cipher,
+		true,
+		tokenKey);
+	DatagramCrypto client = createDatagramCrypto(
+		cipher,
+		false,
+		NULL);
+
+	bool result = false;
+
+	if (server != NULL && client != NULL)
+	{
+		result = testConnectToken(server, key);
+		result &= testReplayWindow(server, client, key);
+		result &= testReflection(server, client, key);
+	}
+
+	printf("%s: %s\n",
+		cipherNames[cipher],
+		result == true ? "passed" : "failed");
+	fflush(stdout);
+
+	destroyDatagramCrypto(client);
+	destroyDatagramCrypto(server);
+	return result;
+}
+
+int main()
+{
+	bool result = true;
+
+	for (uint8_t i = 0; i < DATAGRAM_CIPHER_COUNT; i++)
+		result &= testCipher(i);
+
+	if (result == false)
+	{
+		printf("Datagram crypto test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
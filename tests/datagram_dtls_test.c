@@ -0,0 +1,511 @@
+#include "mpnw/datagram_server.h"
+#include "mpnw/datagram_client.h"
+
+#include "mpmt/thread.h"
+#include "openssl/pem.h"
+#include "openssl/x509.h"
+#include <stdio.h>
+
+#define CERTIFICATE_FILE_PATH "mpnw-dtls-test-certificate.pem"
+#define PRIVATE_KEY_FILE_PATH "mpnw-dtls-test-private-key.pem"
+#define BUFFER_SIZE 1500
+#define ECHO_COUNT 100
+#define MAX_PAYLOAD_SIZE 200
+#define DTLS_RECORD_HEADER_SIZE 13
+#define DTLS_HANDSHAKE_TYPE 22
+#define HELLO_VERIFY_REQUEST_TYPE 3
+#define TIMEOUT_TIME 5.0
+
+// Forwards datagrams between the client and the server
+typedef struct Proxy
+{
+	Socket clientSocket;
+	Socket serverSocket;
+	SocketAddress clientAddress;
+	SocketAddress serverAddress;
+	SocketAddress address;
+	bool hasClient;
+	size_t helloVerifyCount;
+	size_t verifyPeerCount;
+} Proxy;
+
+static DatagramServer server = NULL;
+static size_t serverReceiveCount = 0;
+static size_t clientReceiveCount = 0;
+static size_t errorCount = 0;
+
+inline static size_t getMessageSize(size_t index)
+{
+	return 1 + index % MAX_PAYLOAD_SIZE;
+}
+
+static void onServerReceive(
+	DatagramServer server,
+	SocketAddress address,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	serverReceiveCount++;
+
+	// Decrypted datagram is sent back to the peer
+	if (datagramServerSend(
+		server,
+		buffer,
+		byteCount,
+		address) == false)
+	{
+		errorCount++;
+	}
+}
+static void onClientReceive(
+	DatagramClient client,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	// Handshake failure is passed without the buffer
+	if (buffer == NULL)
+	{
+		errorCount++;
+		return;
+	}
+
+	size_t index = clientReceiveCount;
+
+	if (byteCount != getMessageSize(index))
+	{
+		errorCount++;
+		return;
+	}
+
+	for (size_t i = 0; i < byteCount; i++)
+	{
+		if (buffer[i] != (uint8_t)(index + i))
+		{
+			errorCount++;
+			return;
+		}
+	}
+
+	clientReceiveCount++;
+}
+static void onPlainReceive(
+	DatagramClient client,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	errorCount++;
+}
+
+static bool createCertificateFiles()
+{
+	EVP_PKEY_CTX* context = EVP_PKEY_CTX_new_id(
+		EVP_PKEY_EC,
+		NULL);
+
+	if (context == NULL)
+		return false;
+
+	EVP_PKEY* key = NULL;
+
+	if (EVP_PKEY_keygen_init(context) != 1 ||
+		EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+			context, NID_X9_62_prime256v1) != 1 ||
+		EVP_PKEY_keygen(context, &key) != 1)
+	{
+		EVP_PKEY_CTX_free(context);
+		return false;
+	}
+
+	EVP_PKEY_CTX_free(context);
+
+	X509* certificate = X509_new();
+
+	if (certificate == NULL)
+	{
+		EVP_PKEY_free(key);
+		return false;
+	}
+
+	// Self-signed certificate, client does not verify it
+	X509_NAME* name = X509_get_subject_name(certificate);
+
+	ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+	X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+	X509_gmtime_adj(X509_getm_notAfter(certificate), 3600);
+	X509_set_pubkey(certificate, key);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+		(const unsigned char*)LOCALHOST_HOSTNAME, -1, -1, 0);
+	X509_set_issuer_name(certificate, name);
+
+	bool result = X509_sign(certificate, key, EVP_sha256()) != 0;
+
+	FILE* file = fopen(CERTIFICATE_FILE_PATH, "wb");
+
+	if (file != NULL)
+	{
+		result &= PEM_write_X509(file, certificate) == 1;
+		fclose(file);
+	}
+	else
+	{
+		result = false;
+	}
+
+	file = fopen(PRIVATE_KEY_FILE_PATH, "wb");
+
+	if (file != NULL)
+	{
+		result &= PEM_write_PrivateKey(file, key,
+			NULL, NULL, 0, NULL, NULL) == 1;
+		fclose(file);
+	}
+	else
+	{
+		result = false;
+	}
+
+	X509_free(certificate);
+	EVP_PKEY_free(key);
+	return result;
+}
+
+// Ports are allocated by the system, reruns do not collide
+inline static SocketAddress createLoopbackAddress(Socket socket)
+{
+	SocketAddress address = createEmptySocketAddress();
+
+	if (address == NULL)
+		return NULL;
+
+	uint16_t port;
+
+	bool result = getSocketLocalAddress(
+		socket,
+		address);
+	result &= getSocketAddressPort(
+		address,
+		&port);
+
+	destroySocketAddress(address);
+
+	if (result == false)
+		return NULL;
+
+	char service[MAX_NUMERIC_SERVICE_LENGTH];
+
+	snprintf(
+		service,
+		MAX_NUMERIC_SERVICE_LENGTH,
+		"%hu",
+		port);
+
+	return createSocketAddress(
+		LOOPBACK_IP_ADDRESS_V4,
+		service);
+}
+
+inline static Socket createProxySocket()
+{
+	SocketAddress address = createSocketAddress(
+		ANY_IP_ADDRESS_V4,
+		ANY_IP_ADDRESS_PORT);
+
+	if (address == NULL)
+		return NULL;
+
+	Socket socket = createSocket(
+		DATAGRAM_SOCKET_TYPE,
+		IP_V4_ADDRESS_FAMILY,
+		address,
+		false,
+		false,
+		NULL);
+
+	destroySocketAddress(address);
+	return socket;
+}
+
+static void updateProxy(Proxy* proxy)
+{
+	uint8_t buffer[BUFFER_SIZE];
+	size_t byteCount;
+
+	while (socketReceiveFrom(
+		proxy->clientSocket,
+		buffer,
+		BUFFER_SIZE,
+		proxy->clientAddress,
+		&byteCount) == true)
+	{
+		proxy->hasClient = true;
+
+		socketSendTo(
+			proxy->serverSocket,
+			buffer,
+			byteCount,
+			proxy->serverAddress);
+	}
+
+	while (socketReceiveFrom(
+		proxy->serverSocket,
+		buffer,
+		BUFFER_SIZE,
+		proxy->address,
+		&byteCount) == true)
+	{
+		// Record header is followed by the handshake message type
+		if (byteCount > DTLS_RECORD_HEADER_SIZE &&
+			buffer[0] == DTLS_HANDSHAKE_TYPE &&
+			buffer[DTLS_RECORD_HEADER_SIZE] == HELLO_VERIFY_REQUEST_TYPE)
+		{
+			if (proxy->helloVerifyCount++ == 0)
+				proxy->verifyPeerCount = getDatagramServerPeerCount(server);
+		}
+
+		if (proxy->hasClient == true)
+		{
+			socketSendTo(
+				proxy->clientSocket,
+				buffer,
+				byteCount,
+				proxy->clientAddress);
+		}
+	}
+}
+
+// Unverified datagrams should not create peers
+static bool testPlainDatagram(SocketAddress serverAddress)
+{
+	DatagramClient client = createDatagramClient(
+		serverAddress,
+		BUFFER_SIZE,
+		onPlainReceive,
+		NULL,
+		NULL);
+
+	if (client == NULL)
+		return false;
+
+	// Handshake record header without the valid client hello
+	uint8_t datagram[100];
+
+	memset(
+		datagram,
+		0,
+		sizeof(datagram));
+
+	datagram[0] = DTLS_HANDSHAKE_TYPE;
+	datagram[1] = 0xFE;
+	datagram[2] = 0xFD;
+
+	bool result = datagramClientSend(
+		client,
+		datagram,
+		sizeof(datagram));
+
+	for (int i = 0; i < 50; i++)
+	{
+		while (updateDatagramServer(server) == true);
+		while (updateDatagramClient(client) == true);
+		sleepThread(0.001);
+	}
+
+	destroyDatagramClient(client);
+
+	if (result == false || getDatagramServerPeerCount(server) != 0 ||
+		serverReceiveCount != 0)
+	{
+		printf("Unverified datagram created a peer\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool testHandshake(
+	Proxy* proxy,
+	DatagramClient client)
+{
+	double timeoutTime = getCurrentClock() + TIMEOUT_TIME;
+
+	while ((isDatagramClientConnected(client) == false ||
+		getDatagramServerPeerCount(server) == 0) &&
+		isDatagramClientFailed(client) == false &&
+		getCurrentClock() < timeoutTime)
+	{
+		updateProxy(proxy);
+		while (updateDatagramServer(server) == true);
+		updateProxy(proxy);
+		while (updateDatagramClient(client) == true);
+		sleepThread(0.001);
+	}
+
+	printf("DTLS handshake: %zu cookie requests, %zu peers\n",
+		proxy->helloVerifyCount,
+		getDatagramServerPeerCount(server));
+	fflush(stdout);
+
+	// Cookie is requested before the peer is created
+	if (isDatagramClientConnected(client) == false ||
+		getDatagramServerPeerCount(server) != 1 ||
+		proxy->helloVerifyCount == 0 ||
+		proxy->verifyPeerCount != 0)
+	{
+		printf("Failed to establish DTLS connection\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool testEcho(
+	Proxy* proxy,
+	DatagramClient client)
+{
+	uint8_t message[MAX_PAYLOAD_SIZE];
+	double timeoutTime = getCurrentClock() + TIMEOUT_TIME;
+
+	// Each message is echoed before the next one is sent
+	for (size_t i = 0; i < ECHO_COUNT && errorCount == 0; i++)
+	{
+		size_t messageSize = getMessageSize(i);
+
+		for (size_t j = 0; j < messageSize; j++)
+			message[j] = (uint8_t)(i + j);
+
+		if (datagramClientSend(
+			client,
+			message,
+			messageSize) == false)
+		{
+			break;
+		}
+
+		while (clientReceiveCount == i && errorCount == 0 &&
+			getCurrentClock() < timeoutTime)
+		{
+			updateProxy(proxy);
+			while (updateDatagramServer(server) == true);
+			updateProxy(proxy);
+			while (updateDatagramClient(client) == true);
+		}
+	}
+
+	printf("DTLS echo: %zu/%d messages, %zu received by the server\n",
+		clientReceiveCount,
+		ECHO_COUNT,
+		serverReceiveCount);
+	fflush(stdout);
+
+	return clientReceiveCount == ECHO_COUNT &&
+		getDatagramServerPeerCount(server) == 1 &&
+		errorCount == 0;
+}
+
+static bool runTest(SslContext clientContext)
+{
+	Proxy proxy;
+	memset(&proxy, 0, sizeof(Proxy));
+
+	proxy.clientSocket = createProxySocket();
+	proxy.serverSocket = createProxySocket();
+	proxy.clientAddress = createEmptySocketAddress();
+	proxy.address = createEmptySocketAddress();
+	proxy.serverAddress = createLoopbackAddress(
+		getDatagramServerSocket(server));
+
+	SocketAddress proxyAddress = NULL;
+	DatagramClient client = NULL;
+
+	if (proxy.clientSocket != NULL)
+		proxyAddress = createLoopbackAddress(proxy.clientSocket);
+
+	if (proxyAddress != NULL)
+	{
+		client = createDatagramClient(
+			proxyAddress,
+			BUFFER_SIZE,
+			onClientReceive,
+			NULL,
+			clientContext);
+	}
+
+	bool result = false;
+
+	if (client != NULL && proxy.serverSocket != NULL &&
+		proxy.clientAddress != NULL && proxy.address != NULL &&
+		proxy.serverAddress != NULL)
+	{
+		result = testPlainDatagram(proxy.serverAddress);
+		result = result && testHandshake(&proxy, client);
+		result = result && testEcho(&proxy, client);
+	}
+	else
+	{
+		printf("Failed to create client or proxy\n");
+	}
+
+	destroyDatagramClient(client);
+	destroySocketAddress(proxyAddress);
+	destroySocketAddress(proxy.serverAddress);
+	destroySocketAddress(proxy.address);
+	destroySocketAddress(proxy.clientAddress);
+	destroySocket(proxy.serverSocket);
+	destroySocket(proxy.clientSocket);
+	return result;
+}
+
+int main()
+{
+	if (initializeNetwork() == false)
+		return EXIT_FAILURE;
+
+	if (createCertificateFiles() == false)
+	{
+		printf("Failed to create certificate\n");
+		terminateNetwork();
+		return EXIT_FAILURE;
+	}
+
+	SslContext serverContext = createSslContextFromFile(
+		DTLS_SECURITY_PROTOCOL,
+		CERTIFICATE_FILE_PATH,
+		PRIVATE_KEY_FILE_PATH,
+		false);
+	SslContext clientContext = createSslContext(
+		DTLS_SECURITY_PROTOCOL,
+		NULL);
+
+	if (serverContext != NULL)
+	{
+		server = createDatagramServer(
+			IP_V4_ADDRESS_FAMILY,
+			ANY_IP_ADDRESS_PORT,
+			BUFFER_SIZE,
+			onServerReceive,
+			NULL,
+			serverContext);
+	}
+
+	bool result = false;
+
+	if (server != NULL && clientContext != NULL)
+		result = runTest(clientContext);
+	else
+		printf("Failed to create DTLS server\n");
+
+	destroyDatagramServer(server);
+	destroySslContext(clientContext);
+	destroySslContext(serverContext);
+	remove(CERTIFICATE_FILE_PATH);
+	remove(PRIVATE_KEY_FILE_PATH);
+	terminateNetwork();
+
+	if (result == false)
+	{
+		printf("Datagram DTLS test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
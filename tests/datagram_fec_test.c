@@ -0,0 +1,355 @@
+#include "mpnw/datagram_fec.h"
+
+#include "mpmt/thread.h"
+#include <stdio.h>
+
+#define PACKET_SIZE 1200
+#define MAX_MESSAGE_SIZE (PACKET_SIZE - DATAGRAM_FEC_HEADER_SIZE)
+#define MESSAGE_COUNT 20000
+#define COST_MESSAGE_COUNT 200000
+#define TICK_MESSAGE_COUNT 32
+#define SINGLE_LOSS_INTERVAL 20
+
+static const size_t groupSizes[] = {
+	4, 8, 16,
+};
+static const uint32_t lossPercents[] = {
+	1, 5, 10,
+};
+
+static DatagramFec receiver = NULL;
+static uint8_t receivedMessages[MESSAGE_COUNT];
+static uint32_t lossPercent = 0;
+static uint32_t lossState = 1;
+static size_t sentCount = 0;
+static size_t lostCount = 0;
+static size_t errorCount = 0;
+static uint64_t byteSum = 0;
+
+// Deterministic packet loss, parity packets are lost too
+static bool onSend(
+	DatagramFec fec,
+	const uint8_t* buffer,
+	size_t count)
+{
+	sentCount++;
+	lossState = lossState * 1103515245 + 12345;
+
+	if ((lossState >> 16) % 100 < lossPercent)
+	{
+		lostCount++;
+		return true;
+	}
+
+	return datagramFecReceive(
+		receiver,
+		buffer,
+		count);
+}
+static bool onIntervalSend(
+	DatagramFec fec,
+	const uint8_t* buffer,
+	size_t count)
+{
+	// Interval is longer than any group with parity,
+	// so there is at most one lost packet per group
+	if (++sentCount % SINGLE_LOSS_INTERVAL == 4)
+		return true;
+
+	return datagramFecReceive(
+		receiver,
+		buffer,
+		count);
+}
+static void onReceive(
+	DatagramFec fec,
+	const uint8_t* buffer,
+	size_t byteCount,
+	bool isRecovered)
+{
+	uint32_t index;
+
+	if (byteCount < sizeof(uint32_t))
+	{
+		errorCount++;
+		return;
+	}
+
+	memcpy(
+		&index,
+		buffer,
+		sizeof(uint32_t));
+
+	if (index >= MESSAGE_COUNT ||
+		byteCount != sizeof(uint32_t) + index % 300)
+	{
+		errorCount++;
+		return;
+	}
+
+	for (size_t i = sizeof(uint32_t); i < byteCount; i++)
+	{
+		if (buffer[i] != (uint8_t)(index + i))
+		{
+			errorCount++;
+			return;
+		}
+	}
+
+	// Each message should be received once
+	if (receivedMessages[index] != 0)
+		errorCount++;
+
+	receivedMessages[index] = 1;
+}
+static void onCostReceive(
+	DatagramFec fec,
+	const uint8_t* buffer,
+	size_t byteCount,
+	bool isRecovered)
+{
+	byteSum += buffer[0] + byteCount;
+}
+
+static bool sendMessages(DatagramFec sender)
+{
+	uint8_t message[MAX_MESSAGE_SIZE];
+
+	for (uint32_t i = 0; i < MESSAGE_COUNT; i++)
+	{
+		size_t messageSize = sizeof(uint32_t) + i % 300;
+
+		memcpy(
+			message,
+			&i,
+			sizeof(uint32_t));
+
+		for (size_t j = sizeof(uint32_t); j < messageSize; j++)
+			message[j] = (uint8_t)(i + j);
+
+		if (datagramFecSend(
+			sender,
+			message,
+			messageSize) == false)
+		{
+			return false;
+		}
+
+		// Partial groups are flushed at the end of each tick
+		if (i % TICK_MESSAGE_COUNT == TICK_MESSAGE_COUNT - 1 &&
+			flushDatagramFec(sender) == false)
+		{
+			return false;
+		}
+	}
+
+	return flushDatagramFec(sender);
+}
+
+static bool testRecovery(
+	size_t groupSize,
+	uint32_t _lossPercent)
+{
+	DatagramFec sender = createDatagramFec(
+		groupSize,
+		PACKET_SIZE,
+		onSend,
+		onReceive,
+		NULL);
+	receiver = createDatagramFec(
+		groupSize,
+		PACKET_SIZE,
+		onSend,
+		onReceive,
+		NULL);
+
+	bool result = false;
+
+	if (sender != NULL && receiver != NULL)
+	{
+		memset(
+			receivedMessages,
+			0,
+			sizeof(receivedMessages));
+
+		lossPercent = _lossPercent;
+		lossState = 1;
+		sentCount = 0;
+		lostCount = 0;
+		errorCount = 0;
+
+		result = sendMessages(sender);
+	}
+
+	if (result == true)
+	{
+		size_t receivedCount = 0;
+
+		for (size_t i = 0; i < MESSAGE_COUNT; i++)
+			receivedCount += receivedMessages[i];
+
+		uint64_t parityCount, recoveredCount;
+
+		getDatagramFecStats(
+			receiver,
+			&parityCount,
+			&recoveredCount);
+
+		size_t missingCount = MESSAGE_COUNT -
+			(receivedCount - (size_t)recoveredCount);
+
+		printf("Group %zu, %u%% loss: %zu/%d delivered, "
+			"%llu of %zu lost messages recovered (%.1f%%)\n",
+			groupSize,
+			_lossPercent,
+			receivedCount,
+			MESSAGE_COUNT,
+			(unsigned long long)recoveredCount,
+			missingCount,
+			missingCount != 0 ?
+				(double)recoveredCount * 100.0 / (double)missingCount : 0.0);
+		fflush(stdout);
+
+		result = errorCount == 0 && lostCount != 0 &&
+			recoveredCount != 0 && recoveredCount <= missingCount;
+	}
+
+	destroyDatagramFec(receiver);
+	destroyDatagramFec(sender);
+	receiver = NULL;
+	return result;
+}
+
+// Exactly one lost packet per group is always recovered
+static bool testSingleLoss(size_t groupSize)
+{
+	DatagramFec sender = createDatagramFec(
+		groupSize,
+		PACKET_SIZE,
+		onIntervalSend,
+		onReceive,
+		NULL);
+	receiver = createDatagramFec(
+		groupSize,
+		PACKET_SIZE,
+		onIntervalSend,
+		onReceive,
+		NULL);
+
+	bool result = false;
+
+	if (sender != NULL && receiver != NULL)
+	{
+		memset(
+			receivedMessages,
+			0,
+			sizeof(receivedMessages));
+
+		sentCount = 0;
+		errorCount = 0;
+
+		result = sendMessages(sender);
+	}
+
+	if (result == true)
+	{
+		size_t receivedCount = 0;
+
+		for (size_t i = 0; i < MESSAGE_COUNT; i++)
+			receivedCount += receivedMessages[i];
+
+		result = errorCount == 0 && receivedCount == MESSAGE_COUNT;
+	}
+
+	destroyDatagramFec(receiver);
+	destroyDatagramFec(sender);
+	receiver = NULL;
+	return result;
+}
+
+static bool measureCost(size_t groupSize)
+{
+	DatagramFec sender = createDatagramFec(
+		groupSize,
+		PACKET_SIZE,
+		onIntervalSend,
+		onCostReceive,
+		NULL);
+	receiver = createDatagramFec(
+		groupSize,
+		PACKET_SIZE,
+		onIntervalSend,
+		onCostReceive,
+		NULL);
+
+	bool result = sender != NULL && receiver != NULL;
+
+	if (result == true)
+	{
+		uint8_t message[MAX_MESSAGE_SIZE];
+
+		memset(
+			message,
+			7,
+			MAX_MESSAGE_SIZE);
+
+		sentCount = 0;
+		byteSum = 0;
+
+		double startTime = getCurrentClock();
+
+		for (size_t i = 0; i < COST_MESSAGE_COUNT; i++)
+		{
+			result &= datagramFecSend(
+				sender,
+				message,
+				MAX_MESSAGE_SIZE);
+		}
+
+		double elapsedTime = getCurrentClock() - startTime;
+
+		printf("Group %zu encode and decode: %.1f ns per message, "
+			"%.2f GB/s (sum %llu)\n",
+			groupSize,
+			elapsedTime * 1000000000.0 / COST_MESSAGE_COUNT,
+			(double)COST_MESSAGE_COUNT * MAX_MESSAGE_SIZE /
+				elapsedTime / 1000000000.0,
+			(unsigned long long)byteSum);
+		fflush(stdout);
+	}
+
+	destroyDatagramFec(receiver);
+	destroyDatagramFec(sender);
+	receiver = NULL;
+	return result;
+}
+
+int main()
+{
+	bool result = true;
+
+	size_t groupSizeCount = sizeof(groupSizes) / sizeof(size_t);
+	size_t lossPercentCount = sizeof(lossPercents) / sizeof(uint32_t);
+
+	for (size_t i = 0; i < groupSizeCount; i++)
+	{
+		result &= testSingleLoss(groupSizes[i]);
+
+		for (size_t j = 0; j < lossPercentCount; j++)
+		{
+			result &= testRecovery(
+				groupSizes[i],
+				lossPercents[j]);
+		}
+
+		result &= measureCost(groupSizes[i]);
+	}
+
+	if (result == false)
+	{
+		printf("Datagram FEC test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
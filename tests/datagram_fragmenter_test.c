@@ -0,0 +1,233 @@
+#include "mpnw/datagram_fragmenter.h"
+
+#include <stdio.h>
+
+#define MAX_MESSAGE_SIZE 16384
+#define REASSEMBLY_COUNT 4
+#define TIMEOUT_TIME 1.0
+#define MESSAGE_COUNT 64
+
+static DatagramFragmenter receiver = NULL;
+static uint8_t messageBuffer[MAX_MESSAGE_SIZE];
+static size_t receivedSize = 0;
+static size_t receivedCount = 0;
+
+static bool onSend(
+	DatagramFragmenter fragmenter,
+	const uint8_t* buffer,
+	size_t count)
+{
+	return datagramFragmenterReceive(
+		receiver,
+		buffer,
+		count);
+}
+static bool onReceiverSend(
+	DatagramFragmenter fragmenter,
+	const uint8_t* buffer,
+	size_t count)
+{
+	return true;
+}
+static void onReceive(
+	DatagramFragmenter fragmenter,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	memcpy(
+		messageBuffer,
+		buffer,
+		byteCount);
+
+	receivedSize = byteCount;
+	receivedCount++;
+}
+
+static bool testMessages(DatagramFragmenter sender)
+{
+	uint8_t message[MAX_MESSAGE_SIZE];
+
+	for (size_t i = 0; i < MESSAGE_COUNT; i++)
+	{
+		size_t messageSize = 1 + (i * 7919) % MAX_MESSAGE_SIZE;
+
+		for (size_t j = 0; j < messageSize; j++)
+			message[j] = (uint8_t)(i + j * 31);
+
+		receivedCount = 0;
+
+		if (datagramFragmenterSend(
+			sender,
+			message,
+			messageSize) == false)
+		{
+			return false;
+		}
+
+		if (receivedCount != 1 || receivedSize != messageSize ||
+			memcmp(messageBuffer, message, messageSize) != 0)
+		{
+			printf("Message %zu is not reassembled\n", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+inline static void writeFragment(
+	uint8_t* packet,
+	uint16_t messageID,
+	uint16_t fragmentIndex,
+	uint16_t fragmentCount,
+	uint32_t messageSize)
+{
+	messageID = hostToNet16(messageID);
+	fragmentIndex = hostToNet16(fragmentIndex);
+	fragmentCount = hostToNet16(fragmentCount);
+	messageSize = hostToNet32(messageSize);
+
+	// Fragment packet type
+	packet[0] = 1;
+
+	memcpy(
+		packet + 1,
+		&messageID,
+		sizeof(uint16_t));
+	memcpy(
+		packet + 3,
+		&fragmentIndex,
+		sizeof(uint16_t));
+	memcpy(
+		packet + 5,
+		&fragmentCount,
+		sizeof(uint16_t));
+	memcpy(
+		packet + 7,
+		&messageSize,
+		sizeof(uint32_t));
+}
+
+// Fragments with the inconsistent sizes should not leave gaps
+static bool testCraftedFragments()
+{
+	uint8_t packet[DATAGRAM_FRAGMENT_HEADER_SIZE + 1000];
+
+	memset(
+		packet,
+		0xAA,
+		sizeof(packet));
+
+	receivedCount = 0;
+
+	writeFragment(
+		packet,
+		1000,
+		0,
+		3,
+		2500);
+
+	bool result = datagramFragmenterReceive(
+		receiver,
+		packet,
+		DATAGRAM_FRAGMENT_HEADER_SIZE + 1000);
+
+	writeFragment(
+		packet,
+		1000,
+		1,
+		3,
+		2500);
+
+	result &= !datagramFragmenterReceive(
+		receiver,
+		packet,
+		DATAGRAM_FRAGMENT_HEADER_SIZE + 100);
+
+	writeFragment(
+		packet,
+		1000,
+		2,
+		3,
+		2500);
+
+	result &= datagramFragmenterReceive(
+		receiver,
+		packet,
+		DATAGRAM_FRAGMENT_HEADER_SIZE + 500);
+
+	// Last fragment size is not the message remainder
+	writeFragment(
+		packet,
+		1001,
+		2,
+		3,
+		2500);
+
+	result &= !datagramFragmenterReceive(
+		receiver,
+		packet,
+		DATAGRAM_FRAGMENT_HEADER_SIZE + 499);
+
+	// Fragment count does not cover the message size
+	writeFragment(
+		packet,
+		1002,
+		0,
+		2,
+		2500);
+
+	result &= !datagramFragmenterReceive(
+		receiver,
+		packet,
+		DATAGRAM_FRAGMENT_HEADER_SIZE + 1000);
+
+	if (result == false || receivedCount != 0)
+	{
+		printf("Inconsistent fragments are accepted\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	receiver = createDatagramFragmenter(
+		MIN_DATAGRAM_PACKET_SIZE,
+		MIN_DATAGRAM_PACKET_SIZE,
+		MAX_MESSAGE_SIZE,
+		REASSEMBLY_COUNT,
+		TIMEOUT_TIME,
+		onReceiverSend,
+		onReceive,
+		NULL);
+	DatagramFragmenter sender = createDatagramFragmenter(
+		MIN_DATAGRAM_PACKET_SIZE,
+		MIN_DATAGRAM_PACKET_SIZE,
+		MAX_MESSAGE_SIZE,
+		REASSEMBLY_COUNT,
+		TIMEOUT_TIME,
+		onSend,
+		onReceive,
+		NULL);
+
+	bool result = false;
+
+	if (receiver != NULL && sender != NULL)
+	{
+		result = testMessages(sender);
+		result &= testCraftedFragments();
+	}
+
+	destroyDatagramFragmenter(sender);
+	destroyDatagramFragmenter(receiver);
+
+	if (result == false)
+	{
+		printf("Datagram fragmenter test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
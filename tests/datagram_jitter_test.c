@@ -0,0 +1,255 @@
+#include "mpnw/datagram_jitter.h"
+
+#include "mpmt/thread.h"
+#include <stdio.h>
+
+#define FRAME_COUNT 16
+#define FRAME_SIZE 64
+#define MAX_PLAYED_COUNT 64
+#define FIRST_SEQUENCE 65530
+#define NO_LOST_SEQUENCE 30000
+// Frames are never due during the test
+#define LONG_DELAY 1000.0
+
+typedef struct PlayedFrame
+{
+	uint16_t sequence;
+	bool isLost;
+} PlayedFrame;
+
+static PlayedFrame playedFrames[MAX_PLAYED_COUNT];
+static size_t playedCount = 0;
+static size_t errorCount = 0;
+
+inline static size_t getFrameSize(uint16_t sequence)
+{
+	return 1 + sequence % FRAME_SIZE;
+}
+
+static void onFrame(
+	DatagramJitter jitter,
+	uint16_t sequence,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	if (playedCount == MAX_PLAYED_COUNT)
+	{
+		errorCount++;
+		return;
+	}
+
+	if (buffer != NULL)
+	{
+		if (byteCount != getFrameSize(sequence))
+			errorCount++;
+
+		for (size_t i = 0; i < byteCount; i++)
+		{
+			if (buffer[i] != (uint8_t)(sequence + i))
+			{
+				errorCount++;
+				break;
+			}
+		}
+	}
+	else if (byteCount != 0)
+	{
+		errorCount++;
+	}
+
+	playedFrames[playedCount].sequence = sequence;
+	playedFrames[playedCount].isLost = buffer == NULL;
+	playedCount++;
+}
+
+// All frames share the timestamp, transit time stays constant
+static bool pushFrame(
+	DatagramJitter jitter,
+	uint16_t sequence,
+	double timestamp)
+{
+	uint8_t frame[FRAME_SIZE];
+	size_t frameSize = getFrameSize(sequence);
+
+	for (size_t i = 0; i < frameSize; i++)
+		frame[i] = (uint8_t)(sequence + i);
+
+	return datagramJitterPush(
+		jitter,
+		sequence,
+		timestamp,
+		frame,
+		frameSize);
+}
+
+// Played frames since the index, lost frames have the flag set
+static bool checkPlayed(
+	size_t index,
+	uint16_t sequence,
+	size_t count,
+	uint16_t lostSequence)
+{
+	if (playedCount != index + count || errorCount != 0)
+		return false;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		PlayedFrame* frame = &playedFrames[index + i];
+		uint16_t frameSequence = (uint16_t)(sequence + i);
+
+		if (frame->sequence != frameSequence ||
+			frame->isLost != (frameSequence == lostSequence))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool testPlayout(double timestamp)
+{
+	DatagramJitter jitter = createDatagramJitter(
+		FRAME_COUNT,
+		FRAME_SIZE,
+		0.0,
+		0.0,
+		onFrame,
+		NULL);
+
+	if (jitter == NULL)
+		return false;
+
+	uint16_t sequence = FIRST_SEQUENCE;
+	bool result = true;
+
+	// First frame starts the playout, next ones are reordered
+	result &= pushFrame(jitter, sequence, timestamp);
+
+	for (uint16_t i = 1; i < 7; i += 2)
+	{
+		result &= pushFrame(jitter, sequence + i + 1, timestamp);
+		result &= pushFrame(jitter, sequence + i, timestamp);
+	}
+
+	result &= pushFrame(jitter, sequence + 7, timestamp);
+
+	// Frames are played across the sequence wrap
+	updateDatagramJitter(jitter);
+	result &= checkPlayed(0, sequence, 8, NO_LOST_SEQUENCE);
+
+	if (result == false)
+	{
+		printf("Frames are not played in order\n");
+		destroyDatagramJitter(jitter);
+		return false;
+	}
+
+	// Missing frame is played as lost when the next one is due
+	sequence += 8;
+	result &= pushFrame(jitter, sequence, timestamp);
+	result &= pushFrame(jitter, sequence + 2, timestamp);
+
+	updateDatagramJitter(jitter);
+	result &= checkPlayed(8, sequence, 3, sequence + 1);
+
+	// Frame arrived after the playout is counted as late
+	result &= pushFrame(jitter, sequence + 1, timestamp);
+	updateDatagramJitter(jitter);
+	result &= checkPlayed(8, sequence, 3, sequence + 1);
+
+	uint64_t lateCount, lostCount;
+
+	getDatagramJitterStats(
+		jitter,
+		&lateCount,
+		&lostCount);
+
+	if (result == false || lateCount != 1 || lostCount != 1)
+	{
+		printf("Lost or late frames are not counted\n");
+		destroyDatagramJitter(jitter);
+		return false;
+	}
+
+	// Buffered frames are flushed when the stream jumps ahead
+	sequence += 3;
+	result &= pushFrame(jitter, sequence, timestamp + LONG_DELAY);
+	result &= pushFrame(jitter, sequence + 1, timestamp + LONG_DELAY);
+
+	updateDatagramJitter(jitter);
+	result &= checkPlayed(11, sequence, 0, NO_LOST_SEQUENCE);
+
+	uint16_t jumpSequence = sequence + FRAME_COUNT + 5;
+	result &= pushFrame(jitter, jumpSequence, timestamp);
+	result &= checkPlayed(11, sequence, 2, NO_LOST_SEQUENCE);
+
+	updateDatagramJitter(jitter);
+	result &= checkPlayed(13, jumpSequence, 1, NO_LOST_SEQUENCE);
+
+	getDatagramJitterStats(
+		jitter,
+		&lateCount,
+		&lostCount);
+
+	destroyDatagramJitter(jitter);
+
+	// Skipped frames between the flushed and the new one are lost
+	if (result == false || lostCount != 1 + FRAME_COUNT + 3)
+	{
+		printf("Jumped ahead stream is not flushed\n");
+		return false;
+	}
+
+	return true;
+}
+
+// Frames are held until their playout delay is passed
+static bool testDelay(double timestamp)
+{
+	DatagramJitter jitter = createDatagramJitter(
+		FRAME_COUNT,
+		FRAME_SIZE,
+		LONG_DELAY,
+		LONG_DELAY,
+		onFrame,
+		NULL);
+
+	if (jitter == NULL)
+		return false;
+
+	playedCount = 0;
+
+	bool result = pushFrame(jitter, 1, timestamp);
+	result &= pushFrame(jitter, 2, timestamp);
+
+	updateDatagramJitter(jitter);
+	result &= playedCount == 0;
+	result &= getDatagramJitterPlayoutDelay(jitter) == LONG_DELAY;
+
+	destroyDatagramJitter(jitter);
+
+	if (result == false)
+	{
+		printf("Frames are played before the delay\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	double timestamp = getCurrentClock();
+
+	bool result = testPlayout(timestamp);
+	result &= testDelay(timestamp);
+
+	if (result == false)
+	{
+		printf("Datagram jitter test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+#include "mpnw/datagram_pacer.h"
+
+#include <stdio.h>
+
+#define QUEUE_SIZE 100
+#define BURST_SIZE 1000
+#define MAX_PACKET_SIZE 1200
+#define MAX_SENT_COUNT 16
+// Refill is negligible during the test, token debt stays
+#define SLOW_RATE 1.0
+
+static size_t sentIDs[MAX_SENT_COUNT];
+static size_t sentCount = 0;
+static size_t errorCount = 0;
+
+static bool onSend(
+	DatagramPacer pacer,
+	const uint8_t* buffer,
+	size_t count)
+{
+	// Packet ID is in the first byte, followed by the pattern
+	size_t id = buffer[0];
+
+	for (size_t i = 1; i < count; i++)
+	{
+		if (buffer[i] != (uint8_t)(id + i))
+		{
+			errorCount++;
+			break;
+		}
+	}
+
+	if (sentCount == MAX_SENT_COUNT)
+	{
+		errorCount++;
+		return true;
+	}
+
+	sentIDs[sentCount++] = id;
+	return true;
+}
+
+static bool sendPacket(
+	DatagramPacer pacer,
+	uint8_t id,
+	size_t count)
+{
+	uint8_t packet[MAX_PACKET_SIZE];
+	packet[0] = id;
+
+	for (size_t i = 1; i < count; i++)
+		packet[i] = (uint8_t)(id + i);
+
+	return datagramPacerSend(
+		pacer,
+		packet,
+		count);
+}
+
+static bool checkSent(
+	const size_t* ids,
+	size_t count)
+{
+	if (sentCount != count || errorCount != 0)
+		return false;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (sentIDs[i] != ids[i])
+			return false;
+	}
+
+	return true;
+}
+
+// Full bucket sends big packet at once, then queues behind the debt
+static bool testTokenDebt(DatagramPacer pacer)
+{
+	setDatagramPacerRate(
+		pacer,
+		SLOW_RATE);
+
+	bool result = sendPacket(pacer, 1, MAX_PACKET_SIZE);
+	result &= getDatagramPacerQueuedSize(pacer) == 0;
+
+	// Each packet is queued with the 2 byte length prefix
+	result &= sendPacket(pacer, 2, 31);
+	result &= sendPacket(pacer, 3, 31);
+	result &= sendPacket(pacer, 4, 31);
+	result &= getDatagramPacerQueuedSize(pacer) == 99;
+	result &= !sendPacket(pacer, 5, 1);
+
+	const size_t firstIDs[] = { 1 };
+	result &= updateDatagramPacer(pacer);
+	result &= checkSent(firstIDs, 1);
+
+	// Debt of the big packet is paid in about 200 seconds
+	result &= getDatagramPacerDelayTime(pacer) > 100.0;
+
+	if (result == false)
+	{
+		printf("Token debt does not queue packets\n");
+		return false;
+	}
+
+	// Disabled pacing drains the queue in the send order
+	setDatagramPacerRate(
+		pacer,
+		0.0);
+
+	const size_t drainIDs[] = { 1, 2, 3, 4 };
+	result = updateDatagramPacer(pacer);
+	result &= checkSent(drainIDs, 4);
+	result &= getDatagramPacerQueuedSize(pacer) == 0;
+
+	if (result == false)
+	{
+		printf("Queued packets are not drained in order\n");
+		return false;
+	}
+
+	return true;
+}
+
+// Queue offset is now 99, next length prefix is split by the wrap
+static bool testQueueWrap(DatagramPacer pacer)
+{
+	setDatagramPacerRate(
+		pacer,
+		SLOW_RATE);
+
+	bool result = sendPacket(pacer, 6, 40);
+	result &= sendPacket(pacer, 7, 50);
+	result &= getDatagramPacerQueuedSize(pacer) == 94;
+
+	const size_t queuedIDs[] = { 1, 2, 3, 4 };
+	result &= updateDatagramPacer(pacer);
+	result &= checkSent(queuedIDs, 4);
+
+	setDatagramPacerRate(
+		pacer,
+		0.0);
+
+	const size_t drainIDs[] = { 1, 2, 3, 4, 6, 7 };
+	result &= updateDatagramPacer(pacer);
+	result &= checkSent(drainIDs, 6);
+
+	// Empty queue without pacing sends at once
+	const size_t directIDs[] = { 1, 2, 3, 4, 6, 7, 8 };
+	result &= sendPacket(pacer, 8, 10);
+	result &= checkSent(directIDs, 7);
+
+	if (result == false)
+	{
+		printf("Wrapped queue packets are corrupted\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	DatagramPacer pacer = createDatagramPacer(
+		QUEUE_SIZE,
+		BURST_SIZE,
+		onSend,
+		NULL);
+
+	bool result = false;
+
+	if (pacer != NULL)
+	{
+		result = testTokenDebt(pacer);
+		result = result && testQueueWrap(pacer);
+	}
+
+	destroyDatagramPacer(pacer);
+
+	if (result == false)
+	{
+		printf("Datagram pacer test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,328 @@
+#include "mpnw/datagram_snapshot.h"
+
+#include <stdio.h>
+
+// Not a multiple of the diff block and word sizes
+#define STATE_SIZE 4005
+#define HISTORY_COUNT 32
+#define TICK_COUNT 2000
+#define CHANGE_COUNT 40
+#define LOSS_PERCENT 20
+#define SMALL_STATE_SIZE 20
+
+static DatagramSnapshot sender = NULL;
+static DatagramSnapshot receiver = NULL;
+static uint8_t sentStates[HISTORY_COUNT][STATE_SIZE];
+static uint32_t lossPercent = 0;
+static uint32_t lossState = 1;
+static size_t lostCount = 0;
+static size_t receivedCount = 0;
+static size_t errorCount = 0;
+static uint16_t lastSequence = 0;
+static uint8_t lastState[SMALL_STATE_SIZE];
+
+// Deterministic packet loss, acknowledgements are lost too
+inline static bool isPacketLost()
+{
+	lossState = lossState * 1103515245 + 12345;
+
+	if ((lossState >> 16) % 100 < lossPercent)
+	{
+		lostCount++;
+		return true;
+	}
+
+	return false;
+}
+
+static bool onSenderSend(
+	DatagramSnapshot snapshot,
+	const uint8_t* buffer,
+	size_t count)
+{
+	if (isPacketLost() == true)
+		return true;
+
+	return datagramSnapshotReceive(
+		receiver,
+		buffer,
+		count);
+}
+static bool onReceiverSend(
+	DatagramSnapshot snapshot,
+	const uint8_t* buffer,
+	size_t count)
+{
+	if (isPacketLost() == true)
+		return true;
+
+	if (datagramSnapshotReceive(
+		sender,
+		buffer,
+		count) == false)
+	{
+		errorCount++;
+	}
+
+	return true;
+}
+static bool onSmallSend(
+	DatagramSnapshot snapshot,
+	const uint8_t* buffer,
+	size_t count)
+{
+	return true;
+}
+
+static void onReceive(
+	DatagramSnapshot snapshot,
+	uint16_t sequence,
+	const uint8_t* state)
+{
+	// Reconstructed state should be equal to the sent one
+	if (memcmp(state, sentStates[sequence % HISTORY_COUNT], STATE_SIZE) != 0)
+		errorCount++;
+
+	receivedCount++;
+}
+static void onSmallReceive(
+	DatagramSnapshot snapshot,
+	uint16_t sequence,
+	const uint8_t* state)
+{
+	memcpy(
+		lastState,
+		state,
+		SMALL_STATE_SIZE);
+
+	lastSequence = sequence;
+	receivedCount++;
+}
+
+static bool testSnapshots(uint32_t _lossPercent)
+{
+	sender = createDatagramSnapshot(
+		true,
+		STATE_SIZE,
+		HISTORY_COUNT,
+		onSenderSend,
+		NULL,
+		NULL);
+	receiver = createDatagramSnapshot(
+		false,
+		STATE_SIZE,
+		HISTORY_COUNT,
+		onReceiverSend,
+		onReceive,
+		NULL);
+
+	bool result = sender != NULL && receiver != NULL;
+
+	if (result == true)
+	{
+		uint8_t state[STATE_SIZE];
+		uint32_t changeState = 7;
+
+		memset(
+			state,
+			0,
+			STATE_SIZE);
+
+		lossPercent = _lossPercent;
+		lossState = 1;
+		lostCount = 0;
+		receivedCount = 0;
+		errorCount = 0;
+
+		for (size_t i = 0; i < TICK_COUNT; i++)
+		{
+			// Few random bytes change, including the state tail
+			for (size_t j = 0; j < CHANGE_COUNT; j++)
+			{
+				changeState = changeState * 1103515245 + 12345;
+				state[(changeState >> 8) % STATE_SIZE] = (uint8_t)changeState;
+			}
+
+			state[STATE_SIZE - 1] = (uint8_t)i;
+
+			memcpy(
+				sentStates[i % HISTORY_COUNT],
+				state,
+				STATE_SIZE);
+
+			result &= datagramSnapshotSend(
+				sender,
+				state);
+		}
+
+		uint64_t stateByteCount, packetByteCount;
+
+		getDatagramSnapshotStats(
+			sender,
+			&stateByteCount,
+			&packetByteCount);
+
+		printf("%u%% loss: %zu/%d snapshots received, "
+			"%.1fx smaller than the full state\n",
+			_lossPercent,
+			receivedCount,
+			TICK_COUNT,
+			(double)stateByteCount / (double)packetByteCount);
+		fflush(stdout);
+
+		// Most snapshots are delta encoded against the baseline
+		result &= errorCount == 0 && receivedCount != 0 &&
+			packetByteCount * 10 < stateByteCount;
+
+		if (_lossPercent != 0)
+			result &= lostCount != 0 && receivedCount < TICK_COUNT;
+		else
+			result &= receivedCount == TICK_COUNT;
+	}
+
+	destroyDatagramSnapshot(receiver);
+	destroyDatagramSnapshot(sender);
+	receiver = NULL;
+	sender = NULL;
+	return result;
+}
+
+inline static size_t writeStateHeader(
+	uint8_t* packet,
+	uint16_t sequence)
+{
+	sequence = hostToNet16(sequence);
+
+	// State packet type, encoded against the zero state
+	packet[0] = 0;
+
+	memcpy(
+		packet + 1,
+		&sequence,
+		sizeof(uint16_t));
+	memcpy(
+		packet + 3,
+		&sequence,
+		sizeof(uint16_t));
+	return DATAGRAM_SNAPSHOT_HEADER_SIZE;
+}
+
+// Small state has three words, the last one is 4 bytes
+static bool testMalformedDeltas()
+{
+	DatagramSnapshot snapshot = createDatagramSnapshot(
+		false,
+		SMALL_STATE_SIZE,
+		HISTORY_COUNT,
+		onSmallSend,
+		onSmallReceive,
+		NULL);
+
+	if (snapshot == NULL)
+		return false;
+
+	uint8_t packet[64];
+	size_t size;
+	receivedCount = 0;
+
+	// Word mask bit after the last word
+	size = writeStateHeader(packet, 1);
+	packet[size++] = 0x08;
+	packet[size++] = 0x01;
+	packet[size++] = 0x55;
+
+	bool result = !datagramSnapshotReceive(
+		snapshot,
+		packet,
+		size);
+
+	// Changed word without changed bytes
+	size = writeStateHeader(packet, 2);
+	packet[size++] = 0x01;
+	packet[size++] = 0x00;
+
+	result &= !datagramSnapshotReceive(
+		snapshot,
+		packet,
+		size);
+
+	// Byte mask after the end of the last word
+	size = writeStateHeader(packet, 3);
+	packet[size++] = 0x04;
+	packet[size++] = 0x10;
+	packet[size++] = 0x55;
+
+	result &= !datagramSnapshotReceive(
+		snapshot,
+		packet,
+		size);
+
+	// Truncated changed bytes
+	size = writeStateHeader(packet, 4);
+	packet[size++] = 0x01;
+	packet[size++] = 0x03;
+	packet[size++] = 0x55;
+
+	result &= !datagramSnapshotReceive(
+		snapshot,
+		packet,
+		size);
+
+	// Trailing bytes after the delta
+	size = writeStateHeader(packet, 5);
+	packet[size++] = 0x01;
+	packet[size++] = 0x01;
+	packet[size++] = 0x55;
+	packet[size++] = 0x55;
+
+	result &= !datagramSnapshotReceive(
+		snapshot,
+		packet,
+		size);
+
+	if (result == false || receivedCount != 0)
+	{
+		printf("Malformed delta is accepted\n");
+		destroyDatagramSnapshot(snapshot);
+		return false;
+	}
+
+	// Changed first and last bytes of the state
+	size = writeStateHeader(packet, 6);
+	packet[size++] = 0x05;
+	packet[size++] = 0x01;
+	packet[size++] = 0x12;
+	packet[size++] = 0x08;
+	packet[size++] = 0x34;
+
+	result = datagramSnapshotReceive(
+		snapshot,
+		packet,
+		size);
+
+	destroyDatagramSnapshot(snapshot);
+
+	if (result == false || receivedCount != 1 || lastSequence != 6 ||
+		lastState[0] != 0x12 || lastState[SMALL_STATE_SIZE - 1] != 0x34)
+	{
+		printf("Valid delta is not decoded\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	bool result = testSnapshots(0);
+	result &= testSnapshots(LOSS_PERCENT);
+	result &= testMalformedDeltas();
+
+	if (result == false)
+	{
+		printf("Datagram snapshot test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
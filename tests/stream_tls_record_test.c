@@ -0,0 +1,538 @@
+#include "mpnw/stream_server.h"
+
+#include "mpmt/thread.h"
+#include "openssl/pem.h"
+#include "openssl/x509.h"
+#include <stdio.h>
+
+#define CERTIFICATE_FILE_PATH "mpnw-tls-record-test-certificate.pem"
+#define PRIVATE_KEY_FILE_PATH "mpnw-tls-record-test-private-key.pem"
+#define FRAME_COUNT 4
+#define PROXY_BUFFER_SIZE 65536
+#define TLS_RECORD_HEADER_SIZE 5
+#define TLS_APPLICATION_DATA_TYPE 23
+#define TIMEOUT_TIME 5.0
+
+// Counts server TLS records passing through the proxy
+typedef struct RecordCounter
+{
+	uint8_t header[TLS_RECORD_HEADER_SIZE];
+	size_t headerSize;
+	size_t recordSize;
+	size_t recordCount;
+} RecordCounter;
+
+static StreamSession serverSession = NULL;
+
+static bool onSessionCreate(
+	StreamServer server,
+	StreamSession session,
+	void** handle)
+{
+	serverSession = session;
+	return true;
+}
+static void onSessionDestroy(
+	StreamServer server,
+	StreamSession session)
+{
+	serverSession = NULL;
+}
+static bool onSessionUpdate(
+	StreamServer server,
+	StreamSession session)
+{
+	return true;
+}
+static bool onSessionReceive(
+	StreamServer server,
+	StreamSession session,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	return byteCount != 0;
+}
+
+static bool createCertificateFiles()
+{
+	EVP_PKEY_CTX* context = EVP_PKEY_CTX_new_id(
+		EVP_PKEY_EC,
+		NULL);
+
+	if (context == NULL)
+		return false;
+
+	EVP_PKEY* key = NULL;
+
+	if (EVP_PKEY_keygen_init(context) != 1 ||
+		EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+			context, NID_X9_62_prime256v1) != 1 ||
+		EVP_PKEY_keygen(context, &key) != 1)
+	{
+		EVP_PKEY_CTX_free(context);
+		return false;
+	}
+
+	EVP_PKEY_CTX_free(context);
+
+	X509* certificate = X509_new();
+
+	if (certificate == NULL)
+	{
+		EVP_PKEY_free(key);
+		return false;
+	}
+
+	// Self-signed certificate, client does not verify it
+	X509_NAME* name = X509_get_subject_name(certificate);
+
+	ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+	X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+	X509_gmtime_adj(X509_getm_notAfter(certificate), 3600);
+	X509_set_pubkey(certificate, key);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+		(const unsigned char*)LOCALHOST_HOSTNAME, -1, -1, 0);
+	X509_set_issuer_name(certificate, name);
+
+	bool result = X509_sign(certificate, key, EVP_sha256()) != 0;
+
+	FILE* file = fopen(CERTIFICATE_FILE_PATH, "wb");
+
+	if (file != NULL)
+	{
+		result &= PEM_write_X509(file, certificate) == 1;
+		fclose(file);
+	}
+	else
+	{
+		result = false;
+	}
+
+	file = fopen(PRIVATE_KEY_FILE_PATH, "wb");
+
+	if (file != NULL)
+	{
+		result &= PEM_write_PrivateKey(file, key,
+			NULL, NULL, 0, NULL, NULL) == 1;
+		fclose(file);
+	}
+	else
+	{
+		result = false;
+	}
+
+	X509_free(certificate);
+	EVP_PKEY_free(key);
+	return result;
+}
+
+// Ports are allocated by the system, reruns do not collide
+inline static bool getLocalService(
+	Socket socket,
+	char* service)
+{
+	SocketAddress address = createEmptySocketAddress();
+
+	if (address == NULL)
+		return false;
+
+	uint16_t port;
+
+	bool result = getSocketLocalAddress(
+		socket,
+		address);
+	result &= getSocketAddressPort(
+		address,
+		&port);
+
+	destroySocketAddress(address);
+
+	if (result == false)
+		return false;
+
+	snprintf(
+		service,
+		MAX_NUMERIC_SERVICE_LENGTH,
+		"%hu",
+		port);
+	return true;
+}
+
+inline static Socket createConnectingSocket(
+	SslContext sslContext,
+	const char* service)
+{
+	SocketAddress localAddress = createSocketAddress(
+		ANY_IP_ADDRESS_V4,
+		ANY_IP_ADDRESS_PORT);
+
+	if (localAddress == NULL)
+		return NULL;
+
+	Socket socket = createSocket(
+		STREAM_SOCKET_TYPE,
+		IP_V4_ADDRESS_FAMILY,
+		localAddress,
+		false,
+		false,
+		sslContext);
+
+	destroySocketAddress(localAddress);
+
+	if (socket == NULL)
+		return NULL;
+
+	SocketAddress remoteAddress = createSocketAddress(
+		LOOPBACK_IP_ADDRESS_V4,
+		service);
+
+	if (remoteAddress == NULL)
+	{
+		destroySocket(socket);
+		return NULL;
+	}
+
+	// Non-blocking connection is completed by the listen backlog
+	bool result = false;
+	double timeoutTime = getCurrentClock() + TIMEOUT_TIME;
+
+	while (result == false && getCurrentClock() < timeoutTime)
+	{
+		result = connectSocket(
+			socket,
+			remoteAddress);
+	}
+
+	destroySocketAddress(remoteAddress);
+
+	if (result == false)
+	{
+		destroySocket(socket);
+		return NULL;
+	}
+
+	return socket;
+}
+
+static void countRecords(
+	RecordCounter* counter,
+	const uint8_t* buffer,
+	size_t byteCount)
+{
+	size_t offset = 0;
+
+	while (offset < byteCount)
+	{
+		if (counter->recordSize != 0)
+		{
+			size_t size = byteCount - offset;
+
+			if (size > counter->recordSize)
+				size = counter->recordSize;
+
+			counter->recordSize -= size;
+			offset += size;
+			continue;
+		}
+
+		counter->header[counter->headerSize++] = buffer[offset++];
+
+		if (counter->headerSize < TLS_RECORD_HEADER_SIZE)
+			continue;
+
+		// Type, version and big-endian length
+		if (counter->header[0] == TLS_APPLICATION_DATA_TYPE)
+			counter->recordCount++;
+
+		counter->recordSize = ((size_t)counter->header[3] << 8) |
+			counter->header[4];
+		counter->headerSize = 0;
+	}
+}
+
+static bool forwardData(
+	Socket receiveSocket,
+	Socket sendSocket,
+	uint8_t* buffer,
+	RecordCounter* counter)
+{
+	size_t byteCount;
+
+	bool result = socketReceive(
+		receiveSocket,
+		buffer,
+		PROXY_BUFFER_SIZE,
+		&byteCount);
+
+	if (result == false || byteCount == 0)
+		return true;
+
+	if (counter != NULL)
+	{
+		countRecords(
+			counter,
+			buffer,
+			byteCount);
+	}
+
+	return socketSend(
+		sendSocket,
+		buffer,
+		byteCount);
+}
+
+typedef struct Proxy
+{
+	StreamServer server;
+	Socket clientSocket;
+	Socket upstreamSocket;
+	uint8_t* buffer;
+	RecordCounter counter;
+} Proxy;
+
+static bool updateProxy(Proxy* proxy)
+{
+	updateStreamServer(proxy->server);
+
+	bool result = forwardData(
+		proxy->clientSocket,
+		proxy->upstreamSocket,
+		proxy->buffer,
+		NULL);
+	result &= forwardData(
+		proxy->upstreamSocket,
+		proxy->clientSocket,
+		proxy->buffer,
+		&proxy->counter);
+	return result;
+}
+
+static bool runTest(
+	StreamServer server,
+	Socket proxySocket,
+	SslContext clientContext)
+{
+	char serverService[MAX_NUMERIC_SERVICE_LENGTH];
+	char proxyService[MAX_NUMERIC_SERVICE_LENGTH];
+
+	bool result = getLocalService(
+		getStreamServerSocket(server),
+		serverService);
+	result &= getLocalService(
+		proxySocket,
+		proxyService);
+
+	if (result == false)
+		return false;
+
+	Socket clientSocket = createConnectingSocket(
+		clientContext,
+		proxyService);
+
+	if (clientSocket == NULL)
+		return false;
+
+	Socket acceptedSocket = NULL;
+	double timeoutTime = getCurrentClock() + TIMEOUT_TIME;
+
+	while (acceptedSocket == NULL && getCurrentClock() < timeoutTime)
+		acceptedSocket = acceptSocket(proxySocket);
+
+	Socket upstreamSocket = createConnectingSocket(
+		NULL,
+		serverService);
+
+	uint8_t* buffer = malloc(
+		PROXY_BUFFER_SIZE * sizeof(uint8_t));
+
+	if (acceptedSocket == NULL || upstreamSocket == NULL || buffer == NULL)
+	{
+		free(buffer);
+		destroySocket(upstreamSocket);
+		destroySocket(acceptedSocket);
+		destroySocket(clientSocket);
+		return false;
+	}
+
+	Proxy proxy;
+	memset(&proxy, 0, sizeof(Proxy));
+	proxy.server = server;
+	proxy.clientSocket = acceptedSocket;
+	proxy.upstreamSocket = upstreamSocket;
+	proxy.buffer = buffer;
+
+	bool isConnected = false;
+	timeoutTime = getCurrentClock() + TIMEOUT_TIME;
+
+	while (isConnected == false && result == true &&
+		getCurrentClock() < timeoutTime)
+	{
+		isConnected = connectSslSocket(clientSocket);
+		result = updateProxy(&proxy);
+	}
+
+	// Server finishes TLS 1.2 handshake before the client
+	for (int i = 0; i < 10; i++)
+		updateStreamServer(server);
+
+	if (isConnected == false || result == false || serverSession == NULL)
+	{
+		printf("Failed to establish TLS connection\n");
+		result = false;
+		goto DESTROY_SOCKETS;
+	}
+
+	size_t handshakeRecordCount = proxy.counter.recordCount;
+
+	uint8_t payloads[FRAME_COUNT][100];
+	const void* buffers[FRAME_COUNT];
+	size_t counts[FRAME_COUNT];
+	size_t frameSize = 0;
+
+	for (size_t i = 0; i < FRAME_COUNT; i++)
+	{
+		memset(payloads[i], (int)i, sizeof(payloads[i]));
+		buffers[i] = payloads[i];
+		counts[i] = 16 + i * 24;
+		// Length prefix, payload and checksum trailer
+		frameSize += sizeof(uint16_t) + counts[i] + sizeof(uint32_t);
+	}
+
+	if (streamSessionSendFrames(serverSession, buffers, counts, FRAME_COUNT) == false)
+	{
+		printf("Failed to send frames\n");
+		result = false;
+		goto DESTROY_SOCKETS;
+	}
+
+	size_t receivedSize = 0;
+	timeoutTime = getCurrentClock() + TIMEOUT_TIME;
+
+	while (receivedSize < frameSize && result == true &&
+		getCurrentClock() < timeoutTime)
+	{
+		result = updateProxy(&proxy);
+
+		size_t byteCount;
+
+		bool isReceived = socketReceive(
+			clientSocket,
+			buffer,
+			PROXY_BUFFER_SIZE,
+			&byteCount);
+
+		if (isReceived == true)
+			receivedSize += byteCount;
+	}
+
+	size_t recordCount = proxy.counter.recordCount - handshakeRecordCount;
+
+	printf("Framed batch: %d frames, %zu bytes, %zu TLS records\n",
+		FRAME_COUNT,
+		receivedSize,
+		recordCount);
+	fflush(stdout);
+
+	// All frame parts should be gathered to the one record
+	if (receivedSize != frameSize || recordCount != 1)
+		result = false;
+
+DESTROY_SOCKETS:
+	free(buffer);
+	destroySocket(upstreamSocket);
+	destroySocket(acceptedSocket);
+	destroySocket(clientSocket);
+	return result;
+}
+
+int main()
+{
+	if (initializeNetwork() == false)
+		return EXIT_FAILURE;
+
+	if (createCertificateFiles() == false)
+	{
+		printf("Failed to create certificate\n");
+		terminateNetwork();
+		return EXIT_FAILURE;
+	}
+
+	// TLS 1.2 has no post-handshake application data records
+	SslContext serverContext = createSslContextFromFile(
+		TLS_1_2_SECURITY_PROTOCOL,
+		CERTIFICATE_FILE_PATH,
+		PRIVATE_KEY_FILE_PATH,
+		false);
+	SslContext clientContext = createSslContext(
+		TLS_1_2_SECURITY_PROTOCOL,
+		NULL);
+
+	StreamServer server = NULL;
+	Socket proxySocket = NULL;
+
+	if (serverContext != NULL)
+	{
+		server = createStreamServer(
+			IP_V4_ADDRESS_FAMILY,
+			ANY_IP_ADDRESS_PORT,
+			1,
+			1,
+			0,
+			PROXY_BUFFER_SIZE,
+			PROXY_BUFFER_SIZE,
+			onSessionCreate,
+			onSessionDestroy,
+			onSessionUpdate,
+			onSessionReceive,
+			NULL,
+			serverContext);
+	}
+
+	SocketAddress proxyAddress = createSocketAddress(
+		ANY_IP_ADDRESS_V4,
+		ANY_IP_ADDRESS_PORT);
+
+	if (proxyAddress != NULL)
+	{
+		proxySocket = createSocket(
+			STREAM_SOCKET_TYPE,
+			IP_V4_ADDRESS_FAMILY,
+			proxyAddress,
+			true,
+			false,
+			NULL);
+		destroySocketAddress(proxyAddress);
+	}
+
+	bool result = false;
+
+	if (server != NULL && proxySocket != NULL && clientContext != NULL)
+	{
+		setStreamServerFraming(
+			server,
+			UINT16_STREAM_FRAMING,
+			PROXY_BUFFER_SIZE);
+		setStreamServerChecksumming(
+			server,
+			true);
+
+		result = runTest(
+			server,
+			proxySocket,
+			clientContext);
+	}
+	else
+	{
+		printf("Failed to create server or proxy\n");
+	}
+
+	destroySocket(proxySocket);
+	destroyStreamServer(server);
+	destroySslContext(clientContext);
+	destroySslContext(serverContext);
+	remove(CERTIFICATE_FILE_PATH);
+	remove(PRIVATE_KEY_FILE_PATH);
+	terminateNetwork();
+
+	return result == true ? EXIT_SUCCESS : EXIT_FAILURE;
+}